@@ -0,0 +1,240 @@
+/*
+    GatewayBench.cpp
+
+    * Benchmark of the ingestion gateway: it starts a gateway on a free local port and
+    simulates many chairs, each one on its own connection, streaming batch frames like the
+    stream transport of the sketch.
+    * It reports the sustained samples/s written by the gateway and the percentiles of the
+    ingest latency.
+    * Usage: gateway_bench [--chairs COUNT] [--seconds DURATION] [--rate BATCHES_PER_SECOND]
+    [--batch SAMPLES] [--threads COUNT] [--workers COUNT] [--data DIRECTORY]
+    A rate of 0 sends the batches as fast as possible.
+*/
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <thread>
+#include <vector>
+
+#include "Gateway.h"
+
+struct benchConfig {
+    int chairs = 2000;
+    int seconds = 10;
+    double rate = 2;
+    int batchSize = 10;
+    int threads = 4;
+    int workers = 4;
+    std::string dataPath = "gateway_bench_data";
+};
+
+// Define a simulated chair: its connection and the timestamp of its next sample
+struct simulatedChair {
+    int socket;
+    uint64_t deviceId;
+    uint64_t nextTimestampMillis;
+};
+
+static void writeLittleEndian(std::vector<uint8_t>* frame, uint64_t value, int size) {
+    for (int i = 0; i < size; i++) {
+        frame->push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+static bool sendAll(int socket, const std::vector<uint8_t>& frame) {
+    size_t sent = 0;
+    while (sent < frame.size()) {
+        ssize_t length = send(socket, frame.data() + sent, frame.size() - sent, MSG_NOSIGNAL);
+        if (length <= 0) {
+            return false;
+        }
+        sent += length;
+    }
+
+    return true;
+}
+
+static bool connectChair(uint16_t port, simulatedChair* chair) {
+    chair->socket = socket(AF_INET, SOCK_STREAM, 0);
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(chair->socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        return false;
+    }
+
+    int enable = 1;
+    setsockopt(chair->socket, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+    std::vector<uint8_t> hello;
+    writeLittleEndian(&hello, 1 + STREAM_HELLO_BODY_SIZE, 4);
+    hello.push_back(STREAM_FRAME_HELLO);
+    hello.push_back(STREAM_PROTOCOL_VERSION);
+    hello.push_back(PRESSURE_SENSOR_COUNT);
+    writeLittleEndian(&hello, chair->deviceId, 6);
+
+    return sendAll(chair->socket, hello);
+}
+
+static void buildBatch(simulatedChair* chair, int batchSize, std::vector<uint8_t>* frame) {
+    frame->clear();
+    writeLittleEndian(frame, 1 + STREAM_BATCH_HEADER_SIZE + batchSize * STREAM_SAMPLE_SIZE, 4);
+    frame->push_back(STREAM_FRAME_BATCH);
+    writeLittleEndian(frame, batchSize, 2);
+
+    for (int i = 0; i < batchSize; i++) {
+        // The samples are 500 ms apart, as with the default sample rate of the sketch
+        writeLittleEndian(frame, chair->nextTimestampMillis, 8);
+        chair->nextTimestampMillis += 500;
+
+        for (int j = 0; j < PRESSURE_SENSOR_COUNT; j++) {
+            writeLittleEndian(frame, (chair->nextTimestampMillis / 500 + j) % 4096, 2);
+        }
+    }
+}
+
+static void runClients(const benchConfig* config, std::vector<simulatedChair>* chairs,
+                       const std::atomic<bool>* running, std::atomic<uint64_t>* sentSamples) {
+    std::vector<uint8_t> frame;
+    auto start = std::chrono::steady_clock::now();
+    uint64_t round = 0;
+
+    while (running->load()) {
+        for (simulatedChair& chair : *chairs) {
+            buildBatch(&chair, config->batchSize, &frame);
+            if (!sendAll(chair.socket, frame)) {
+                return;
+            }
+            sentSamples->fetch_add(config->batchSize, std::memory_order_relaxed);
+        }
+
+        // Pace the rounds, each chair sends one batch per round
+        round++;
+        if (config->rate > 0) {
+            std::this_thread::sleep_until(start + std::chrono::microseconds(
+                static_cast<uint64_t>(round * 1e6 / config->rate)));
+        }
+    }
+}
+
+static bool parseArguments(int argc, char** argv, benchConfig* config) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const char* value = argv[i + 1];
+
+        if (strcmp(argv[i], "--chairs") == 0) {
+            config->chairs = atoi(value);
+        } else if (strcmp(argv[i], "--seconds") == 0) {
+            config->seconds = atoi(value);
+        } else if (strcmp(argv[i], "--rate") == 0) {
+            config->rate = atof(value);
+        } else if (strcmp(argv[i], "--batch") == 0) {
+            config->batchSize = atoi(value);
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            config->threads = atoi(value);
+        } else if (strcmp(argv[i], "--workers") == 0) {
+            config->workers = atoi(value);
+        } else if (strcmp(argv[i], "--data") == 0) {
+            config->dataPath = value;
+        } else {
+            return false;
+        }
+    }
+
+    return argc % 2 == 1 && config->chairs > 0 && config->threads > 0 && config->batchSize > 0
+           && config->batchSize <= STREAM_MAX_BATCH_SAMPLES;
+}
+
+int main(int argc, char** argv) {
+    benchConfig config;
+    if (!parseArguments(argc, argv, &config)) {
+        fprintf(stderr, "Usage: %s [--chairs COUNT] [--seconds DURATION] [--rate BATCHES/S] "
+                        "[--batch SAMPLES] [--threads COUNT] [--workers COUNT] "
+                        "[--data DIRECTORY]\n", argv[0]);
+        return 1;
+    }
+
+    std::filesystem::remove_all(config.dataPath);
+
+    gatewayConfig serverConfig;
+    serverConfig.host = "127.0.0.1";
+    serverConfig.port = 0;
+    serverConfig.dataPath = config.dataPath;
+    serverConfig.workerCount = config.workers;
+
+    Gateway gateway(serverConfig);
+    if (!gateway.start()) {
+        perror("Could not start the gateway");
+        return 1;
+    }
+
+    // Spread the chairs over the client threads, all starting at the current time
+    uint64_t nowMillis = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    std::vector<std::vector<simulatedChair>> chairsByThread(config.threads);
+    for (int i = 0; i < config.chairs; i++) {
+        simulatedChair chair = {-1, 0x0000a0000000ULL + i, nowMillis};
+        if (!connectChair(gateway.getPort(), &chair)) {
+            perror("Could not connect a chair");
+            return 1;
+        }
+        chairsByThread[i % config.threads].push_back(chair);
+    }
+
+    std::atomic<bool> running{true};
+    std::atomic<uint64_t> sentSamples{0};
+    std::vector<std::thread> clients;
+    for (int i = 0; i < config.threads; i++) {
+        clients.emplace_back(runClients, &config, &chairsByThread[i], &running, &sentSamples);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(std::chrono::seconds(config.seconds));
+    running.store(false);
+    for (std::thread& client : clients) {
+        client.join();
+    }
+
+    // Wait for the gateway to write what was already sent
+    while (gateway.getStats().samplesWritten + gateway.getStats().duplicates
+               < sentSamples.load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    double elapsedSeconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+
+    for (std::vector<simulatedChair>& chairs : chairsByThread) {
+        for (simulatedChair& chair : chairs) {
+            close(chair.socket);
+        }
+    }
+
+    gatewayStats stats = gateway.getStats();
+    const LatencyHistogram& latencies = gateway.getLatencies();
+    printf("chairs=%d batches=%llu samples=%llu duplicates=%llu invalid=%llu failures=%llu\n",
+           config.chairs, static_cast<unsigned long long>(stats.batches),
+           static_cast<unsigned long long>(stats.samplesWritten),
+           static_cast<unsigned long long>(stats.duplicates),
+           static_cast<unsigned long long>(stats.invalidSamples),
+           static_cast<unsigned long long>(stats.writeFailures));
+    printf("throughput=%.0f samples/s\n", stats.samplesWritten / elapsedSeconds);
+    printf("ingest latency: p50=%lluus p99=%lluus p99.9=%lluus\n",
+           static_cast<unsigned long long>(latencies.getPercentile(50)),
+           static_cast<unsigned long long>(latencies.getPercentile(99)),
+           static_cast<unsigned long long>(latencies.getPercentile(99.9)));
+
+    gateway.stop();
+
+    return 0;
+}
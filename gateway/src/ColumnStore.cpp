@@ -0,0 +1,171 @@
+#include <ctime>
+#include <filesystem>
+
+#include "ColumnStore.h"
+
+const uint64_t MILLIS_PER_DAY = 24ULL * 60 * 60 * 1000;
+
+// Append an unsigned integer in little-endian order
+static void appendLittleEndian(std::vector<uint8_t>* data, uint64_t value, int size) {
+    for (int i = 0; i < size; i++) {
+        data->push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+ColumnStore::ColumnStore(const std::string& rootPath, size_t maxOpenFiles)
+    : rootPath(rootPath), maxOpenFiles(maxOpenFiles) {}
+
+ColumnStore::~ColumnStore() {
+    for (auto& entry : writers) {
+        if (entry.second.file != nullptr) {
+            fclose(entry.second.file);
+        }
+    }
+}
+
+bool ColumnStore::openDay(uint64_t deviceId, deviceWriter* writer, int64_t day) {
+    if (writer->file != nullptr) {
+        fclose(writer->file);
+        writer->file = nullptr;
+        openFiles--;
+    }
+    if (openFiles >= maxOpenFiles) {
+        closeLeastRecentlyUsed();
+    }
+
+    char device[16];
+    snprintf(device, sizeof(device), "%012llx", static_cast<unsigned long long>(deviceId));
+
+    time_t daySeconds = day * (MILLIS_PER_DAY / 1000);
+    struct tm timeInfo;
+    gmtime_r(&daySeconds, &timeInfo);
+    char date[16];
+    strftime(date, sizeof(date), "%F", &timeInfo);
+
+    std::filesystem::path directory = std::filesystem::path(rootPath) / device;
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        return false;
+    }
+
+    std::string path = (directory / (std::string(date) + ".scol")).string();
+    FILE* file = fopen(path.c_str(), "ab+");
+    if (file == nullptr) {
+        return false;
+    }
+
+    // Recover the watermark from the end of the last block, written before a restart
+    if (fseek(file, 0, SEEK_END) == 0 && ftell(file) >= 8 && fseek(file, -8, SEEK_END) == 0) {
+        uint8_t tail[8];
+        if (fread(tail, 1, sizeof(tail), file) == sizeof(tail)) {
+            uint64_t lastTimestampMillis = 0;
+            for (int i = 7; i >= 0; i--) {
+                lastTimestampMillis = (lastTimestampMillis << 8) | tail[i];
+            }
+            if (lastTimestampMillis > writer->lastTimestampMillis) {
+                writer->lastTimestampMillis = lastTimestampMillis;
+            }
+        }
+    }
+
+    writer->file = file;
+    writer->day = day;
+    openFiles++;
+
+    return true;
+}
+
+void ColumnStore::closeLeastRecentlyUsed() {
+    deviceWriter* oldest = nullptr;
+    for (auto& entry : writers) {
+        deviceWriter* writer = &entry.second;
+        if (writer->file != nullptr && (oldest == nullptr || writer->lastUse < oldest->lastUse)) {
+            oldest = writer;
+        }
+    }
+
+    if (oldest != nullptr) {
+        fclose(oldest->file);
+        oldest->file = nullptr;
+        oldest->day = -1;
+        openFiles--;
+    }
+}
+
+bool ColumnStore::writeBlock(deviceWriter* writer, appendResult* result) {
+    if (staged.empty()) {
+        return true;
+    }
+
+    size_t count = staged.size();
+    block.clear();
+    appendLittleEndian(&block, COLUMN_BLOCK_MAGIC, 4);
+    appendLittleEndian(&block, count, 4);
+    for (const gatewaySample& sample : staged) {
+        appendLittleEndian(&block, sample.timestampMillis, 8);
+    }
+    for (int j = 0; j < PRESSURE_SENSOR_COUNT; j++) {
+        for (const gatewaySample& sample : staged) {
+            appendLittleEndian(&block, sample.pressureSensor[j], 2);
+        }
+    }
+    uint64_t lastTimestampMillis = staged.back().timestampMillis;
+    appendLittleEndian(&block, lastTimestampMillis, 8);
+
+    staged.clear();
+
+    // The block is written at once and flushed, so a reader never sees half of a batch
+    if (fwrite(block.data(), 1, block.size(), writer->file) != block.size()
+            || fflush(writer->file) != 0) {
+        return false;
+    }
+
+    // The watermark only covers the samples on the file, so the ones of a failed block are
+    // written again when the device sends them again
+    writer->lastTimestampMillis = lastTimestampMillis;
+    result->written += count;
+    return true;
+}
+
+appendResult ColumnStore::append(const deviceBatch& batch, uint64_t nowMillis) {
+    appendResult result;
+    deviceWriter* writer = &writers[batch.deviceId];
+    writer->lastUse = ++useCounter;
+
+    for (const gatewaySample& sample : batch.samples) {
+        if (sample.timestampMillis < GATEWAY_MIN_TIMESTAMP_MILLIS
+                || sample.timestampMillis > nowMillis + GATEWAY_MAX_CLOCK_SKEW_MILLIS) {
+            result.invalid++;
+            continue;
+        }
+
+        // Each day has its own file, so the block is split when the samples cross midnight
+        int64_t day = sample.timestampMillis / MILLIS_PER_DAY;
+        if (day != writer->day || writer->file == nullptr) {
+            if ((writer->file != nullptr && !writeBlock(writer, &result))
+                    || !openDay(batch.deviceId, writer, day)) {
+                staged.clear();
+                result.failed = true;
+                return result;
+            }
+        }
+
+        // The devices send their samples in order, so anything up to the watermark was
+        // already written, or staged in the block
+        uint64_t watermarkMillis = staged.empty() ? writer->lastTimestampMillis
+                                                  : staged.back().timestampMillis;
+        if (sample.timestampMillis <= watermarkMillis) {
+            result.duplicates++;
+            continue;
+        }
+
+        staged.push_back(sample);
+    }
+
+    if (writer->file != nullptr && !writeBlock(writer, &result)) {
+        result.failed = true;
+    }
+
+    return result;
+}
@@ -0,0 +1,94 @@
+/*
+    ColumnStore.h
+
+    * This module appends the samples of each device to columnar files, one per device and per
+    day (UTC): <root>/<MAC>/<YYYY-MM-DD>.scol
+    * Each write appends a block with the samples of a batch, column by column, so that a
+    reader of a single sensor only touches its own bytes (little-endian):
+    [uint32 magic "SCB1"][uint32 sample count]
+    [uint64 timestamp in milliseconds] x count
+    [uint16 value of the sensor 1] x count ... [uint16 value of the sensor 12] x count
+    [uint64 timestamp of the last sample]
+    * The last timestamp closes each block, so the newest sample of a file is read from its
+    last bytes. It is the watermark that drops the samples sent again by a device (at-least-once
+    delivery), which survives restarts of the gateway.
+*/
+
+#ifndef ColumnStore_H_
+#define ColumnStore_H_
+
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Protocol.h"
+
+// Define the magic number at the start of each block ("SCB1")
+const uint32_t COLUMN_BLOCK_MAGIC = 0x31424353;
+
+// Define the oldest timestamp accepted (2020-01-01), older ones come from a device without NTP
+const uint64_t GATEWAY_MIN_TIMESTAMP_MILLIS = 1577836800000ULL;
+// Define how far in the future a timestamp is accepted, in milliseconds (ms)
+const uint64_t GATEWAY_MAX_CLOCK_SKEW_MILLIS = 24ULL * 60 * 60 * 1000;
+
+// Define the result of appending a batch
+struct appendResult {
+    uint32_t written = 0;
+    uint32_t duplicates = 0;
+    uint32_t invalid = 0;
+    bool failed = false;
+};
+
+/**
+ * Class that appends the batches of the devices to their columnar files. Each instance is only
+ * used by a single worker, which owns a disjoint set of devices
+ */
+class ColumnStore {
+    // Define the state of a device: its watermark and its open file
+    struct deviceWriter {
+        uint64_t lastTimestampMillis = 0;
+        int64_t day = -1;
+        FILE* file = nullptr;
+        uint64_t lastUse = 0;
+    };
+
+    std::string rootPath;
+    // The devices are many more than the file descriptors, so only the recent ones stay open
+    size_t maxOpenFiles;
+    size_t openFiles = 0;
+    uint64_t useCounter = 0;
+
+    std::unordered_map<uint64_t, deviceWriter> writers;
+
+    // Reuse the arrays of the block being written between the batches
+    std::vector<gatewaySample> staged;
+    std::vector<uint8_t> block;
+
+    bool openDay(uint64_t deviceId, deviceWriter* writer, int64_t day);
+    void closeLeastRecentlyUsed();
+    // Write the staged samples as a block, then advance the watermark and count them as written
+    bool writeBlock(deviceWriter* writer, appendResult* result);
+
+public:
+    /**
+     * Constructor for the ColumnStore class
+     * @param rootPath The directory of the files
+     * @param maxOpenFiles The maximum amount of files kept open
+     */
+    ColumnStore(const std::string& rootPath, size_t maxOpenFiles);
+    ~ColumnStore();
+
+    ColumnStore(const ColumnStore&) = delete;
+    ColumnStore& operator=(const ColumnStore&) = delete;
+
+    /**
+     * Validate, deduplicate and append the samples of a batch
+     * @param batch The batch to be appended
+     * @param nowMillis The current Unix time, to reject the samples from the future
+     * @return The amount of samples written, duplicated and invalid
+     */
+    appendResult append(const deviceBatch& batch, uint64_t nowMillis);
+};
+
+#endif  // ColumnStore_H_
@@ -0,0 +1,409 @@
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+
+#include "Gateway.h"
+
+// Set the maximum amount of events handled by each call of epoll_wait()
+const int GATEWAY_MAX_EVENTS = 256;
+// Set the size of the array of each read from a socket, in bytes
+const size_t GATEWAY_READ_SIZE = 64 * 1024;
+
+LatencyHistogram::LatencyHistogram() {
+    for (std::atomic<uint64_t>& bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+void LatencyHistogram::record(uint64_t micros) {
+    int bucket;
+    if (micros < LATENCY_SUB_BUCKETS) {
+        bucket = micros;
+    } else {
+        // Split each power of two in sub-buckets, using the bits that follow the highest one
+        int exponent = 63 - __builtin_clzll(micros);
+        int subBucket = (micros >> (exponent - LATENCY_SUB_BUCKET_BITS)) & (LATENCY_SUB_BUCKETS - 1);
+        bucket = (exponent - LATENCY_SUB_BUCKET_BITS + 1) * LATENCY_SUB_BUCKETS + subBucket;
+    }
+
+    buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::getPercentile(double percentile) const {
+    uint64_t total = 0;
+    for (const std::atomic<uint64_t>& bucket : buckets) {
+        total += bucket.load(std::memory_order_relaxed);
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    uint64_t target = static_cast<uint64_t>(total * percentile / 100.0);
+    uint64_t count = 0;
+    for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+        count += buckets[i].load(std::memory_order_relaxed);
+        if (count > target || count == total) {
+            if (i < LATENCY_SUB_BUCKETS) {
+                return i;
+            }
+
+            int exponent = i / LATENCY_SUB_BUCKETS + LATENCY_SUB_BUCKET_BITS - 1;
+            uint64_t subBucket = i % LATENCY_SUB_BUCKETS;
+            return ((LATENCY_SUB_BUCKETS + subBucket + 1) << (exponent - LATENCY_SUB_BUCKET_BITS))
+                   - 1;
+        }
+    }
+
+    return 0;
+}
+
+Gateway::Gateway(const gatewayConfig& config) : config(config) {}
+
+Gateway::~Gateway() {
+    stop();
+}
+
+bool Gateway::start() {
+    listenSocket = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenSocket < 0) {
+        return false;
+    }
+
+    int enable = 1;
+    setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(config.port);
+    if (inet_pton(AF_INET, config.host.c_str(), &address.sin_addr) != 1
+            || bind(listenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+            || listen(listenSocket, SOMAXCONN) != 0) {
+        close(listenSocket);
+        listenSocket = -1;
+        return false;
+    }
+
+    socklen_t addressLength = sizeof(address);
+    getsockname(listenSocket, reinterpret_cast<sockaddr*>(&address), &addressLength);
+    port = ntohs(address.sin_port);
+
+    epollDescriptor = epoll_create1(EPOLL_CLOEXEC);
+    stopEvent = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    resumeEvent = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = listenSocket;
+    epoll_ctl(epollDescriptor, EPOLL_CTL_ADD, listenSocket, &event);
+    event.data.fd = stopEvent;
+    epoll_ctl(epollDescriptor, EPOLL_CTL_ADD, stopEvent, &event);
+    event.data.fd = resumeEvent;
+    epoll_ctl(epollDescriptor, EPOLL_CTL_ADD, resumeEvent, &event);
+
+    for (int i = 0; i < config.workerCount; i++) {
+        queues.emplace_back(new workerQueue());
+    }
+    for (int i = 0; i < config.workerCount; i++) {
+        workerThreads.emplace_back(&Gateway::runWorker, this, i);
+    }
+    eventLoopThread = std::thread(&Gateway::runEventLoop, this);
+
+    return true;
+}
+
+void Gateway::stop() {
+    if (!eventLoopThread.joinable()) {
+        return;
+    }
+
+    uint64_t value = 1;
+    if (write(stopEvent, &value, sizeof(value)) != sizeof(value)) {
+        perror("Could not stop the event loop");
+    }
+    eventLoopThread.join();
+
+    // The batches held by the paused connections are queued too, past the capacity
+    for (int socket : pausedSockets) {
+        dispatch(&connectionStates[socket].heldBatch, true);
+    }
+    pausedSockets.clear();
+
+    // The workers finish the batches already queued before leaving
+    for (std::unique_ptr<workerQueue>& queue : queues) {
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        queue->closed = true;
+        queue->notEmpty.notify_all();
+    }
+    for (std::thread& worker : workerThreads) {
+        worker.join();
+    }
+    workerThreads.clear();
+    queues.clear();
+
+    for (auto& entry : connectionStates) {
+        close(entry.first);
+    }
+    connectionStates.clear();
+
+    close(listenSocket);
+    close(epollDescriptor);
+    close(stopEvent);
+    close(resumeEvent);
+    listenSocket = epollDescriptor = stopEvent = resumeEvent = -1;
+}
+
+void Gateway::runEventLoop() {
+    epoll_event events[GATEWAY_MAX_EVENTS];
+
+    while (true) {
+        int count = epoll_wait(epollDescriptor, events, GATEWAY_MAX_EVENTS, -1);
+        if (count < 0 && errno != EINTR) {
+            perror("epoll_wait");
+            return;
+        }
+
+        for (int i = 0; i < count; i++) {
+            int descriptor = events[i].data.fd;
+
+            if (descriptor == stopEvent) {
+                return;
+            } else if (descriptor == resumeEvent) {
+                resumeConnections();
+            } else if (descriptor == listenSocket) {
+                acceptConnections();
+            } else if ((events[i].events & (EPOLLERR | EPOLLHUP)) != 0
+                           && (events[i].events & EPOLLIN) == 0) {
+                closeConnection(descriptor);
+            } else if (!readConnection(descriptor)) {
+                closeConnection(descriptor);
+            }
+        }
+    }
+}
+
+void Gateway::acceptConnections() {
+    while (true) {
+        int socket = accept4(listenSocket, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (socket < 0) {
+            return;
+        }
+
+        epoll_event event = {};
+        event.events = EPOLLIN | EPOLLRDHUP;
+        event.data.fd = socket;
+        if (epoll_ctl(epollDescriptor, EPOLL_CTL_ADD, socket, &event) != 0) {
+            close(socket);
+            continue;
+        }
+
+        connectionStates[socket];
+        connections.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+bool Gateway::readConnection(int socket) {
+    static thread_local uint8_t data[GATEWAY_READ_SIZE];
+    connectionState* connection = &connectionStates[socket];
+
+    // Read until the socket is drained, the event is level-triggered but a single wake up per
+    // burst is cheaper. The frames of each read are decoded before the next one, so that a
+    // connection only keeps the start of a frame between the reads
+    while (!connection->paused) {
+        ssize_t length = read(socket, data, sizeof(data));
+        if (length == 0) {
+            return false;
+        }
+        if (length < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return true;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+
+        connection->decoder.feed(data, length);
+        if (!decodeFrames(socket, connection)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool Gateway::decodeFrames(int socket, connectionState* connection) {
+    while (true) {
+        FrameStatus status = connection->decoder.next(&connection->heldBatch);
+
+        if (status == FrameStatus::Incomplete) {
+            break;
+        }
+        if (status == FrameStatus::Invalid) {
+            invalidStreams.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        if (status == FrameStatus::Batch && !dispatch(&connection->heldBatch, false)) {
+            pauseConnection(socket, connection);
+            return true;
+        }
+    }
+
+    // What is left can't be more than a frame, or the stream lost its alignment with the frames
+    if (connection->decoder.getPendingLength() > STREAM_LENGTH_SIZE + STREAM_MAX_FRAME_LENGTH) {
+        invalidStreams.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    return true;
+}
+
+void Gateway::pauseConnection(int socket, connectionState* connection) {
+    // Without EPOLLIN the socket isn't read, so its buffer fills up and TCP slows down the
+    // device, while the event loop keeps serving the other connections
+    epoll_event event = {};
+    event.events = 0;
+    event.data.fd = socket;
+    epoll_ctl(epollDescriptor, EPOLL_CTL_MOD, socket, &event);
+
+    connection->paused = true;
+    pausedSockets.push_back(socket);
+}
+
+void Gateway::resumeConnections() {
+    uint64_t value;
+    if (read(resumeEvent, &value, sizeof(value)) != sizeof(value)) {
+        return;
+    }
+
+    std::vector<int> sockets;
+    sockets.swap(pausedSockets);
+    for (int socket : sockets) {
+        // The batch held goes first, and the connection stays paused if its queue is still full
+        connectionState* connection = &connectionStates[socket];
+        if (!dispatch(&connection->heldBatch, false)) {
+            pausedSockets.push_back(socket);
+            continue;
+        }
+
+        connection->paused = false;
+        epoll_event event = {};
+        event.events = EPOLLIN | EPOLLRDHUP;
+        event.data.fd = socket;
+        epoll_ctl(epollDescriptor, EPOLL_CTL_MOD, socket, &event);
+
+        // The frames already received are decoded now, the socket may not be readable again
+        if (!decodeFrames(socket, connection)) {
+            closeConnection(socket);
+        }
+    }
+}
+
+void Gateway::closeConnection(int socket) {
+    epoll_ctl(epollDescriptor, EPOLL_CTL_DEL, socket, nullptr);
+    close(socket);
+
+    // The batch held by a paused connection was received whole, so it is queued anyway
+    auto entry = connectionStates.find(socket);
+    if (entry != connectionStates.end() && entry->second.paused) {
+        dispatch(&entry->second.heldBatch, true);
+        pausedSockets.erase(std::remove(pausedSockets.begin(), pausedSockets.end(), socket),
+                            pausedSockets.end());
+    }
+    connectionStates.erase(socket);
+}
+
+bool Gateway::dispatch(deviceBatch* batch, bool force) {
+    workerQueue* queue = queues[std::hash<uint64_t>()(batch->deviceId) % queues.size()].get();
+
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    if (queue->batches.size() >= GATEWAY_QUEUE_CAPACITY && !force) {
+        queue->connectionsPaused = true;
+        return false;
+    }
+
+    queue->batches.push_back(std::move(*batch));
+    queue->notEmpty.notify_one();
+    return true;
+}
+
+void Gateway::runWorker(int index) {
+    workerQueue* queue = queues[index].get();
+    ColumnStore store(config.dataPath, config.maxOpenFiles);
+
+    while (true) {
+        deviceBatch batch;
+        bool resume = false;
+        {
+            std::unique_lock<std::mutex> lock(queue->mutex);
+            queue->notEmpty.wait(lock, [queue] {
+                return !queue->batches.empty() || queue->closed;
+            });
+            if (queue->batches.empty()) {
+                return;
+            }
+
+            batch = std::move(queue->batches.front());
+            queue->batches.pop_front();
+
+            // The connections paused by a full queue are resumed once it drained enough, so
+            // that they aren't paused again by the next batch
+            if (queue->connectionsPaused && queue->batches.size() <= GATEWAY_QUEUE_RESUME_LEVEL) {
+                queue->connectionsPaused = false;
+                resume = true;
+            }
+        }
+
+        uint64_t value = 1;
+        if (resume && write(resumeEvent, &value, sizeof(value)) != sizeof(value)) {
+            perror("Could not resume the connections");
+        }
+
+        uint64_t nowMillis = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        appendResult result = store.append(batch, nowMillis);
+
+        batches.fetch_add(1, std::memory_order_relaxed);
+        samplesWritten.fetch_add(result.written, std::memory_order_relaxed);
+        duplicates.fetch_add(result.duplicates, std::memory_order_relaxed);
+        invalidSamples.fetch_add(result.invalid, std::memory_order_relaxed);
+        if (result.failed) {
+            writeFailures.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        latencies.record(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - batch.receivedAt).count());
+    }
+}
+
+uint16_t Gateway::getPort() const {
+    return port;
+}
+
+gatewayStats Gateway::getStats() const {
+    gatewayStats stats;
+    stats.connections = connections.load(std::memory_order_relaxed);
+    stats.batches = batches.load(std::memory_order_relaxed);
+    stats.samplesWritten = samplesWritten.load(std::memory_order_relaxed);
+    stats.duplicates = duplicates.load(std::memory_order_relaxed);
+    stats.invalidSamples = invalidSamples.load(std::memory_order_relaxed);
+    stats.invalidStreams = invalidStreams.load(std::memory_order_relaxed);
+    stats.writeFailures = writeFailures.load(std::memory_order_relaxed);
+
+    return stats;
+}
+
+const LatencyHistogram& Gateway::getLatencies() const {
+    return latencies;
+}
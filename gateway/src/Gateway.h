@@ -0,0 +1,192 @@
+/*
+    Gateway.h
+
+    * This module implements the ingestion gateway: a TCP server that accepts the batches
+    streamed by many devices and appends them to columnar files (see ColumnStore.h).
+    * A single thread runs an epoll event loop that accepts the connections and decodes their
+    frames (see Protocol.h). The decoded batches are handed to a pool of workers, chosen by
+    device, so that each device is written by a single worker, in order and without locks.
+    * A connection whose batch finds the queue of its worker full stops being read, while the
+    others go on, until the worker drains its queue.
+    * It also keeps the counters and the ingest latency histogram of the gateway, measured from
+    the arrival of a frame until its samples are written.
+*/
+
+#ifndef Gateway_H_
+#define Gateway_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "ColumnStore.h"
+#include "Protocol.h"
+
+// Define the amount of sub-buckets of each power of two of the latency histogram, so that
+// the percentiles have a resolution of about 6%
+const int LATENCY_SUB_BUCKET_BITS = 4;
+const int LATENCY_SUB_BUCKETS = 1 << LATENCY_SUB_BUCKET_BITS;
+const int LATENCY_HISTOGRAM_BUCKETS = 64 * LATENCY_SUB_BUCKETS;
+
+// Set the maximum amount of batches waiting for each worker. A full queue pauses the reading of
+// the connections that fill it, which lets TCP slow down their devices, until the queue drains
+// to the resume level
+const size_t GATEWAY_QUEUE_CAPACITY = 4096;
+const size_t GATEWAY_QUEUE_RESUME_LEVEL = GATEWAY_QUEUE_CAPACITY / 2;
+
+struct gatewayConfig {
+    std::string host = "0.0.0.0";
+    // Port of the server, 0 picks a free one (see getPort())
+    uint16_t port = 5555;
+    std::string dataPath = "data";
+    int workerCount = 4;
+    // Maximum amount of files kept open by each worker
+    size_t maxOpenFiles = 512;
+};
+
+// Define a snapshot of the counters of the gateway
+struct gatewayStats {
+    uint64_t connections = 0;
+    uint64_t batches = 0;
+    uint64_t samplesWritten = 0;
+    uint64_t duplicates = 0;
+    uint64_t invalidSamples = 0;
+    uint64_t invalidStreams = 0;
+    uint64_t writeFailures = 0;
+};
+
+/**
+ * Class that keeps a histogram of latencies, with log-linear buckets (HDR-like). It can be
+ * recorded from several threads
+ */
+class LatencyHistogram {
+    std::atomic<uint64_t> buckets[LATENCY_HISTOGRAM_BUCKETS];
+
+public:
+    LatencyHistogram();
+
+    /**
+     * Add a latency to the histogram
+     * @param micros The latency, in microseconds
+     */
+    void record(uint64_t micros);
+
+    /**
+     * Get a percentile of the latencies recorded
+     * @param percentile The percentile, from 0 to 100
+     * @return The upper bound of the bucket of the percentile, in microseconds
+     */
+    uint64_t getPercentile(double percentile) const;
+};
+
+/**
+ * Class that runs the gateway: the event loop and the workers
+ */
+class Gateway {
+    // Define the queue of batches of a worker
+    struct workerQueue {
+        std::mutex mutex;
+        std::condition_variable notEmpty;
+        std::deque<deviceBatch> batches;
+        bool closed = false;
+        // Store whether connections are paused until the queue drains to the resume level
+        bool connectionsPaused = false;
+    };
+
+    // Define the state of a connection: its frame decoder, and the batch decoded, held while
+    // the queue of its worker is full
+    struct connectionState {
+        FrameDecoder decoder;
+        deviceBatch heldBatch;
+        bool paused = false;
+    };
+
+    gatewayConfig config;
+
+    int listenSocket = -1;
+    int epollDescriptor = -1;
+    // Wake up the event loop to stop it, or to resume the paused connections
+    int stopEvent = -1;
+    int resumeEvent = -1;
+    uint16_t port = 0;
+
+    std::thread eventLoopThread;
+    std::vector<std::thread> workerThreads;
+    std::vector<std::unique_ptr<workerQueue>> queues;
+
+    // Store the state of each connection, by socket, and the sockets of the paused ones
+    std::unordered_map<int, connectionState> connectionStates;
+    std::vector<int> pausedSockets;
+
+    std::atomic<uint64_t> connections{0};
+    std::atomic<uint64_t> batches{0};
+    std::atomic<uint64_t> samplesWritten{0};
+    std::atomic<uint64_t> duplicates{0};
+    std::atomic<uint64_t> invalidSamples{0};
+    std::atomic<uint64_t> invalidStreams{0};
+    std::atomic<uint64_t> writeFailures{0};
+
+    LatencyHistogram latencies;
+
+    void runEventLoop();
+    void acceptConnections();
+    // Read and decode the frames of a connection, returning false if it must be closed
+    bool readConnection(int socket);
+    // Decode the complete frames received and dispatch their batches, pausing the connection if
+    // its worker is full, returning false if the stream is invalid
+    bool decodeFrames(int socket, connectionState* connection);
+    void pauseConnection(int socket, connectionState* connection);
+    void resumeConnections();
+    void closeConnection(int socket);
+    // Queue a batch for its worker, returning false if the queue is full, unless forced
+    bool dispatch(deviceBatch* batch, bool force);
+    void runWorker(int index);
+
+public:
+    /**
+     * Constructor for the Gateway class
+     * @param config The configuration of the gateway
+     */
+    explicit Gateway(const gatewayConfig& config);
+    ~Gateway();
+
+    Gateway(const Gateway&) = delete;
+    Gateway& operator=(const Gateway&) = delete;
+
+    /**
+     * Open the server and start the event loop and the workers
+     * @return true if the server is listening, false otherwise
+     */
+    bool start();
+
+    /**
+     * Stop the event loop, write the queued batches and stop the workers
+     */
+    void stop();
+
+    /**
+     * Get the port of the server, useful when it was picked by the system
+     * @return The port of the server
+     */
+    uint16_t getPort() const;
+
+    /**
+     * Get a snapshot of the counters of the gateway
+     * @return The counters of the gateway
+     */
+    gatewayStats getStats() const;
+
+    /**
+     * Get the histogram of the ingest latencies
+     * @return The histogram of the ingest latencies
+     */
+    const LatencyHistogram& getLatencies() const;
+};
+
+#endif  // Gateway_H_
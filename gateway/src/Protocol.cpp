@@ -0,0 +1,104 @@
+#include "Protocol.h"
+
+// Read an unsigned integer stored in little-endian order
+static uint64_t readLittleEndian(const uint8_t* position, int size) {
+    uint64_t value = 0;
+    for (int i = size - 1; i >= 0; i--) {
+        value = (value << 8) | position[i];
+    }
+
+    return value;
+}
+
+void FrameDecoder::feed(const uint8_t* data, size_t length) {
+    // Drop the decoded bytes once they take most of the array, instead of on every frame
+    if (consumed > 0 && consumed >= pending.size() / 2) {
+        pending.erase(pending.begin(), pending.begin() + consumed);
+        consumed = 0;
+    }
+
+    pending.insert(pending.end(), data, data + length);
+}
+
+FrameStatus FrameDecoder::next(deviceBatch* batch) {
+    size_t available = pending.size() - consumed;
+    if (available < STREAM_LENGTH_SIZE) {
+        return FrameStatus::Incomplete;
+    }
+
+    const uint8_t* frame = &pending[consumed];
+    uint32_t frameLength = readLittleEndian(frame, STREAM_LENGTH_SIZE);
+
+    // A length out of bounds means that the stream lost its alignment with the frames
+    if (frameLength < 1 || frameLength > STREAM_MAX_FRAME_LENGTH) {
+        return FrameStatus::Invalid;
+    }
+    if (available < STREAM_LENGTH_SIZE + frameLength) {
+        return FrameStatus::Incomplete;
+    }
+
+    consumed += STREAM_LENGTH_SIZE + frameLength;
+
+    uint8_t type = frame[STREAM_LENGTH_SIZE];
+    const uint8_t* body = frame + STREAM_LENGTH_SIZE + 1;
+    size_t bodyLength = frameLength - 1;
+
+    if (type == STREAM_FRAME_HELLO) {
+        return decodeHello(body, bodyLength);
+    }
+    if (type == STREAM_FRAME_BATCH && identified) {
+        return decodeBatch(body, bodyLength, batch);
+    }
+
+    return FrameStatus::Invalid;
+}
+
+FrameStatus FrameDecoder::decodeHello(const uint8_t* body, size_t length) {
+    if (length != STREAM_HELLO_BODY_SIZE || body[0] != STREAM_PROTOCOL_VERSION
+            || body[1] != PRESSURE_SENSOR_COUNT) {
+        return FrameStatus::Invalid;
+    }
+
+    deviceId = readLittleEndian(&body[2], 6);
+    identified = true;
+
+    return FrameStatus::Hello;
+}
+
+FrameStatus FrameDecoder::decodeBatch(const uint8_t* body, size_t length,
+                                      deviceBatch* batch) const {
+    if (length < STREAM_BATCH_HEADER_SIZE) {
+        return FrameStatus::Invalid;
+    }
+
+    size_t count = readLittleEndian(body, STREAM_BATCH_HEADER_SIZE);
+    if (length != STREAM_BATCH_HEADER_SIZE + count * STREAM_SAMPLE_SIZE) {
+        return FrameStatus::Invalid;
+    }
+
+    batch->deviceId = deviceId;
+    batch->receivedAt = std::chrono::steady_clock::now();
+    batch->samples.resize(count);
+
+    const uint8_t* position = body + STREAM_BATCH_HEADER_SIZE;
+    for (size_t i = 0; i < count; i++) {
+        gatewaySample* sample = &batch->samples[i];
+
+        sample->timestampMillis = readLittleEndian(position, 8);
+        position += 8;
+        for (int j = 0; j < PRESSURE_SENSOR_COUNT; j++) {
+            sample->pressureSensor[j] = readLittleEndian(position, 2);
+            position += 2;
+        }
+    }
+
+    return FrameStatus::Batch;
+}
+
+size_t FrameDecoder::getPendingLength() const {
+    return pending.size() - consumed;
+}
+
+uint64_t FrameDecoder::getDeviceId() const {
+    return deviceId;
+}
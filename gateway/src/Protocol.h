@@ -0,0 +1,109 @@
+/*
+    Protocol.h
+
+    * This module decodes the frames that the devices stream to the gateway, in the format of
+    the stream transport of the sketch (see mainSketch/StreamTransport.h):
+    * [uint32 frame length, excluding this field][uint8 frame type][frame body], little-endian
+    * Hello frame: [uint8 version][uint8 sensor count][6 bytes MAC]
+    * Batch frame: [uint16 sample count] followed, for each sample, by
+    [uint64 timestamp in milliseconds][uint16 value of each pressure sensor]
+    * The bytes are decoded incrementally, as they arrive from a connection.
+*/
+
+#ifndef Protocol_H_
+#define Protocol_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Mirror the constants of the sketch, which can't be included on the host
+const uint8_t STREAM_PROTOCOL_VERSION = 1;
+const uint8_t STREAM_FRAME_HELLO = 1;
+const uint8_t STREAM_FRAME_BATCH = 2;
+const int STREAM_MAX_BATCH_SAMPLES = 128;
+const int PRESSURE_SENSOR_COUNT = 12;
+
+// Define the size of each part of the frames, in bytes
+const size_t STREAM_LENGTH_SIZE = 4;
+const size_t STREAM_HELLO_BODY_SIZE = 1 + 1 + 6;
+const size_t STREAM_BATCH_HEADER_SIZE = 2;
+const size_t STREAM_SAMPLE_SIZE = 8 + 2 * PRESSURE_SENSOR_COUNT;
+// Define the largest frame length accepted, a full batch with its type
+const uint32_t STREAM_MAX_FRAME_LENGTH =
+    1 + STREAM_BATCH_HEADER_SIZE + STREAM_MAX_BATCH_SAMPLES * STREAM_SAMPLE_SIZE;
+
+struct gatewaySample {
+    uint64_t timestampMillis;
+    uint16_t pressureSensor[PRESSURE_SENSOR_COUNT];
+};
+
+// Define a batch received from a device, as handed from the event loop to the workers
+struct deviceBatch {
+    // MAC address of the device, from its hello frame
+    uint64_t deviceId;
+    // Time when the whole frame was received, to measure the ingest latency
+    std::chrono::steady_clock::time_point receivedAt;
+    std::vector<gatewaySample> samples;
+};
+
+/**
+ * Enumerate the results of decoding a frame
+ *
+ * Incomplete: the frame didn't fully arrive yet
+ * Hello: the device was identified
+ * Batch: a batch was decoded
+ * Invalid: the stream is corrupted or doesn't follow the protocol, so it must be closed
+ */
+enum class FrameStatus {
+    Incomplete,
+    Hello,
+    Batch,
+    Invalid
+};
+
+/**
+ * Class that decodes the frames of a single connection
+ */
+class FrameDecoder {
+    // Store the bytes received and not decoded yet, from the position consumed
+    std::vector<uint8_t> pending;
+    size_t consumed = 0;
+
+    // Store the device of the connection, once its hello frame is decoded
+    uint64_t deviceId = 0;
+    bool identified = false;
+
+    FrameStatus decodeHello(const uint8_t* body, size_t length);
+    FrameStatus decodeBatch(const uint8_t* body, size_t length, deviceBatch* batch) const;
+
+public:
+    /**
+     * Add the bytes received from the connection
+     * @param data The bytes received
+     * @param length The amount of bytes received
+     */
+    void feed(const uint8_t* data, size_t length);
+
+    /**
+     * Decode the next complete frame
+     * @param batch The batch to be filled, if the frame is a batch
+     * @return The result of the decoding
+     */
+    FrameStatus next(deviceBatch* batch);
+
+    /**
+     * Get the amount of bytes received and not decoded yet
+     * @return The amount of bytes pending
+     */
+    size_t getPendingLength() const;
+
+    /**
+     * Get the device of the connection
+     * @return The MAC address of the device, valid after the hello frame
+     */
+    uint64_t getDeviceId() const;
+};
+
+#endif  // Protocol_H_
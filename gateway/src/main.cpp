@@ -0,0 +1,93 @@
+/*
+    main.cpp
+
+    * Entry point of the ingestion gateway server.
+    * Usage: smartchair_gateway [--host ADDRESS] [--port PORT] [--data DIRECTORY]
+    [--workers COUNT] [--max-open-files COUNT]
+*/
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include "Gateway.h"
+
+// Set the interval between the reports of the counters, in seconds (s)
+const int GATEWAY_REPORT_INTERVAL_SECONDS = 10;
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void onSignal(int) {
+    stopRequested = 1;
+}
+
+static bool parseArguments(int argc, char** argv, gatewayConfig* config) {
+    for (int i = 1; i < argc; i++) {
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        if (value == nullptr) {
+            return false;
+        } else if (strcmp(argv[i], "--host") == 0) {
+            config->host = value;
+        } else if (strcmp(argv[i], "--port") == 0) {
+            config->port = atoi(value);
+        } else if (strcmp(argv[i], "--data") == 0) {
+            config->dataPath = value;
+        } else if (strcmp(argv[i], "--workers") == 0) {
+            config->workerCount = atoi(value);
+        } else if (strcmp(argv[i], "--max-open-files") == 0) {
+            config->maxOpenFiles = atoi(value);
+        } else {
+            return false;
+        }
+        i++;
+    }
+
+    return config->workerCount > 0 && config->maxOpenFiles > 0;
+}
+
+int main(int argc, char** argv) {
+    gatewayConfig config;
+    if (!parseArguments(argc, argv, &config)) {
+        fprintf(stderr, "Usage: %s [--host ADDRESS] [--port PORT] [--data DIRECTORY] "
+                        "[--workers COUNT] [--max-open-files COUNT]\n", argv[0]);
+        return 1;
+    }
+
+    Gateway gateway(config);
+    if (!gateway.start()) {
+        perror("Could not start the gateway");
+        return 1;
+    }
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    printf("Listening on %s:%u, writing to %s\n", config.host.c_str(), gateway.getPort(),
+           config.dataPath.c_str());
+    fflush(stdout);
+
+    int elapsedSeconds = 0;
+    while (!stopRequested) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+
+        if (++elapsedSeconds % GATEWAY_REPORT_INTERVAL_SECONDS == 0) {
+            gatewayStats stats = gateway.getStats();
+            printf("connections=%llu batches=%llu samples=%llu duplicates=%llu invalid=%llu "
+                   "p99=%lluus\n",
+                   static_cast<unsigned long long>(stats.connections),
+                   static_cast<unsigned long long>(stats.batches),
+                   static_cast<unsigned long long>(stats.samplesWritten),
+                   static_cast<unsigned long long>(stats.duplicates),
+                   static_cast<unsigned long long>(stats.invalidSamples),
+                   static_cast<unsigned long long>(gateway.getLatencies().getPercentile(99)));
+            fflush(stdout);
+        }
+    }
+
+    gateway.stop();
+
+    return 0;
+}
@@ -0,0 +1,177 @@
+/*
+    AdcBench.cpp
+
+    * Benchmark of the acquisition path of the internal ADC (see InternalADCs.h): synthetic DMA
+    frames of the pins of the sketch are fed to the mock of the continuous mode driver (see
+    host/shims/esp_adc/adc_continuous.h), one reading interval at a time, and collected by
+    InternalADCs as at each reading of the sketch.
+    * Only the collection is timed, so the cost reported is the draining and the unpacking of
+    the frames, with and without the averaging. The values collected are checked against the
+    ones of the frames.
+    * It reports the conversions unpacked per second, the cost of each conversion and the share
+    of a core that the unpacking takes at INTERNAL_ADC_CONVERSION_RATE, on the host.
+    * Usage: adc_bench [--seconds DURATION] [--reading-rate READINGS_PER_SECOND]
+*/
+
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include <esp_adc/adc_continuous.h>
+
+#include "AsyncLog.h"
+#include "DataReader.h"
+#include "InternalADCs.h"
+
+// Set the amount of distinct reading intervals of synthetic frames, fed in turns
+const int BENCH_INTERVAL_COUNT = 64;
+
+// Define the globals of the sketch
+AsyncLog asyncLog;
+
+struct benchConfig {
+    // Set the duration of the conversions fed, in seconds of the conversion rate
+    double seconds = 600;
+    int readingRate = SAMPLE_RATE * OVERSAMPLING_RATIO;
+};
+
+/**
+ * Struct of the synthetic frames of a reading interval and the values expected from them
+ */
+struct benchInterval {
+    std::vector<uint8_t> frames;
+    uint16_t averages[INTERNAL_ADC_MAX_PINS];
+    uint16_t lasts[INTERNAL_ADC_MAX_PINS];
+};
+
+static const uint8_t pins[4] = {A2, A3, A4, A5};
+static const int pinCount = sizeof(pins) / sizeof(pins[0]);
+
+// Build the frames of the conversions of a reading interval, the pins in turns
+static void buildInterval(int resultCount, std::mt19937* random, benchInterval* interval) {
+    std::uniform_int_distribution<int> noise(-40, 40);
+    uint32_t sums[INTERNAL_ADC_MAX_PINS] = {0};
+    uint32_t counts[INTERNAL_ADC_MAX_PINS] = {0};
+    uint16_t levels[INTERNAL_ADC_MAX_PINS] = {800, 1600, 2400, 3200};
+
+    interval->frames.resize(resultCount * SOC_ADC_DIGI_RESULT_BYTES);
+    for (int i = 0; i < resultCount; i++) {
+        int pin = i % pinCount;
+        adc_digi_output_data_t result;
+        result.type1.data = levels[pin] + noise(*random);
+        result.type1.channel = pins[pin];
+        memcpy(&interval->frames[i * SOC_ADC_DIGI_RESULT_BYTES], &result,
+               SOC_ADC_DIGI_RESULT_BYTES);
+
+        sums[pin] += result.type1.data;
+        counts[pin]++;
+        interval->lasts[pin] = result.type1.data;
+    }
+
+    for (int pin = 0; pin < pinCount; pin++) {
+        interval->averages[pin] = (sums[pin] + counts[pin] / 2) / counts[pin];
+    }
+}
+
+// Feed and collect the intervals, returning the time spent collecting, in nanoseconds (ns)
+static double runBench(const std::vector<benchInterval>& intervals, long readingCount,
+                       bool averaging, long* mismatches) {
+    InternalADCs internalAdcs;
+    if (!internalAdcs.setup(pins, pinCount, averaging)) {
+        fprintf(stderr, "Could not set up the internal ADC\n");
+        exit(1);
+    }
+
+    double collectNanos = 0;
+    uint16_t readings[INTERNAL_ADC_MAX_PINS];
+    for (long reading = 0; reading < readingCount; reading++) {
+        const benchInterval& interval = intervals[reading % intervals.size()];
+        hostFeedAdcFrames(interval.frames.data(), interval.frames.size());
+
+        auto start = std::chrono::steady_clock::now();
+        internalAdcs.collect(readings);
+        collectNanos += std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - start).count();
+
+        const uint16_t* expected = averaging ? interval.averages : interval.lasts;
+        *mismatches += memcmp(readings, expected, pinCount * sizeof(uint16_t)) != 0;
+    }
+
+    return collectNanos;
+}
+
+static bool parseArguments(int argc, char** argv, benchConfig* config) {
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            return false;
+        }
+        const char* option = argv[i];
+        const char* value = argv[++i];
+
+        if (strcmp(option, "--seconds") == 0) {
+            config->seconds = atof(value);
+        } else if (strcmp(option, "--reading-rate") == 0) {
+            config->readingRate = atoi(value);
+        } else {
+            return false;
+        }
+    }
+
+    return config->seconds > 0 && config->readingRate > 0;
+}
+
+int main(int argc, char** argv) {
+    benchConfig config;
+    if (!parseArguments(argc, argv, &config)) {
+        fprintf(stderr, "Usage: %s [--seconds DURATION] [--reading-rate READINGS_PER_SECOND]\n",
+                argv[0]);
+        return 1;
+    }
+
+    // The conversions of an interval must fit in the pool, as on the device
+    int resultCount = INTERNAL_ADC_CONVERSION_RATE / config.readingRate;
+    if (resultCount < pinCount
+            || static_cast<uint32_t>(resultCount) * SOC_ADC_DIGI_RESULT_BYTES
+                   > INTERNAL_ADC_POOL_SIZE) {
+        fprintf(stderr, "The reading rate must leave between %d and %u conversions per reading\n",
+                pinCount, INTERNAL_ADC_POOL_SIZE / SOC_ADC_DIGI_RESULT_BYTES);
+        return 1;
+    }
+
+    asyncLog.setup();
+
+    std::mt19937 random(1);
+    std::vector<benchInterval> intervals(BENCH_INTERVAL_COUNT);
+    for (benchInterval& interval : intervals) {
+        buildInterval(resultCount, &random, &interval);
+    }
+
+    long readingCount = static_cast<long>(config.seconds * config.readingRate);
+    double conversions = static_cast<double>(readingCount) * resultCount;
+    printf("readings=%ld conversions/reading=%d conversions=%.0f rate=%u conversions/s\n",
+           readingCount, resultCount, conversions, INTERNAL_ADC_CONVERSION_RATE);
+
+    long totalMismatches = 0;
+    for (int averaging = 1; averaging >= 0; averaging--) {
+        long mismatches = 0;
+        double nanos = runBench(intervals, readingCount, averaging, &mismatches);
+        double nanosPerConversion = nanos / conversions;
+
+        printf("%-9s collect=%.0fns/reading unpack=%.2fns/conversion throughput=%.1fM "
+               "conversions/s core-share=%.3f%% mismatches=%ld\n",
+               averaging ? "average" : "last", nanos / readingCount, nanosPerConversion,
+               1e3 / nanosPerConversion,
+               nanosPerConversion * INTERNAL_ADC_CONVERSION_RATE / 1e7, mismatches);
+        totalMismatches += mismatches;
+    }
+    fflush(stdout);
+
+    // The log task is still running, so the process ends without the destructors
+    Serial.flush();
+    _exit(totalMismatches > 0 ? 1 : 0);
+}
@@ -0,0 +1,232 @@
+/*
+    ChangeBench.cpp
+
+    * Benchmark of the change filter (see ChangeFilter.h) on replayed sessions: the captures of
+    capture_tool (see Capture.h) are decimated as in DataReader, and their samples go through
+    the serialization of Database, with and without the filter, in batches of BATCH_SIZE_MAX
+    samples. The samples that Database skips (a null sample after another one) are left out of
+    both versions.
+    * It reports the bytes of the batches and their rate over the duration of the session, the
+    ratio between them, and the CPU cost of each version per sample. Both versions run in many
+    alternate rounds, and the best round of each is kept, which leaves out most of the noise of
+    the host.
+    * The records of the filter are then stored in the form of the database (see
+    toDatabaseForm()) and rebuilt by the decoder of the readers (see host/consumer), at a cost
+    per record also reported. Every sample must be rebuilt within the deadband of its channels,
+    otherwise the benchmark fails.
+    * Usage: change_bench CAPTURE... [--rounds ROUNDS]
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "AsyncLog.h"
+#include "BatchController.h"
+#include "Capture.h"
+#include "Decimator.h"
+#include "JsonBatch.h"
+#include "RecordDecoder.h"
+#include "RtdbEmulator.h"
+#include "Sensors.h"
+
+// Define the globals of the sketch
+AsyncLog asyncLog;
+
+struct benchConfig {
+    std::vector<std::string> capturePaths;
+    int rounds = 20;
+};
+
+// Define a sample of a session, once decimated
+struct sessionSample {
+    unsigned long long timestampMillis;
+    sensorData data;
+};
+
+/**
+ * Struct of the results of a version, the best of the rounds
+ */
+struct benchResult {
+    double nanos = 0;
+    uint64_t bytes = 0;
+    uint64_t records = 0;
+};
+
+// Decimate the readings of a capture into the samples that Database sends
+static bool loadSession(const std::string& path, std::vector<sessionSample>* samples) {
+    CaptureReader reader;
+    if (!reader.open(path)) {
+        fprintf(stderr, "Could not read the capture %s\n", path.c_str());
+        return false;
+    }
+
+    Decimator decimator;
+    captureRecord record;
+    bool lastWasValid = false;
+    while (reader.read(&record)) {
+        sessionSample sample;
+        if (!decimator.update(record.values, sample.data.pressureSensor)) {
+            continue;
+        }
+        sample.timestampMillis = record.timestampMillis;
+
+        bool isValid = !Sensors::isNull(sample.data.pressureSensor);
+        if (isValid || lastWasValid) {
+            samples->push_back(sample);
+        }
+        lastWasValid = isValid;
+    }
+
+    return !samples->empty();
+}
+
+// Serialize the samples of a session in batches, with or without the filter, and keep their
+// records in the form of the database when asked to
+static void runRound(const std::vector<sessionSample>& samples, bool filtered,
+                     benchResult* result, std::map<std::string, std::string>* records) {
+    static JsonBatch jsonBatch;
+    ChangeFilter changeFilter;
+    uint64_t bytes = 0;
+    uint64_t recordCount = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t first = 0; first < samples.size(); first += BATCH_SIZE_MAX) {
+        size_t end = first + BATCH_SIZE_MAX < samples.size() ? first + BATCH_SIZE_MAX
+                                                             : samples.size();
+        changeFilter.begin();
+        jsonBatch.clear();
+        for (size_t i = first; i < end; i++) {
+            uint16_t channelMask = filtered ? changeFilter.filter(samples[i].timestampMillis,
+                                                                  &samples[i].data)
+                                            : CHANNEL_MASK_ALL;
+            if (channelMask != 0) {
+                jsonBatch.appendSample(samples[i].timestampMillis, &samples[i].data, nullptr,
+                                       channelMask);
+            }
+        }
+        changeFilter.commit();
+
+        if (jsonBatch.getSampleCount() > 0) {
+            const char* body = jsonBatch.getBody();
+            bytes += jsonBatch.getLength();
+            recordCount += jsonBatch.getSampleCount();
+
+            if (records != nullptr) {
+                std::map<std::string, std::string> members;
+                splitJsonObject(body, &members);
+                for (const auto& member : members) {
+                    (*records)[member.first] = toDatabaseForm(member.second);
+                }
+            }
+        }
+    }
+    double nanos = std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now() - start).count();
+
+    if (result->nanos == 0 || nanos < result->nanos) {
+        result->nanos = nanos;
+    }
+    result->bytes = bytes;
+    result->records = recordCount;
+}
+
+// Rebuild the samples from the records of the database, and get the largest error, in counts,
+// or -1 if a sample isn't within the deadband of its channels
+static int decodeSession(const std::vector<sessionSample>& samples,
+                         const std::map<std::string, std::string>& records, double* nanos) {
+    RecordDecoder decoder;
+    int maxError = 0;
+    bool withinDeadband = true;
+
+    auto start = std::chrono::steady_clock::now();
+    for (const sessionSample& sample : samples) {
+        auto record = records.find(std::to_string(sample.timestampMillis));
+        if (record != records.end() && !decoder.apply(record->second)) {
+            return -1;
+        }
+
+        for (int c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+            int error = abs(decoder.getValues()[c] - sample.data.pressureSensor[c]);
+            withinDeadband = withinDeadband && error <= Sensors::getDeadband(c);
+            maxError = error > maxError ? error : maxError;
+        }
+    }
+    *nanos = std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now() - start).count();
+
+    return withinDeadband ? maxError : -1;
+}
+
+static bool parseArguments(int argc, char** argv, benchConfig* config) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--rounds") == 0) {
+            if (i + 1 >= argc) {
+                return false;
+            }
+            config->rounds = atoi(argv[++i]);
+        } else {
+            config->capturePaths.push_back(argv[i]);
+        }
+    }
+
+    return !config->capturePaths.empty() && config->rounds > 0;
+}
+
+int main(int argc, char** argv) {
+    benchConfig config;
+    if (!parseArguments(argc, argv, &config)) {
+        fprintf(stderr, "Usage: %s CAPTURE... [--rounds ROUNDS]\n", argv[0]);
+        return 1;
+    }
+
+    bool passed = true;
+    for (const std::string& path : config.capturePaths) {
+        std::vector<sessionSample> samples;
+        if (!loadSession(path, &samples)) {
+            return 1;
+        }
+
+        // Alternate the versions, and which one goes first, so that both run in the same
+        // conditions
+        benchResult dense;
+        benchResult filtered;
+        for (int round = 0; round < config.rounds; round++) {
+            if (round % 2 == 0) {
+                runRound(samples, true, &filtered, nullptr);
+            }
+            runRound(samples, false, &dense, nullptr);
+            if (round % 2 != 0) {
+                runRound(samples, true, &filtered, nullptr);
+            }
+        }
+
+        std::map<std::string, std::string> records;
+        benchResult stored;
+        runRound(samples, true, &stored, &records);
+        double decodeNanos = 0;
+        int maxError = decodeSession(samples, records, &decodeNanos);
+        passed = passed && maxError >= 0;
+
+        double seconds = (samples.back().timestampMillis - samples.front().timestampMillis) / 1e3;
+        seconds = seconds > 0 ? seconds : 1;
+        printf("%s: samples=%zu seconds=%.0f records kept=%.1f%%\n", path.c_str(),
+               samples.size(), seconds, 100.0 * filtered.records / samples.size());
+        printf("  dense    bytes=%llu (%.0f bytes/s) encode=%.1fns/sample\n",
+               static_cast<unsigned long long>(dense.bytes), dense.bytes / seconds,
+               dense.nanos / samples.size());
+        printf("  filtered bytes=%llu (%.0f bytes/s) encode=%.1fns/sample\n",
+               static_cast<unsigned long long>(filtered.bytes), filtered.bytes / seconds,
+               filtered.nanos / samples.size());
+        printf("  ratio    bytes=%.3f encode=%.3f decode=%.1fns/record largest error=%d counts%s\n",
+               static_cast<double>(filtered.bytes) / dense.bytes, filtered.nanos / dense.nanos,
+               records.empty() ? 0 : decodeNanos / records.size(), maxError,
+               maxError >= 0 ? "" : " (MISMATCH)");
+    }
+
+    return passed ? 0 : 1;
+}
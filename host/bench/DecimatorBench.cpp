@@ -0,0 +1,223 @@
+/*
+    DecimatorBench.cpp
+
+    * Benchmark of the Decimator (see Decimator.h): the cost of the CIC filter per reading of a
+    channel, and the noise that it removes from the readings.
+    * The readings are synthetic: a constant level on each channel, as with a seated person,
+    plus white gaussian noise, as the one of the internal ADC, rounded and clamped to the range
+    of the channels. They are generated once, so only the filter is timed.
+    * The cost is measured in many short rounds over the same readings, and the best round is
+    kept, which leaves out most of the noise of the host. It is given in nanoseconds and, on x86,
+    in cycles of the time-stamp counter, per reading of a channel (a channel-sample).
+    * The noise is the standard deviation of the outputs around the level of their channel,
+    against the one of the readings. It is compared with the reduction of white noise expected
+    from the impulse response of the filter. The output also carries the truncation of the shift
+    that removes the gain of the filter, which shows with a low noise.
+    * Usage: decimator_bench [--readings READINGS] [--rounds ROUNDS] [--noise COUNTS]
+*/
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAS_TSC 1
+#endif
+
+#include "AsyncLog.h"
+#include "Decimator.h"
+#include "Errors.h"
+
+// Set the amount of readings of a round, a multiple of OVERSAMPLING_RATIO
+const int BENCH_ROUND_READINGS = 64 * OVERSAMPLING_RATIO;
+
+// Define the globals of the sketch
+Errors errorHandler;
+AsyncLog asyncLog;
+
+struct benchConfig {
+    long readings = 1 << 20;
+    int rounds = 200;
+    // Standard deviation of the noise of the readings, in counts
+    double noise = 20;
+};
+
+/**
+ * Struct of the cost of the best round, per reading of a channel
+ */
+struct benchCost {
+    double nanos = 0;
+    double cycles = 0;
+};
+
+// Get the level of a channel, spread over the range of the sensors
+static double getLevel(int channel) {
+    return 800 + 250 * channel;
+}
+
+// Generate the readings of all the channels, the levels plus the noise
+static std::vector<uint16_t> generateReadings(long readingCount, double noise) {
+    std::mt19937 random(42);
+    std::normal_distribution<double> distribution(0, noise);
+
+    std::vector<uint16_t> readings(readingCount * SENSOR_CHANNEL_COUNT);
+    for (long r = 0; r < readingCount; r++) {
+        for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+            double value = std::round(getLevel(i) + distribution(random));
+            readings[r * SENSOR_CHANNEL_COUNT + i] = std::min(65535.0, std::max(0.0, value));
+        }
+    }
+
+    return readings;
+}
+
+// Get the standard deviation of values around the levels of their channels
+static double getDeviation(const std::vector<uint16_t>& values) {
+    double sum = 0;
+    for (size_t k = 0; k < values.size(); k++) {
+        double error = values[k] - getLevel(k % SENSOR_CHANNEL_COUNT);
+        sum += error * error;
+    }
+
+    return std::sqrt(sum / values.size());
+}
+
+// Get the reduction of the deviation of white noise by the filter, from its impulse response:
+// a boxcar of OVERSAMPLING_RATIO readings convolved DECIMATOR_ORDER times with itself
+static double getExpectedReduction() {
+    std::vector<double> response = {1};
+    for (int stage = 0; stage < DECIMATOR_ORDER; stage++) {
+        std::vector<double> next(response.size() + OVERSAMPLING_RATIO - 1, 0);
+        for (size_t k = 0; k < response.size(); k++) {
+            for (int j = 0; j < OVERSAMPLING_RATIO; j++) {
+                next[k + j] += response[k];
+            }
+        }
+        response = next;
+    }
+
+    double sum = 0;
+    double squareSum = 0;
+    for (double coefficient : response) {
+        sum += coefficient;
+        squareSum += coefficient * coefficient;
+    }
+
+    return std::sqrt(squareSum) / sum;
+}
+
+// Filter all the readings once, and get the outputs
+static std::vector<uint16_t> filterReadings(const std::vector<uint16_t>& readings) {
+    Decimator decimator;
+    std::vector<uint16_t> outputs;
+    uint16_t output[SENSOR_CHANNEL_COUNT];
+
+    for (size_t r = 0; r < readings.size(); r += SENSOR_CHANNEL_COUNT) {
+        if (decimator.update(&readings[r], output)) {
+            outputs.insert(outputs.end(), output, output + SENSOR_CHANNEL_COUNT);
+        }
+    }
+
+    return outputs;
+}
+
+// Time the filter over the first readings in many rounds, and get the cost of the best one
+static benchCost measureCost(const std::vector<uint16_t>& readings, int rounds) {
+    Decimator decimator;
+    uint16_t output[SENSOR_CHANNEL_COUNT];
+    uint32_t checksum = 0;
+    benchCost best;
+
+    for (int round = 0; round < rounds; round++) {
+        auto start = std::chrono::steady_clock::now();
+#ifdef BENCH_HAS_TSC
+        unsigned long long startCycles = __rdtsc();
+#endif
+
+        for (int r = 0; r < BENCH_ROUND_READINGS; r++) {
+            if (decimator.update(&readings[r * SENSOR_CHANNEL_COUNT], output)) {
+                checksum += output[r % SENSOR_CHANNEL_COUNT];
+            }
+        }
+
+        benchCost cost;
+#ifdef BENCH_HAS_TSC
+        cost.cycles = static_cast<double>(__rdtsc() - startCycles);
+#endif
+        cost.nanos = std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - start).count();
+
+        if (best.nanos == 0 || cost.nanos < best.nanos) {
+            best = cost;
+        }
+    }
+
+    // Keep the outputs alive, so that the filter isn't optimized out
+    if (checksum == 1) {
+        printf("\n");
+    }
+
+    best.nanos /= BENCH_ROUND_READINGS * SENSOR_CHANNEL_COUNT;
+    best.cycles /= BENCH_ROUND_READINGS * SENSOR_CHANNEL_COUNT;
+    return best;
+}
+
+static bool parseArguments(int argc, char** argv, benchConfig* config) {
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            return false;
+        }
+        const char* option = argv[i];
+        const char* value = argv[++i];
+
+        if (strcmp(option, "--readings") == 0) {
+            config->readings = atol(value);
+        } else if (strcmp(option, "--rounds") == 0) {
+            config->rounds = atoi(value);
+        } else if (strcmp(option, "--noise") == 0) {
+            config->noise = atof(value);
+        } else {
+            return false;
+        }
+    }
+
+    return config->readings >= BENCH_ROUND_READINGS && config->rounds > 0 && config->noise > 0;
+}
+
+int main(int argc, char** argv) {
+    benchConfig config;
+    if (!parseArguments(argc, argv, &config)) {
+        fprintf(stderr, "Usage: %s [--readings READINGS] [--rounds ROUNDS] [--noise COUNTS]\n",
+                argv[0]);
+        return 1;
+    }
+
+    std::vector<uint16_t> readings = generateReadings(config.readings, config.noise);
+    std::vector<uint16_t> outputs = filterReadings(readings);
+    benchCost cost = measureCost(readings, config.rounds);
+
+    printf("channels=%d ratio=%d order=%d readings=%ld outputs=%zu\n", SENSOR_CHANNEL_COUNT,
+           OVERSAMPLING_RATIO, DECIMATOR_ORDER, config.readings,
+           outputs.size() / SENSOR_CHANNEL_COUNT);
+#ifdef BENCH_HAS_TSC
+    printf("cost          %.2fns/channel-sample %.2f cycles/channel-sample (time-stamp counter)\n",
+           cost.nanos, cost.cycles);
+#else
+    printf("cost          %.2fns/channel-sample\n", cost.nanos);
+#endif
+
+    double inputDeviation = getDeviation(readings);
+    double outputDeviation = getDeviation(outputs);
+    double expectedReduction = getExpectedReduction();
+    printf("noise         %.2f counts in, %.2f counts out (%.2fx, %.1f dB), "
+           "expected %.2f counts (%.1f dB)\n", inputDeviation, outputDeviation,
+           outputDeviation / inputDeviation, 20 * std::log10(inputDeviation / outputDeviation),
+           inputDeviation * expectedReduction, -20 * std::log10(expectedReduction));
+
+    return 0;
+}
@@ -0,0 +1,178 @@
+/*
+    DrainBench.cpp
+
+    * Benchmark of the drain of a backlog by Database: the buffer is filled with a backlog of
+    samples at once, as after an outage, and the loop of the encode stage (see Stages.h) sends
+    them to an RTDB emulator (see host/emulator) until the buffer is empty.
+    * It reports the drain rate for each size of backlog, in samples/s, against the rate of a
+    single sample per loop of the encode stage, the one of the data path before the batches were
+    peeked from the buffer. The backlogs stay below the threshold of the spool, so that only the
+    buffer is drained.
+    * Each backlog is drained in many alternate rounds, and the best round of each is kept, which
+    leaves out most of the noise of the host. The emulator answers after a latency, as the
+    database does over the network.
+    * Usage: drain_bench [--latency MS] [--depth BATCHES] [--rounds ROUNDS]
+*/
+
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+
+#include <LittleFS.h>
+
+#include "AsyncLog.h"
+#include "Buffer.h"
+#include "Clock.h"
+#include "Connectivity.h"
+#include "Database.h"
+#include "Errors.h"
+#include "RtdbEmulator.h"
+#include "Stages.h"
+#include "Telemetry.h"
+
+namespace fs = std::filesystem;
+
+// Define the sizes of the backlogs drained, below the threshold of the spool
+const int DRAIN_BACKLOGS[] = {BATCH_SIZE_MAX, 4 * BATCH_SIZE_MAX, 10 * BATCH_SIZE_MAX,
+                              20 * BATCH_SIZE_MAX, 30 * BATCH_SIZE_MAX};
+const int DRAIN_BACKLOG_COUNT = sizeof(DRAIN_BACKLOGS) / sizeof(DRAIN_BACKLOGS[0]);
+static_assert(30 * BATCH_SIZE_MAX < SPOOL_SPILL_THRESHOLD, "The backlogs must not be spooled");
+
+// Define the globals of the sketch
+Errors errorHandler;
+AsyncLog asyncLog;
+Telemetry telemetry;
+Connectivity connectivity;
+StageMonitor stageMonitor;
+
+struct benchConfig {
+    int latencyMillis = 20;
+    int depth = UPLOAD_PIPELINE_DEPTH;
+    int rounds = 5;
+};
+
+static SensorDataBuffer dataBuffer;
+static Database database;
+
+static unsigned long long previousTimestampMillis = 0;
+
+// Fill the buffer with a backlog of samples, with distinct timestamps in the past
+static void fillBacklog(int backlog) {
+    unsigned long long timestampMillis = clockEpochMillis() - 500ULL * backlog;
+    timestampMillis = timestampMillis > previousTimestampMillis ? timestampMillis
+                                                                : previousTimestampMillis + 1;
+
+    for (int i = 0; i < backlog; i++) {
+        sensorData* sample = dataBuffer.getNewSample(timestampMillis);
+        for (int c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+            sample->pressureSensor[c] = 1000 + 100 * c + (i * 37) % 500;
+        }
+        dataBuffer.commitNewSample();
+        previousTimestampMillis = timestampMillis;
+        timestampMillis += 500;
+    }
+}
+
+// Run the loop of the encode stage until the buffer is empty, and get the duration in seconds
+static double drainBacklog(int backlog) {
+    fillBacklog(backlog);
+
+    auto start = std::chrono::steady_clock::now();
+    while (!dataBuffer.isBufferEmpty()) {
+        database.sendData(&dataBuffer);
+        vTaskDelay(ENCODE_STAGE_INTERVAL_MILLIS);
+    }
+
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool parseArguments(int argc, char** argv, benchConfig* config) {
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            return false;
+        }
+        const char* option = argv[i];
+        const char* value = argv[++i];
+
+        if (strcmp(option, "--latency") == 0) {
+            config->latencyMillis = atoi(value);
+        } else if (strcmp(option, "--depth") == 0) {
+            config->depth = atoi(value);
+        } else if (strcmp(option, "--rounds") == 0) {
+            config->rounds = atoi(value);
+        } else {
+            return false;
+        }
+    }
+
+    return config->latencyMillis >= 0 && config->depth > 0 && config->rounds > 0;
+}
+
+int main(int argc, char** argv) {
+    benchConfig config;
+    if (!parseArguments(argc, argv, &config)) {
+        fprintf(stderr, "Usage: %s [--latency MS] [--depth BATCHES] [--rounds ROUNDS]\n",
+                argv[0]);
+        return 1;
+    }
+
+    fs::path dataPath = fs::temp_directory_path() / ("drain_bench_" + std::to_string(getpid()));
+    fs::create_directories(dataPath);
+    hostSetLittleFSRoot((dataPath / "littlefs").c_str());
+    hostSetSerialOutput(fopen("/dev/null", "w"));
+
+    emulatorConfig emulator;
+    emulator.port = 0;
+    emulator.latencyMillis = config.latencyMillis;
+    RtdbEmulator rtdb(emulator);
+    if (!rtdb.start()) {
+        perror("Could not start the emulator");
+        return 1;
+    }
+    char address[32];
+    snprintf(address, sizeof(address), "127.0.0.1:%u", rtdb.getPort());
+    setenv("FIREBASE_DATABASE_EMULATOR_HOST", address, 1);
+    setenv("FIREBASE_DATABASE_NAMESPACE", "drain", 1);
+
+    asyncLog.setup();
+    connectivity.setup();
+    database.setPipelineDepth(config.depth);
+    database.setup();
+
+    // The first drain opens the connections and records the boot
+    drainBacklog(BATCH_SIZE_MAX);
+
+    // Alternate the backlogs, so that all of them run in the same conditions
+    double bestSeconds[DRAIN_BACKLOG_COUNT] = {};
+    for (int round = 0; round < config.rounds; round++) {
+        for (int b = 0; b < DRAIN_BACKLOG_COUNT; b++) {
+            double seconds = drainBacklog(DRAIN_BACKLOGS[b]);
+            if (bestSeconds[b] == 0 || seconds < bestSeconds[b]) {
+                bestSeconds[b] = seconds;
+            }
+        }
+    }
+
+    double singleSampleRate = 1000.0 / ENCODE_STAGE_INTERVAL_MILLIS;
+    printf("latency=%dms depth=%d rounds=%d loop=%lums (a sample per loop: %.0f samples/s)\n",
+           config.latencyMillis, config.depth, config.rounds, ENCODE_STAGE_INTERVAL_MILLIS,
+           singleSampleRate);
+    for (int b = 0; b < DRAIN_BACKLOG_COUNT; b++) {
+        double rate = DRAIN_BACKLOGS[b] / bestSeconds[b];
+        printf("backlog=%-5d drain=%.3fs rate=%.0f samples/s (%.1fx a sample per loop)\n",
+               DRAIN_BACKLOGS[b], bestSeconds[b], rate, rate / singleSampleRate);
+    }
+    fflush(stdout);
+
+    rtdb.stop();
+    std::error_code error;
+    fs::remove_all(dataPath, error);
+
+    // The log task is still running, so the process ends without the destructors
+    _exit(0);
+}
@@ -0,0 +1,376 @@
+/*
+    JsonBench.cpp
+
+    * Benchmark of the serialization of the batches by JsonBatch (see JsonBatch.h) against the
+    FirebaseJson path that it replaced, where each sample was added to the JSON object of the
+    library as an array under its timestamp, and the body was printed from the object.
+    * The host has no FirebaseJson, so its structure is reproduced here: a tree of nodes, as
+    the cJSON tree of the library, with an allocation per node and per key, printed into a
+    buffer that doubles as it grows. The calls are the ones of the former appendDataToJSON():
+    the array of the sample cleared and filled channel by channel, then copied into the object
+    under the timestamp, and the object printed twice per batch (once for its length, once for
+    the request).
+    * The body of JsonBatch is still handed to the library with FirebaseJson::setJsonData(),
+    which parses it into its tree and prints it for the request. That part is measured too, with
+    the same model of the library, so that the cost of a batch on the device is complete.
+    * Every version serializes the same batches of BATCH_SIZE_MAX samples, whose bodies are
+    checked to match, in many alternate rounds, and the best round of each is kept, which leaves
+    out most of the noise of the host. It reports the cost per batch, the bytes serialized per
+    second of CPU and the heap allocations per batch (see AllocationCounter.h).
+    * Usage: json_bench [--batches BATCHES] [--rounds ROUNDS]
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "AllocationCounter.h"
+#include "AsyncLog.h"
+#include "BatchController.h"
+#include "JsonBatch.h"
+
+// Define the globals of the sketch
+AsyncLog asyncLog;
+
+struct benchConfig {
+    int batches = 2000;
+    int rounds = 10;
+};
+
+/**
+ * Struct of the results of a version, the best of the rounds
+ */
+struct benchResult {
+    double nanos = 0;
+    double allocations = 0;
+    uint64_t bytes = 0;
+};
+
+/**
+ * Struct of a node of the model of the tree of FirebaseJson: an object, an array or a number.
+ * The children are linked, as in cJSON, and the key of a member is allocated with it
+ */
+struct jsonNode {
+    jsonNode* child = nullptr;
+    jsonNode* next = nullptr;
+    char* key = nullptr;
+    long long value = 0;
+    char type = 'n';
+};
+
+/**
+ * Struct of the buffer where the tree is printed, doubled when it gets full
+ */
+struct printBuffer {
+    char* data = nullptr;
+    size_t capacity = 0;
+    size_t length = 0;
+};
+
+static void deleteTree(jsonNode* node) {
+    while (node != nullptr) {
+        jsonNode* next = node->next;
+        deleteTree(node->child);
+        delete[] node->key;
+        delete node;
+        node = next;
+    }
+}
+
+static char* copyKey(const char* key, size_t length) {
+    char* copy = new char[length + 1];
+    memcpy(copy, key, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+static jsonNode* duplicateTree(const jsonNode* node) {
+    jsonNode* copy = new jsonNode(*node);
+    copy->next = nullptr;
+    copy->key = node->key != nullptr ? copyKey(node->key, strlen(node->key)) : nullptr;
+
+    jsonNode** last = &copy->child;
+    for (const jsonNode* child = node->child; child != nullptr; child = child->next) {
+        *last = duplicateTree(child);
+        last = &(*last)->next;
+    }
+
+    return copy;
+}
+
+static void appendChild(jsonNode* parent, jsonNode* child) {
+    jsonNode** last = &parent->child;
+    while (*last != nullptr) {
+        last = &(*last)->next;
+    }
+    *last = child;
+}
+
+static void reserve(printBuffer* buffer, size_t needed) {
+    if (buffer->length + needed <= buffer->capacity) {
+        return;
+    }
+
+    size_t capacity = buffer->capacity > 0 ? buffer->capacity : 256;
+    while (capacity < buffer->length + needed) {
+        capacity *= 2;
+    }
+    char* data = new char[capacity];
+    memcpy(data, buffer->data, buffer->length);
+    delete[] buffer->data;
+    buffer->data = data;
+    buffer->capacity = capacity;
+}
+
+static void printText(printBuffer* buffer, const char* text, size_t length) {
+    reserve(buffer, length);
+    memcpy(buffer->data + buffer->length, text, length);
+    buffer->length += length;
+}
+
+static void printNode(printBuffer* buffer, const jsonNode* node) {
+    if (node->key != nullptr) {
+        printText(buffer, "\"", 1);
+        printText(buffer, node->key, strlen(node->key));
+        printText(buffer, "\":", 2);
+    }
+
+    if (node->type == 'n') {
+        char number[24];
+        printText(buffer, number, snprintf(number, sizeof(number), "%lld", node->value));
+        return;
+    }
+
+    printText(buffer, node->type == 'o' ? "{" : "[", 1);
+    for (const jsonNode* child = node->child; child != nullptr; child = child->next) {
+        printNode(buffer, child);
+        if (child->next != nullptr) {
+            printText(buffer, ",", 1);
+        }
+    }
+    printText(buffer, node->type == 'o' ? "}" : "]", 1);
+}
+
+// Print a tree into a new buffer, which the library hands over as a String
+static std::string printTree(const jsonNode* root) {
+    printBuffer buffer;
+    printNode(&buffer, root);
+    std::string text(buffer.data, buffer.length);
+    delete[] buffer.data;
+    return text;
+}
+
+// Parse the subset of JSON written by JsonBatch (objects, arrays and integers) into a tree
+static jsonNode* parseNode(const char** position) {
+    jsonNode* node = new jsonNode();
+    char opening = **position;
+    if (opening != '{' && opening != '[') {
+        node->value = strtoll(*position, const_cast<char**>(position), 10);
+        return node;
+    }
+
+    node->type = opening == '{' ? 'o' : 'a';
+    (*position)++;
+    while (**position != '}' && **position != ']') {
+        const char* key = nullptr;
+        size_t keyLength = 0;
+        if (node->type == 'o') {
+            key = *position + 1;
+            keyLength = strchr(key, '"') - key;
+            *position = key + keyLength + 2;
+        }
+
+        jsonNode* child = parseNode(position);
+        child->key = key != nullptr ? copyKey(key, keyLength) : nullptr;
+        appendChild(node, child);
+        if (**position == ',') {
+            (*position)++;
+        }
+    }
+    (*position)++;
+
+    return node;
+}
+
+// Build the synthetic samples of a batch, with the values of seated and empty chairs
+static void makeBatch(int batch, unsigned long long* timestamps, sensorData* samples) {
+    for (int i = 0; i < BATCH_SIZE_MAX; i++) {
+        timestamps[i] = 1700000000000ULL + 500ULL * (batch * BATCH_SIZE_MAX + i);
+        for (int c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+            samples[i].pressureSensor[c] = (batch + i) % 4 == 0 ? 0 : 800 + 211 * c + i * 7;
+        }
+    }
+}
+
+// Serialize a batch as the former appendDataToJSON() did with FirebaseJson
+static std::string serializeFirebaseJson(const unsigned long long* timestamps,
+                                         const sensorData* samples, size_t* length) {
+    jsonNode root;
+    root.type = 'o';
+    jsonNode* payload = new jsonNode();
+    payload->type = 'a';
+
+    for (int i = 0; i < BATCH_SIZE_MAX; i++) {
+        // payload.clear() and payload.add() for each channel
+        deleteTree(payload->child);
+        payload->child = nullptr;
+        for (int c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+            jsonNode* value = new jsonNode();
+            value->value = samples[i].pressureSensor[c];
+            appendChild(payload, value);
+        }
+
+        // jsonBuffer.add(timestampMillis, payload), with the key converted to a String
+        std::string key = std::to_string(timestamps[i]);
+        jsonNode* member = duplicateTree(payload);
+        member->key = copyKey(key.c_str(), key.size());
+        appendChild(&root, member);
+    }
+    deleteTree(payload);
+
+    // serializedBufferLength() for the upload stats, then the body of the request
+    *length = printTree(&root).size();
+    std::string body = printTree(&root);
+
+    // jsonBuffer.clear()
+    deleteTree(root.child);
+    return body;
+}
+
+// Serialize a batch with JsonBatch, as the sketch does
+static const char* serializeJsonBatch(JsonBatch* jsonBatch, const unsigned long long* timestamps,
+                                      const sensorData* samples) {
+    jsonBatch->clear();
+    for (int i = 0; i < BATCH_SIZE_MAX; i++) {
+        jsonBatch->appendSample(timestamps[i], &samples[i]);
+    }
+
+    return jsonBatch->getBody();
+}
+
+// Hand the body to the model of the library, as FirebaseJson::setJsonData() and the request do
+static std::string handToLibrary(const char* body) {
+    const char* position = body;
+    jsonNode* root = parseNode(&position);
+    std::string request = printTree(root);
+    deleteTree(root);
+    return request;
+}
+
+// Run a round of a version, counting its allocations
+template <typename Serialize>
+static void runRound(int batchCount, const std::vector<unsigned long long>& timestamps,
+                     const std::vector<sensorData>& samples, Serialize serialize,
+                     benchResult* result) {
+    uint64_t bytes = 0;
+    uint64_t allocationsBefore = hostGetAllocationCount();
+    hostSetAllocationCounting(true);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int b = 0; b < batchCount; b++) {
+        bytes += serialize(&timestamps[b * BATCH_SIZE_MAX], &samples[b * BATCH_SIZE_MAX]);
+    }
+    double nanos = std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now() - start).count() / batchCount;
+
+    hostSetAllocationCounting(false);
+    result->allocations = static_cast<double>(hostGetAllocationCount() - allocationsBefore)
+                          / batchCount;
+    result->bytes = bytes;
+    if (result->nanos == 0 || nanos < result->nanos) {
+        result->nanos = nanos;
+    }
+}
+
+static bool parseArguments(int argc, char** argv, benchConfig* config) {
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            return false;
+        }
+        const char* option = argv[i];
+        const char* value = argv[++i];
+
+        if (strcmp(option, "--batches") == 0) {
+            config->batches = atoi(value);
+        } else if (strcmp(option, "--rounds") == 0) {
+            config->rounds = atoi(value);
+        } else {
+            return false;
+        }
+    }
+
+    return config->batches > 0 && config->rounds > 0;
+}
+
+static void printResult(const char* label, const benchResult& result, int batchCount) {
+    double bytesPerBatch = static_cast<double>(result.bytes) / batchCount;
+    printf("  %-24s %8.0fns/batch %7.1f MB/s %7.1f allocations/batch\n", label, result.nanos,
+           bytesPerBatch / result.nanos * 1e3, result.allocations);
+}
+
+int main(int argc, char** argv) {
+    benchConfig config;
+    if (!parseArguments(argc, argv, &config)) {
+        fprintf(stderr, "Usage: %s [--batches BATCHES] [--rounds ROUNDS]\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<unsigned long long> timestamps(config.batches * BATCH_SIZE_MAX);
+    std::vector<sensorData> samples(config.batches * BATCH_SIZE_MAX);
+    for (int b = 0; b < config.batches; b++) {
+        makeBatch(b, &timestamps[b * BATCH_SIZE_MAX], &samples[b * BATCH_SIZE_MAX]);
+    }
+
+    // Every version must write the same body
+    static JsonBatch jsonBatch;
+    size_t firebaseLength = 0;
+    std::string firebaseBody = serializeFirebaseJson(&timestamps[0], &samples[0],
+                                                     &firebaseLength);
+    const char* jsonBatchBody = serializeJsonBatch(&jsonBatch, &timestamps[0], &samples[0]);
+    if (firebaseBody != jsonBatchBody || handToLibrary(jsonBatchBody) != firebaseBody) {
+        fprintf(stderr, "The bodies differ:\n%s\n%s\n", firebaseBody.c_str(), jsonBatchBody);
+        return 1;
+    }
+
+    auto firebaseJson = [](const unsigned long long* batchTimestamps,
+                           const sensorData* batchSamples) {
+        size_t length = 0;
+        return serializeFirebaseJson(batchTimestamps, batchSamples, &length).size();
+    };
+    auto jsonBatchOnly = [](const unsigned long long* batchTimestamps,
+                            const sensorData* batchSamples) {
+        serializeJsonBatch(&jsonBatch, batchTimestamps, batchSamples);
+        return static_cast<size_t>(jsonBatch.getLength());
+    };
+    auto jsonBatchToLibrary = [](const unsigned long long* batchTimestamps,
+                                 const sensorData* batchSamples) {
+        return handToLibrary(serializeJsonBatch(&jsonBatch, batchTimestamps, batchSamples))
+            .size();
+    };
+
+    // Only the allocations of this thread are counted
+    hostTrackAllocations(true);
+
+    // Alternate the versions, so that all of them run in the same conditions
+    benchResult firebaseResult;
+    benchResult jsonBatchResult;
+    benchResult libraryResult;
+    for (int round = 0; round < config.rounds; round++) {
+        runRound(config.batches, timestamps, samples, firebaseJson, &firebaseResult);
+        runRound(config.batches, timestamps, samples, jsonBatchOnly, &jsonBatchResult);
+        runRound(config.batches, timestamps, samples, jsonBatchToLibrary, &libraryResult);
+    }
+
+    printf("batches=%d rounds=%d samples/batch=%d bytes/batch=%.0f\n", config.batches,
+           config.rounds, BATCH_SIZE_MAX,
+           static_cast<double>(jsonBatchResult.bytes) / config.batches);
+    printResult("FirebaseJson", firebaseResult, config.batches);
+    printResult("JsonBatch", jsonBatchResult, config.batches);
+    printResult("JsonBatch + setJsonData", libraryResult, config.batches);
+    printf("  ratio (FirebaseJson / JsonBatch) time=%.1f\n",
+           firebaseResult.nanos / jsonBatchResult.nanos);
+
+    return 0;
+}
@@ -0,0 +1,237 @@
+/*
+    PipelineBench.cpp
+
+    * Micro-benchmark of the data path of the sketch, built for the host, in ns/sample:
+        acquisition: the readings of the sensors by DataReader (the internal ADC through the
+        mock of its DMA driver, the external ADCs through the emulated I2C bus, see Wire.h),
+        their decimation and the publication of the samples on the buffer
+        buffering: a write and a read of a sample through SensorDataBuffer, in batches
+        serialization: the batches of the samples of the buffer serialized by JsonBatch, with
+        their full timestamps, as Database does
+    * The clock is fast-forwarded, so the waits for the conversions cost nothing and only the
+    work of each stage is timed. The cost of the acquisition includes the emulation of the I2C
+    bus, which isn't the one of the device, so its transactions per sample are also reported.
+    * The stages run in batches of BATCH_SIZE_MAX samples, in many rounds, and the best round
+    of each is kept, which leaves out most of the noise of the host.
+    * Usage: pipeline_bench [--samples SAMPLES] [--rounds ROUNDS]
+*/
+
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <Wire.h>
+
+#include "AsyncLog.h"
+#include "BatchController.h"
+#include "DataReader.h"
+#include "Errors.h"
+#include "ExternalADCs.h"
+#include "JsonBatch.h"
+#include "Telemetry.h"
+
+// Define the globals of the sketch
+Errors errorHandler;
+AsyncLog asyncLog;
+Telemetry telemetry;
+
+struct benchConfig {
+    long samples = 20000;
+    int rounds = 10;
+};
+
+/**
+ * Struct of the costs of the stages, the best of the rounds, in nanoseconds (ns) per sample
+ */
+struct benchResult {
+    double acquisitionNanos = 0;
+    double bufferingNanos = 0;
+    double serializationNanos = 0;
+    uint64_t serializedBytes = 0;
+    long serializedSamples = 0;
+};
+
+static DataReader dataReader;
+static SensorDataBuffer dataBuffer;
+static SensorDataBuffer benchBuffer;
+static JsonBatch jsonBatch;
+
+// Give the readings of the pins of the internal ADC, a level per pin
+static uint16_t readInternalAdc(uint8_t pin, void*) {
+    return 500 + 100 * pin;
+}
+
+// Give the raw results of the external ADCs, a level per input
+static int16_t readExternalAdc(uint8_t address, uint8_t input, void*) {
+    return 1000 * input + 100 * (address - I2C_ADDRESS_1);
+}
+
+static double elapsedNanos(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+static void keepBest(double* best, double value) {
+    if (*best == 0 || value < *best) {
+        *best = value;
+    }
+}
+
+// Take readings until the next sample is published on the buffer
+static void acquireSample() {
+    sensorReading completed;
+    while (true) {
+        dataReader.startReading();
+        while (!dataReader.advanceReading(&completed)) {
+            // Poll the conversions at the pace of fillBuffer(), the wait skipped by the clock
+            vTaskDelay(1);
+        }
+
+        if (dataReader.filterReading(completed, &dataBuffer)) {
+            return;
+        }
+    }
+}
+
+// Serialize the samples of the buffer in batches, releasing them
+static void serializeSamples(benchResult* result) {
+    sensorDataSpan spans[2];
+    int count;
+    while ((count = dataBuffer.peekSamples(spans, BATCH_SIZE_MAX)) > 0) {
+        jsonBatch.clear();
+        for (int s = 0; s < 2; s++) {
+            for (int i = 0; i < spans[s].count; i++) {
+                const sensorData* sample = &spans[s].samples[i];
+                jsonBatch.appendSample(dataBuffer.getTimestampMillis(sample), sample);
+            }
+        }
+        jsonBatch.getBody();
+        dataBuffer.commitSamples(count);
+
+        result->serializedBytes += jsonBatch.getLength();
+        result->serializedSamples += jsonBatch.getSampleCount();
+    }
+}
+
+// Write and read the samples through a buffer, in batches
+static void bufferSamples(long sampleCount) {
+    sensorData sample;
+    for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+        sample.pressureSensor[i] = 100 * i;
+    }
+
+    sensorDataSpan spans[2];
+    unsigned long long timestampMillis = 1700000000000ULL;
+    for (long written = 0; written < sampleCount; written += BATCH_SIZE_MAX) {
+        for (int i = 0; i < BATCH_SIZE_MAX; i++) {
+            sensorData* slot = benchBuffer.getNewSample(timestampMillis);
+            timestampMillis += 500;
+            memcpy(slot->pressureSensor, sample.pressureSensor, sizeof(sample.pressureSensor));
+            benchBuffer.commitNewSample();
+        }
+
+        int count = benchBuffer.peekSamples(spans, BATCH_SIZE_MAX);
+        benchBuffer.commitSamples(count);
+    }
+}
+
+static void runRound(long sampleCount, benchResult* result) {
+    double acquisitionNanos = 0;
+    double serializationNanos = 0;
+    result->serializedBytes = 0;
+    result->serializedSamples = 0;
+
+    for (long acquired = 0; acquired < sampleCount; acquired += BATCH_SIZE_MAX) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < BATCH_SIZE_MAX; i++) {
+            acquireSample();
+        }
+        acquisitionNanos += elapsedNanos(start);
+
+        start = std::chrono::steady_clock::now();
+        serializeSamples(result);
+        serializationNanos += elapsedNanos(start);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    bufferSamples(sampleCount);
+    double bufferingNanos = elapsedNanos(start);
+
+    keepBest(&result->acquisitionNanos, acquisitionNanos / result->serializedSamples);
+    keepBest(&result->serializationNanos, serializationNanos / result->serializedSamples);
+    keepBest(&result->bufferingNanos, bufferingNanos / result->serializedSamples);
+}
+
+static bool parseArguments(int argc, char** argv, benchConfig* config) {
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            return false;
+        }
+        const char* option = argv[i];
+        const char* value = argv[++i];
+
+        if (strcmp(option, "--samples") == 0) {
+            config->samples = atol(value);
+        } else if (strcmp(option, "--rounds") == 0) {
+            config->rounds = atoi(value);
+        } else {
+            return false;
+        }
+    }
+
+    return config->samples >= BATCH_SIZE_MAX && config->rounds > 0;
+}
+
+int main(int argc, char** argv) {
+    benchConfig config;
+    if (!parseArguments(argc, argv, &config)) {
+        fprintf(stderr, "Usage: %s [--samples SAMPLES] [--rounds ROUNDS]\n", argv[0]);
+        return 1;
+    }
+
+    // The samples are acquired in whole batches
+    config.samples -= config.samples % BATCH_SIZE_MAX;
+
+    // The log task is started before the fast-forward, so that it sleeps in real time
+    hostSetSerialOutput(fopen("/dev/null", "w"));
+    asyncLog.setup();
+    hostSetFastForward(true);
+    hostSetAnalogReader(readInternalAdc, nullptr);
+    hostSetExternalAdcReader(readExternalAdc, nullptr);
+
+    if (!dataReader.setup()) {
+        fprintf(stderr, "Could not set up the DataReader\n");
+        return 1;
+    }
+
+    printf("samples=%ld rounds=%d batch=%d channels=%d readings/sample=%d\n", config.samples,
+           config.rounds, BATCH_SIZE_MAX, SENSOR_CHANNEL_COUNT, OVERSAMPLING_RATIO);
+
+    benchResult result;
+    hostI2cStats i2cBefore = hostGetI2cStats();
+    for (int round = 0; round < config.rounds; round++) {
+        runRound(config.samples, &result);
+    }
+    hostI2cStats i2cAfter = hostGetI2cStats();
+
+    long totalSamples = config.samples * config.rounds;
+    printf("acquisition   %.0fns/sample (%.1f I2C transactions/sample)\n",
+           result.acquisitionNanos,
+           static_cast<double>(i2cAfter.transactions - i2cBefore.transactions) / totalSamples);
+    printf("buffering     %.1fns/sample\n", result.bufferingNanos);
+    printf("serialization %.1fns/sample (%.1f bytes/sample)\n", result.serializationNanos,
+           static_cast<double>(result.serializedBytes) / result.serializedSamples);
+    fflush(stdout);
+
+    bool complete = result.serializedSamples == config.samples;
+    if (!complete) {
+        fprintf(stderr, "Serialized %ld samples out of %ld\n", result.serializedSamples,
+                config.samples);
+    }
+
+    // The log task is still running, so the process ends without the destructors
+    _exit(complete ? 0 : 1);
+}
@@ -0,0 +1,260 @@
+/*
+    SensorBench.cpp
+
+    * Benchmark of the code generated by the sensor registry (see SensorRegistry.h) against the
+    hand-written code it replaces: the acquisition sequence of the sketch and the null check of
+    the samples.
+    * The drivers are mocks with the shape of the ones of the sketch (see PressureSensors.h): 4
+    channels that complete as soon as the reading starts, then 4 pairs of channels written one
+    pair per call, plus a disabled sensor that must cost nothing. Their values are copied from a
+    table of synthetic samples, a quarter of them null.
+    * Both versions read the same samples, which are checked to match, in many short alternate
+    rounds, and the best round of each is kept, which leaves out most of the noise of the host.
+    It reports the cost of each version per reading and per sample, and the ratio between them.
+    * Usage: sensor_bench [--readings READINGS] [--rounds ROUNDS]
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "SensorRegistry.h"
+
+// Set the amount of synthetic samples, read in turns
+const int BENCH_SAMPLE_COUNT = 1024;
+
+// Define the channels of the mocks, as the pressure sensors of the sketch
+const int BENCH_SYNC_CHANNEL_COUNT = 4;
+const int BENCH_PAIR_COUNT = 4;
+const int BENCH_CHANNEL_COUNT = BENCH_SYNC_CHANNEL_COUNT + 2 * BENCH_PAIR_COUNT;
+
+struct benchConfig {
+    long readings = 1000000;
+    int rounds = 100;
+};
+
+// Point to the synthetic sample being read, set at each reading
+static const uint16_t* benchSource = nullptr;
+
+/**
+ * Mock of a driver whose reading completes as soon as it starts
+ *
+ * @tparam SourceOffset the first channel of the driver in the synthetic samples
+ * @tparam ChannelCount the amount of channels of the driver
+ */
+template <int SourceOffset, int ChannelCount>
+class BenchSyncSensor : public SensorDriver<ChannelCount, 8, true> {
+public:
+    bool setup() { return true; }
+
+    bool start(uint16_t* values) {
+        memcpy(values, &benchSource[SourceOffset], ChannelCount * sizeof(uint16_t));
+        return true;
+    }
+
+    bool advance(uint16_t*) { return true; }
+};
+
+/**
+ * Mock of a driver whose reading completes over several calls, a pair of channels each
+ *
+ * @tparam SourceOffset the first channel of the driver in the synthetic samples
+ * @tparam PairCount the amount of pairs of channels of the driver
+ */
+template <int SourceOffset, int PairCount>
+class BenchStepSensor : public SensorDriver<2 * PairCount, 8> {
+    int pairIndex = 0;
+
+public:
+    bool setup() { return true; }
+
+    bool start(uint16_t*) {
+        pairIndex = 0;
+        return false;
+    }
+
+    bool advance(uint16_t* values) {
+        int index = pairIndex++;
+        values[2 * index] = benchSource[SourceOffset + 2 * index];
+        values[2 * index + 1] = benchSource[SourceOffset + 2 * index + 1];
+        return pairIndex >= PairCount;
+    }
+};
+
+typedef SensorRegistry<
+    BenchSyncSensor<0, BENCH_SYNC_CHANNEL_COUNT>,
+    EnabledSensor<DISABLE, BenchSyncSensor<0, 4>>,
+    BenchStepSensor<BENCH_SYNC_CHANNEL_COUNT, BENCH_PAIR_COUNT>
+> BenchSensors;
+
+static_assert(BenchSensors::CHANNEL_COUNT == BENCH_CHANNEL_COUNT,
+              "The disabled sensor must not take any channel");
+
+/**
+ * Hand-written acquisition sequence, as in the sketch before the registry
+ */
+class HandWrittenSensors {
+    int pairIndex = 0;
+
+public:
+    bool start(uint16_t* values) {
+        memcpy(values, benchSource, BENCH_SYNC_CHANNEL_COUNT * sizeof(uint16_t));
+        pairIndex = 0;
+        return false;
+    }
+
+    bool advance(uint16_t* values) {
+        int index = pairIndex++;
+        int channel = BENCH_SYNC_CHANNEL_COUNT + 2 * index;
+        values[channel] = benchSource[channel];
+        values[channel + 1] = benchSource[channel + 1];
+        return pairIndex >= BENCH_PAIR_COUNT;
+    }
+
+    static bool isNull(const uint16_t* values) {
+        uint16_t combined = 0;
+        for (int i = 0; i < BENCH_CHANNEL_COUNT; i++) {
+            combined |= values[i];
+        }
+        return combined == 0;
+    }
+};
+
+/**
+ * Struct of the results of a version, the best of the rounds
+ */
+struct benchResult {
+    double acquireNanos = 0;
+    double nullCheckNanos = 0;
+    long nullCount = 0;
+    std::vector<uint16_t> samples;
+};
+
+// Start and advance a reading out of line, as the DataReader of the sketch does from its own
+// translation unit, so that the compiler can't merge the steps of a reading into a single copy
+template <typename Sensors>
+__attribute__((noinline)) static bool startReading(Sensors* sensors, uint16_t* values) {
+    return sensors->start(values);
+}
+
+template <typename Sensors>
+__attribute__((noinline)) static bool advanceReading(Sensors* sensors, uint16_t* values) {
+    return sensors->advance(values);
+}
+
+// Run a round of the readings and the null checks of a version, keeping the fastest ones
+template <typename Sensors>
+static void runRound(Sensors* sensors, const std::vector<uint16_t>& source, long readingCount,
+                     benchResult* result) {
+    result->samples.resize(source.size());
+
+    auto start = std::chrono::steady_clock::now();
+    for (long reading = 0; reading < readingCount; reading++) {
+        int index = reading % BENCH_SAMPLE_COUNT;
+        benchSource = &source[index * BENCH_CHANNEL_COUNT];
+        uint16_t* values = &result->samples[index * BENCH_CHANNEL_COUNT];
+
+        bool complete = startReading(sensors, values);
+        while (!complete) {
+            complete = advanceReading(sensors, values);
+        }
+    }
+    double acquireNanos = std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now() - start).count();
+
+    long nullCount = 0;
+    start = std::chrono::steady_clock::now();
+    for (long reading = 0; reading < readingCount; reading++) {
+        int index = reading % BENCH_SAMPLE_COUNT;
+        nullCount += Sensors::isNull(&result->samples[index * BENCH_CHANNEL_COUNT]);
+    }
+    double nullCheckNanos = std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now() - start).count();
+
+    if (result->acquireNanos == 0 || acquireNanos < result->acquireNanos) {
+        result->acquireNanos = acquireNanos;
+    }
+    if (result->nullCheckNanos == 0 || nullCheckNanos < result->nullCheckNanos) {
+        result->nullCheckNanos = nullCheckNanos;
+    }
+    result->nullCount = nullCount;
+}
+
+static bool parseArguments(int argc, char** argv, benchConfig* config) {
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            return false;
+        }
+        const char* option = argv[i];
+        const char* value = argv[++i];
+
+        if (strcmp(option, "--readings") == 0) {
+            config->readings = atol(value);
+        } else if (strcmp(option, "--rounds") == 0) {
+            config->rounds = atoi(value);
+        } else {
+            return false;
+        }
+    }
+
+    return config->readings > 0 && config->rounds > 0;
+}
+
+int main(int argc, char** argv) {
+    benchConfig config;
+    if (!parseArguments(argc, argv, &config)) {
+        fprintf(stderr, "Usage: %s [--readings READINGS] [--rounds ROUNDS]\n", argv[0]);
+        return 1;
+    }
+
+    // Build the synthetic samples, a quarter of them null
+    std::mt19937 random(1);
+    std::uniform_int_distribution<int> value(1, 4095);
+    std::vector<uint16_t> source(BENCH_SAMPLE_COUNT * BENCH_CHANNEL_COUNT, 0);
+    for (int sample = 0; sample < BENCH_SAMPLE_COUNT; sample++) {
+        if (sample % 4 == 3) {
+            continue;
+        }
+        for (int channel = 0; channel < BENCH_CHANNEL_COUNT; channel++) {
+            source[sample * BENCH_CHANNEL_COUNT + channel] = value(random);
+        }
+    }
+
+    printf("readings=%ld rounds=%d channels=%d\n", config.readings, config.rounds,
+           BENCH_CHANNEL_COUNT);
+
+    benchResult registry;
+    benchResult handWritten;
+    BenchSensors registrySensors;
+    HandWrittenSensors handWrittenSensors;
+
+    // Alternate the versions, and which one goes first, so that both run in the same conditions
+    for (int round = 0; round < config.rounds; round++) {
+        if (round % 2 == 0) {
+            runRound(&registrySensors, source, config.readings, &registry);
+        }
+        runRound(&handWrittenSensors, source, config.readings, &handWritten);
+        if (round % 2 != 0) {
+            runRound(&registrySensors, source, config.readings, &registry);
+        }
+    }
+
+    const benchResult* results[] = {&registry, &handWritten};
+    const char* names[] = {"registry", "hand"};
+    for (int i = 0; i < 2; i++) {
+        printf("%-9s acquire=%.2fns/reading null-check=%.2fns/sample nulls=%ld\n", names[i],
+               results[i]->acquireNanos / config.readings,
+               results[i]->nullCheckNanos / config.readings, results[i]->nullCount);
+    }
+
+    bool match = registry.samples == handWritten.samples && registry.samples == source
+        && registry.nullCount == handWritten.nullCount;
+    printf("ratio     acquire=%.3f null-check=%.3f samples=%s\n",
+           registry.acquireNanos / handWritten.acquireNanos,
+           registry.nullCheckNanos / handWritten.nullCheckNanos, match ? "match" : "MISMATCH");
+
+    return match ? 0 : 1;
+}
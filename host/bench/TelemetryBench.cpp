@@ -0,0 +1,198 @@
+/*
+    TelemetryBench.cpp
+
+    * Benchmark of the recording of the telemetry (see Telemetry.h): the cost of record(),
+    called by the stages of the data path for each sample, against its budget of well under a
+    microsecond, and the cost of a snapshot, serialized every few minutes.
+    * The durations recorded are generated once, spread over the stages and log-uniform from
+    1 us to about a second, so that all the buckets of the histograms are hit, as in production.
+    * The cost is measured in many short rounds over the same durations, and the best round is
+    kept, which leaves out most of the noise of the host. It is given in nanoseconds and, on x86,
+    in cycles of the time-stamp counter, per record. The cycles give an order of magnitude of the
+    cost on the ESP32 (240 MHz, about 4.2 ns per cycle), whose instruction set differs.
+    * Usage: telemetry_bench [--records RECORDS] [--rounds ROUNDS]
+*/
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAS_TSC 1
+#endif
+
+#include "AsyncLog.h"
+#include "Errors.h"
+#include "Telemetry.h"
+
+// Set the amount of records of a round
+const int BENCH_ROUND_RECORDS = 4096;
+
+// Set the budget of a record, in nanoseconds (ns)
+const double BENCH_RECORD_BUDGET_NANOS = 1000;
+
+// Define the globals of the sketch
+Errors errorHandler;
+AsyncLog asyncLog;
+
+struct benchConfig {
+    long records = 1 << 20;
+    int rounds = 200;
+};
+
+/**
+ * Struct of the cost of the best round, per call
+ */
+struct benchCost {
+    double nanos = 0;
+    double cycles = 0;
+};
+
+/**
+ * Struct of a duration recorded, with its stage
+ */
+struct benchRecord {
+    TelemetryStage stage;
+    unsigned long durationMicros;
+};
+
+// Generate the durations, log-uniform from 1 us to 2^20 us, spread over the stages
+static std::vector<benchRecord> generateRecords(long recordCount) {
+    std::mt19937 random(42);
+    std::uniform_real_distribution<double> exponent(0, 20);
+
+    std::vector<benchRecord> records(recordCount);
+    for (long r = 0; r < recordCount; r++) {
+        records[r].stage = static_cast<TelemetryStage>(r % static_cast<int>(TelemetryStage::Count));
+        records[r].durationMicros = std::exp2(exponent(random));
+    }
+
+    return records;
+}
+
+// Time the records in many rounds, each over the next durations, and get the cost of the best one
+static benchCost measureRecords(Telemetry* telemetry, const std::vector<benchRecord>& records,
+                                int rounds) {
+    benchCost best;
+
+    for (int round = 0; round < rounds; round++) {
+        size_t first = (static_cast<size_t>(round) * BENCH_ROUND_RECORDS)
+                       % (records.size() - BENCH_ROUND_RECORDS + 1);
+
+        auto start = std::chrono::steady_clock::now();
+#ifdef BENCH_HAS_TSC
+        unsigned long long startCycles = __rdtsc();
+#endif
+
+        for (size_t r = first; r < first + BENCH_ROUND_RECORDS; r++) {
+            telemetry->record(records[r].stage, records[r].durationMicros);
+        }
+
+        benchCost cost;
+#ifdef BENCH_HAS_TSC
+        cost.cycles = static_cast<double>(__rdtsc() - startCycles);
+#endif
+        cost.nanos = std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - start).count();
+
+        if (best.nanos == 0 || cost.nanos < best.nanos) {
+            best = cost;
+        }
+    }
+
+    best.nanos /= BENCH_ROUND_RECORDS;
+    best.cycles /= BENCH_ROUND_RECORDS;
+    return best;
+}
+
+// Time the serialization of a snapshot in many rounds, and get the cost of the best one
+static benchCost measureSnapshot(const Telemetry& telemetry, int rounds, int* length) {
+    char snapshot[TELEMETRY_SNAPSHOT_CAPACITY];
+    benchCost best;
+
+    for (int round = 0; round < rounds; round++) {
+        auto start = std::chrono::steady_clock::now();
+#ifdef BENCH_HAS_TSC
+        unsigned long long startCycles = __rdtsc();
+#endif
+
+        *length = telemetry.serialize(snapshot, sizeof(snapshot));
+
+        benchCost cost;
+#ifdef BENCH_HAS_TSC
+        cost.cycles = static_cast<double>(__rdtsc() - startCycles);
+#endif
+        cost.nanos = std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - start).count();
+
+        if (best.nanos == 0 || cost.nanos < best.nanos) {
+            best = cost;
+        }
+    }
+
+    return best;
+}
+
+static bool parseArguments(int argc, char** argv, benchConfig* config) {
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            return false;
+        }
+        const char* option = argv[i];
+        const char* value = argv[++i];
+
+        if (strcmp(option, "--records") == 0) {
+            config->records = atol(value);
+        } else if (strcmp(option, "--rounds") == 0) {
+            config->rounds = atoi(value);
+        } else {
+            return false;
+        }
+    }
+
+    return config->records >= BENCH_ROUND_RECORDS && config->rounds > 0;
+}
+
+int main(int argc, char** argv) {
+    benchConfig config;
+    if (!parseArguments(argc, argv, &config)) {
+        fprintf(stderr, "Usage: %s [--records RECORDS] [--rounds ROUNDS]\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<benchRecord> records = generateRecords(config.records);
+    Telemetry telemetry;
+    benchCost recordCost = measureRecords(&telemetry, records, config.rounds);
+    int snapshotLength = 0;
+    benchCost snapshotCost = measureSnapshot(telemetry, config.rounds, &snapshotLength);
+
+    uint64_t recorded = 0;
+    for (int s = 0; s < static_cast<int>(TelemetryStage::Count); s++) {
+        const latencyHistogram& histogram = telemetry.getHistogram(static_cast<TelemetryStage>(s));
+        for (uint32_t count : histogram.buckets) {
+            recorded += count;
+        }
+    }
+
+    printf("stages=%d buckets=%d records=%ld recorded=%llu\n",
+           static_cast<int>(TelemetryStage::Count), TELEMETRY_HISTOGRAM_BUCKETS, config.records,
+           static_cast<unsigned long long>(recorded));
+#ifdef BENCH_HAS_TSC
+    printf("record        %.2fns/record %.2f cycles/record (time-stamp counter), "
+           "%.1f%% of the budget of %.0fns\n", recordCost.nanos, recordCost.cycles,
+           100 * recordCost.nanos / BENCH_RECORD_BUDGET_NANOS, BENCH_RECORD_BUDGET_NANOS);
+    printf("snapshot      %.0fns/snapshot %.0f cycles/snapshot, %d bytes\n", snapshotCost.nanos,
+           snapshotCost.cycles, snapshotLength);
+#else
+    printf("record        %.2fns/record, %.1f%% of the budget of %.0fns\n", recordCost.nanos,
+           100 * recordCost.nanos / BENCH_RECORD_BUDGET_NANOS, BENCH_RECORD_BUDGET_NANOS);
+    printf("snapshot      %.0fns/snapshot, %d bytes\n", snapshotCost.nanos, snapshotLength);
+#endif
+
+    return recordCost.nanos < BENCH_RECORD_BUDGET_NANOS ? 0 : 1;
+}
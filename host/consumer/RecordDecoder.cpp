@@ -0,0 +1,96 @@
+#include <cstdlib>
+#include <map>
+#include <vector>
+
+#include "RecordDecoder.h"
+#include "RtdbEmulator.h"
+
+// Parse the value of a channel, an integer of 16 bits
+static bool parseValue(const std::string& json, uint16_t* value) {
+    if (json.empty() || json.size() > 5
+        || json.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
+
+    unsigned long parsed = strtoul(json.c_str(), nullptr, 10);
+    if (parsed > UINT16_MAX) {
+        return false;
+    }
+    *value = static_cast<uint16_t>(parsed);
+
+    return true;
+}
+
+// Parse the key of a channel of a sparse record
+static bool parseChannel(const std::string& key, int* channel) {
+    if (key.empty() || key.size() > 2 || key.find_first_not_of("0123456789") != std::string::npos
+        || (key.size() > 1 && key[0] == '0')) {
+        return false;
+    }
+
+    *channel = atoi(key.c_str());
+
+    return *channel < SENSOR_CHANNEL_COUNT;
+}
+
+bool RecordDecoder::parseRecord(const std::string& json, uint16_t* channelMask,
+                                uint16_t values[SENSOR_CHANNEL_COUNT]) {
+    *channelMask = 0;
+
+    // A keyframe, or a sparse record stored as an array by the database
+    std::vector<std::string> elements;
+    if (splitJsonArray(json, &elements)) {
+        if (elements.empty() || elements.size() > SENSOR_CHANNEL_COUNT) {
+            return false;
+        }
+
+        for (size_t i = 0; i < elements.size(); i++) {
+            if (elements[i] == "null") {
+                continue;
+            }
+            if (!parseValue(elements[i], &values[i])) {
+                return false;
+            }
+            *channelMask |= 1 << i;
+        }
+
+        return *channelMask != 0;
+    }
+
+    // A sparse record, indexed by channel
+    std::map<std::string, std::string> members;
+    if (!splitJsonObject(json, &members) || members.empty()) {
+        return false;
+    }
+
+    for (const auto& member : members) {
+        int channel;
+        if (!parseChannel(member.first, &channel) || !parseValue(member.second, &values[channel])) {
+            return false;
+        }
+        *channelMask |= 1 << channel;
+    }
+
+    return true;
+}
+
+bool RecordDecoder::apply(const std::string& json) {
+    uint16_t channelMask;
+    uint16_t values[SENSOR_CHANNEL_COUNT];
+    if (!parseRecord(json, &channelMask, values)) {
+        return false;
+    }
+
+    decoder.apply(channelMask, values);
+    keyframeApplied = keyframeApplied || channelMask == CHANNEL_MASK_ALL;
+
+    return true;
+}
+
+bool RecordDecoder::hasKeyframe() const {
+    return keyframeApplied;
+}
+
+const uint16_t* RecordDecoder::getValues() const {
+    return decoder.getValues();
+}
@@ -0,0 +1,61 @@
+/*
+    RecordDecoder.h
+
+    * This module rebuilds, on the side of the readers of the database, the dense samples from
+    the records sent by the change filter of the sketch (see ChangeFilter.h).
+    * The records are read as the database returns them, in any of their forms:
+        keyframe: [VALUE_0,...,VALUE_11]
+        sparse record: {"3":VALUE_3,"7":VALUE_7}, or, once it holds more than half of the
+        channels up to its last one, the array the database stores instead of it, with null in
+        the missing channels and without the ones after its last channel: [VALUE_0,null,VALUE_2]
+    * The records must be applied in the order of their timestamps. The timestamps without a
+    record hold the values of the last one (see ChangeDecoder).
+*/
+
+#ifndef RecordDecoder_H_
+#define RecordDecoder_H_
+
+#include <string>
+
+#include "ChangeFilter.h"
+
+/**
+ * Class that rebuilds the dense samples from the records of the database
+ */
+class RecordDecoder {
+    ChangeDecoder decoder;
+    bool keyframeApplied = false;
+
+public:
+    /**
+     * Parse a record into the channels it carries and their values
+     * @param json The record, as returned by the database
+     * @param channelMask The channels carried by the record (bit i for the sensor i)
+     * @param values The values of the record, indexed by channel
+     * @return true if the record is valid, false otherwise
+     */
+    static bool parseRecord(const std::string& json, uint16_t* channelMask,
+                            uint16_t values[SENSOR_CHANNEL_COUNT]);
+
+    /**
+     * Apply the record of the next timestamp
+     * @param json The record, as returned by the database
+     * @return true if the record is valid, false otherwise (the values are kept)
+     */
+    bool apply(const std::string& json);
+
+    /**
+     * Check if a keyframe was applied, before which the values of the channels that weren't
+     * carried yet are unknown
+     * @return true if a keyframe was applied, false otherwise
+     */
+    bool hasKeyframe() const;
+
+    /**
+     * Get the dense values of the last timestamp applied
+     * @return The value of each channel
+     */
+    const uint16_t* getValues() const;
+};
+
+#endif  // RecordDecoder_H_
@@ -0,0 +1,642 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+#include "RtdbEmulator.h"
+
+// Set the maximum size of the headers of a request, in bytes
+const size_t EMULATOR_MAX_HEADER_SIZE = 8192;
+// Set the maximum size of the body of a request, as the limit of the database (256 MB) is far
+// above what the devices send, in bytes
+const size_t EMULATOR_MAX_BODY_SIZE = 16 * 1024 * 1024;
+
+static size_t skipWhitespace(const std::string& json, size_t position) {
+    while (position < json.size() && isspace(static_cast<unsigned char>(json[position]))) {
+        position++;
+    }
+
+    return position;
+}
+
+// Find the end of a string that starts at position (a quote), or npos if it isn't closed
+static size_t skipString(const std::string& json, size_t position) {
+    for (position++; position < json.size(); position++) {
+        if (json[position] == '\\') {
+            position++;
+        } else if (json[position] == '"') {
+            return position + 1;
+        }
+    }
+
+    return std::string::npos;
+}
+
+// Find the end of the value that starts at position, or npos if it isn't closed
+static size_t skipValue(const std::string& json, size_t position) {
+    if (position >= json.size()) {
+        return std::string::npos;
+    }
+
+    if (json[position] == '"') {
+        return skipString(json, position);
+    }
+
+    if (json[position] == '{' || json[position] == '[') {
+        int depth = 0;
+        while (position < json.size()) {
+            char c = json[position];
+            if (c == '"') {
+                position = skipString(json, position);
+                if (position == std::string::npos) {
+                    return position;
+                }
+                continue;
+            }
+
+            if (c == '{' || c == '[') {
+                depth++;
+            } else if ((c == '}' || c == ']') && --depth == 0) {
+                return position + 1;
+            }
+            position++;
+        }
+
+        return std::string::npos;
+    }
+
+    // Numbers, booleans and null end at the next separator
+    size_t end = json.find_first_of(",}] \t\r\n", position);
+    end = end == std::string::npos ? json.size() : end;
+
+    return end > position ? end : std::string::npos;
+}
+
+bool splitJsonObject(const std::string& json, std::map<std::string, std::string>* members) {
+    size_t position = skipWhitespace(json, 0);
+    if (position >= json.size() || json[position] != '{') {
+        return false;
+    }
+
+    position = skipWhitespace(json, position + 1);
+    if (position < json.size() && json[position] == '}') {
+        return skipWhitespace(json, position + 1) == json.size();
+    }
+
+    while (position < json.size()) {
+        size_t keyEnd = json[position] == '"' ? skipString(json, position) : std::string::npos;
+        if (keyEnd == std::string::npos) {
+            return false;
+        }
+        std::string key = json.substr(position + 1, keyEnd - position - 2);
+
+        position = skipWhitespace(json, keyEnd);
+        if (position >= json.size() || json[position] != ':') {
+            return false;
+        }
+
+        position = skipWhitespace(json, position + 1);
+        size_t valueEnd = skipValue(json, position);
+        if (valueEnd == std::string::npos || key.empty()) {
+            return false;
+        }
+        (*members)[key] = json.substr(position, valueEnd - position);
+
+        position = skipWhitespace(json, valueEnd);
+        if (position < json.size() && json[position] == '}') {
+            return skipWhitespace(json, position + 1) == json.size();
+        }
+        if (position >= json.size() || json[position] != ',') {
+            return false;
+        }
+        position = skipWhitespace(json, position + 1);
+    }
+
+    return false;
+}
+
+bool splitJsonArray(const std::string& json, std::vector<std::string>* elements) {
+    size_t position = skipWhitespace(json, 0);
+    if (position >= json.size() || json[position] != '[') {
+        return false;
+    }
+
+    position = skipWhitespace(json, position + 1);
+    if (position < json.size() && json[position] == ']') {
+        return skipWhitespace(json, position + 1) == json.size();
+    }
+
+    while (position < json.size()) {
+        size_t valueEnd = skipValue(json, position);
+        if (valueEnd == std::string::npos) {
+            return false;
+        }
+        elements->push_back(json.substr(position, valueEnd - position));
+
+        position = skipWhitespace(json, valueEnd);
+        if (position < json.size() && json[position] == ']') {
+            return skipWhitespace(json, position + 1) == json.size();
+        }
+        if (position >= json.size() || json[position] != ',') {
+            return false;
+        }
+        position = skipWhitespace(json, position + 1);
+    }
+
+    return false;
+}
+
+// Parse a key that is an index of an array: digits only, without leading zeros
+static bool parseArrayIndex(const std::string& key, size_t* index) {
+    if (key.empty() || key.size() > 9 || (key.size() > 1 && key[0] == '0')) {
+        return false;
+    }
+
+    *index = 0;
+    for (char c : key) {
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        *index = *index * 10 + (c - '0');
+    }
+
+    return true;
+}
+
+std::string toDatabaseForm(const std::string& json) {
+    std::map<std::string, std::string> members;
+    if (!splitJsonObject(json, &members) || members.empty()) {
+        return json;
+    }
+
+    std::map<size_t, const std::string*> elements;
+    for (const auto& member : members) {
+        size_t index;
+        if (!parseArrayIndex(member.first, &index)) {
+            return json;
+        }
+        elements[index] = &member.second;
+    }
+
+    // As the database, only the objects holding more than half of their indexes are arrays
+    size_t length = elements.rbegin()->first + 1;
+    if (2 * elements.size() <= length) {
+        return json;
+    }
+
+    std::string array = "[";
+    for (size_t index = 0; index < length; index++) {
+        auto element = elements.find(index);
+        array += index > 0 ? "," : "";
+        array += element != elements.end() ? *element->second : "null";
+    }
+
+    return array + "]";
+}
+
+std::string normalizePath(const std::string& path) {
+    std::string normalized = "/";
+    for (char c : path) {
+        if (c != '/' || normalized.back() != '/') {
+            normalized += c;
+        }
+    }
+
+    if (normalized.size() > 1 && normalized.back() == '/') {
+        normalized.pop_back();
+    }
+
+    return normalized;
+}
+
+static std::string joinPath(const std::string& path, const std::string& key) {
+    return normalizePath(path + "/" + key);
+}
+
+// Get the first path after all the paths below path, to iterate over them in a sorted map
+static std::string getSubtreeEnd(const std::string& path) {
+    return path == "/" ? "0" : path + "0";
+}
+
+static std::string getSubtreeBegin(const std::string& path) {
+    return path == "/" ? "/" : path + "/";
+}
+
+// Get the value of a parameter of the query of a request
+static std::string getQueryParameter(const std::string& query, const char* name) {
+    std::string prefix = std::string(name) + "=";
+    size_t position = 0;
+    while (position < query.size()) {
+        size_t end = query.find('&', position);
+        end = end == std::string::npos ? query.size() : end;
+        if (query.compare(position, prefix.size(), prefix) == 0) {
+            return query.substr(position + prefix.size(), end - position - prefix.size());
+        }
+        position = end + 1;
+    }
+
+    return "";
+}
+
+static bool sendAll(int socket, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t length = send(socket, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (length <= 0) {
+            return false;
+        }
+        sent += length;
+    }
+
+    return true;
+}
+
+static const char* getStatusText(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 204: return "No Content";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 503: return "Service Unavailable";
+        default: return "Error";
+    }
+}
+
+RtdbEmulator::RtdbEmulator(const emulatorConfig& config) : config(config) {}
+
+RtdbEmulator::~RtdbEmulator() {
+    stop();
+}
+
+bool RtdbEmulator::start() {
+    listenSocket = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenSocket < 0) {
+        return false;
+    }
+
+    int enable = 1;
+    setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(config.port);
+    if (inet_pton(AF_INET, config.host.c_str(), &address.sin_addr) != 1
+            || bind(listenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+            || listen(listenSocket, SOMAXCONN) != 0) {
+        close(listenSocket);
+        listenSocket = -1;
+        return false;
+    }
+
+    socklen_t addressLength = sizeof(address);
+    getsockname(listenSocket, reinterpret_cast<sockaddr*>(&address), &addressLength);
+    port = ntohs(address.sin_port);
+
+    startTime = std::chrono::steady_clock::now();
+    running.store(true);
+    acceptThread = std::thread(&RtdbEmulator::acceptConnections, this);
+
+    return true;
+}
+
+void RtdbEmulator::stop() {
+    if (!running.exchange(false)) {
+        return;
+    }
+
+    // Unblock accept() and the reads of the connections
+    shutdown(listenSocket, SHUT_RDWR);
+    acceptThread.join();
+    close(listenSocket);
+    listenSocket = -1;
+
+    std::unique_lock<std::mutex> lock(connectionsMutex);
+    for (int socket : connectionSockets) {
+        shutdown(socket, SHUT_RDWR);
+    }
+    connectionsClosed.wait(lock, [this] { return connectionSockets.empty(); });
+}
+
+uint16_t RtdbEmulator::getPort() const {
+    return port;
+}
+
+void RtdbEmulator::setOutage(bool outage) {
+    manualOutage.store(outage);
+}
+
+bool RtdbEmulator::isInOutage() const {
+    if (manualOutage.load()) {
+        return true;
+    }
+    if (config.outageStartSeconds < 0) {
+        return false;
+    }
+
+    double elapsedSeconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - startTime).count();
+    return elapsedSeconds >= config.outageStartSeconds
+           && elapsedSeconds < config.outageStartSeconds + config.outageSeconds;
+}
+
+void RtdbEmulator::acceptConnections() {
+    while (running.load()) {
+        int socket = accept4(listenSocket, nullptr, nullptr, SOCK_CLOEXEC);
+        if (socket < 0) {
+            if (errno == EINTR || errno == ECONNABORTED || errno == EMFILE) {
+                continue;
+            }
+            return;
+        }
+
+        // During an outage, the connections are closed right away, as if the server was down
+        if (isInOutage()) {
+            outageClosures++;
+            close(socket);
+            continue;
+        }
+
+        int enable = 1;
+        setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+        connections++;
+
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        if (!running.load()) {
+            close(socket);
+            return;
+        }
+        connectionSockets.insert(socket);
+        std::thread(&RtdbEmulator::serveConnection, this, socket).detach();
+    }
+}
+
+void RtdbEmulator::serveConnection(int socket) {
+    thread_local std::mt19937 random(std::random_device{}());
+    std::uniform_real_distribution<double> probability(0, 1);
+
+    std::string received;
+    char chunk[16384];
+    bool open = true;
+
+    while (open) {
+        // Read the headers of the next request
+        size_t headerEnd;
+        while ((headerEnd = received.find("\r\n\r\n")) == std::string::npos) {
+            ssize_t length = received.size() < EMULATOR_MAX_HEADER_SIZE
+                                 ? recv(socket, chunk, sizeof(chunk), 0) : -1;
+            if (length <= 0) {
+                open = false;
+                break;
+            }
+            received.append(chunk, length);
+        }
+        if (!open) {
+            break;
+        }
+
+        // The request line is "<method> <path>.json?<query> HTTP/1.1"
+        std::string headers = received.substr(0, headerEnd);
+        char method[16] = "";
+        char target[2048] = "";
+        sscanf(headers.c_str(), "%15s %2047s", method, target);
+
+        size_t contentLength = 0;
+        const char* field = strcasestr(headers.c_str(), "\r\nContent-Length:");
+        if (field != nullptr) {
+            contentLength = strtoul(field + 17, nullptr, 10);
+        }
+        bool closeRequested = strcasestr(headers.c_str(), "\r\nConnection: close") != nullptr;
+        if (contentLength > EMULATOR_MAX_BODY_SIZE) {
+            badRequests++;
+            break;
+        }
+
+        // Read the body
+        size_t requestSize = headerEnd + 4 + contentLength;
+        while (received.size() < requestSize) {
+            ssize_t length = recv(socket, chunk, sizeof(chunk), 0);
+            if (length <= 0) {
+                open = false;
+                break;
+            }
+            received.append(chunk, length);
+        }
+        if (!open) {
+            break;
+        }
+
+        std::string body = received.substr(headerEnd + 4, contentLength);
+        received.erase(0, requestSize);
+        requests++;
+        bytesReceived += requestSize;
+
+        if (isInOutage()) {
+            outageClosures++;
+            break;
+        }
+
+        std::string targetPath = target;
+        std::string query;
+        size_t querySeparator = targetPath.find('?');
+        if (querySeparator != std::string::npos) {
+            query = targetPath.substr(querySeparator + 1);
+            targetPath.erase(querySeparator);
+        }
+
+        int status;
+        std::string response;
+        if (probability(random) < config.errorRate) {
+            injectedErrors++;
+            status = 503;
+            response = "{\"error\":\"Service unavailable (injected)\"}";
+        } else if (targetPath.size() < 5
+                       || targetPath.compare(targetPath.size() - 5, 5, ".json") != 0) {
+            badRequests++;
+            status = 404;
+            response = "{\"error\":\"The path must end with .json\"}";
+        } else {
+            std::string databaseNamespace = getQueryParameter(query, "ns");
+            targetPath.erase(targetPath.size() - 5);
+            status = handleRequest(method, normalizePath(targetPath),
+                                   databaseNamespace.empty() ? "default" : databaseNamespace,
+                                   body, &response);
+            if (status == 200 && getQueryParameter(query, "print") == "silent") {
+                status = 204;
+                response.clear();
+            }
+        }
+
+        int delayMillis = config.latencyMillis;
+        if (config.jitterMillis > 0) {
+            delayMillis += std::uniform_int_distribution<int>(0, config.jitterMillis)(random);
+        }
+        if (delayMillis > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(delayMillis));
+        }
+
+        // The update is already applied, only its response is lost
+        if (status < 300 && probability(random) < config.dropRate) {
+            droppedResponses++;
+            break;
+        }
+
+        char header[256];
+        snprintf(header, sizeof(header),
+                 "HTTP/1.1 %d %s\r\nContent-Type: application/json; charset=utf-8\r\n"
+                 "Content-Length: %zu\r\nConnection: %s\r\n\r\n",
+                 status, getStatusText(status), response.size(),
+                 closeRequested ? "close" : "keep-alive");
+        if (!sendAll(socket, header + response) || closeRequested) {
+            break;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    close(socket);
+    connectionSockets.erase(socket);
+    connectionsClosed.notify_all();
+}
+
+int RtdbEmulator::handleRequest(const std::string& method, const std::string& path,
+                                const std::string& databaseNamespace, const std::string& body,
+                                std::string* response) {
+    std::lock_guard<std::mutex> lock(dataMutex);
+    std::map<std::string, std::string>& data = databases[databaseNamespace];
+
+    if (method == "GET") {
+        *response = getValue(data, path);
+        return 200;
+    }
+
+    if (method == "DELETE") {
+        data.erase(path);
+        data.erase(data.lower_bound(getSubtreeBegin(path)), data.lower_bound(getSubtreeEnd(path)));
+        *response = "null";
+        return 200;
+    }
+
+    if (method == "PATCH") {
+        // Each member replaces the child with its key, the other children are kept
+        std::map<std::string, std::string> members;
+        if (!splitJsonObject(body, &members)) {
+            badRequests++;
+            *response = "{\"error\":\"Invalid data; couldn't parse JSON object.\"}";
+            return 400;
+        }
+
+        for (const auto& member : members) {
+            setValue(&data, joinPath(path, member.first), member.second);
+        }
+        *response = body;
+        return 200;
+    }
+
+    if (method == "PUT" || method == "POST") {
+        size_t end = skipValue(body, skipWhitespace(body, 0));
+        if (end == std::string::npos || skipWhitespace(body, end) != body.size()) {
+            badRequests++;
+            *response = "{\"error\":\"Invalid data; couldn't parse JSON object.\"}";
+            return 400;
+        }
+
+        if (method == "PUT") {
+            setValue(&data, path, body);
+            *response = body;
+        } else {
+            // The push ids are chronological, as the ones of the database
+            char pushId[24];
+            snprintf(pushId, sizeof(pushId), "-E%018llu",
+                     static_cast<unsigned long long>(nextPushId++));
+            setValue(&data, joinPath(path, pushId), body);
+            *response = std::string("{\"name\":\"") + pushId + "\"}";
+        }
+        return 200;
+    }
+
+    *response = "{\"error\":\"Method not allowed\"}";
+    return 405;
+}
+
+void RtdbEmulator::setValue(std::map<std::string, std::string>* data, const std::string& path,
+                            const std::string& value) {
+    // The values are only stored on the leaves, so a new value replaces the ones below it and
+    // the ones of its ancestors
+    for (size_t slash = path.find('/', 1); slash != std::string::npos;
+             slash = path.find('/', slash + 1)) {
+        data->erase(path.substr(0, slash));
+    }
+    auto below = data->lower_bound(getSubtreeBegin(path));
+    data->erase(below, data->lower_bound(getSubtreeEnd(path)));
+
+    auto inserted = data->insert_or_assign(path, toDatabaseForm(value));
+    keysWritten++;
+    if (!inserted.second) {
+        overwrites++;
+    }
+}
+
+std::string RtdbEmulator::getValue(const std::map<std::string, std::string>& data,
+                                   const std::string& path) const {
+    auto exact = data.find(path);
+    if (exact != data.end()) {
+        return exact->second;
+    }
+
+    // Only the keys of the children are listed, as with "shallow=true"
+    std::string begin = getSubtreeBegin(path);
+    std::string children = "{";
+    std::string lastChild;
+    for (auto it = data.lower_bound(begin); it != data.end()
+             && it->first.compare(0, begin.size(), begin) == 0; ++it) {
+        std::string child = it->first.substr(begin.size(), it->first.find('/', begin.size())
+                                                               - begin.size());
+        if (child != lastChild) {
+            children += (children.size() > 1 ? ",\"" : "\"") + child + "\":true";
+            lastChild = child;
+        }
+    }
+
+    return children.size() > 1 ? children + "}" : "null";
+}
+
+size_t RtdbEmulator::countValues(const std::string& databaseNamespace,
+                                 const std::string& path) const {
+    std::lock_guard<std::mutex> lock(dataMutex);
+    auto database = databases.find(databaseNamespace);
+    if (database == databases.end()) {
+        return 0;
+    }
+
+    std::string normalized = normalizePath(path);
+    const std::map<std::string, std::string>& data = database->second;
+    size_t count = normalized != "/" ? data.count(normalized) : 0;
+    auto end = data.lower_bound(getSubtreeEnd(normalized));
+    for (auto it = data.lower_bound(getSubtreeBegin(normalized)); it != end; ++it) {
+        count++;
+    }
+
+    return count;
+}
+
+emulatorStats RtdbEmulator::getStats() const {
+    emulatorStats stats;
+    stats.connections = connections.load();
+    stats.requests = requests.load();
+    stats.bytesReceived = bytesReceived.load();
+    stats.keysWritten = keysWritten.load();
+    stats.overwrites = overwrites.load();
+    stats.injectedErrors = injectedErrors.load();
+    stats.droppedResponses = droppedResponses.load();
+    stats.outageClosures = outageClosures.load();
+    stats.badRequests = badRequests.load();
+
+    return stats;
+}
@@ -0,0 +1,191 @@
+/*
+    RtdbEmulator.h
+
+    * This module implements a local stand-in for the Firebase Realtime Database, limited to
+    the subset of the REST API used by the sketch: PATCH of the batches and of the telemetry
+    (updateNodeSilentAsync), POST of the boot log (pushInt), plus PUT, GET and DELETE to
+    inspect and reset the data.
+    * The data is kept in memory, one tree per database instance ("ns" parameter), stored as
+    a sorted map of paths. As in the database, the objects indexed by integers are stored as
+    arrays (see toDatabaseForm()). Every update of a path that already had a value is counted,
+    as it shows the batches that were sent again after a lost response.
+    * Each connection is served by its own thread and kept open between the requests (HTTP/1.1
+    keep-alive), as the devices do.
+    * Faults can be injected: a latency before each response, an error rate (503 responses,
+    the update is not applied), a drop rate (the update is applied, but the connection is closed
+    without a response) and an outage window, during which every connection is closed.
+*/
+
+#ifndef RtdbEmulator_H_
+#define RtdbEmulator_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct emulatorConfig {
+    std::string host = "127.0.0.1";
+    // Port of the server, 0 picks a free one (see getPort())
+    uint16_t port = 9000;
+    // Latency added to each response, plus a random jitter up to jitterMillis
+    int latencyMillis = 0;
+    int jitterMillis = 0;
+    // Probability of answering a request with an error (503), from 0 to 1
+    double errorRate = 0;
+    // Probability of closing the connection after applying a request, without a response
+    double dropRate = 0;
+    // Outage window, in seconds since the start of the emulator. A negative start disables it
+    double outageStartSeconds = -1;
+    double outageSeconds = 0;
+};
+
+// Define a snapshot of the counters of the emulator
+struct emulatorStats {
+    uint64_t connections = 0;
+    uint64_t requests = 0;
+    uint64_t bytesReceived = 0;
+    uint64_t keysWritten = 0;
+    uint64_t overwrites = 0;
+    uint64_t injectedErrors = 0;
+    uint64_t droppedResponses = 0;
+    uint64_t outageClosures = 0;
+    uint64_t badRequests = 0;
+};
+
+/**
+ * Class that runs the emulator: the listening thread and one thread per connection
+ */
+class RtdbEmulator {
+    emulatorConfig config;
+
+    int listenSocket = -1;
+    uint16_t port = 0;
+    std::chrono::steady_clock::time_point startTime;
+    std::atomic<bool> running{false};
+    std::atomic<bool> manualOutage{false};
+
+    std::thread acceptThread;
+
+    // Track the open connections, so that stop() can close them and wait for their threads
+    std::mutex connectionsMutex;
+    std::condition_variable connectionsClosed;
+    std::set<int> connectionSockets;
+
+    // Store the data of each database instance, by path
+    mutable std::mutex dataMutex;
+    std::unordered_map<std::string, std::map<std::string, std::string>> databases;
+    uint64_t nextPushId = 0;
+
+    std::atomic<uint64_t> connections{0};
+    std::atomic<uint64_t> requests{0};
+    std::atomic<uint64_t> bytesReceived{0};
+    std::atomic<uint64_t> keysWritten{0};
+    std::atomic<uint64_t> overwrites{0};
+    std::atomic<uint64_t> injectedErrors{0};
+    std::atomic<uint64_t> droppedResponses{0};
+    std::atomic<uint64_t> outageClosures{0};
+    std::atomic<uint64_t> badRequests{0};
+
+    void acceptConnections();
+    void serveConnection(int socket);
+    bool isInOutage() const;
+
+    // Apply a request to the data and build the status and the body of its response
+    int handleRequest(const std::string& method, const std::string& path,
+                      const std::string& databaseNamespace, const std::string& body,
+                      std::string* response);
+    // Set a value on a path, replacing its children. Must be called with dataMutex held
+    void setValue(std::map<std::string, std::string>* data, const std::string& path,
+                  const std::string& value);
+    std::string getValue(const std::map<std::string, std::string>& data,
+                         const std::string& path) const;
+
+public:
+    /**
+     * Constructor for the RtdbEmulator class
+     * @param config The configuration of the emulator
+     */
+    explicit RtdbEmulator(const emulatorConfig& config);
+    ~RtdbEmulator();
+
+    RtdbEmulator(const RtdbEmulator&) = delete;
+    RtdbEmulator& operator=(const RtdbEmulator&) = delete;
+
+    /**
+     * Open the server and start accepting connections
+     * @return true if the server is listening, false otherwise
+     */
+    bool start();
+
+    /**
+     * Close the server and the connections, waiting for their threads
+     */
+    void stop();
+
+    /**
+     * Get the port of the server, useful when it was picked by the system
+     * @return The port of the server
+     */
+    uint16_t getPort() const;
+
+    /**
+     * Start or end an outage, on top of the configured outage window
+     * @param outage Whether the emulator must close every connection
+     */
+    void setOutage(bool outage);
+
+    /**
+     * Count the values stored on a path and below it
+     * @param databaseNamespace The database instance
+     * @param path The path, "/" for the whole database
+     * @return The amount of values stored
+     */
+    size_t countValues(const std::string& databaseNamespace, const std::string& path) const;
+
+    /**
+     * Get a snapshot of the counters of the emulator
+     * @return The counters of the emulator
+     */
+    emulatorStats getStats() const;
+};
+
+/**
+ * Split the members of a JSON object into their keys and their raw (unparsed) values
+ * @param json The JSON object
+ * @param members The keys and the values of the members, in order
+ * @return true if the object is well formed at its top level, false otherwise
+ */
+bool splitJsonObject(const std::string& json,
+                     std::map<std::string, std::string>* members);
+
+/**
+ * Split the elements of a JSON array into their raw (unparsed) values
+ * @param json The JSON array
+ * @param elements The values of the elements, in order
+ * @return true if the array is well formed at its top level, false otherwise
+ */
+bool splitJsonArray(const std::string& json, std::vector<std::string>* elements);
+
+/**
+ * Convert a value into the form returned by the database: an object whose keys are all
+ * indexes is stored as an array when it holds more than half of them, with null in the holes
+ * @param json The value
+ * @return The array, or the same value when it isn't converted
+ */
+std::string toDatabaseForm(const std::string& json);
+
+/**
+ * Normalize a path of the database: a single "/" between the keys, without a trailing "/"
+ * @param path The path
+ * @return The normalized path, "/" for the root
+ */
+std::string normalizePath(const std::string& path);
+
+#endif  // RtdbEmulator_H_
@@ -0,0 +1,103 @@
+/*
+    main.cpp
+
+    * Entry point of the standalone RTDB emulator, to run the sketch (or any client of the REST
+    API) against it. Set FIREBASE_DATABASE_EMULATOR_HOST=<host>:<port> on the host programs.
+    * Usage: rtdb_emulator [--host ADDRESS] [--port PORT] [--latency MS] [--jitter MS]
+    [--error-rate PROBABILITY] [--drop-rate PROBABILITY] [--outage START_S:DURATION_S]
+*/
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include "RtdbEmulator.h"
+
+// Set the interval between the reports of the counters, in seconds (s)
+const int EMULATOR_REPORT_INTERVAL_SECONDS = 10;
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void onSignal(int) {
+    stopRequested = 1;
+}
+
+static bool parseArguments(int argc, char** argv, emulatorConfig* config) {
+    for (int i = 1; i < argc; i++) {
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        if (value == nullptr) {
+            return false;
+        } else if (strcmp(argv[i], "--host") == 0) {
+            config->host = value;
+        } else if (strcmp(argv[i], "--port") == 0) {
+            config->port = atoi(value);
+        } else if (strcmp(argv[i], "--latency") == 0) {
+            config->latencyMillis = atoi(value);
+        } else if (strcmp(argv[i], "--jitter") == 0) {
+            config->jitterMillis = atoi(value);
+        } else if (strcmp(argv[i], "--error-rate") == 0) {
+            config->errorRate = atof(value);
+        } else if (strcmp(argv[i], "--drop-rate") == 0) {
+            config->dropRate = atof(value);
+        } else if (strcmp(argv[i], "--outage") == 0) {
+            if (sscanf(value, "%lf:%lf", &config->outageStartSeconds,
+                       &config->outageSeconds) != 2) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+        i++;
+    }
+
+    return config->latencyMillis >= 0 && config->jitterMillis >= 0;
+}
+
+int main(int argc, char** argv) {
+    emulatorConfig config;
+    if (!parseArguments(argc, argv, &config)) {
+        fprintf(stderr, "Usage: %s [--host ADDRESS] [--port PORT] [--latency MS] [--jitter MS] "
+                        "[--error-rate PROBABILITY] [--drop-rate PROBABILITY] "
+                        "[--outage START_S:DURATION_S]\n", argv[0]);
+        return 1;
+    }
+
+    RtdbEmulator emulator(config);
+    if (!emulator.start()) {
+        perror("Could not start the emulator");
+        return 1;
+    }
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    printf("Listening on %s:%u\n", config.host.c_str(), emulator.getPort());
+    fflush(stdout);
+
+    int elapsedSeconds = 0;
+    while (!stopRequested) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+
+        if (++elapsedSeconds % EMULATOR_REPORT_INTERVAL_SECONDS == 0) {
+            emulatorStats stats = emulator.getStats();
+            printf("connections=%llu requests=%llu bytes=%llu keys=%llu overwrites=%llu "
+                   "errors=%llu drops=%llu outage=%llu\n",
+                   static_cast<unsigned long long>(stats.connections),
+                   static_cast<unsigned long long>(stats.requests),
+                   static_cast<unsigned long long>(stats.bytesReceived),
+                   static_cast<unsigned long long>(stats.keysWritten),
+                   static_cast<unsigned long long>(stats.overwrites),
+                   static_cast<unsigned long long>(stats.injectedErrors),
+                   static_cast<unsigned long long>(stats.droppedResponses),
+                   static_cast<unsigned long long>(stats.outageClosures));
+            fflush(stdout);
+        }
+    }
+
+    emulator.stop();
+
+    return 0;
+}
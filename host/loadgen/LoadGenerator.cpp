@@ -0,0 +1,478 @@
+/*
+    LoadGenerator.cpp
+
+    * Load generator of the upload path: it starts the RTDB emulator (see RtdbEmulator.h) and
+    runs many simulated chairs against it, each one with the real Database, SensorDataBuffer and
+    Spool of the sketch, built for the host (see host/shims).
+    * Each chair is a process, so that the globals of the sketch (telemetry, log, error handler,
+    file system) are its own. Its samples are produced by a thread at a fixed rate, in place of
+    the DataReader, and sent by the loop of the encode stage (see Stages.h).
+    * After the run, the production stops and the chairs keep sending until their backlog is
+    empty. Then, the samples stored by the emulator are compared with the ones produced, so
+    that the samples lost by a failure show up.
+    * It reports the upload throughput, the size of the requests, the failures, the samples
+    lost and the time that the chairs took to drain their backlog once the production stopped,
+    and prints a line per second with the rates seen by the emulator.
+    * The logs of each chair are written to <data>/chair-<index>/log.txt and its spool to
+    <data>/chair-<index>/littlefs.
+    * Usage: rtdb_loadgen [--chairs COUNT] [--seconds DURATION] [--rate SAMPLES_PER_SECOND]
+    [--drain DURATION] [--data DIRECTORY] [--latency MS] [--jitter MS]
+    [--error-rate PROBABILITY] [--drop-rate PROBABILITY] [--outage START_S:DURATION_S]
+    [--depth BATCHES] [--batch SAMPLES] [--heap-leak BYTES_PER_SECOND]
+    * --depth sets the amount of batches in flight of each chair (see UploadPipeline.h).
+    * --batch fixes the size of the batches, in place of the one adapted to the backlog and to
+    the push latency (see BatchController.h), to compare both: with an outage until the end of
+    the run, the chairs drain the backlog of the outage.
+    * --heap-leak shrinks the largest free block of the heap of each chair at a fixed rate from
+    its boot, as a fragmenting heap, so that the restarts of the heap watchdog (see
+    HeapWatchdog.h) can be checked not to lose any sample.
+*/
+
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <LittleFS.h>
+
+#include "AsyncLog.h"
+#include "Buffer.h"
+#include "Clock.h"
+#include "Connectivity.h"
+#include "Database.h"
+#include "Errors.h"
+#include "RtdbEmulator.h"
+#include "Stages.h"
+#include "Telemetry.h"
+
+// Define the globals of the sketch, one instance per chair (process)
+Errors errorHandler;
+AsyncLog asyncLog;
+Telemetry telemetry;
+Connectivity connectivity;
+StageMonitor stageMonitor;
+
+static SensorDataBuffer dataBuffer;
+static Database database;
+
+struct loadConfig {
+    int chairs = 100;
+    int seconds = 30;
+    double rate = 2;
+    int drainSeconds = 30;
+    std::string dataPath = "loadgen_data";
+    int depth = UPLOAD_PIPELINE_DEPTH;
+    // Fixed size of the batches, 0 to adapt it
+    int batchSize = 0;
+    // Rate at which the largest free block of the heap shrinks, in bytes per second (B/s)
+    double heapLeak = 0;
+    emulatorConfig emulator;
+};
+
+// Define the counters of a chair, kept in memory shared with the load generator, so that they
+// survive the reboots of the chair
+struct chairReport {
+    uint64_t producedSamples;
+    uint64_t overflowedSamples;
+    uint32_t pushes;
+    uint32_t pushFailures;
+    uint32_t reboots;
+    int32_t backlog;
+    bool drained;
+    // Time from the end of the run to the last batch sent, in seconds (s)
+    double drainSeconds;
+};
+
+// Define a simulated chair: its process and the pipe to start it
+struct simulatedChair {
+    pid_t process;
+    int startPipe;
+};
+
+// Produce the samples of a chair at a fixed rate, as the DataReader would
+static void produceSamples(const loadConfig* config, int chairIndex,
+                           const std::atomic<bool>* producing, chairReport* report) {
+    std::mt19937 random(chairIndex + report->reboots * 7919);
+    std::uniform_int_distribution<int> step(-12, 12);
+    uint16_t values[SENSOR_CHANNEL_COUNT];
+    for (int j = 0; j < SENSOR_CHANNEL_COUNT; j++) {
+        values[j] = 1000 + 100 * j;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t sequence = 0;
+    unsigned long long previousTimestampMillis = 0;
+
+    while (producing->load()) {
+        // The first channel always moves beyond the deadband of the change filter, so that
+        // every sample reaches the database and the lost ones can be counted. The others
+        // drift slowly, as with a seated person
+        values[0] = 500 + (sequence * 37) % 3000;
+        for (int j = 1; j < SENSOR_CHANNEL_COUNT; j++) {
+            values[j] = std::min(4000, std::max(100, values[j] + step(random)));
+        }
+
+        // After a stall, the late samples are produced at once. They still get distinct
+        // timestamps, as the samples of the same millisecond share a key on the database
+        unsigned long long timestampMillis = std::max(clockEpochMillis(),
+                                                      previousTimestampMillis + 1);
+        previousTimestampMillis = timestampMillis;
+
+        sensorData* sample = dataBuffer.getNewSample(timestampMillis);
+        if (sample != nullptr) {
+            memcpy(sample->pressureSensor, values, sizeof(values));
+            dataBuffer.commitNewSample();
+            report->producedSamples++;
+        } else {
+            // Dropped as the data collection of the sketch does (see DataReader.cpp)
+            telemetry.countDroppedSample();
+            report->overflowedSamples++;
+        }
+
+        sequence++;
+        std::this_thread::sleep_until(start + std::chrono::microseconds(
+            static_cast<uint64_t>(sequence * 1e6 / config->rate)));
+    }
+}
+
+// Shrink the largest free block of the heap of the chair with the time since its boot
+static void leakHeap(const loadConfig* config, std::chrono::steady_clock::time_point bootTime) {
+    static const uint32_t freeHeap = ESP.getFreeHeap();
+    static const uint32_t largestFreeBlock = ESP.getMaxAllocHeap();
+    if (config->heapLeak <= 0) {
+        return;
+    }
+
+    double bootSeconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - bootTime).count();
+    double leaked = std::min(config->heapLeak * bootSeconds, static_cast<double>(freeHeap));
+    hostSetHeap(freeHeap - leaked, std::max(largestFreeBlock - leaked, 0.0));
+}
+
+// Run a boot of a chair, from the setup of the sketch until the end of the run or a restart
+static void bootChair(const loadConfig* config, int chairIndex, const char* chairPath,
+                      std::chrono::steady_clock::time_point runEnd,
+                      std::chrono::steady_clock::time_point drainEnd, chairReport* report) {
+    hostSetEfuseMac(0x0000a0000000ULL + chairIndex);
+    hostSetLittleFSRoot((std::string(chairPath) + "/littlefs").c_str());
+
+    auto bootTime = std::chrono::steady_clock::now();
+
+    // The boot log is sent by the first call of sendData(), like on the device
+    asyncLog.setup();
+    connectivity.setup();
+    database.setPipelineDepth(config->depth);
+    if (config->batchSize > 0) {
+        database.setFixedBatchSize(config->batchSize);
+    }
+    database.setup();
+
+    // The counters of the telemetry start from zero on each boot
+    uint32_t pushesBefore = report->pushes;
+    uint32_t pushFailuresBefore = report->pushFailures;
+    auto updateCounters = [&] {
+        report->pushes = pushesBefore + telemetry.getPushCount();
+        report->pushFailures = pushFailuresBefore + telemetry.getPushFailureCount();
+    };
+
+    std::atomic<bool> producing{std::chrono::steady_clock::now() < runEnd};
+    std::thread producer(produceSamples, config, chairIndex, &producing, report);
+
+    // Run the loop of the encode stage, without its notifications
+    while (std::chrono::steady_clock::now() < runEnd) {
+        leakHeap(config, bootTime);
+        if (!dataBuffer.isBufferEmpty()) {
+            database.sendData(&dataBuffer);
+            updateCounters();
+        }
+        vTaskDelay(ENCODE_STAGE_INTERVAL_MILLIS);
+    }
+
+    producing.store(false);
+    producer.join();
+
+    // Keep sending until the buffer is empty and no batch was sent for a second while the
+    // connection works, as the spool is sent even without new samples
+    auto lastPush = std::chrono::steady_clock::now();
+    uint32_t pushes = telemetry.getPushCount();
+    while (std::chrono::steady_clock::now() < drainEnd) {
+        leakHeap(config, bootTime);
+        database.sendData(&dataBuffer);
+        updateCounters();
+        vTaskDelay(ENCODE_STAGE_INTERVAL_MILLIS);
+
+        if (telemetry.getPushCount() != pushes) {
+            pushes = telemetry.getPushCount();
+            lastPush = std::chrono::steady_clock::now();
+            report->drainSeconds = std::chrono::duration<double>(lastPush - runEnd).count();
+        } else if (dataBuffer.isBufferEmpty()
+                       && connectivity.getState() == ConnectivityState::Connected
+                       && std::chrono::steady_clock::now() - lastPush > std::chrono::seconds(1)) {
+            report->drained = true;
+            break;
+        }
+    }
+
+    report->backlog = dataBuffer.getBufferSize();
+
+    // The log task is still running, so the process ends without the destructors
+    delay(50);
+    fflush(stdout);
+    _exit(0);
+}
+
+// Run a chair: each boot is a process, started again when the previous one restarts the chair
+static void runChair(const loadConfig* config, int chairIndex, int startPipe,
+                     chairReport* report) {
+    char chairPath[256];
+    snprintf(chairPath, sizeof(chairPath), "%s/chair-%04d", config->dataPath.c_str(),
+             chairIndex);
+    std::filesystem::create_directories(chairPath);
+
+    // The chair writes its log to a file, the output of the load generator is the report
+    std::string logPath = std::string(chairPath) + "/log.txt";
+    if (freopen(logPath.c_str(), "w", stdout) == nullptr) {
+        _exit(1);
+    }
+
+    uint16_t port;
+    if (read(startPipe, &port, sizeof(port)) != sizeof(port)) {
+        _exit(1);
+    }
+
+    // Each chair has its own database instance
+    char address[32];
+    snprintf(address, sizeof(address), "127.0.0.1:%u", port);
+    setenv("FIREBASE_DATABASE_EMULATOR_HOST", address, 1);
+    setenv("FIREBASE_DATABASE_NAMESPACE", chairPath + config->dataPath.size() + 1, 1);
+
+    auto runEnd = std::chrono::steady_clock::now() + std::chrono::seconds(config->seconds);
+    auto drainEnd = runEnd + std::chrono::seconds(config->drainSeconds);
+
+    while (std::chrono::steady_clock::now() < drainEnd) {
+        fflush(stdout);
+        pid_t boot = fork();
+        if (boot == 0) {
+            bootChair(config, chairIndex, chairPath, runEnd, drainEnd, report);
+        }
+
+        int status = 0;
+        if (boot < 0 || waitpid(boot, &status, 0) < 0 || !WIFEXITED(status)
+                || WEXITSTATUS(status) != 2) {
+            break;
+        }
+        report->reboots++;
+    }
+
+    _exit(0);
+}
+
+static bool parseArguments(int argc, char** argv, loadConfig* config) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const char* value = argv[i + 1];
+
+        if (strcmp(argv[i], "--chairs") == 0) {
+            config->chairs = atoi(value);
+        } else if (strcmp(argv[i], "--seconds") == 0) {
+            config->seconds = atoi(value);
+        } else if (strcmp(argv[i], "--rate") == 0) {
+            config->rate = atof(value);
+        } else if (strcmp(argv[i], "--drain") == 0) {
+            config->drainSeconds = atoi(value);
+        } else if (strcmp(argv[i], "--data") == 0) {
+            config->dataPath = value;
+        } else if (strcmp(argv[i], "--depth") == 0) {
+            config->depth = atoi(value);
+        } else if (strcmp(argv[i], "--batch") == 0) {
+            config->batchSize = atoi(value);
+        } else if (strcmp(argv[i], "--heap-leak") == 0) {
+            config->heapLeak = atof(value);
+        } else if (strcmp(argv[i], "--latency") == 0) {
+            config->emulator.latencyMillis = atoi(value);
+        } else if (strcmp(argv[i], "--jitter") == 0) {
+            config->emulator.jitterMillis = atoi(value);
+        } else if (strcmp(argv[i], "--error-rate") == 0) {
+            config->emulator.errorRate = atof(value);
+        } else if (strcmp(argv[i], "--drop-rate") == 0) {
+            config->emulator.dropRate = atof(value);
+        } else if (strcmp(argv[i], "--outage") == 0) {
+            if (sscanf(value, "%lf:%lf", &config->emulator.outageStartSeconds,
+                       &config->emulator.outageSeconds) != 2) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+
+    return argc % 2 == 1 && config->chairs > 0 && config->seconds > 0 && config->rate > 0
+           && config->drainSeconds >= 0 && config->depth >= 1
+           && config->depth <= UPLOAD_PIPELINE_MAX_DEPTH && config->heapLeak >= 0
+           && (config->batchSize == 0
+               || (config->batchSize >= BATCH_SIZE_MIN && config->batchSize <= BATCH_SIZE_MAX));
+}
+
+int main(int argc, char** argv) {
+    loadConfig config;
+    if (!parseArguments(argc, argv, &config)) {
+        fprintf(stderr, "Usage: %s [--chairs COUNT] [--seconds DURATION] [--rate SAMPLES/S] "
+                        "[--drain DURATION] [--data DIRECTORY] [--latency MS] [--jitter MS] "
+                        "[--error-rate PROBABILITY] [--drop-rate PROBABILITY] "
+                        "[--outage START_S:DURATION_S] [--depth BATCHES] [--batch SAMPLES] "
+                        "[--heap-leak BYTES/S]\n", argv[0]);
+        return 1;
+    }
+
+    std::filesystem::remove_all(config.dataPath);
+    std::filesystem::create_directories(config.dataPath);
+    fflush(stdout);
+
+    void* sharedMemory = mmap(nullptr, config.chairs * sizeof(chairReport),
+                              PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (sharedMemory == MAP_FAILED) {
+        perror("Could not allocate the reports of the chairs");
+        return 1;
+    }
+    chairReport* reports = static_cast<chairReport*>(sharedMemory);
+
+    // The chairs are forked before the emulator starts its threads, so that they start from a
+    // process with a single thread
+    std::vector<simulatedChair> chairs;
+    for (int i = 0; i < config.chairs; i++) {
+        int startPipe[2];
+        if (pipe(startPipe) != 0) {
+            perror("Could not create the pipe of a chair");
+            return 1;
+        }
+
+        pid_t process = fork();
+        if (process < 0) {
+            perror("Could not start a chair");
+            return 1;
+        }
+        if (process == 0) {
+            for (const simulatedChair& chair : chairs) {
+                close(chair.startPipe);
+            }
+            close(startPipe[1]);
+            runChair(&config, i, startPipe[0], &reports[i]);
+        }
+
+        close(startPipe[0]);
+        chairs.push_back({process, startPipe[1]});
+    }
+
+    // The emulator picks a free port, sent to the chairs to start them
+    config.emulator.port = 0;
+    RtdbEmulator emulator(config.emulator);
+    if (!emulator.start()) {
+        perror("Could not start the emulator");
+        for (const simulatedChair& chair : chairs) {
+            kill(chair.process, SIGKILL);
+        }
+        return 1;
+    }
+
+    uint16_t port = emulator.getPort();
+    for (const simulatedChair& chair : chairs) {
+        if (write(chair.startPipe, &port, sizeof(port)) != sizeof(port)) {
+            perror("Could not start a chair");
+        }
+        close(chair.startPipe);
+    }
+
+    // Print the rates seen by the emulator every second, until every chair ended
+    printf("%6s %10s %12s %10s %8s %8s %8s\n", "time_s", "requests/s", "bytes/s", "keys/s",
+           "errors", "drops", "outage");
+    auto start = std::chrono::steady_clock::now();
+    emulatorStats previous = emulator.getStats();
+    size_t endedChairs = 0;
+    int elapsedSeconds = 0;
+
+    while (endedChairs < chairs.size()) {
+        std::this_thread::sleep_until(start + std::chrono::seconds(++elapsedSeconds));
+
+        emulatorStats stats = emulator.getStats();
+        printf("%6d %10llu %12llu %10llu %8llu %8llu %8llu\n", elapsedSeconds,
+               static_cast<unsigned long long>(stats.requests - previous.requests),
+               static_cast<unsigned long long>(stats.bytesReceived - previous.bytesReceived),
+               static_cast<unsigned long long>(stats.keysWritten - previous.keysWritten),
+               static_cast<unsigned long long>(stats.injectedErrors - previous.injectedErrors),
+               static_cast<unsigned long long>(stats.droppedResponses
+                                               - previous.droppedResponses),
+               static_cast<unsigned long long>(stats.outageClosures - previous.outageClosures));
+        fflush(stdout);
+        previous = stats;
+
+        endedChairs = 0;
+        for (simulatedChair& chair : chairs) {
+            if (chair.process != 0 && waitpid(chair.process, nullptr, WNOHANG) != 0) {
+                chair.process = 0;
+            }
+            endedChairs += chair.process == 0;
+        }
+    }
+
+    double elapsedTotalSeconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    emulator.stop();
+
+    // Count the samples stored on the database instance of each chair. The boot log and the
+    // telemetry are stored on their own nodes
+    chairReport total = {};
+    uint64_t storedSamples = 0;
+    int drainedChairs = 0;
+    double totalDrainSeconds = 0;
+    double maxDrainSeconds = 0;
+    for (size_t i = 0; i < chairs.size(); i++) {
+        char databaseNamespace[32];
+        snprintf(databaseNamespace, sizeof(databaseNamespace), "chair-%04zu", i);
+        storedSamples += emulator.countValues(databaseNamespace, "/")
+                         - emulator.countValues(databaseNamespace, "/bootLog")
+                         - emulator.countValues(databaseNamespace, "/telemetry");
+
+        total.producedSamples += reports[i].producedSamples;
+        total.overflowedSamples += reports[i].overflowedSamples;
+        total.pushes += reports[i].pushes;
+        total.pushFailures += reports[i].pushFailures;
+        total.reboots += reports[i].reboots;
+        total.backlog += reports[i].backlog;
+        drainedChairs += reports[i].drained;
+        totalDrainSeconds += reports[i].drainSeconds;
+        maxDrainSeconds = std::max(maxDrainSeconds, reports[i].drainSeconds);
+    }
+
+    emulatorStats stats = emulator.getStats();
+    printf("chairs=%d depth=%d batch=%s drained=%d elapsed=%.1fs drain=%.1fs (max %.1fs)\n",
+           config.chairs, config.depth,
+           config.batchSize > 0 ? std::to_string(config.batchSize).c_str() : "adaptive",
+           drainedChairs, elapsedTotalSeconds, totalDrainSeconds / config.chairs,
+           maxDrainSeconds);
+    printf("produced=%llu overflowed=%llu stored=%llu lost=%lld backlog=%d\n",
+           static_cast<unsigned long long>(total.producedSamples),
+           static_cast<unsigned long long>(total.overflowedSamples),
+           static_cast<unsigned long long>(storedSamples),
+           static_cast<long long>(total.producedSamples - storedSamples), total.backlog);
+    printf("pushes=%u failures=%u reboots=%u requests=%llu overwrites=%llu connections=%llu\n",
+           total.pushes, total.pushFailures, total.reboots,
+           static_cast<unsigned long long>(stats.requests),
+           static_cast<unsigned long long>(stats.overwrites),
+           static_cast<unsigned long long>(stats.connections));
+    printf("throughput=%.0f samples/s, %.1f requests/s, %.0f bytes/request, %.1f bytes/sample\n",
+           storedSamples / elapsedTotalSeconds, stats.requests / elapsedTotalSeconds,
+           static_cast<double>(stats.bytesReceived) / std::max<uint64_t>(stats.requests, 1),
+           static_cast<double>(stats.bytesReceived) / std::max<uint64_t>(storedSamples, 1));
+
+    return 0;
+}
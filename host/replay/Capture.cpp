@@ -0,0 +1,115 @@
+#include <cstring>
+
+#include "Capture.h"
+
+static void writeLittleEndian(uint8_t* data, uint64_t value, int size) {
+    for (int i = 0; i < size; i++) {
+        data[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+static uint64_t readLittleEndian(const uint8_t* data, int size) {
+    uint64_t value = 0;
+    for (int i = 0; i < size; i++) {
+        value |= static_cast<uint64_t>(data[i]) << (8 * i);
+    }
+
+    return value;
+}
+
+CaptureWriter::~CaptureWriter() {
+    close();
+}
+
+bool CaptureWriter::open(const std::string& path, uint32_t intervalMicros) {
+    file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+
+    uint8_t header[CAPTURE_HEADER_SIZE] = {0};
+    memcpy(header, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC));
+    writeLittleEndian(&header[4], CAPTURE_VERSION, 2);
+    writeLittleEndian(&header[6], SENSOR_CHANNEL_COUNT, 2);
+    writeLittleEndian(&header[8], intervalMicros, 4);
+    recordCount = 0;
+
+    return fwrite(header, 1, sizeof(header), file) == sizeof(header);
+}
+
+bool CaptureWriter::write(const captureRecord& record) {
+    uint8_t data[CAPTURE_RECORD_SIZE];
+    writeLittleEndian(data, record.timestampMillis, 8);
+    for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+        writeLittleEndian(&data[8 + 2 * i], record.values[i], 2);
+    }
+
+    if (file == nullptr || fwrite(data, 1, sizeof(data), file) != sizeof(data)) {
+        return false;
+    }
+
+    recordCount++;
+    return true;
+}
+
+bool CaptureWriter::close() {
+    if (file == nullptr) {
+        return true;
+    }
+
+    bool closed = fclose(file) == 0;
+    file = nullptr;
+
+    return closed;
+}
+
+CaptureReader::~CaptureReader() {
+    if (file != nullptr) {
+        fclose(file);
+    }
+}
+
+bool CaptureReader::open(const std::string& path) {
+    file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+
+    uint8_t header[CAPTURE_HEADER_SIZE];
+    if (fread(header, 1, sizeof(header), file) != sizeof(header)
+            || memcmp(header, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC)) != 0
+            || readLittleEndian(&header[4], 2) != CAPTURE_VERSION
+            || readLittleEndian(&header[6], 2) != SENSOR_CHANNEL_COUNT) {
+        fclose(file);
+        file = nullptr;
+        return false;
+    }
+    intervalMicros = readLittleEndian(&header[8], 4);
+
+    // A partially written record at the end of the capture is not counted
+    fseek(file, 0, SEEK_END);
+    recordCount = (ftell(file) - CAPTURE_HEADER_SIZE) / CAPTURE_RECORD_SIZE;
+    rewind();
+
+    return true;
+}
+
+bool CaptureReader::read(captureRecord* record) {
+    uint8_t data[CAPTURE_RECORD_SIZE];
+    if (file == nullptr || fread(data, 1, sizeof(data), file) != sizeof(data)) {
+        return false;
+    }
+
+    record->timestampMillis = readLittleEndian(data, 8);
+    for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+        record->values[i] = readLittleEndian(&data[8 + 2 * i], 2);
+    }
+
+    return true;
+}
+
+void CaptureReader::rewind() {
+    if (file != nullptr) {
+        fseek(file, CAPTURE_HEADER_SIZE, SEEK_SET);
+    }
+}
@@ -0,0 +1,103 @@
+/*
+    Capture.h
+
+    * This module defines the binary format of the captures of sensor streams, used to replay
+    the same input through the data path of the sketch (see Replay.cpp).
+    * A capture holds the readings of the pressure sensors, before the decimator: the values
+    of the ADCs at SAMPLE_RATE * OVERSAMPLING_RATIO, each one with its timestamp.
+    * Layout (little-endian):
+        header: magic "SCAP" (4 bytes), version (u16), channel count (u16), nominal interval
+        between the readings in microseconds (u32), reserved (u32)
+        records: timestamp in milliseconds since 01 January 1970 (u64), then one u16 per
+        channel, in the order of sensorData::pressureSensor
+*/
+
+#ifndef Capture_H_
+#define Capture_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "Buffer.h"
+
+const char CAPTURE_MAGIC[4] = {'S', 'C', 'A', 'P'};
+const uint16_t CAPTURE_VERSION = 1;
+const int CAPTURE_HEADER_SIZE = 16;
+const int CAPTURE_RECORD_SIZE = 8 + 2 * SENSOR_CHANNEL_COUNT;
+
+// Define a reading of the capture
+struct captureRecord {
+    uint64_t timestampMillis = 0;
+    uint16_t values[SENSOR_CHANNEL_COUNT] = {0};
+};
+
+/**
+ * Class that writes a capture, record by record
+ */
+class CaptureWriter {
+    FILE* file = nullptr;
+    uint64_t recordCount = 0;
+
+public:
+    ~CaptureWriter();
+
+    /**
+     * Create the capture and write its header
+     * @param path The path of the capture
+     * @param intervalMicros The nominal interval between the readings, in microseconds
+     * @return true if the capture was created, false otherwise
+     */
+    bool open(const std::string& path, uint32_t intervalMicros);
+
+    /**
+     * Append a reading to the capture
+     * @param record The reading
+     * @return true if the reading was written, false otherwise
+     */
+    bool write(const captureRecord& record);
+
+    /**
+     * Flush and close the capture
+     * @return true if every record reached the file, false otherwise
+     */
+    bool close();
+
+    uint64_t getRecordCount() const { return recordCount; }
+};
+
+/**
+ * Class that reads a capture, record by record
+ */
+class CaptureReader {
+    FILE* file = nullptr;
+    uint32_t intervalMicros = 0;
+    uint64_t recordCount = 0;
+
+public:
+    ~CaptureReader();
+
+    /**
+     * Open the capture and check its header
+     * @param path The path of the capture
+     * @return true if the capture is valid, false otherwise
+     */
+    bool open(const std::string& path);
+
+    /**
+     * Read the next reading of the capture
+     * @param record The reading
+     * @return true if a whole reading was read, false at the end of the capture
+     */
+    bool read(captureRecord* record);
+
+    /**
+     * Go back to the first reading
+     */
+    void rewind();
+
+    uint32_t getIntervalMicros() const { return intervalMicros; }
+    uint64_t getRecordCount() const { return recordCount; }
+};
+
+#endif  // Capture_H_
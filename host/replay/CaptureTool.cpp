@@ -0,0 +1,262 @@
+/*
+    CaptureTool.cpp
+
+    * Tool that creates and inspects the captures of sensor streams (see Capture.h):
+        record: records the "CAPTURE," lines printed by a device built with CAPTURE_STATUS
+        enabled, from a serial port (set up beforehand, e.g. "stty -F /dev/ttyUSB0 115200 raw")
+        or from a saved log. The other lines of the log are ignored
+        generate: generates a synthetic capture of a scenario: an empty chair, a person seated
+        still (occupied) or a person shifting their posture often (fidgeting)
+        info: prints the header and the statistics of a capture
+    * Usage: capture_tool record INPUT OUTPUT
+             capture_tool generate empty|occupied|fidgeting SECONDS OUTPUT [SEED]
+             capture_tool info CAPTURE
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+
+#include "Capture.h"
+#include "DataReader.h"
+
+// Set the interval between the readings of the sketch, in microseconds (us)
+const uint32_t READING_INTERVAL_MICROS = 1000000 / (SAMPLE_RATE * OVERSAMPLING_RATIO);
+
+// Set the full scale of the readings of the synthetic captures (12 bits)
+const int SYNTHETIC_FULL_SCALE = 4095;
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void onSignal(int) {
+    stopRequested = 1;
+}
+
+// Parse a "CAPTURE,<timestamp>,<values...>" line, anywhere in the line
+static bool parseCaptureLine(const char* line, captureRecord* record) {
+    const char* position = strstr(line, "CAPTURE,");
+    if (position == nullptr) {
+        return false;
+    }
+    position += strlen("CAPTURE,");
+
+    char* end;
+    record->timestampMillis = strtoull(position, &end, 10);
+    if (end == position) {
+        return false;
+    }
+
+    for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+        if (*end != ',') {
+            return false;
+        }
+        position = end + 1;
+        unsigned long value = strtoul(position, &end, 10);
+        if (end == position || value > UINT16_MAX) {
+            return false;
+        }
+        record->values[i] = value;
+    }
+
+    // A line cut by the serial port must not be taken as a shorter value
+    return *end == '\r' || *end == '\n' || *end == '\0';
+}
+
+static int record(const char* inputPath, const char* outputPath) {
+    FILE* input = strcmp(inputPath, "-") == 0 ? stdin : fopen(inputPath, "r");
+    if (input == nullptr) {
+        perror("Could not open the input");
+        return 1;
+    }
+
+    CaptureWriter writer;
+    if (!writer.open(outputPath, READING_INTERVAL_MICROS)) {
+        perror("Could not create the capture");
+        return 1;
+    }
+
+    // The recording of a serial port ends with Ctrl+C
+    signal(SIGINT, onSignal);
+
+    char line[512];
+    uint64_t ignoredLines = 0;
+    uint64_t lastTimestampMillis = 0;
+    while (!stopRequested && fgets(line, sizeof(line), input) != nullptr) {
+        captureRecord reading;
+        if (!parseCaptureLine(line, &reading)) {
+            ignoredLines += strstr(line, "CAPTURE,") != nullptr;
+            continue;
+        }
+
+        // The readings must be in order to be replayed
+        if (reading.timestampMillis < lastTimestampMillis) {
+            ignoredLines++;
+            continue;
+        }
+        lastTimestampMillis = reading.timestampMillis;
+
+        if (!writer.write(reading)) {
+            perror("Could not write the capture");
+            return 1;
+        }
+    }
+
+    if (input != stdin) {
+        fclose(input);
+    }
+    if (!writer.close()) {
+        perror("Could not write the capture");
+        return 1;
+    }
+
+    printf("readings=%llu malformed=%llu\n",
+           static_cast<unsigned long long>(writer.getRecordCount()),
+           static_cast<unsigned long long>(ignoredLines));
+
+    return 0;
+}
+
+// Define the state of the synthetic seat: the load on each sensor and the target of a shift
+struct syntheticSeat {
+    double load[SENSOR_CHANNEL_COUNT];
+    double target[SENSOR_CHANNEL_COUNT];
+};
+
+// Pick a posture: a load on each sensor, heavier on the back of the seat
+static void pickPosture(std::mt19937* random, double* load) {
+    std::uniform_real_distribution<double> weight(0.6, 1.0);
+    std::uniform_real_distribution<double> lean(-0.25, 0.25);
+    double sideLean = lean(*random);
+
+    for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+        double side = (i % 2 == 0 ? 1 : -1) * sideLean;
+        double depth = 0.5 + 0.5 * (i / 2) / (SENSOR_CHANNEL_COUNT / 2 - 1);
+        load[i] = std::min(1.0, std::max(0.0, weight(*random) * depth + side)) * 3000;
+    }
+}
+
+static int generate(const char* scenario, int seconds, const char* outputPath, unsigned seed) {
+    bool occupied = strcmp(scenario, "occupied") == 0;
+    bool fidgeting = strcmp(scenario, "fidgeting") == 0;
+    if (!occupied && !fidgeting && strcmp(scenario, "empty") != 0) {
+        fprintf(stderr, "Unknown scenario: %s\n", scenario);
+        return 1;
+    }
+
+    CaptureWriter writer;
+    if (!writer.open(outputPath, READING_INTERVAL_MICROS)) {
+        perror("Could not create the capture");
+        return 1;
+    }
+
+    std::mt19937 random(seed);
+    std::normal_distribution<double> noise(0, occupied || fidgeting ? 12 : 3);
+    std::uniform_real_distribution<double> shiftInterval(2, 8);
+
+    syntheticSeat seat;
+    if (occupied || fidgeting) {
+        pickPosture(&random, seat.load);
+    } else {
+        std::fill(seat.load, seat.load + SENSOR_CHANNEL_COUNT, 20);
+    }
+    std::copy(seat.load, seat.load + SENSOR_CHANNEL_COUNT, seat.target);
+
+    // The captures start at the current time, rounded to the second
+    uint64_t startMillis = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count() * 1000;
+    uint64_t readingCount = static_cast<uint64_t>(seconds) * 1000000 / READING_INTERVAL_MICROS;
+    double nextShiftSeconds = shiftInterval(random);
+
+    for (uint64_t n = 0; n < readingCount; n++) {
+        double timeSeconds = n * READING_INTERVAL_MICROS / 1e6;
+
+        // A fidgeting person moves to another posture every few seconds
+        if (fidgeting && timeSeconds >= nextShiftSeconds) {
+            pickPosture(&random, seat.target);
+            nextShiftSeconds = timeSeconds + shiftInterval(random);
+        }
+
+        captureRecord reading;
+        reading.timestampMillis = startMillis + n * READING_INTERVAL_MICROS / 1000;
+
+        // The breathing moves the load a little, about every 4 seconds
+        double breathing = occupied || fidgeting ? 1 + 0.02 * sin(2 * M_PI * timeSeconds / 4) : 1;
+        for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+            // The shifts take about half a second
+            seat.load[i] += (seat.target[i] - seat.load[i]) * 0.12;
+            double value = seat.load[i] * breathing + noise(random);
+            int clamped = std::max(0, static_cast<int>(value));
+            reading.values[i] = std::min(SYNTHETIC_FULL_SCALE, clamped);
+        }
+
+        if (!writer.write(reading)) {
+            perror("Could not write the capture");
+            return 1;
+        }
+    }
+
+    if (!writer.close()) {
+        perror("Could not write the capture");
+        return 1;
+    }
+
+    printf("readings=%llu\n", static_cast<unsigned long long>(writer.getRecordCount()));
+
+    return 0;
+}
+
+static int info(const char* path) {
+    CaptureReader reader;
+    if (!reader.open(path)) {
+        fprintf(stderr, "Not a valid capture: %s\n", path);
+        return 1;
+    }
+
+    captureRecord reading;
+    uint64_t firstMillis = 0;
+    uint64_t lastMillis = 0;
+    double sums[SENSOR_CHANNEL_COUNT] = {0};
+    uint64_t count = 0;
+    while (reader.read(&reading)) {
+        firstMillis = count == 0 ? reading.timestampMillis : firstMillis;
+        lastMillis = reading.timestampMillis;
+        for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+            sums[i] += reading.values[i];
+        }
+        count++;
+    }
+
+    printf("readings=%llu interval=%uus duration=%.1fs start=%llu\n",
+           static_cast<unsigned long long>(count), reader.getIntervalMicros(),
+           (lastMillis - firstMillis) / 1000.0, static_cast<unsigned long long>(firstMillis));
+    printf("mean values:");
+    for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+        printf(" %.0f", count > 0 ? sums[i] / count : 0.0);
+    }
+    printf("\n");
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc == 4 && strcmp(argv[1], "record") == 0) {
+        return record(argv[2], argv[3]);
+    }
+    if ((argc == 5 || argc == 6) && strcmp(argv[1], "generate") == 0 && atoi(argv[3]) > 0) {
+        return generate(argv[2], atoi(argv[3]), argv[4], argc == 6 ? atoi(argv[5]) : 1);
+    }
+    if (argc == 3 && strcmp(argv[1], "info") == 0) {
+        return info(argv[2]);
+    }
+
+    fprintf(stderr, "Usage: %s record INPUT OUTPUT\n"
+                    "       %s generate empty|occupied|fidgeting SECONDS OUTPUT [SEED]\n"
+                    "       %s info CAPTURE\n", argv[0], argv[0], argv[0]);
+    return 1;
+}
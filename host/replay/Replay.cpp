@@ -0,0 +1,440 @@
+/*
+    Replay.cpp
+
+    * Replay driver: it feeds a capture (see Capture.h) through the data path of the sketch,
+    DataReader -> SensorDataBuffer -> Database, built for the host with mocked ADCs and an RTDB
+    emulator (see host/emulator), so that the changes of the pipeline can be compared on
+    identical inputs.
+    * The ADCs return the last reading of the capture whose timestamp is not after the clock
+    of the sketch, which starts at the first timestamp of the capture.
+    * In the real-time mode, the stages of the data path run on their own tasks, as on the
+    device (see Stages.h), and their busy shares and queue occupancies are reported. In the fast
+    mode, the acquisition and the encode stage take turns on a single thread whose waits are
+    skipped (see hostSetFastForward()), so the replay runs as fast as the work allows; the
+    uploads still run on the tasks of their slots.
+    * The access point can be scripted to go down periodically (--wifi-flap UP:DOWN, in seconds
+    of the clock of the sketch), to check that the sampling goes on during the outages and that
+    the samples are all stored once the connection is back.
+    * It reports the samples/s from end to end, the durations of each stage (from the telemetry
+    of the sketch), the bytes uploaded, the outages and the traffic of the I2C bus per sample
+    (see Wire.h).
+    * It also counts the heap allocations of the sketch once the first batches were sent (see
+    AllocationCounter.h), which must stay at zero in the steady state. With
+    --check-allocations, the replay fails if any is counted.
+    * The log of the sketch is written to <data>/replay.log and its spool to <data>/littlefs.
+    * Usage: replay CAPTURE [--mode fast|realtime] [--data DIRECTORY] [--latency MS]
+    [--jitter MS] [--error-rate PROBABILITY] [--wifi-flap UP:DOWN] [--check-allocations]
+*/
+
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <LittleFS.h>
+#include <WiFi.h>
+#include <Wire.h>
+
+#include "AllocationCounter.h"
+#include "AsyncLog.h"
+#include "Buffer.h"
+#include "Capture.h"
+#include "Connectivity.h"
+#include "DataReader.h"
+#include "Database.h"
+#include "Errors.h"
+#include "RtdbEmulator.h"
+#include "SimulatedClock.h"
+#include "Stages.h"
+#include "Telemetry.h"
+
+// Set the time without any batch sent after which the data path is considered drained, in
+// milliseconds of the clock of the sketch (ms)
+const unsigned long REPLAY_DRAIN_IDLE_MILLIS = 3000;
+
+// Set the amount of batches sent before the allocations are counted, as the warm-up of the
+// connections and of the buffers of the sketch
+const uint32_t REPLAY_WARMUP_PUSHES = 10;
+
+// Define the globals of the sketch
+Errors errorHandler;
+AsyncLog asyncLog;
+Telemetry telemetry;
+Connectivity connectivity;
+StageMonitor stageMonitor;
+
+static SensorDataBuffer dataBuffer;
+static DataReader dataReader;
+static Database database;
+static StagePipeline stagePipeline;
+
+struct replayConfig {
+    std::string capturePath;
+    bool fast = true;
+    std::string dataPath = "replay_data";
+    emulatorConfig emulator;
+    // Durations of the periods with and without the access point, in seconds (s)
+    double wifiUpSeconds = 0;
+    double wifiDownSeconds = 0;
+    bool checkAllocations = false;
+};
+
+// Define the capture being replayed and the reading returned by the ADCs
+struct replayState {
+    std::vector<captureRecord> readings;
+    size_t index = 0;
+};
+
+static replayState state;
+
+// Store whether the allocations are counted, and the amount of batches sent when it started
+static bool countingAllocations = false;
+static uint32_t countingStartPushes = 0;
+
+// Move to the last reading that is not after the clock of the sketch
+static const captureRecord& getCurrentReading() {
+    unsigned long long nowMillis = clockEpochMillis();
+    while (state.index + 1 < state.readings.size()
+               && state.readings[state.index + 1].timestampMillis <= nowMillis) {
+        state.index++;
+    }
+
+    return state.readings[state.index];
+}
+
+// Read the internal ADC. The pins A2 to A5 are the first channels of the samples
+static uint16_t readInternalAdc(uint8_t pin, void*) {
+    return getCurrentReading().values[pin - A2];
+}
+
+// Read an input of an external ADC. DataReader converts the inputs from 3 to 0 and stores
+// each pair of results (0x48, 0x49) after the channels of the internal ADC
+static int16_t readExternalAdc(uint8_t address, uint8_t input, void*) {
+    int channelIndex = 3 - input;
+    int adc = address == I2C_ADDRESS_1 ? 0 : 1;
+    int value = getCurrentReading().values[4 + 2 * channelIndex + adc];
+
+    // Give the raw result that the sketch scales back to the value (see ExternalADCs.cpp)
+    value = std::min(EXTERNAL_ADC_RESULT_RANGE, std::max(-EXTERNAL_ADC_RESULT_RANGE, value));
+    long scaled = value + EXTERNAL_ADC_RESULT_RANGE;
+    return (scaled * 65535 + 2 * EXTERNAL_ADC_RESULT_RANGE - 1) / (2 * EXTERNAL_ADC_RESULT_RANGE)
+           - 32768;
+}
+
+// Count the samples published by DataReader since the last call, from the write index
+static uint32_t countPublishedSamples() {
+    static uint32_t lastWriteIndex = 0;
+
+    uint32_t writeIndex = dataBuffer.writeIndex.load();
+    uint32_t published = writeIndex - lastWriteIndex;
+    lastWriteIndex = writeIndex;
+
+    return published;
+}
+
+// Start counting the allocations of the sketch once the warm-up batches were sent
+static void updateAllocationCounting() {
+    if (!countingAllocations && telemetry.getPushCount() >= REPLAY_WARMUP_PUSHES) {
+        countingAllocations = true;
+        countingStartPushes = telemetry.getPushCount();
+        hostSetAllocationCounting(true);
+    }
+}
+
+// Bring the access point up or down, following the script of the configuration
+static void applyWiFiScript(const replayConfig& config, unsigned long elapsedMillis) {
+    static bool available = true;
+    if (config.wifiDownSeconds <= 0) {
+        return;
+    }
+
+    double periodSeconds = config.wifiUpSeconds + config.wifiDownSeconds;
+    bool up = fmod(elapsedMillis / 1000.0, periodSeconds) < config.wifiUpSeconds;
+    if (up != available) {
+        available = up;
+        hostSetWiFiAvailable(up);
+    }
+}
+
+// Send the samples left in the buffer and in the spool, until no batch is sent for a while
+// with a working connection. Without the encode task, its loop is run here
+static void drainDatabase(bool runEncodeStage) {
+    unsigned long lastPushMillis = clockMillis();
+    uint32_t pushes = telemetry.getPushCount();
+
+    hostSetWiFiAvailable(true);
+    while (!dataBuffer.isBufferEmpty()
+               || connectivity.getState() != ConnectivityState::Connected
+               || clockMillis() - lastPushMillis < REPLAY_DRAIN_IDLE_MILLIS) {
+        if (runEncodeStage) {
+            database.sendData(&dataBuffer);
+        }
+        vTaskDelay(ENCODE_STAGE_INTERVAL_MILLIS);
+
+        if (telemetry.getPushCount() != pushes) {
+            pushes = telemetry.getPushCount();
+            lastPushMillis = clockMillis();
+        }
+    }
+}
+
+// Count the durations recorded for a stage
+static uint64_t countRecords(TelemetryStage stage) {
+    const latencyHistogram& histogram = telemetry.getHistogram(stage);
+
+    uint64_t count = 0;
+    for (int i = 0; i < TELEMETRY_HISTOGRAM_BUCKETS; i++) {
+        count += histogram.buckets[i];
+    }
+
+    return count;
+}
+
+static void printStage(const char* label, TelemetryStage stage) {
+    const latencyHistogram& histogram = telemetry.getHistogram(stage);
+
+    // The durations are only known up to their bucket, [2^(i-1), 2^i) us
+    uint64_t count = 0;
+    double totalMicros = 0;
+    for (int i = 0; i < TELEMETRY_HISTOGRAM_BUCKETS; i++) {
+        count += histogram.buckets[i];
+        totalMicros += histogram.buckets[i] * (i == 0 ? 0.5 : 0.75 * (1u << i));
+    }
+
+    uint64_t seen = 0;
+    int p99Bucket = 0;
+    while (p99Bucket < TELEMETRY_HISTOGRAM_BUCKETS - 1
+               && (seen += histogram.buckets[p99Bucket]) < count * 0.99) {
+        p99Bucket++;
+    }
+
+    printf("  %-14s count=%-8llu mean~%.0fus p99<%luus max=%luus\n", label,
+           static_cast<unsigned long long>(count), count > 0 ? totalMicros / count : 0.0,
+           1ul << p99Bucket, static_cast<unsigned long>(histogram.maxMicros));
+}
+
+static bool parseArguments(int argc, char** argv, replayConfig* config) {
+    if (argc < 2) {
+        return false;
+    }
+    config->capturePath = argv[1];
+
+    for (int i = 2; i < argc; i++) {
+        const char* option = argv[i];
+        if (strcmp(option, "--check-allocations") == 0) {
+            config->checkAllocations = true;
+            continue;
+        }
+
+        if (i + 1 >= argc) {
+            return false;
+        }
+        const char* value = argv[++i];
+
+        if (strcmp(option, "--mode") == 0 && strcmp(value, "fast") == 0) {
+            config->fast = true;
+        } else if (strcmp(option, "--mode") == 0 && strcmp(value, "realtime") == 0) {
+            config->fast = false;
+        } else if (strcmp(option, "--data") == 0) {
+            config->dataPath = value;
+        } else if (strcmp(option, "--latency") == 0) {
+            config->emulator.latencyMillis = atoi(value);
+        } else if (strcmp(option, "--jitter") == 0) {
+            config->emulator.jitterMillis = atoi(value);
+        } else if (strcmp(option, "--error-rate") == 0) {
+            config->emulator.errorRate = atof(value);
+        } else if (strcmp(option, "--wifi-flap") == 0) {
+            if (sscanf(value, "%lf:%lf", &config->wifiUpSeconds, &config->wifiDownSeconds) != 2) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char** argv) {
+    replayConfig config;
+    if (!parseArguments(argc, argv, &config)) {
+        fprintf(stderr, "Usage: %s CAPTURE [--mode fast|realtime] [--data DIRECTORY] "
+                        "[--latency MS] [--jitter MS] [--error-rate PROBABILITY] "
+                        "[--wifi-flap UP:DOWN] [--check-allocations]\n", argv[0]);
+        return 1;
+    }
+
+    CaptureReader reader;
+    captureRecord reading;
+    if (!reader.open(config.capturePath)) {
+        fprintf(stderr, "Not a valid capture: %s\n", config.capturePath.c_str());
+        return 1;
+    }
+    while (reader.read(&reading)) {
+        state.readings.push_back(reading);
+    }
+    if (state.readings.empty()) {
+        fprintf(stderr, "The capture is empty\n");
+        return 1;
+    }
+
+    // Each replay starts from an empty spool, so that the runs are comparable
+    std::filesystem::remove_all(config.dataPath);
+    std::filesystem::create_directories(config.dataPath);
+    hostSetLittleFSRoot((config.dataPath + "/littlefs").c_str());
+    FILE* log = fopen((config.dataPath + "/replay.log").c_str(), "w");
+    if (log == nullptr) {
+        perror("Could not create the log");
+        return 1;
+    }
+    hostSetSerialOutput(log);
+
+    config.emulator.port = 0;
+    RtdbEmulator emulator(config.emulator);
+    if (!emulator.start()) {
+        perror("Could not start the emulator");
+        return 1;
+    }
+    char address[32];
+    snprintf(address, sizeof(address), "127.0.0.1:%u", emulator.getPort());
+    setenv("FIREBASE_DATABASE_EMULATOR_HOST", address, 1);
+    setenv("FIREBASE_DATABASE_NAMESPACE", "replay", 1);
+
+    // The tasks of the sketch inherit the tracking of the allocations from this thread
+    hostTrackAllocations(true);
+
+    // The log task is started before the fast-forward, so that it sleeps in real time
+    asyncLog.setup();
+    hostSetFastForward(config.fast);
+    setSimulatedEpochMillis(state.readings.front().timestampMillis);
+    hostSetAnalogReader(readInternalAdc, nullptr);
+    hostSetExternalAdcReader(readExternalAdc, nullptr);
+
+    connectivity.setup();
+    database.setup();
+
+    // The replay ends one interval after the last reading
+    unsigned long long endMillis = state.readings.back().timestampMillis
+                                   + reader.getIntervalMicros() / 1000;
+    uint64_t publishedSamples = 0;
+    unsigned long startMillis = clockMillis();
+    auto start = std::chrono::steady_clock::now();
+
+    if (config.fast) {
+        if (!dataReader.setup()) {
+            fprintf(stderr, "Could not set up the DataReader\n");
+            return 1;
+        }
+
+        while (clockEpochMillis() < endMillis) {
+            applyWiFiScript(config, clockMillis() - startMillis);
+            dataReader.fillBuffer(&dataBuffer);
+
+            uint32_t published = countPublishedSamples();
+            publishedSamples += published;
+            if (published > 0) {
+                database.sendData(&dataBuffer);
+            }
+            updateAllocationCounting();
+        }
+    } else {
+        if (!stagePipeline.setup(&dataReader, &dataBuffer, &database)) {
+            fprintf(stderr, "Could not start the stages\n");
+            return 1;
+        }
+
+        while (clockEpochMillis() < endMillis) {
+            applyWiFiScript(config, clockMillis() - startMillis);
+            publishedSamples += countPublishedSamples();
+            updateAllocationCounting();
+            delay(10);
+        }
+
+        // Let the readings already taken go through the filter
+        stagePipeline.stopAcquisition();
+        while (stagePipeline.getReadingQueueSize() > 0) {
+            delay(10);
+        }
+        delay(10);
+        publishedSamples += countPublishedSamples();
+    }
+
+    // The drain isn't the steady state, its allocations aren't counted
+    hostSetAllocationCounting(false);
+    uint64_t allocations = hostGetAllocationCount();
+    uint32_t countedPushes = countingAllocations
+                                 ? telemetry.getPushCount() - countingStartPushes : 0;
+
+    drainDatabase(config.fast);
+    double elapsedSeconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    emulator.stop();
+
+    // The boot log and the telemetry have their own nodes
+    uint64_t storedSamples = emulator.countValues("replay", "/")
+                             - emulator.countValues("replay", "/bootLog")
+                             - emulator.countValues("replay", "/telemetry");
+    emulatorStats stats = emulator.getStats();
+    hostI2cStats i2cStats = hostGetI2cStats();
+    double acquiredSamples = std::max<uint64_t>(countRecords(TelemetryStage::Acquisition), 1);
+    double captureSeconds = (endMillis - state.readings.front().timestampMillis) / 1000.0;
+
+    printf("mode=%s readings=%zu capture=%.1fs elapsed=%.3fs speedup=%.0fx\n",
+           config.fast ? "fast" : "realtime", state.readings.size(), captureSeconds,
+           elapsedSeconds, captureSeconds / elapsedSeconds);
+    printf("samples: published=%llu stored=%llu backlog=%d end-to-end=%.0f samples/s\n",
+           static_cast<unsigned long long>(publishedSamples),
+           static_cast<unsigned long long>(storedSamples), dataBuffer.getBufferSize(),
+           publishedSamples / elapsedSeconds);
+    printf("uploads: pushes=%u failures=%u requests=%llu bytes=%llu bytes/sample=%.1f\n",
+           telemetry.getPushCount(), telemetry.getPushFailureCount(),
+           static_cast<unsigned long long>(stats.requests),
+           static_cast<unsigned long long>(stats.bytesReceived),
+           static_cast<double>(stats.bytesReceived) / std::max<uint64_t>(publishedSamples, 1));
+    printf("connectivity: outages=%u outage=%.1fs offline-samples=%u reconnect-attempts=%u\n",
+           connectivity.getOutageCount(), connectivity.getOutageMillis() / 1000.0,
+           connectivity.getOfflineSampleCount(), connectivity.getReconnectAttempts());
+    printf("stages (clock of the sketch):\n");
+    printStage("acquisition", TelemetryStage::Acquisition);
+    printStage("adcWait", TelemetryStage::AdcWait);
+    printStage("serialization", TelemetryStage::Serialization);
+    printStage("upload", TelemetryStage::Upload);
+    printStage("i2cBus", TelemetryStage::I2cBus);
+    if (!config.fast) {
+        printf("pipeline stages (busy share of the replay, largest queue):\n");
+        for (int i = 0; i < static_cast<int>(PipelineStage::Count); i++) {
+            PipelineStage stage = static_cast<PipelineStage>(i);
+            printf("  %-14s busy=%.1f%% queue-max=%d/%d\n", STAGE_CONFIGS[i].name,
+                   stageMonitor.getBusyMicros(stage) / (elapsedSeconds * 1e4),
+                   stageMonitor.getQueueHighWaterMark(stage),
+                   stageMonitor.getQueueCapacity(stage));
+        }
+    }
+    printf("i2c: clock=%dkHz transactions=%llu bytes=%llu per-sample: transactions=%.1f "
+           "bytes=%.1f bus=%.0fus\n", I2C_CLOCK_HZ / 1000,
+           static_cast<unsigned long long>(i2cStats.transactions),
+           static_cast<unsigned long long>(i2cStats.bytes),
+           static_cast<double>(i2cStats.transactions) / acquiredSamples,
+           static_cast<double>(i2cStats.bytes) / acquiredSamples,
+           i2cStats.busMicros / acquiredSamples);
+    printf("allocations: steady-state=%llu batches=%u (after the first %u)\n",
+           static_cast<unsigned long long>(allocations), countedPushes, REPLAY_WARMUP_PUSHES);
+    fflush(stdout);
+
+    // A steady state without any batch can't be checked
+    bool allocationsFailed = config.checkAllocations && (allocations > 0 || countedPushes == 0);
+    if (allocationsFailed) {
+        fprintf(stderr, "The steady state of the sketch allocates, or wasn't reached\n");
+    }
+
+    // The log task is still running, so the process ends without the destructors
+    Serial.flush();
+    _exit(allocationsFailed ? 1 : 0);
+}
@@ -0,0 +1,25 @@
+#include <Arduino.h>
+
+#include "SimulatedClock.h"
+
+// Save the time since the boot when the wall-clock time was set, in microseconds (us)
+static unsigned long epochBaseMicros = 0;
+// Save the wall-clock time that was set, in milliseconds (ms)
+static unsigned long long epochBaseMillis = 0;
+
+void setSimulatedEpochMillis(unsigned long long epochMillis) {
+    epochBaseMicros = micros();
+    epochBaseMillis = epochMillis;
+}
+
+unsigned long clockMicros() {
+    return micros();
+}
+
+unsigned long clockMillis() {
+    return millis();
+}
+
+unsigned long long clockEpochMillis() {
+    return epochBaseMillis + (micros() - epochBaseMicros) / 1000;
+}
@@ -0,0 +1,20 @@
+/*
+    SimulatedClock.h
+
+    * This module replaces Clock.cpp of the sketch in the replay builds: the time since the boot
+    is the clock of the host shims (fast-forwarded or not, see Arduino.h) and the wall-clock
+    time starts at a chosen timestamp, usually the first one of the capture being replayed.
+*/
+
+#ifndef SimulatedClock_H_
+#define SimulatedClock_H_
+
+#include "Clock.h"
+
+/**
+ * Set the wall-clock time of the sketch from now on
+ * @param epochMillis The current timestamp, in milliseconds since 01 January 1970
+ */
+void setSimulatedEpochMillis(unsigned long long epochMillis);
+
+#endif  // SimulatedClock_H_
@@ -0,0 +1,71 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "AllocationCounter.h"
+
+static std::atomic<bool> countingEnabled{false};
+static std::atomic<uint64_t> allocationCount{0};
+
+static thread_local bool trackedThread = false;
+static thread_local int libraryDepth = 0;
+
+void hostSetAllocationCounting(bool enabled) {
+    countingEnabled.store(enabled);
+}
+
+uint64_t hostGetAllocationCount() {
+    return allocationCount.load();
+}
+
+void hostTrackAllocations(bool tracked) {
+    trackedThread = tracked;
+}
+
+bool hostIsTrackingAllocations() {
+    return trackedThread;
+}
+
+HostLibraryScope::HostLibraryScope() {
+    libraryDepth++;
+}
+
+HostLibraryScope::~HostLibraryScope() {
+    libraryDepth--;
+}
+
+static void* allocate(std::size_t size) {
+    if (trackedThread && libraryDepth == 0 && countingEnabled.load(std::memory_order_relaxed)) {
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void* memory = std::malloc(size > 0 ? size : 1);
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void* operator new(std::size_t size) {
+    return allocate(size);
+}
+
+void* operator new[](std::size_t size) {
+    return allocate(size);
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
@@ -0,0 +1,40 @@
+/*
+    AllocationCounter.h (host)
+
+    * This module replaces the global operators new and delete of the host builds, to count the
+    heap allocations made by the sketch, so that its steady state can be checked to be free of
+    them (see the replay).
+    * Only the threads of the sketch are counted: the tasks created by xTaskCreatePinnedToCore()
+    inherit it from their creator, and a host tool marks its own thread that runs the sketch.
+    The threads of the emulator and of the timers aren't counted.
+    * The shims stand for the ESP32 libraries, whose allocations the sketch doesn't control,
+    so their calls run in a HostLibraryScope that isn't counted either.
+*/
+
+#ifndef AllocationCounter_H_
+#define AllocationCounter_H_
+
+#include <cstdint>
+
+// Start or stop counting the allocations of the threads of the sketch, for the whole process
+void hostSetAllocationCounting(bool enabled);
+
+// Get the amount of allocations counted, over all the threads of the sketch
+uint64_t hostGetAllocationCount();
+
+// Mark the calling thread as a thread of the sketch, or not
+void hostTrackAllocations(bool tracked);
+
+// Check whether the calling thread is a thread of the sketch
+bool hostIsTrackingAllocations();
+
+/**
+ * Scope of a call to a library shim, whose allocations aren't counted
+ */
+class HostLibraryScope {
+public:
+    HostLibraryScope();
+    ~HostLibraryScope();
+};
+
+#endif  // AllocationCounter_H_
@@ -0,0 +1,328 @@
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "AllocationCounter.h"
+#include "Arduino.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+
+HardwareSerial Serial;
+EspClass ESP;
+
+// Define a FreeRTOS task: a thread with its notification counter
+struct hostTask {
+    std::mutex mutex;
+    std::condition_variable notified;
+    uint32_t notifications = 0;
+};
+
+static const std::chrono::steady_clock::time_point bootTime = std::chrono::steady_clock::now();
+
+static thread_local hostTask currentTask;
+static thread_local uint64_t efuseMac = 0x000000c0ffeeULL;
+static thread_local uint16_t (*analogReader)(uint8_t, void*) = nullptr;
+static thread_local void* analogReaderContext = nullptr;
+
+static std::atomic<uint32_t> freeHeap{160000};
+static std::atomic<uint32_t> minFreeHeap{160000};
+static std::atomic<uint32_t> largestFreeBlock{110000};
+
+static std::mutex serialMutex;
+static FILE* serialOutput = stdout;
+
+// Store the time skipped by the waits of the simulation thread, in microseconds (us)
+static std::atomic<int64_t> skippedMicros{0};
+static std::atomic<bool> fastForward{false};
+static std::thread::id simulationThread;
+
+unsigned long micros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - bootTime).count() + skippedMicros.load();
+}
+
+unsigned long millis() {
+    return micros() / 1000;
+}
+
+// Move the clock forward to targetMicros, running the timers due on the way
+static void advanceClock(int64_t targetMicros) {
+    while (true) {
+        int64_t nextTimerMicros = hostGetNextTimerMicros();
+        int64_t stopMicros = std::min(targetMicros, nextTimerMicros);
+
+        int64_t nowMicros = micros();
+        if (stopMicros > nowMicros) {
+            skippedMicros += stopMicros - nowMicros;
+        }
+
+        if (nextTimerMicros > targetMicros) {
+            return;
+        }
+        hostRunDueTimers(micros());
+    }
+}
+
+// Wait for a duration, either sleeping or moving the clock forward
+static void wait(int64_t durationMicros) {
+    if (hostIsFastForwarding()) {
+        advanceClock(micros() + durationMicros);
+    } else {
+        std::this_thread::sleep_for(std::chrono::microseconds(durationMicros));
+    }
+}
+
+void delay(unsigned long ms) {
+    wait(ms * 1000LL);
+}
+
+void delayMicroseconds(unsigned int us) {
+    wait(us);
+}
+
+void yield() {
+    std::this_thread::yield();
+}
+
+void pinMode(uint8_t, uint8_t) {}
+
+uint16_t analogRead(uint8_t pin) {
+    return analogReader != nullptr ? analogReader(pin, analogReaderContext) : 0;
+}
+
+bool getLocalTime(struct tm* info, uint32_t) {
+    time_t now = time(nullptr);
+    return localtime_r(&now, info) != nullptr;
+}
+
+void configTime(long gmtOffset_sec, int daylightOffset_sec, const char*, const char*,
+                const char*) {
+    // The host clock is already synchronized, only the time zone is applied. POSIX offsets
+    // have the opposite sign ("UTC3" is 3 hours behind UTC)
+    long offset = -(gmtOffset_sec + daylightOffset_sec);
+    char timeZone[32];
+    snprintf(timeZone, sizeof(timeZone), "UTC%+ld:%02ld", offset / 3600, labs(offset) / 60 % 60);
+    setenv("TZ", timeZone, 1);
+    tzset();
+}
+
+size_t Print::print(long long value, int base) {
+    if (value < 0) {
+        return print('-') + print(static_cast<unsigned long long>(-value), base);
+    }
+    return print(static_cast<unsigned long long>(value), base);
+}
+
+size_t Print::print(unsigned long long value, int base) {
+    char digits[66];
+    char* position = &digits[sizeof(digits) - 1];
+    *position = '\0';
+
+    do {
+        int digit = value % base;
+        *--position = digit < 10 ? '0' + digit : 'A' + digit - 10;
+        value /= base;
+    } while (value != 0);
+
+    return print(position);
+}
+
+size_t Print::print(double value, int digits) {
+    char text[64];
+    snprintf(text, sizeof(text), "%.*f", digits, value);
+    return print(text);
+}
+
+size_t Print::print(const IPAddress& value) {
+    uint32_t address = value;
+    char text[16];
+    snprintf(text, sizeof(text), "%u.%u.%u.%u", address & 0xFF, (address >> 8) & 0xFF,
+             (address >> 16) & 0xFF, address >> 24);
+    return print(text);
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+    std::lock_guard<std::mutex> lock(serialMutex);
+    return fwrite(buffer, 1, size, serialOutput);
+}
+
+void HardwareSerial::flush() {
+    std::lock_guard<std::mutex> lock(serialMutex);
+    fflush(serialOutput);
+}
+
+void EspClass::restart() {
+    // There is nothing to restart on the host, the process ends as the device would reboot.
+    // The other tasks are still running, so the destructors of the globals aren't run
+    Serial.println("ESP.restart() called, exiting");
+    Serial.flush();
+    _exit(2);
+}
+
+uint32_t EspClass::getFreeHeap() {
+    return freeHeap.load();
+}
+
+uint32_t EspClass::getMinFreeHeap() {
+    return minFreeHeap.load();
+}
+
+uint32_t EspClass::getMaxAllocHeap() {
+    return largestFreeBlock.load();
+}
+
+size_t heap_caps_get_largest_free_block(unsigned int) {
+    return largestFreeBlock.load();
+}
+
+uint64_t EspClass::getEfuseMac() {
+    return efuseMac;
+}
+
+void vTaskDelay(TickType_t ticks) {
+    wait(ticks * 1000LL);
+}
+
+void taskYIELD() {
+    std::this_thread::yield();
+}
+
+TickType_t xTaskGetTickCount() {
+    return millis();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    return &currentTask;
+}
+
+BaseType_t xTaskCreatePinnedToCore(void (*function)(void*), const char*, uint32_t,
+                                   void* parameter, UBaseType_t, TaskHandle_t* handle,
+                                   BaseType_t) {
+    // The new thread inherits the identity of its creator, like the tasks of a device
+    uint64_t mac = efuseMac;
+    uint16_t (*reader)(uint8_t, void*) = analogReader;
+    void* readerContext = analogReaderContext;
+    bool tracked = hostIsTrackingAllocations();
+
+    std::mutex mutex;
+    std::condition_variable started;
+    TaskHandle_t task = nullptr;
+
+    std::thread([&, function, parameter, mac, reader, readerContext, tracked] {
+        efuseMac = mac;
+        analogReader = reader;
+        analogReaderContext = readerContext;
+        hostTrackAllocations(tracked);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            task = &currentTask;
+            started.notify_one();
+        }
+        function(parameter);
+    }).detach();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    started.wait(lock, [&task] { return task != nullptr; });
+    if (handle != nullptr) {
+        *handle = task;
+    }
+
+    return pdPASS;
+}
+
+void xTaskNotifyGive(TaskHandle_t task) {
+    std::lock_guard<std::mutex> lock(task->mutex);
+    task->notifications++;
+    task->notified.notify_one();
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t*) {
+    xTaskNotifyGive(task);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait) {
+    // The simulation thread moves the clock to the next timer until it is notified, as only
+    // its timers can notify it
+    if (hostIsFastForwarding()) {
+        int64_t timeoutMicros = ticksToWait == portMAX_DELAY
+                                    ? INT64_MAX : micros() + ticksToWait * 1000LL;
+        auto isNotified = [] {
+            std::lock_guard<std::mutex> lock(currentTask.mutex);
+            return currentTask.notifications > 0;
+        };
+
+        while (!isNotified()) {
+            int64_t nextTimerMicros = hostGetNextTimerMicros();
+            if (nextTimerMicros == INT64_MAX && timeoutMicros == INT64_MAX) {
+                return 0;
+            }
+            advanceClock(std::min(nextTimerMicros, timeoutMicros));
+            if (nextTimerMicros >= timeoutMicros) {
+                break;
+            }
+        }
+
+        // The clock is already at the end of the wait
+        ticksToWait = 0;
+    }
+
+    std::unique_lock<std::mutex> lock(currentTask.mutex);
+    auto hasNotifications = [] { return currentTask.notifications > 0; };
+
+    if (ticksToWait == portMAX_DELAY) {
+        currentTask.notified.wait(lock, hasNotifications);
+    } else if (!currentTask.notified.wait_for(lock, std::chrono::milliseconds(ticksToWait),
+                                              hasNotifications)) {
+        return 0;
+    }
+
+    uint32_t notifications = currentTask.notifications;
+    currentTask.notifications = clearCountOnExit ? 0 : notifications - 1;
+
+    return notifications;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t) {
+    return 0;
+}
+
+void disableCore0WDT() {}
+
+int xPortGetCoreID() {
+    return 0;
+}
+
+void hostSetHeap(uint32_t heap, uint32_t largestBlock) {
+    freeHeap.store(heap);
+    largestFreeBlock.store(largestBlock);
+    if (heap < minFreeHeap.load()) {
+        minFreeHeap.store(heap);
+    }
+}
+
+void hostSetEfuseMac(uint64_t mac) {
+    efuseMac = mac;
+}
+
+void hostSetAnalogReader(uint16_t (*reader)(uint8_t pin, void* context), void* context) {
+    analogReader = reader;
+    analogReaderContext = context;
+}
+
+void hostSetFastForward(bool enabled) {
+    simulationThread = std::this_thread::get_id();
+    fastForward.store(enabled);
+}
+
+bool hostIsFastForwarding() {
+    return fastForward.load() && std::this_thread::get_id() == simulationThread;
+}
+
+void hostSetSerialOutput(FILE* stream) {
+    std::lock_guard<std::mutex> lock(serialMutex);
+    serialOutput = stream;
+}
@@ -0,0 +1,186 @@
+/*
+    Arduino.h (host shim)
+
+    * This module implements, on a Linux host, the subset of the Arduino core for the ESP32
+    (and of FreeRTOS) used by the sketch, so that its modules run unchanged on a PC.
+    * The Serial port writes to the standard output, the time functions use the clocks of the
+    host, and the FreeRTOS tasks are threads, with their notifications.
+    * The values that identify a device (MAC address) and the readings of the internal ADC can
+    be set by the host programs, per thread (see the host* functions at the end).
+    * The clock can be fast-forwarded for one thread, the simulation thread: its waits (delay,
+    vTaskDelay, task notifications) move the clock forward to their end, running the timers
+    due on the way, instead of sleeping. The clock still runs with the time spent working, so
+    the durations measured by the sketch stay meaningful.
+*/
+
+#ifndef Arduino_H_
+#define Arduino_H_
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include <algorithm>
+#include <string>
+
+using std::max;
+using std::min;
+
+typedef bool boolean;
+
+#define IRAM_ATTR
+
+#define INPUT 0x01
+#define A2 2
+#define A3 3
+#define A4 4
+#define A5 5
+
+#define DEC 10
+#define HEX 16
+
+unsigned long micros();
+unsigned long millis();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+uint16_t analogRead(uint8_t pin);
+
+bool getLocalTime(struct tm* info, uint32_t ms = 5000);
+void configTime(long gmtOffset_sec, int daylightOffset_sec, const char* server1,
+                const char* server2 = nullptr, const char* server3 = nullptr);
+
+class String : public std::string {
+public:
+    String() {}
+    String(const char* value) : std::string(value != nullptr ? value : "") {}
+    String(const std::string& value) : std::string(value) {}
+    explicit String(int value) : std::string(std::to_string(value)) {}
+    explicit String(unsigned int value) : std::string(std::to_string(value)) {}
+    explicit String(long value) : std::string(std::to_string(value)) {}
+    explicit String(unsigned long value) : std::string(std::to_string(value)) {}
+    explicit String(long long value) : std::string(std::to_string(value)) {}
+    explicit String(unsigned long long value) : std::string(std::to_string(value)) {}
+
+    unsigned int length() const { return size(); }
+    bool reserve(unsigned int size) { std::string::reserve(size); return true; }
+    bool concat(const char* value) { append(value); return true; }
+};
+
+class IPAddress {
+    uint32_t address = 0;
+
+public:
+    IPAddress() {}
+    IPAddress(uint32_t address) : address(address) {}
+    operator uint32_t() const { return address; }
+};
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(const uint8_t* buffer, size_t size) = 0;
+
+    size_t write(uint8_t value) { return write(&value, 1); }
+    size_t print(const char* value) { return write(reinterpret_cast<const uint8_t*>(value),
+                                                   strlen(value)); }
+    size_t print(const String& value) { return print(value.c_str()); }
+    size_t print(char value) { return write(static_cast<uint8_t>(value)); }
+    size_t print(int value, int base = DEC) { return print(static_cast<long long>(value), base); }
+    size_t print(unsigned int value, int base = DEC) {
+        return print(static_cast<unsigned long long>(value), base);
+    }
+    size_t print(long value, int base = DEC) { return print(static_cast<long long>(value), base); }
+    size_t print(unsigned long value, int base = DEC) {
+        return print(static_cast<unsigned long long>(value), base);
+    }
+    size_t print(long long value, int base = DEC);
+    size_t print(unsigned long long value, int base = DEC);
+    size_t print(double value, int digits = 2);
+    size_t print(const IPAddress& value);
+
+    size_t println() { return print("\r\n"); }
+    template <typename T>
+    size_t println(const T& value) { return print(value) + println(); }
+};
+
+class HardwareSerial : public Print {
+public:
+    void begin(unsigned long) {}
+    void flush();
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+class EspClass {
+public:
+    void restart();
+    uint32_t getFreeHeap();
+    uint32_t getMinFreeHeap();
+    uint32_t getMaxAllocHeap();
+    uint64_t getEfuseMac();
+};
+
+extern EspClass ESP;
+
+// FreeRTOS subset: the tasks are threads and the ticks are milliseconds
+typedef struct hostTask* TaskHandle_t;
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define portMAX_DELAY 0xffffffffUL
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) (static_cast<TickType_t>(ms))
+#define tskIDLE_PRIORITY 0
+#define tskNO_AFFINITY 0x7FFFFFFF
+#define portYIELD_FROM_ISR(woken)
+
+void vTaskDelay(TickType_t ticks);
+void taskYIELD();
+TickType_t xTaskGetTickCount();
+TaskHandle_t xTaskGetCurrentTaskHandle();
+BaseType_t xTaskCreatePinnedToCore(void (*function)(void*), const char* name, uint32_t stackSize,
+                                   void* parameter, UBaseType_t priority, TaskHandle_t* handle,
+                                   BaseType_t core);
+void xTaskNotifyGive(TaskHandle_t task);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* higherPriorityTaskWoken);
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait);
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+void disableCore0WDT();
+int xPortGetCoreID();
+
+// Set the MAC address returned by ESP.getEfuseMac() on the calling thread
+void hostSetEfuseMac(uint64_t mac);
+
+// Set the free heap and its largest free block reported to the sketch, for the whole process.
+// The heap of the host isn't comparable to the one of the device, so plausible values of a
+// device with its connections up are reported unless a host tool sets them
+void hostSetHeap(uint32_t freeHeap, uint32_t largestFreeBlock);
+
+// Set the function that provides the readings of analogRead() on the calling thread
+void hostSetAnalogReader(uint16_t (*reader)(uint8_t pin, void* context), void* context);
+
+// Fast-forward the waits of the calling thread, which becomes the simulation thread. Must be
+// enabled before any timer is started
+void hostSetFastForward(bool enabled);
+
+// Check whether the calling thread is the simulation thread, with the clock fast-forwarded
+bool hostIsFastForwarding();
+
+// Set the stream that receives the output of the Serial port, the standard output by default
+void hostSetSerialOutput(FILE* stream);
+
+#endif  // Arduino_H_
@@ -0,0 +1,58 @@
+/*
+    FastLED.h (host shim)
+
+    * The host has no RGB LED, so the colors set by the Errors module are discarded.
+*/
+
+#ifndef FastLED_H_
+#define FastLED_H_
+
+#include "Arduino.h"
+
+struct CRGB {
+    enum HTMLColorCode {
+        Green,
+        Yellow,
+        DarkBlue,
+        Magenta,
+        Red,
+        Aqua
+    };
+
+    HTMLColorCode color = Green;
+
+    CRGB() {}
+    CRGB(HTMLColorCode color) : color(color) {}
+};
+
+template <int SIZE>
+class CRGBArray {
+    CRGB leds[SIZE];
+
+public:
+    CRGB& operator[](int index) { return leds[index]; }
+    operator CRGB*() { return leds; }
+};
+
+#define GRB 0
+#define WS2812 0
+#define TypicalLEDStrip 0
+
+class CLEDController {
+public:
+    CLEDController& setCorrection(int) { return *this; }
+};
+
+class CFastLED {
+    CLEDController controller;
+
+public:
+    template <int CHIPSET, int PIN, int ORDER>
+    CLEDController& addLeds(CRGB*, int) { return controller; }
+    void setBrightness(uint8_t) {}
+    void show() {}
+};
+
+extern CFastLED FastLED;
+
+#endif  // FastLED_H_
@@ -0,0 +1,221 @@
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "AllocationCounter.h"
+#include "FirebaseESP32.h"
+#include "WiFi.h"
+
+FirebaseESP32 Firebase;
+
+// Set the time to wait for the response of the database, as the server response timeout of the
+// library, in seconds (s)
+const int FIREBASE_RESPONSE_TIMEOUT_SECONDS = 10;
+
+FirebaseData::~FirebaseData() {
+    if (socketDescriptor >= 0) {
+        close(socketDescriptor);
+    }
+}
+
+static int connectTo(const String& host, uint16_t port) {
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses = nullptr;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0) {
+        return -1;
+    }
+
+    int socketDescriptor = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (connect(socketDescriptor, addresses->ai_addr, addresses->ai_addrlen) != 0) {
+        close(socketDescriptor);
+        socketDescriptor = -1;
+    }
+    freeaddrinfo(addresses);
+
+    if (socketDescriptor >= 0) {
+        int enable = 1;
+        setsockopt(socketDescriptor, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+        timeval timeout = {FIREBASE_RESPONSE_TIMEOUT_SECONDS, 0};
+        setsockopt(socketDescriptor, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    }
+
+    return socketDescriptor;
+}
+
+static bool sendAll(int socketDescriptor, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t length = send(socketDescriptor, data.data() + sent, data.size() - sent,
+                              MSG_NOSIGNAL);
+        if (length <= 0) {
+            return false;
+        }
+        sent += length;
+    }
+
+    return true;
+}
+
+// Read a whole response and return its status code, or 0 if the connection failed
+static int readResponse(int socketDescriptor, bool* keepAlive) {
+    std::string response;
+    size_t headerEnd = std::string::npos;
+    size_t contentLength = 0;
+    char chunk[1024];
+
+    while (true) {
+        if (headerEnd != std::string::npos && response.size() >= headerEnd + 4 + contentLength) {
+            break;
+        }
+
+        ssize_t length = recv(socketDescriptor, chunk, sizeof(chunk), 0);
+        if (length <= 0) {
+            return 0;
+        }
+        response.append(chunk, length);
+
+        if (headerEnd == std::string::npos) {
+            headerEnd = response.find("\r\n\r\n");
+            if (headerEnd != std::string::npos) {
+                size_t field = response.find("Content-Length:");
+                if (field != std::string::npos && field < headerEnd) {
+                    contentLength = strtoul(response.c_str() + field + 15, nullptr, 10);
+                }
+            }
+        }
+    }
+
+    *keepAlive = response.find("Connection: close") == std::string::npos;
+
+    // The status line is "HTTP/1.1 <code> <reason>"
+    size_t code = response.find(' ');
+    return code != std::string::npos ? atoi(response.c_str() + code + 1) : 0;
+}
+
+void FirebaseESP32::begin(FirebaseConfig* config, FirebaseAuth*) {
+    const char* emulatorHost = getenv("FIREBASE_DATABASE_EMULATOR_HOST");
+    std::string address;
+    if (emulatorHost != nullptr) {
+        address = emulatorHost;
+    } else if (config->database_url.compare(0, 7, "http://") == 0) {
+        address = config->database_url.substr(7);
+        address = address.substr(0, address.find('/'));
+    }
+
+    const char* namespaceName = getenv("FIREBASE_DATABASE_NAMESPACE");
+    if (namespaceName != nullptr) {
+        databaseNamespace = namespaceName;
+    } else {
+        // "https://<namespace>.firebaseio.com" or "http://host:port/?ns=<namespace>"
+        std::string url = config->database_url;
+        size_t query = url.find("ns=");
+        size_t scheme = url.find("://");
+        if (query != std::string::npos) {
+            databaseNamespace = url.substr(query + 3, url.find('&', query) - query - 3);
+        } else if (scheme != std::string::npos) {
+            databaseNamespace = url.substr(scheme + 3, url.find_first_of(".:/", scheme + 3)
+                                                           - scheme - 3);
+        } else {
+            databaseNamespace = "default";
+        }
+    }
+
+    size_t separator = address.rfind(':');
+    host = address.substr(0, separator);
+    port = separator != std::string::npos ? atoi(address.c_str() + separator + 1) : 80;
+    if (host.empty()) {
+        port = 0;
+    }
+}
+
+bool FirebaseESP32::request(FirebaseData& fbdo, const char* method, const char* path,
+                            const char* query, const String& body) {
+    HostLibraryScope library;
+
+    // Without the access point, the requests fail as the socket can't reach the server
+    if (WiFi.status() != WL_CONNECTED) {
+        if (fbdo.socketDescriptor >= 0) {
+            close(fbdo.socketDescriptor);
+            fbdo.socketDescriptor = -1;
+        }
+        fbdo.responseCode = 0;
+        fbdo.error = "connection lost";
+        return false;
+    }
+
+    // Address "/a/b/" as "/a/b.json", as the library does
+    std::string node = path;
+    while (node.size() > 1 && node.back() == '/') {
+        node.pop_back();
+    }
+
+    char header[320];
+    snprintf(header, sizeof(header),
+             "%s %s.json?ns=%s%s HTTP/1.1\r\nHost: %s\r\nContent-Type: application/json\r\n"
+             "Content-Length: %zu\r\nConnection: keep-alive\r\n\r\n",
+             method, node.c_str(), databaseNamespace.c_str(), query, host.c_str(), body.size());
+    std::string message = header + body;
+
+    // A connection kept open may have been closed by the server since the last request, so the
+    // request is sent again on a new connection if it fails on the old one
+    for (int attempt = 0; attempt < 2; attempt++) {
+        bool reused = fbdo.socketDescriptor >= 0;
+        if (!reused) {
+            fbdo.socketDescriptor = connectTo(host, port);
+            if (fbdo.socketDescriptor < 0) {
+                fbdo.responseCode = 0;
+                fbdo.error = "connection refused";
+                return false;
+            }
+        }
+
+        bool keepAlive = false;
+        int code = sendAll(fbdo.socketDescriptor, message)
+                       ? readResponse(fbdo.socketDescriptor, &keepAlive) : 0;
+
+        if (code == 0 || !keepAlive) {
+            close(fbdo.socketDescriptor);
+            fbdo.socketDescriptor = -1;
+        }
+
+        if (code == 0 && reused) {
+            continue;
+        }
+
+        fbdo.responseCode = code;
+        if (code == 0) {
+            fbdo.error = "connection lost";
+        } else if (code >= 300) {
+            fbdo.error = "bad request, response code " + std::to_string(code);
+        } else {
+            fbdo.error.clear();
+        }
+
+        return code >= 200 && code < 300;
+    }
+
+    fbdo.error = "connection lost";
+    return false;
+}
+
+bool FirebaseESP32::updateNode(FirebaseData& fbdo, const char* path, FirebaseJson& json) {
+    return request(fbdo, "PATCH", path, "", json.raw());
+}
+
+bool FirebaseESP32::updateNodeSilent(FirebaseData& fbdo, const char* path, FirebaseJson& json) {
+    return request(fbdo, "PATCH", path, "&print=silent", json.raw());
+}
+
+bool FirebaseESP32::updateNodeSilentAsync(FirebaseData& fbdo, const char* path,
+                                          FirebaseJson& json) {
+    return request(fbdo, "PATCH", path, "&print=silent", json.raw());
+}
+
+bool FirebaseESP32::pushInt(FirebaseData& fbdo, const char* path, long long value) {
+    HostLibraryScope library;
+    return request(fbdo, "POST", path, "", String(value));
+}
@@ -0,0 +1,90 @@
+/*
+    FirebaseESP32.h (host shim)
+
+    * This module implements the subset of the FirebaseESP32 library used by the sketch, as a
+    plain HTTP client of the REST API of the Realtime Database, for the local emulator (see
+    host/emulator) or the Firebase Local Emulator Suite.
+    * The address of the database is taken from FIREBASE_DATABASE_EMULATOR_HOST (host:port), as
+    with the Firebase SDKs, or from the database URL of the config if it starts with http://.
+    * The database instance is selected by FIREBASE_DATABASE_NAMESPACE, or else by the first
+    label of the host of the database URL, as the "ns" parameter of the emulators. It lets many
+    simulated devices share an emulator without sharing their data.
+    * There is no authentication: the emulators accept any request.
+    * The paths and the JSON data are taken as C strings, as the templates of the library do,
+    so that the calls don't copy them into temporary Strings.
+    * Unlike the library, the "async" calls wait for the status of the response, so that the
+    errors injected by the emulator reach the sketch.
+*/
+
+#ifndef FirebaseESP32_H_
+#define FirebaseESP32_H_
+
+#include "AllocationCounter.h"
+#include "Arduino.h"
+
+struct token_info_t {
+    int status = 0;
+};
+
+class FirebaseJson {
+    String data;
+
+public:
+    bool setJsonData(const char* json) {
+        HostLibraryScope library;
+        data.assign(json);
+        return true;
+    }
+    const String& raw() const { return data; }
+};
+
+class FirebaseData {
+    friend class FirebaseESP32;
+
+    // Keep the connection open between the requests, like the library
+    int socketDescriptor = -1;
+    int responseCode = 0;
+    String error;
+
+public:
+    ~FirebaseData();
+
+    String errorReason() const { return error; }
+    int httpCode() const { return responseCode; }
+};
+
+struct FirebaseAuth {
+    struct {
+        String email;
+        String password;
+    } user;
+};
+
+struct FirebaseConfig {
+    String api_key;
+    String database_url;
+    void (*token_status_callback)(token_info_t) = nullptr;
+};
+
+class FirebaseESP32 {
+    String host;
+    uint16_t port = 0;
+    String databaseNamespace;
+
+    bool request(FirebaseData& fbdo, const char* method, const char* path, const char* query,
+                 const String& body);
+
+public:
+    void begin(FirebaseConfig* config, FirebaseAuth* auth);
+    void reconnectWiFi(bool) {}
+    bool ready() const { return port != 0; }
+
+    bool updateNode(FirebaseData& fbdo, const char* path, FirebaseJson& json);
+    bool updateNodeSilent(FirebaseData& fbdo, const char* path, FirebaseJson& json);
+    bool updateNodeSilentAsync(FirebaseData& fbdo, const char* path, FirebaseJson& json);
+    bool pushInt(FirebaseData& fbdo, const char* path, long long value);
+};
+
+extern FirebaseESP32 Firebase;
+
+#endif  // FirebaseESP32_H_
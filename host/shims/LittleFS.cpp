@@ -0,0 +1,184 @@
+#include <stdio.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <string>
+
+#include "AllocationCounter.h"
+#include "LittleFS.h"
+
+namespace fs = std::filesystem;
+
+LittleFSFS LittleFS;
+
+static std::string rootPath = "littlefs";
+
+static hostLittleFSStats stats;
+
+// Store whether a power loss is pending, and the bytes that can still be written before it
+static bool powerLossArmed = false;
+static size_t bytesBeforePowerLoss = 0;
+
+// Define an open file or directory: a stream for the files and an iterator for the directories
+struct hostFile {
+    FILE* stream = nullptr;
+    std::string name;
+    bool isDirectory = false;
+    fs::directory_iterator entries;
+
+    ~hostFile() {
+        if (stream != nullptr) {
+            fclose(stream);
+        }
+    }
+};
+
+static std::string getHostPath(const char* path) {
+    return rootPath + (path[0] == '/' ? "" : "/") + path;
+}
+
+size_t File::write(const uint8_t* buffer, size_t size) {
+    if (!file || file->stream == nullptr) {
+        return 0;
+    }
+
+    // After the power loss, only the bytes written before it reach the file
+    if (powerLossArmed) {
+        size = std::min(size, bytesBeforePowerLoss);
+        bytesBeforePowerLoss -= size;
+    }
+
+    size_t written = size > 0 ? fwrite(buffer, 1, size, file->stream) : 0;
+    stats.bytesWritten += written;
+    stats.writes++;
+    return written;
+}
+
+size_t File::read(uint8_t* buffer, size_t size) {
+    if (!file || file->stream == nullptr) {
+        return 0;
+    }
+
+    size_t read = fread(buffer, 1, size, file->stream);
+    stats.bytesRead += read;
+    return read;
+}
+
+bool File::seek(uint32_t position) {
+    return file && file->stream != nullptr && fseek(file->stream, position, SEEK_SET) == 0;
+}
+
+size_t File::size() const {
+    if (!file || file->stream == nullptr) {
+        return 0;
+    }
+
+    long position = ftell(file->stream);
+    fseek(file->stream, 0, SEEK_END);
+    long size = ftell(file->stream);
+    fseek(file->stream, position, SEEK_SET);
+
+    return size;
+}
+
+void File::flush() {
+    if (file && file->stream != nullptr) {
+        fflush(file->stream);
+        stats.flushes++;
+    }
+}
+
+void File::close() {
+    file.reset();
+}
+
+const char* File::name() const {
+    return file ? file->name.c_str() : "";
+}
+
+bool File::isDirectory() const {
+    return file && file->isDirectory;
+}
+
+File File::openNextFile() {
+    HostLibraryScope library;
+    if (!file || !file->isDirectory || file->entries == fs::directory_iterator()) {
+        return File();
+    }
+
+    auto entry = std::make_shared<hostFile>();
+    entry->name = file->entries->path().filename().string();
+    entry->isDirectory = file->entries->is_directory();
+    if (!entry->isDirectory) {
+        entry->stream = fopen(file->entries->path().c_str(), "rb");
+    }
+    ++file->entries;
+
+    return File(entry);
+}
+
+bool LittleFSFS::begin(bool) {
+    std::error_code error;
+    fs::create_directories(rootPath, error);
+
+    return fs::is_directory(rootPath);
+}
+
+File LittleFSFS::open(const char* path, const char* mode) {
+    HostLibraryScope library;
+    auto file = std::make_shared<hostFile>();
+    std::string hostPath = getHostPath(path);
+    file->name = fs::path(hostPath).filename().string();
+
+    std::error_code error;
+    if (fs::is_directory(hostPath)) {
+        file->isDirectory = true;
+        file->entries = fs::directory_iterator(hostPath, error);
+        return error ? File() : File(file);
+    }
+
+    // The modes of LittleFS are the ones of fopen, always binary
+    std::string binaryMode = std::string(mode) + "b";
+    file->stream = fopen(hostPath.c_str(), binaryMode.c_str());
+    if (file->stream != nullptr && mode[0] == 'w') {
+        stats.filesCreated++;
+    }
+
+    return file->stream != nullptr ? File(file) : File();
+}
+
+bool LittleFSFS::exists(const char* path) {
+    HostLibraryScope library;
+    return fs::exists(getHostPath(path));
+}
+
+bool LittleFSFS::mkdir(const char* path) {
+    HostLibraryScope library;
+    std::error_code error;
+    return fs::create_directories(getHostPath(path), error);
+}
+
+bool LittleFSFS::remove(const char* path) {
+    HostLibraryScope library;
+    std::error_code error;
+    bool removed = fs::remove(getHostPath(path), error);
+    stats.filesRemoved += removed;
+    return removed;
+}
+
+void hostSetLittleFSRoot(const char* path) {
+    rootPath = path;
+}
+
+hostLittleFSStats hostGetLittleFSStats() {
+    return stats;
+}
+
+void hostSetLittleFSPowerLoss(size_t bytesBeforeLoss) {
+    powerLossArmed = true;
+    bytesBeforePowerLoss = bytesBeforeLoss;
+}
+
+void hostRestoreLittleFSPower() {
+    powerLossArmed = false;
+}
@@ -0,0 +1,74 @@
+/*
+    LittleFS.h (host shim)
+
+    * This module implements the subset of the LittleFS library of the ESP32 used by the sketch
+    on a directory of the host, so that the spool persists between the runs like the flash.
+    * The directory is "littlefs" in the working directory, unless set by hostSetLittleFSRoot().
+    * It counts the traffic to the files (see hostGetLittleFSStats()), and it can emulate a power
+    loss in the middle of a write (see hostSetLittleFSPowerLoss()), to check the recovery of
+    the torn writes.
+*/
+
+#ifndef LittleFS_H_
+#define LittleFS_H_
+
+#include <memory>
+
+#include "Arduino.h"
+
+struct hostFile;
+
+class File {
+    std::shared_ptr<hostFile> file;
+
+public:
+    File() {}
+    explicit File(std::shared_ptr<hostFile> file) : file(file) {}
+
+    explicit operator bool() const { return file != nullptr; }
+
+    size_t write(const uint8_t* buffer, size_t size);
+    size_t read(uint8_t* buffer, size_t size);
+    bool seek(uint32_t position);
+    size_t size() const;
+    void flush();
+    void close();
+    const char* name() const;
+    bool isDirectory() const;
+    File openNextFile();
+};
+
+class LittleFSFS {
+public:
+    bool begin(bool formatOnFail = false);
+    File open(const char* path, const char* mode = "r");
+    bool exists(const char* path);
+    bool mkdir(const char* path);
+    bool remove(const char* path);
+};
+
+extern LittleFSFS LittleFS;
+
+// Set the directory of the host that holds the files of LittleFS
+void hostSetLittleFSRoot(const char* path);
+
+struct hostLittleFSStats {
+    uint64_t bytesWritten = 0;
+    uint64_t bytesRead = 0;
+    uint64_t writes = 0;
+    uint64_t flushes = 0;
+    uint64_t filesCreated = 0;
+    uint64_t filesRemoved = 0;
+};
+
+// Get the traffic to the files since the start of the process
+hostLittleFSStats hostGetLittleFSStats();
+
+// Cut the power after the given amount of bytes written from now: the write that crosses it is
+// torn, keeping only its first bytes, and the next ones fail until the power is restored
+void hostSetLittleFSPowerLoss(size_t bytesBeforeLoss);
+
+// Restore the power, so that the writes succeed again
+void hostRestoreLittleFSPower();
+
+#endif  // LittleFS_H_
@@ -0,0 +1,174 @@
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "AllocationCounter.h"
+#include "WiFi.h"
+
+WiFiClass WiFi;
+
+// Store the address to which the connections of WiFiClient are redirected, empty to keep theirs
+static std::mutex clientAddressMutex;
+static std::string clientHost;
+static uint16_t clientPort = 0;
+
+// Define a callback registered for an event, or for all of them (ARDUINO_EVENT_MAX)
+struct hostWiFiHandler {
+    WiFiEventFuncCb callback;
+    arduino_event_id_t event;
+};
+
+static std::mutex handlersMutex;
+static std::vector<hostWiFiHandler> handlers;
+static std::atomic<bool> accessPointAvailable{true};
+static std::atomic<bool> stationConnected{false};
+
+static void dispatchEvent(arduino_event_id_t event) {
+    std::vector<hostWiFiHandler> targets;
+    {
+        HostLibraryScope library;
+        std::lock_guard<std::mutex> lock(handlersMutex);
+        targets = handlers;
+    }
+
+    for (const hostWiFiHandler& handler : targets) {
+        if (handler.event == event || handler.event == ARDUINO_EVENT_MAX) {
+            handler.callback(event, arduino_event_info_t());
+        }
+    }
+}
+
+// Connect the station if the access point is in range, as an association attempt
+static bool connectStation() {
+    if (!accessPointAvailable.load()) {
+        dispatchEvent(ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+        return false;
+    }
+
+    if (!stationConnected.exchange(true)) {
+        dispatchEvent(ARDUINO_EVENT_WIFI_STA_CONNECTED);
+        dispatchEvent(ARDUINO_EVENT_WIFI_STA_GOT_IP);
+    }
+
+    return true;
+}
+
+void WiFiClass::begin(const char*, const char*) {
+    connectStation();
+}
+
+bool WiFiClass::reconnect() {
+    return connectStation();
+}
+
+wl_status_t WiFiClass::status() {
+    return stationConnected.load() ? WL_CONNECTED : WL_DISCONNECTED;
+}
+
+void WiFiClass::onEvent(WiFiEventFuncCb callback, arduino_event_id_t event) {
+    std::lock_guard<std::mutex> lock(handlersMutex);
+    handlers.push_back({callback, event});
+}
+
+void hostSetClientAddress(const char* host, uint16_t port) {
+    std::lock_guard<std::mutex> lock(clientAddressMutex);
+    clientHost = host != nullptr ? host : "";
+    clientPort = port;
+}
+
+void hostSetWiFiAvailable(bool available) {
+    accessPointAvailable.store(available);
+
+    if (!available && stationConnected.exchange(false)) {
+        dispatchEvent(ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+    }
+}
+
+WiFiClient::~WiFiClient() {
+    stop();
+}
+
+int WiFiClient::connect(const char* host, uint16_t port) {
+    stop();
+
+    std::string redirectHost;
+    {
+        std::lock_guard<std::mutex> lock(clientAddressMutex);
+        redirectHost = clientHost;
+        port = clientHost.empty() ? port : clientPort;
+    }
+    if (!redirectHost.empty()) {
+        host = redirectHost.c_str();
+    }
+
+    if (WiFi.status() != WL_CONNECTED) {
+        return 0;
+    }
+
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses = nullptr;
+    char service[8];
+    snprintf(service, sizeof(service), "%u", port);
+    if (getaddrinfo(host, service, &hints, &addresses) != 0) {
+        return 0;
+    }
+
+    socketDescriptor = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (::connect(socketDescriptor, addresses->ai_addr, addresses->ai_addrlen) != 0) {
+        stop();
+    }
+    freeaddrinfo(addresses);
+
+    return socketDescriptor >= 0;
+}
+
+bool WiFiClient::connected() {
+    if (socketDescriptor < 0) {
+        return false;
+    }
+
+    // The peer closed the connection if the socket is readable without any data
+    pollfd descriptor = {socketDescriptor, POLLIN, 0};
+    char data;
+    if (poll(&descriptor, 1, 0) > 0
+            && recv(socketDescriptor, &data, 1, MSG_PEEK | MSG_DONTWAIT) == 0) {
+        return false;
+    }
+
+    return true;
+}
+
+size_t WiFiClient::write(const uint8_t* buffer, size_t size) {
+    size_t written = 0;
+    while (socketDescriptor >= 0 && written < size) {
+        ssize_t length = send(socketDescriptor, buffer + written, size - written, MSG_NOSIGNAL);
+        if (length <= 0) {
+            break;
+        }
+        written += length;
+    }
+
+    return written;
+}
+
+void WiFiClient::setNoDelay(bool noDelay) {
+    int enable = noDelay;
+    setsockopt(socketDescriptor, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+}
+
+void WiFiClient::stop() {
+    if (socketDescriptor >= 0) {
+        close(socketDescriptor);
+        socketDescriptor = -1;
+    }
+}
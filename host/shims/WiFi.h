@@ -0,0 +1,82 @@
+/*
+    WiFi.h (host shim)
+
+    * This module implements the subset of the WiFi library of the ESP32 used by the sketch.
+    WiFiClient is a plain TCP socket of the host, which can be redirected to a local server
+    (see hostSetClientAddress()).
+    * The access point is always in range unless a host tool takes it down (see
+    hostSetWiFiAvailable()), so that the reconnections of the sketch can be scripted. The events
+    are delivered on the thread that changes the state, instead of the event task of the ESP32.
+*/
+
+#ifndef WiFi_H_
+#define WiFi_H_
+
+#include "Arduino.h"
+
+typedef enum {
+    WL_IDLE_STATUS = 0,
+    WL_CONNECTED = 3,
+    WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef enum {
+    ARDUINO_EVENT_WIFI_STA_CONNECTED,
+    ARDUINO_EVENT_WIFI_STA_DISCONNECTED,
+    ARDUINO_EVENT_WIFI_STA_GOT_IP,
+    ARDUINO_EVENT_MAX
+} arduino_event_id_t;
+
+typedef arduino_event_id_t WiFiEvent_t;
+
+typedef struct {} arduino_event_info_t;
+
+typedef arduino_event_info_t WiFiEventInfo_t;
+
+typedef void (*WiFiEventFuncCb)(arduino_event_id_t event, arduino_event_info_t info);
+
+typedef enum {
+    WIFI_OFF,
+    WIFI_STA
+} wifi_mode_t;
+
+class WiFiClass {
+public:
+    bool mode(wifi_mode_t) { return true; }
+    bool setAutoReconnect(bool) { return true; }
+    void begin(const char* ssid, const char* password);
+    bool reconnect();
+    wl_status_t status();
+    IPAddress localIP() { return IPAddress(0x0100007F); }
+    void onEvent(WiFiEventFuncCb callback, arduino_event_id_t event = ARDUINO_EVENT_MAX);
+};
+
+extern WiFiClass WiFi;
+
+/**
+ * Bring the access point up or down. Taking it down disconnects the station, and bringing it
+ * back up only lets the next begin() or reconnect() succeed
+ */
+void hostSetWiFiAvailable(bool available);
+
+/**
+ * Redirect the connections of the WiFiClient instances to an address of the host, as the
+ * servers of the credentials of the sketch (see Credentials.h) aren't reachable from it.
+ * A null host connects to the addresses given again
+ */
+void hostSetClientAddress(const char* host, uint16_t port);
+
+class WiFiClient {
+    int socketDescriptor = -1;
+
+public:
+    ~WiFiClient();
+
+    int connect(const char* host, uint16_t port);
+    bool connected();
+    size_t write(const uint8_t* buffer, size_t size);
+    void setNoDelay(bool noDelay);
+    void stop();
+};
+
+#endif  // WiFi_H_
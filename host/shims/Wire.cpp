@@ -0,0 +1,185 @@
+#include <atomic>
+
+#include "Wire.h"
+
+TwoWire Wire;
+
+// Define the addresses where ADS1115 are emulated
+const uint8_t EMULATED_ADC_FIRST_ADDRESS = 0x48;
+const int EMULATED_ADC_COUNT = 4;
+
+// Define the data rates of the ADS1115, by value of the DR field of the config register
+static const int ADC_DATA_RATES[8] = {8, 16, 32, 64, 128, 250, 475, 860};
+
+/**
+ * Struct of the registers of an emulated ADS1115
+ */
+struct emulatedAdc {
+    uint8_t pointer = 0;
+    // Store the config register as its power-on default, with the OS bit cleared
+    uint16_t config = 0x0583;
+    int16_t conversion = 0;
+    // Store the input of the result in the conversion register
+    uint8_t conversionInput = 0;
+
+    bool converting = false;
+    unsigned long conversionStartMicros = 0;
+};
+
+static emulatedAdc emulatedAdcs[EMULATED_ADC_COUNT];
+
+static int16_t (*externalAdcReader)(uint8_t, uint8_t, void*) = nullptr;
+static void* externalAdcReaderContext = nullptr;
+
+static unsigned long externalAdcDelayMicros = 0;
+static void (*externalAdcObserver)(const hostAdcEvent&, void*) = nullptr;
+static void* externalAdcObserverContext = nullptr;
+
+static std::atomic<uint64_t> transactionCount{0};
+static std::atomic<uint64_t> byteCount{0};
+static std::atomic<uint64_t> busNanos{0};
+
+static emulatedAdc* findAdc(uint8_t address) {
+    int index = address - EMULATED_ADC_FIRST_ADDRESS;
+    return index >= 0 && index < EMULATED_ADC_COUNT ? &emulatedAdcs[index] : nullptr;
+}
+
+// Get the input of the config register of the ADC, 4 to 7 for the inputs against GND
+static int getMux(const emulatedAdc* adc) {
+    return (adc->config >> 12) & 0x07;
+}
+
+static void notifyEvent(HostAdcEvent type, uint8_t address, uint8_t input, int16_t value) {
+    if (externalAdcObserver != nullptr) {
+        externalAdcObserver({type, address, input, value, micros()}, externalAdcObserverContext);
+    }
+}
+
+// Finish the conversion of the ADC once its time elapsed
+static void updateAdc(emulatedAdc* adc, uint8_t address) {
+    if (!adc->converting) {
+        return;
+    }
+
+    unsigned long conversionMicros = 1000000UL / ADC_DATA_RATES[(adc->config >> 5) & 0x07]
+                                     + externalAdcDelayMicros;
+    if (micros() - adc->conversionStartMicros < conversionMicros) {
+        return;
+    }
+
+    adc->converting = false;
+    adc->config |= 0x8000;
+
+    // Only the inputs against GND are read from the host, the other ones read 0
+    int mux = getMux(adc);
+    adc->conversion = externalAdcReader != nullptr && mux >= 4
+                          ? externalAdcReader(address, mux - 4, externalAdcReaderContext)
+                          : 0;
+    adc->conversionInput = mux & 0x03;
+    notifyEvent(HostAdcEvent::ConversionDone, address, adc->conversionInput, adc->conversion);
+}
+
+void TwoWire::countTransaction(int length) {
+    // A start, the address byte, the bytes and a stop, with an acknowledge bit for each byte
+    uint64_t bits = 2 + 9 * static_cast<uint64_t>(1 + length);
+
+    transactionCount++;
+    byteCount += 1 + length;
+    busNanos += bits * 1000000000ULL / clockHz;
+}
+
+void TwoWire::beginTransmission(uint8_t address) {
+    transmitAddress = address;
+    transmitLength = 0;
+}
+
+size_t TwoWire::write(uint8_t value) {
+    if (transmitLength >= I2C_BUFFER_CAPACITY) {
+        return 0;
+    }
+
+    transmitBuffer[transmitLength++] = value;
+    return 1;
+}
+
+uint8_t TwoWire::endTransmission(bool) {
+    emulatedAdc* adc = findAdc(transmitAddress);
+    countTransaction(adc != nullptr ? transmitLength : 0);
+    if (adc == nullptr) {
+        return 2;
+    }
+
+    updateAdc(adc, transmitAddress);
+
+    // The first byte sets the pointer register, the next two are written to the register
+    if (transmitLength >= 1) {
+        adc->pointer = transmitBuffer[0] & 0x03;
+    }
+    if (transmitLength >= 3 && adc->pointer == 0x01) {
+        uint16_t value = (transmitBuffer[1] << 8) | transmitBuffer[2];
+        adc->config = value & 0x7FFF;
+
+        // Writing the OS bit starts a single conversion, which clears it until it is done
+        if (value & 0x8000) {
+            adc->converting = true;
+            adc->conversionStartMicros = micros();
+            notifyEvent(HostAdcEvent::ConversionStarted, transmitAddress, getMux(adc) & 0x03, 0);
+        } else if (!adc->converting) {
+            adc->config |= 0x8000;
+        }
+    }
+
+    return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity) {
+    receiveLength = 0;
+    receiveIndex = 0;
+
+    emulatedAdc* adc = findAdc(address);
+    countTransaction(adc != nullptr ? quantity : 0);
+    if (adc == nullptr) {
+        return 0;
+    }
+
+    updateAdc(adc, address);
+
+    // The register is sent most significant byte first, then repeated
+    uint16_t value = adc->pointer == 0x00 ? static_cast<uint16_t>(adc->conversion)
+                     : adc->pointer == 0x01 ? adc->config
+                                            : 0;
+    if (adc->pointer == 0x00) {
+        notifyEvent(HostAdcEvent::ConversionRead, address, adc->conversionInput, adc->conversion);
+    }
+
+    receiveLength = min(static_cast<int>(quantity), I2C_BUFFER_CAPACITY);
+    for (int i = 0; i < receiveLength; i++) {
+        receiveBuffer[i] = i % 2 == 0 ? value >> 8 : value & 0xFF;
+    }
+
+    return receiveLength;
+}
+
+hostI2cStats hostGetI2cStats() {
+    hostI2cStats stats;
+    stats.transactions = transactionCount.load();
+    stats.bytes = byteCount.load();
+    stats.busMicros = busNanos.load() / 1000.0;
+    return stats;
+}
+
+void hostSetExternalAdcReader(int16_t (*reader)(uint8_t address, uint8_t input, void* context),
+                              void* context) {
+    externalAdcReader = reader;
+    externalAdcReaderContext = context;
+}
+
+void hostSetExternalAdcDelay(unsigned long delayMicros) {
+    externalAdcDelayMicros = delayMicros;
+}
+
+void hostSetExternalAdcObserver(void (*observer)(const hostAdcEvent& event, void* context),
+                                void* context) {
+    externalAdcObserver = observer;
+    externalAdcObserverContext = context;
+}
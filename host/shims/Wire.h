@@ -0,0 +1,114 @@
+/*
+    Wire.h (host shim)
+
+    * This module implements the subset of the Wire library used by the sketch, as a mock of
+    the I2C bus with the external ADCs on it: ADS1115 registers are emulated at the addresses
+    0x48 to 0x4B, and the other addresses don't acknowledge.
+    * The conversions take the time of their data rate, and their results come from a function
+    set by the host programs (see hostSetExternalAdcReader()), for the whole process.
+    * The transactions and the bytes on the bus are counted, with the time that they would take
+    at the clock of the bus (see hostGetI2cStats()), to compare the drivers of the ADCs.
+    * The conversions can take longer than their data rate, as with a slow internal oscillator
+    (see hostSetExternalAdcDelay()), and the starts, the ends and the reads of the conversions
+    can be observed in order (see hostSetExternalAdcObserver()), to test the drivers.
+*/
+
+#ifndef Wire_H_
+#define Wire_H_
+
+#include "Arduino.h"
+
+// Define the capacity of the buffers of a transaction, in bytes
+const int I2C_BUFFER_CAPACITY = 32;
+
+class TwoWire {
+    uint32_t clockHz = 100000;
+
+    // Store the transmission being built
+    uint8_t transmitAddress = 0;
+    uint8_t transmitBuffer[I2C_BUFFER_CAPACITY];
+    int transmitLength = 0;
+
+    // Store the bytes received by the last request
+    uint8_t receiveBuffer[I2C_BUFFER_CAPACITY];
+    int receiveLength = 0;
+    int receiveIndex = 0;
+
+    // Count a transaction of the bytes given, after the address byte
+    void countTransaction(int length);
+
+public:
+    bool begin() { return true; }
+    void setClock(uint32_t frequency) { clockHz = frequency; }
+
+    void beginTransmission(uint8_t address);
+    size_t write(uint8_t value);
+
+    /**
+     * Send the transmission, as the library
+     * @return 0 if it was acknowledged, 2 if the address wasn't
+     */
+    uint8_t endTransmission(bool sendStop = true);
+
+    /**
+     * Read bytes from a device, as the library
+     * @return the amount of bytes received, 0 if the address wasn't acknowledged
+     */
+    uint8_t requestFrom(uint8_t address, uint8_t quantity);
+
+    int available() { return receiveLength - receiveIndex; }
+    int read() { return receiveIndex < receiveLength ? receiveBuffer[receiveIndex++] : -1; }
+};
+
+extern TwoWire Wire;
+
+/**
+ * Struct of the traffic of the I2C bus
+ */
+struct hostI2cStats {
+    uint64_t transactions = 0;
+    // Count the bytes on the bus, with the address bytes
+    uint64_t bytes = 0;
+    // Accumulate the time of the transactions at the clock of the bus, in microseconds (us)
+    double busMicros = 0;
+};
+
+// Get the traffic of the I2C bus since the start of the process
+hostI2cStats hostGetI2cStats();
+
+// Set the function that provides the raw results of the conversions, by address of the ADC and
+// by input (0 to 3, against GND)
+void hostSetExternalAdcReader(int16_t (*reader)(uint8_t address, uint8_t input, void* context),
+                              void* context);
+
+// Set the time that each conversion takes beyond its data rate, in microseconds (us)
+void hostSetExternalAdcDelay(unsigned long delayMicros);
+
+/**
+ * Enum of the events of the conversions of the emulated ADCs
+ */
+enum class HostAdcEvent {
+    // The OS bit was written, with the input of the conversion
+    ConversionStarted,
+    // The conversion is done, with its result, once the bus sees it
+    ConversionDone,
+    // The conversion register was read, with the input of the result that it held
+    ConversionRead
+};
+
+/**
+ * Struct of an event of the conversions of an emulated ADC
+ */
+struct hostAdcEvent {
+    HostAdcEvent type;
+    uint8_t address;
+    uint8_t input;
+    int16_t value;
+    unsigned long micros;
+};
+
+// Set the function called for each event of the conversions, on the thread that uses the bus
+void hostSetExternalAdcObserver(void (*observer)(const hostAdcEvent& event, void* context),
+                                void* context);
+
+#endif  // Wire_H_
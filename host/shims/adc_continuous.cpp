@@ -0,0 +1,217 @@
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "Arduino.h"
+#include "AllocationCounter.h"
+#include "esp_adc/adc_continuous.h"
+
+/**
+ * Struct of the state of a continuous mode driver
+ */
+struct adc_continuous_ctx_t {
+    std::mutex mutex;
+
+    // Store the frames converted and not read yet, as a ring
+    std::vector<uint8_t> pool;
+    uint32_t poolStart = 0;
+    uint32_t poolLength = 0;
+    uint32_t frameSize = 0;
+
+    // Store the channels of the pattern and the rate of the conversions, over all of them
+    std::vector<uint8_t> channels;
+    uint32_t sampleRate = 0;
+
+    // Store the time of the start, in microseconds (us), and count the conversions generated
+    // since then
+    bool started = false;
+    unsigned long startMicros = 0;
+    uint64_t generatedCount = 0;
+    // Store whether the frames are fed by the host, instead of being generated
+    bool fed = false;
+
+    adc_continuous_evt_cbs_t callbacks = {};
+    void* userData = nullptr;
+};
+
+static std::atomic<adc_continuous_ctx_t*> lastDriver{nullptr};
+
+// Append bytes to the pool, which must have room for them
+static void writePool(adc_continuous_ctx_t* driver, const uint8_t* data, uint32_t length) {
+    uint32_t size = driver->pool.size();
+    uint32_t position = (driver->poolStart + driver->poolLength) % size;
+    uint32_t firstLength = std::min(length, size - position);
+
+    memcpy(&driver->pool[position], data, firstLength);
+    memcpy(&driver->pool[0], data + firstLength, length - firstLength);
+    driver->poolLength += length;
+}
+
+// Tell the owner of the driver that the pool is full
+static void overflowPool(adc_continuous_ctx_t* driver) {
+    if (driver->callbacks.on_pool_ovf != nullptr) {
+        adc_continuous_evt_data_t event = {nullptr, 0};
+        driver->callbacks.on_pool_ovf(driver, &event, driver->userData);
+    }
+}
+
+// Generate the frames of conversions due at the clock, from analogRead()
+static void generateFrames(adc_continuous_ctx_t* driver) {
+    uint32_t frameResults = driver->frameSize / SOC_ADC_DIGI_RESULT_BYTES;
+    uint64_t dueCount = static_cast<uint64_t>(micros() - driver->startMicros)
+                        * driver->sampleRate / 1000000;
+
+    // The DMA hands over whole frames, the last one is still being filled
+    uint8_t frame[1024];
+    while (dueCount - driver->generatedCount >= frameResults) {
+        if (driver->pool.size() - driver->poolLength < driver->frameSize) {
+            driver->generatedCount += frameResults;
+            overflowPool(driver);
+            continue;
+        }
+
+        for (uint32_t i = 0; i < frameResults; i++) {
+            uint8_t channel = driver->channels[driver->generatedCount++ % driver->channels.size()];
+            adc_digi_output_data_t result;
+            result.type1.data = analogRead(channel) & 0x0FFF;
+            result.type1.channel = channel;
+            memcpy(&frame[i * SOC_ADC_DIGI_RESULT_BYTES], &result, SOC_ADC_DIGI_RESULT_BYTES);
+        }
+        writePool(driver, frame, driver->frameSize);
+    }
+}
+
+esp_err_t adc_continuous_new_handle(const adc_continuous_handle_cfg_t* hdl_config,
+                                    adc_continuous_handle_t* ret_handle) {
+    if (hdl_config->conv_frame_size == 0 || hdl_config->conv_frame_size > 1024
+            || hdl_config->conv_frame_size % SOC_ADC_DIGI_RESULT_BYTES != 0
+            || hdl_config->max_store_buf_size < hdl_config->conv_frame_size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // The driver allocates its pool, as the one of the device
+    HostLibraryScope library;
+    adc_continuous_ctx_t* driver = new adc_continuous_ctx_t();
+    driver->pool.resize(hdl_config->max_store_buf_size);
+    driver->frameSize = hdl_config->conv_frame_size;
+
+    lastDriver.store(driver);
+    *ret_handle = driver;
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_config(adc_continuous_handle_t handle,
+                                const adc_continuous_config_t* config) {
+    if (config->pattern_num == 0 || config->conv_mode != ADC_CONV_SINGLE_UNIT_1
+            || config->format != ADC_DIGI_OUTPUT_FORMAT_TYPE1
+            || config->sample_freq_hz < 20000 || config->sample_freq_hz > 2000000) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    HostLibraryScope library;
+    std::lock_guard<std::mutex> lock(handle->mutex);
+    handle->channels.clear();
+    for (uint32_t i = 0; i < config->pattern_num; i++) {
+        handle->channels.push_back(config->adc_pattern[i].channel);
+    }
+    handle->sampleRate = config->sample_freq_hz;
+
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_register_event_callbacks(adc_continuous_handle_t handle,
+                                                  const adc_continuous_evt_cbs_t* cbs,
+                                                  void* user_data) {
+    std::lock_guard<std::mutex> lock(handle->mutex);
+    handle->callbacks = *cbs;
+    handle->userData = user_data;
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_start(adc_continuous_handle_t handle) {
+    std::lock_guard<std::mutex> lock(handle->mutex);
+    if (handle->started || handle->channels.empty()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    handle->started = true;
+    handle->startMicros = micros();
+    handle->generatedCount = 0;
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_stop(adc_continuous_handle_t handle) {
+    std::lock_guard<std::mutex> lock(handle->mutex);
+    if (!handle->started) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    handle->started = false;
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_read(adc_continuous_handle_t handle, uint8_t* buf, uint32_t length_max,
+                              uint32_t* out_length, uint32_t) {
+    std::lock_guard<std::mutex> lock(handle->mutex);
+    if (!handle->started) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (!handle->fed) {
+        generateFrames(handle);
+    }
+
+    uint32_t length = std::min(length_max, handle->poolLength);
+    length -= length % SOC_ADC_DIGI_RESULT_BYTES;
+    *out_length = length;
+    if (length == 0) {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    uint32_t size = handle->pool.size();
+    uint32_t firstLength = std::min(length, size - handle->poolStart);
+    memcpy(buf, &handle->pool[handle->poolStart], firstLength);
+    memcpy(buf + firstLength, &handle->pool[0], length - firstLength);
+    handle->poolStart = (handle->poolStart + length) % handle->pool.size();
+    handle->poolLength -= length;
+
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_deinit(adc_continuous_handle_t handle) {
+    adc_continuous_ctx_t* expected = handle;
+    lastDriver.compare_exchange_strong(expected, nullptr);
+
+    HostLibraryScope library;
+    delete handle;
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_io_to_channel(int io_num, adc_unit_t* unit_id, adc_channel_t* channel) {
+    if (io_num < 0 || io_num > ADC_CHANNEL_9) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    *unit_id = ADC_UNIT_1;
+    *channel = static_cast<adc_channel_t>(io_num);
+    return ESP_OK;
+}
+
+uint32_t hostFeedAdcFrames(const uint8_t* frames, uint32_t length) {
+    adc_continuous_ctx_t* driver = lastDriver.load();
+    if (driver == nullptr) {
+        return 0;
+    }
+
+    std::lock_guard<std::mutex> lock(driver->mutex);
+    driver->fed = true;
+
+    uint32_t room = driver->pool.size() - driver->poolLength;
+    if (length > room) {
+        overflowPool(driver);
+        length = room;
+    }
+    writePool(driver, frames, length);
+
+    return length;
+}
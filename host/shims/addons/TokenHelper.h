@@ -0,0 +1,14 @@
+/*
+    TokenHelper.h (host shim)
+
+    * The emulators don't issue tokens, so the status of the token generation is never reported.
+*/
+
+#ifndef TokenHelper_H_
+#define TokenHelper_H_
+
+#include "../FirebaseESP32.h"
+
+inline void tokenStatusCallback(token_info_t) {}
+
+#endif  // TokenHelper_H_
@@ -0,0 +1,134 @@
+/*
+    esp_adc/adc_continuous.h (host shim)
+
+    * This module implements the continuous mode driver of the ADCs of the ESP-IDF, as a mock:
+    the conversions of the pattern are generated at the configured rate, with the values of
+    analogRead() on the thread that reads them (see hostSetAnalogReader()), and are handed over
+    in whole frames, through a pool that drops them once full, as the DMA of the device.
+    * The host programs can feed synthetic frames instead (see hostFeedAdcFrames()), for
+    example to measure the cost of their unpacking.
+    * On the host, the pins 0 to 9 are the channels 0 to 9 of ADC1, and analogRead() is called
+    with the channel.
+*/
+
+#ifndef adc_continuous_H_
+#define adc_continuous_H_
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#define SOC_ADC_DIGI_MAX_BITWIDTH 12
+#define SOC_ADC_DIGI_RESULT_BYTES 2
+
+typedef enum {
+    ADC_UNIT_1,
+    ADC_UNIT_2
+} adc_unit_t;
+
+typedef enum {
+    ADC_CHANNEL_0,
+    ADC_CHANNEL_1,
+    ADC_CHANNEL_2,
+    ADC_CHANNEL_3,
+    ADC_CHANNEL_4,
+    ADC_CHANNEL_5,
+    ADC_CHANNEL_6,
+    ADC_CHANNEL_7,
+    ADC_CHANNEL_8,
+    ADC_CHANNEL_9
+} adc_channel_t;
+
+typedef enum {
+    ADC_ATTEN_DB_0,
+    ADC_ATTEN_DB_2_5,
+    ADC_ATTEN_DB_6,
+    ADC_ATTEN_DB_11
+} adc_atten_t;
+
+typedef enum {
+    ADC_CONV_SINGLE_UNIT_1 = 1,
+    ADC_CONV_SINGLE_UNIT_2,
+    ADC_CONV_BOTH_UNIT,
+    ADC_CONV_ALTER_UNIT
+} adc_digi_convert_mode_t;
+
+typedef enum {
+    ADC_DIGI_OUTPUT_FORMAT_TYPE1,
+    ADC_DIGI_OUTPUT_FORMAT_TYPE2
+} adc_digi_output_format_t;
+
+typedef struct {
+    uint8_t atten;
+    uint8_t channel;
+    uint8_t unit;
+    uint8_t bit_width;
+} adc_digi_pattern_config_t;
+
+typedef struct {
+    union {
+        struct {
+            uint16_t data : 12;
+            uint16_t channel : 4;
+        } type1;
+        uint16_t val;
+    };
+} adc_digi_output_data_t;
+
+typedef struct {
+    uint32_t max_store_buf_size;
+    uint32_t conv_frame_size;
+    struct {
+        uint32_t flush_pool : 1;
+    } flags;
+} adc_continuous_handle_cfg_t;
+
+typedef struct {
+    uint32_t pattern_num;
+    adc_digi_pattern_config_t* adc_pattern;
+    uint32_t sample_freq_hz;
+    adc_digi_convert_mode_t conv_mode;
+    adc_digi_output_format_t format;
+} adc_continuous_config_t;
+
+typedef struct {
+    uint8_t* conv_frame_buffer;
+    uint32_t size;
+} adc_continuous_evt_data_t;
+
+typedef struct adc_continuous_ctx_t* adc_continuous_handle_t;
+
+typedef bool (*adc_continuous_callback_t)(adc_continuous_handle_t handle,
+                                          const adc_continuous_evt_data_t* edata,
+                                          void* user_data);
+
+typedef struct {
+    adc_continuous_callback_t on_conv_done;
+    adc_continuous_callback_t on_pool_ovf;
+} adc_continuous_evt_cbs_t;
+
+esp_err_t adc_continuous_new_handle(const adc_continuous_handle_cfg_t* hdl_config,
+                                    adc_continuous_handle_t* ret_handle);
+esp_err_t adc_continuous_config(adc_continuous_handle_t handle,
+                                const adc_continuous_config_t* config);
+esp_err_t adc_continuous_register_event_callbacks(adc_continuous_handle_t handle,
+                                                  const adc_continuous_evt_cbs_t* cbs,
+                                                  void* user_data);
+esp_err_t adc_continuous_start(adc_continuous_handle_t handle);
+esp_err_t adc_continuous_stop(adc_continuous_handle_t handle);
+
+/**
+ * Read the frames in the pool, as the driver. The mock never waits: without any frame, it
+ * returns ESP_ERR_TIMEOUT right away, whatever the timeout
+ */
+esp_err_t adc_continuous_read(adc_continuous_handle_t handle, uint8_t* buf, uint32_t length_max,
+                              uint32_t* out_length, uint32_t timeout_ms);
+esp_err_t adc_continuous_deinit(adc_continuous_handle_t handle);
+esp_err_t adc_continuous_io_to_channel(int io_num, adc_unit_t* unit_id, adc_channel_t* channel);
+
+// Feed frames of results to the pool of the driver created last, in place of the conversions
+// generated from analogRead(), which stop once frames are fed. The results that don't fit in
+// the pool are dropped, as on the device. Returns the amount of bytes that fit in the pool
+uint32_t hostFeedAdcFrames(const uint8_t* frames, uint32_t length);
+
+#endif  // adc_continuous_H_
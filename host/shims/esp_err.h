@@ -0,0 +1,18 @@
+/*
+    esp_err.h (host shim)
+
+    * This module defines the error codes of the ESP-IDF used by the shims of its drivers.
+*/
+
+#ifndef esp_err_H_
+#define esp_err_H_
+
+typedef int esp_err_t;
+
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_STATE 0x103
+#define ESP_ERR_TIMEOUT 0x107
+
+#endif  // esp_err_H_
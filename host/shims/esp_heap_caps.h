@@ -0,0 +1,16 @@
+/*
+    esp_heap_caps.h (host shim)
+
+    * The largest free block is the one set by the host tools (see hostSetHeap() in Arduino.h).
+*/
+
+#ifndef esp_heap_caps_H_
+#define esp_heap_caps_H_
+
+#include <stddef.h>
+
+#define MALLOC_CAP_8BIT (1 << 2)
+
+size_t heap_caps_get_largest_free_block(unsigned int caps);
+
+#endif  // esp_heap_caps_H_
@@ -0,0 +1,148 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Arduino.h"
+#include "esp_timer.h"
+
+// Define a periodic timer: its callback, its deadline and the thread that waits for it
+struct hostTimer {
+    esp_timer_cb_t callback = nullptr;
+    void* arg = nullptr;
+    int64_t periodMicros = 0;
+    int64_t deadlineMicros = 0;
+    bool running = false;
+    bool simulated = false;
+
+    std::mutex mutex;
+    std::condition_variable stopped;
+    std::thread thread;
+};
+
+// Track the timers of the simulation thread, fired by hostRunDueTimers()
+static std::mutex simulatedTimersMutex;
+static std::vector<hostTimer*> simulatedTimers;
+
+static void runTimer(hostTimer* timer) {
+    auto bootTime = std::chrono::steady_clock::now() - std::chrono::microseconds(micros());
+    std::unique_lock<std::mutex> lock(timer->mutex);
+
+    while (timer->running) {
+        auto deadline = bootTime + std::chrono::microseconds(timer->deadlineMicros);
+        if (timer->stopped.wait_until(lock, deadline, [timer] { return !timer->running; })) {
+            break;
+        }
+
+        // The next deadline only depends on the period, never on the time of the callback
+        timer->deadlineMicros += timer->periodMicros;
+        lock.unlock();
+        timer->callback(timer->arg);
+        lock.lock();
+    }
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* handle) {
+    hostTimer* timer = new hostTimer();
+    timer->callback = args->callback;
+    timer->arg = args->arg;
+    *handle = timer;
+
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period) {
+    if (timer->running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    timer->periodMicros = period;
+    timer->deadlineMicros = micros() + period;
+    timer->running = true;
+    timer->simulated = hostIsFastForwarding();
+
+    if (timer->simulated) {
+        std::lock_guard<std::mutex> lock(simulatedTimersMutex);
+        simulatedTimers.push_back(timer);
+    } else {
+        timer->thread = std::thread(runTimer, timer);
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    if (!timer->running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (timer->simulated) {
+        std::lock_guard<std::mutex> lock(simulatedTimersMutex);
+        timer->running = false;
+        for (size_t i = 0; i < simulatedTimers.size(); i++) {
+            if (simulatedTimers[i] == timer) {
+                simulatedTimers.erase(simulatedTimers.begin() + i);
+                break;
+            }
+        }
+        return ESP_OK;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(timer->mutex);
+        timer->running = false;
+        timer->stopped.notify_all();
+    }
+    timer->thread.join();
+
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    if (timer->running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    delete timer;
+    return ESP_OK;
+}
+
+int64_t esp_timer_get_time() {
+    return micros();
+}
+
+int64_t hostGetNextTimerMicros() {
+    std::lock_guard<std::mutex> lock(simulatedTimersMutex);
+
+    int64_t nextMicros = INT64_MAX;
+    for (hostTimer* timer : simulatedTimers) {
+        nextMicros = std::min(nextMicros, timer->deadlineMicros);
+    }
+
+    return nextMicros;
+}
+
+void hostRunDueTimers(int64_t nowMicros) {
+    // The callbacks may use the timers, so they run without the lock
+    while (true) {
+        hostTimer* dueTimer = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(simulatedTimersMutex);
+            for (hostTimer* timer : simulatedTimers) {
+                if (timer->deadlineMicros <= nowMicros
+                        && (dueTimer == nullptr
+                            || timer->deadlineMicros < dueTimer->deadlineMicros)) {
+                    dueTimer = timer;
+                }
+            }
+            if (dueTimer == nullptr) {
+                return;
+            }
+            dueTimer->deadlineMicros += dueTimer->periodMicros;
+        }
+
+        dueTimer->callback(dueTimer->arg);
+    }
+}
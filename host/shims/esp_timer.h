@@ -0,0 +1,46 @@
+/*
+    esp_timer.h (host shim)
+
+    * This module implements the periodic timers of the ESP32 used by the sketch. Each timer
+    runs on its own thread, with drift-free deadlines, and its callback runs on that thread.
+    * When the clock of the host is fast-forwarded (see hostSetFastForward() in Arduino.h), the
+    timers have no thread: their callbacks run on the simulation thread, as the clock reaches
+    their deadlines.
+*/
+
+#ifndef esp_timer_H_
+#define esp_timer_H_
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+typedef struct hostTimer* esp_timer_handle_t;
+typedef void (*esp_timer_cb_t)(void* arg);
+
+typedef enum {
+    ESP_TIMER_TASK
+} esp_timer_dispatch_t;
+
+typedef struct {
+    esp_timer_cb_t callback;
+    void* arg;
+    esp_timer_dispatch_t dispatch_method;
+    const char* name;
+    bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* handle);
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period);
+esp_err_t esp_timer_stop(esp_timer_handle_t timer);
+esp_err_t esp_timer_delete(esp_timer_handle_t timer);
+int64_t esp_timer_get_time();
+
+// Get the deadline of the next timer without a thread, in microseconds since the boot, or
+// INT64_MAX if there is none
+int64_t hostGetNextTimerMicros();
+
+// Run the callbacks of the timers without a thread whose deadline is before nowMicros
+void hostRunDueTimers(int64_t nowMicros);
+
+#endif  // esp_timer_H_
@@ -0,0 +1,240 @@
+/*
+    AllocationTest.cpp
+
+    * Test of the steady state of the upload path: once warmed up, Database must not allocate
+    on the heap (see AllocationCounter.h), whatever the uploads go through.
+    * The samples are written to the buffer as DataReader does and sent by Database to an RTDB
+    emulator (see host/emulator) that answers some requests with an error, so that batches fail
+    while others are in flight and are built again (go-back-N). In each cycle, the database also
+    goes down while a backlog is written, so that the oldest samples are moved to the spool,
+    which is sent first once the database is back, with its own rewinds.
+    * The first cycle warms up the connections, the spool and the buffers, the next ones are
+    counted. Every sample written must be stored once the cycle is drained.
+    * It runs in real time, as the uploads run on their tasks at the pace of the emulator, with
+    the samples written by the loop of the encode stage at a few times the rate of the device.
+    * Usage: allocation_test [CYCLES]
+*/
+
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include <LittleFS.h>
+
+#include "AllocationCounter.h"
+#include "AsyncLog.h"
+#include "Buffer.h"
+#include "Check.h"
+#include "Clock.h"
+#include "Connectivity.h"
+#include "Database.h"
+#include "Errors.h"
+#include "RtdbEmulator.h"
+#include "Stages.h"
+#include "Telemetry.h"
+
+namespace fs = std::filesystem;
+
+// Set the default amount of counted cycles, after the warm-up one
+const int TEST_CYCLE_COUNT = 4;
+
+// Set the loops of the encode stage of the steady state of each cycle, and the samples written
+// in each of them
+const int TEST_STEADY_LOOPS = 150;
+const int TEST_STEADY_SAMPLES_PER_LOOP = 8;
+
+// Set the backlog written while the database is down, beyond the threshold of the spool, and
+// the samples written in each loop meanwhile
+const int TEST_BACKLOG_SAMPLES = SPOOL_SPILL_THRESHOLD + 4 * SPOOL_SPILL_BATCH_SIZE;
+const int TEST_BACKLOG_SAMPLES_PER_LOOP = 64;
+
+// Set the probability of an error answered by the emulator, and its latency (ms)
+const double TEST_ERROR_RATE = 0.08;
+const int TEST_LATENCY_MILLIS = 30;
+
+// Set the longest time given to a cycle to be drained, in real time (s)
+const int TEST_DRAIN_TIMEOUT_SECONDS = 60;
+
+// Set the least amount of batches sent in each counted cycle
+const uint32_t TEST_MIN_CYCLE_PUSHES = 60;
+
+// Define the globals of the sketch
+Errors errorHandler;
+AsyncLog asyncLog;
+Telemetry telemetry;
+Connectivity connectivity;
+StageMonitor stageMonitor;
+
+static SensorDataBuffer dataBuffer;
+static Database database;
+
+static fs::path testRoot;
+static uint64_t writtenSamples = 0;
+static unsigned long long previousTimestampMillis = 0;
+
+// Write a sample to the buffer, with a first channel that always changes, so that every sample
+// reaches the database and can be counted there
+static bool writeSample() {
+    // The samples written at once still get distinct timestamps, as they are the keys
+    unsigned long long timestampMillis = std::max(clockEpochMillis(), previousTimestampMillis + 1);
+
+    sensorData* sample = dataBuffer.getNewSample(timestampMillis);
+    if (sample == nullptr) {
+        return false;
+    }
+
+    for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+        sample->pressureSensor[i] = 1000 + 100 * i;
+    }
+    sample->pressureSensor[0] = 500 + (writtenSamples * 37) % 3000;
+    dataBuffer.commitNewSample();
+
+    previousTimestampMillis = timestampMillis;
+    writtenSamples++;
+    return true;
+}
+
+// Run the loop of the encode stage once, without its notifications
+static void runEncodeStage() {
+    database.sendData(&dataBuffer);
+    vTaskDelay(ENCODE_STAGE_INTERVAL_MILLIS);
+}
+
+// Count the samples stored on the emulator. The boot log and the telemetry have their own nodes
+static uint64_t countStoredSamples(const RtdbEmulator& emulator) {
+    // The test's own allocations aren't the ones of the sketch
+    HostLibraryScope scope;
+    return emulator.countValues("allocation", "/") - emulator.countValues("allocation", "/bootLog")
+           - emulator.countValues("allocation", "/telemetry");
+}
+
+// Count the spills to the spool logged so far, once the log task wrote them
+static int countSpills() {
+    HostLibraryScope scope;
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    fflush(nullptr);
+
+    std::ifstream log(testRoot / "allocation.log");
+    std::string line;
+    int spills = 0;
+    while (std::getline(log, line)) {
+        spills += line.find(" samples to the spool") != std::string::npos;
+    }
+
+    return spills;
+}
+
+static bool runCycle(RtdbEmulator* emulator) {
+    // Steady state: the samples go in small batches, as soon as they are written
+    for (int i = 0; i < TEST_STEADY_LOOPS; i++) {
+        for (int j = 0; j < TEST_STEADY_SAMPLES_PER_LOOP; j++) {
+            writeSample();
+        }
+        runEncodeStage();
+    }
+
+    // Outage: the backlog goes beyond the threshold of the spool while nothing can be sent
+    emulator->setOutage(true);
+    for (int i = 0; i < TEST_BACKLOG_SAMPLES; i += TEST_BACKLOG_SAMPLES_PER_LOOP) {
+        for (int j = 0; j < TEST_BACKLOG_SAMPLES_PER_LOOP; j++) {
+            writeSample();
+        }
+        runEncodeStage();
+    }
+    emulator->setOutage(false);
+
+    // Drain: the spool is sent first, then the buffer, in full batches
+    auto deadline = std::chrono::steady_clock::now()
+                    + std::chrono::seconds(TEST_DRAIN_TIMEOUT_SECONDS);
+    int loops = 0;
+    while (std::chrono::steady_clock::now() < deadline) {
+        runEncodeStage();
+        if (++loops % 20 == 0 && dataBuffer.isBufferEmpty()
+                && countStoredSamples(*emulator) == writtenSamples) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+int main(int argc, char** argv) {
+    int cycleCount = argc > 1 ? atoi(argv[1]) : TEST_CYCLE_COUNT;
+
+    testRoot = fs::temp_directory_path() / ("allocation_test_" + std::to_string(getpid()));
+    fs::create_directories(testRoot);
+    hostSetLittleFSRoot((testRoot / "littlefs").c_str());
+    hostSetSerialOutput(fopen((testRoot / "allocation.log").c_str(), "w"));
+
+    emulatorConfig config;
+    config.port = 0;
+    config.latencyMillis = TEST_LATENCY_MILLIS;
+    config.errorRate = TEST_ERROR_RATE;
+    RtdbEmulator emulator(config);
+    if (!emulator.start()) {
+        perror("Could not start the emulator");
+        return 1;
+    }
+    char address[32];
+    snprintf(address, sizeof(address), "127.0.0.1:%u", emulator.getPort());
+    setenv("FIREBASE_DATABASE_EMULATOR_HOST", address, 1);
+    setenv("FIREBASE_DATABASE_NAMESPACE", "allocation", 1);
+
+    // The tasks of the sketch inherit the tracking of the allocations from this thread
+    hostTrackAllocations(true);
+
+    asyncLog.setup();
+    connectivity.setup();
+    database.setup();
+
+    // The warm-up cycle opens the connections and the spool, and goes through every path once
+    CHECK(runCycle(&emulator));
+    int warmupSpills = countSpills();
+    uint32_t warmupPushes = telemetry.getPushCount();
+    uint32_t warmupFailures = telemetry.getPushFailureCount();
+    uint64_t warmupOverwrites = emulator.getStats().overwrites;
+
+    hostSetAllocationCounting(true);
+    for (int cycle = 0; cycle < cycleCount; cycle++) {
+        CHECK(runCycle(&emulator));
+    }
+    hostSetAllocationCounting(false);
+
+    uint64_t allocations = hostGetAllocationCount();
+    uint32_t pushes = telemetry.getPushCount() - warmupPushes;
+    uint32_t failures = telemetry.getPushFailureCount() - warmupFailures;
+    uint64_t overwrites = emulator.getStats().overwrites - warmupOverwrites;
+    int spills = countSpills() - warmupSpills;
+    uint64_t storedSamples = countStoredSamples(emulator);
+
+    printf("cycles=%d pushes=%u failures=%u rewritten values=%llu spills=%d samples=%llu "
+           "stored=%llu allocations=%llu\n", cycleCount, pushes, failures,
+           static_cast<unsigned long long>(overwrites), spills,
+           static_cast<unsigned long long>(writtenSamples),
+           static_cast<unsigned long long>(storedSamples),
+           static_cast<unsigned long long>(allocations));
+
+    // The counted cycles went through every path, and nothing was allocated nor lost
+    CHECK(pushes >= TEST_MIN_CYCLE_PUSHES * cycleCount);
+    CHECK(failures > 0);
+    CHECK(overwrites > 0);
+    CHECK(spills >= cycleCount);
+    CHECK(storedSamples == writtenSamples);
+    CHECK(allocations == 0);
+
+    emulator.stop();
+    std::error_code error;
+    fs::remove_all(testRoot, error);
+
+    // The log task is still running, so the process ends without the destructors
+    int result = checkResult("allocation_test");
+    fflush(stdout);
+    _exit(result);
+}
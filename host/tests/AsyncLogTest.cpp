@@ -0,0 +1,153 @@
+/*
+    AsyncLogTest.cpp
+
+    * Test of the encoding of the arguments of the asynchronous log (see AsyncLog.h).
+    * Lifetimes: the char arrays that don't outlive the call (a local array, the member of a
+    temporary) must be copied into the record, while the literals marked with _log are stored
+    as pointers. The copies are bounded by the size of the array and by the text area.
+    * Cost: the arguments of a typical call, with its literals marked (stored as pointers, as
+    all the char arrays were before they were copied) or not (copied), are encoded in many
+    alternate rounds, and the best round of each is kept. It reports the cost per call of both.
+    * Usage: async_log_test
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include "AsyncLog.h"
+#include "Check.h"
+
+// Set the amount of calls of each round of the measurement, and the amount of rounds
+const int TEST_CALL_COUNT = 1000000;
+const int TEST_ROUND_COUNT = 20;
+
+// Define the globals of the sketch
+AsyncLog asyncLog;
+
+struct deviceName {
+    char value[16];
+};
+
+static deviceName makeDeviceName() {
+    deviceName name;
+    snprintf(name.value, sizeof(name.value), "chair-%d", 7);
+    return name;
+}
+
+static void resetRecord(logRecord* record) {
+    record->argCount = 0;
+    record->textLength = 0;
+}
+
+static bool hasText(const logRecord& record, int arg, const char* expected) {
+    return record.types[arg] == LogArgType::Text
+           && record.values[arg].text.length == strlen(expected)
+           && memcmp(record.text + record.values[arg].text.offset, expected,
+                     strlen(expected)) == 0;
+}
+
+// Encode a const local array, whose storage is gone once the function returns
+__attribute__((noinline)) static void encodeLocalArray(logRecord* record) {
+    const char localName[] = {'s', 'l', 'o', 't', '-', '1', '\0'};
+    logEncodeArgs(record, localName);
+}
+
+static void testLifetimes() {
+    static logRecord record;
+
+    resetRecord(&record);
+    logEncodeArgs(&record, makeDeviceName().value);
+    encodeLocalArray(&record);
+
+    // Overwrite the stack where the local array was, so a pointer to it would show it
+    volatile char scratch[64];
+    memset(const_cast<char*>(scratch), 'x', sizeof(scratch));
+
+    CHECK(record.argCount == 2);
+    CHECK(hasText(record, 0, "chair-7"));
+    CHECK(hasText(record, 1, "slot-1"));
+
+    // The marked literals are stored as pointers, without taking any text
+    resetRecord(&record);
+    logEncodeArgs(&record, "Connected"_log, 3);
+    CHECK(record.types[0] == LogArgType::Literal);
+    CHECK(strcmp(record.values[0].literal, "Connected") == 0);
+    CHECK(record.types[1] == LogArgType::Signed && record.values[1].signedValue == 3);
+    CHECK(record.textLength == 0);
+
+    // An array without a terminator is bounded by its size, and the text area by its capacity
+    const char unterminated[4] = {'a', 'b', 'c', 'd'};
+    char longText[LOG_TEXT_CAPACITY + 20];
+    memset(longText, 'y', sizeof(longText) - 1);
+    longText[sizeof(longText) - 1] = '\0';
+
+    resetRecord(&record);
+    logEncodeArgs(&record, unterminated, longText, "end");
+    CHECK(hasText(record, 0, "abcd"));
+    CHECK(record.types[1] == LogArgType::Text);
+    CHECK(record.values[1].text.length == LOG_TEXT_CAPACITY - 4);
+    CHECK(record.types[2] == LogArgType::Text && record.values[2].text.length == 0);
+    CHECK(record.textLength == LOG_TEXT_CAPACITY);
+}
+
+// Encode the arguments of a typical call, as Connectivity does when the connection is back
+__attribute__((noinline)) static void encodeMarked(logRecord* record, unsigned long duration,
+                                                   int samples) {
+    logEncodeArgs(record, "Connection back after "_log, duration, " ms, "_log, samples,
+                  " samples taken in the meantime"_log);
+}
+
+__attribute__((noinline)) static void encodeCopied(logRecord* record, unsigned long duration,
+                                                   int samples) {
+    logEncodeArgs(record, "Connection back after ", duration, " ms, ", samples,
+                  " samples taken in the meantime");
+}
+
+template <typename Encode>
+static double measureRound(Encode encode, logRecord* record) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < TEST_CALL_COUNT; i++) {
+        resetRecord(record);
+        encode(record, i, i & 0xFF);
+    }
+
+    return std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now() - start).count() / TEST_CALL_COUNT;
+}
+
+static void testCost() {
+    static logRecord record;
+    double markedNanos = 0;
+    double copiedNanos = 0;
+
+    // Alternate the versions, and which one goes first, so that both run in the same conditions
+    for (int round = 0; round < TEST_ROUND_COUNT; round++) {
+        double marked = 0;
+        if (round % 2 == 0) {
+            marked = measureRound(encodeMarked, &record);
+        }
+        double copied = measureRound(encodeCopied, &record);
+        if (round % 2 != 0) {
+            marked = measureRound(encodeMarked, &record);
+        }
+
+        markedNanos = markedNanos == 0 || marked < markedNanos ? marked : markedNanos;
+        copiedNanos = copiedNanos == 0 || copied < copiedNanos ? copied : copiedNanos;
+    }
+
+    // The copies fill the text area, so the last literal is cut
+    resetRecord(&record);
+    encodeCopied(&record, 0, 0);
+    CHECK(record.textLength == LOG_TEXT_CAPACITY);
+
+    printf("cost: marked literals=%.1fns/call copied arrays=%.1fns/call ratio=%.2f\n",
+           markedNanos, copiedNanos, copiedNanos / markedNanos);
+}
+
+int main() {
+    testLifetimes();
+    testCost();
+
+    return checkResult("async_log_test");
+}
@@ -0,0 +1,187 @@
+/*
+    BufferLayoutTest.cpp
+
+    * Round-trip test of the packed layout of SensorDataBuffer (see Buffer.h): the 16-bit
+    channels and the 32-bit timestamp offsets from the base of each block must give back the
+    samples written, as getTimestampMillis() rebuilds them.
+    * The clock of the sketch is simulated by the test (see Clock.h): it starts on the timeline
+    of the boot, as the ESP32 before its first sync, and jumps to the time since 1970 halfway.
+    * Cases: samples that roll over to the next blocks, a block started before the sync and
+    finished after it (its samples stay on the timeline of the boot and are converted once
+    read), timestamps that step back within a block, the full range of the channels, laps of
+    the ring, and the free-running indexes wrapping around 2^32.
+    * Usage: buffer_layout_test
+*/
+
+#include <cstdio>
+#include <vector>
+
+#include "AsyncLog.h"
+#include "Buffer.h"
+#include "Check.h"
+#include "Clock.h"
+#include "Errors.h"
+#include "Network.h"
+
+// Define the time of the sync, on the timeline of the boot and since 1970 (ms)
+const unsigned long long TEST_SYNC_BOOT_MILLIS = 600000;
+const unsigned long long TEST_SYNC_EPOCH_MILLIS = 1700000000000ULL;
+
+// Set the interval between two samples (ms)
+const unsigned long long TEST_INTERVAL_MILLIS = 500;
+
+// Define the globals of the sketch
+Errors errorHandler;
+AsyncLog asyncLog;
+
+static SensorDataBuffer dataBuffer;
+
+// Simulate the clock of the sketch: the time since the boot, and the offset of the time since
+// 1970, 0 until the sync
+static unsigned long long bootMillis = 0;
+static unsigned long long epochOffsetMillis = 0;
+
+unsigned long clockMicros() {
+    return bootMillis * 1000;
+}
+
+unsigned long clockMillis() {
+    return bootMillis;
+}
+
+unsigned long long clockEpochMillis() {
+    return bootMillis + epochOffsetMillis;
+}
+
+/**
+ * Struct of a sample written, and the time since the boot when it was taken
+ */
+struct expectedSample {
+    unsigned long long bootMillis;
+    uint16_t values[SENSOR_CHANNEL_COUNT];
+};
+
+static std::vector<expectedSample> written;
+static size_t readCount = 0;
+
+// Write a sample taken at the current time, as DataReader does, with values that cover the
+// full range of the channels
+static bool writeSample() {
+    sensorData* sample = dataBuffer.getNewSample(getCurrentMillisTimestamp());
+    if (sample == nullptr) {
+        return false;
+    }
+
+    expectedSample expected;
+    expected.bootMillis = bootMillis;
+    for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+        expected.values[i] = static_cast<uint16_t>(written.size() * 4099 + i * 5461);
+        sample->pressureSensor[i] = expected.values[i];
+    }
+    dataBuffer.commitNewSample();
+    written.push_back(expected);
+
+    return true;
+}
+
+static int writeSamples(int count) {
+    int accepted = 0;
+    for (int i = 0; i < count && writeSample(); i++) {
+        bootMillis += TEST_INTERVAL_MILLIS;
+        accepted++;
+    }
+
+    return accepted;
+}
+
+// Read the samples in batches and check them. Before the sync, the timestamps are the ones of
+// the boot, after it they are all converted to the time since 1970
+static void readSamples(int count, int batchSize) {
+    sensorDataSpan spans[2];
+    while (count > 0) {
+        int peeked = dataBuffer.peekSamples(spans, count < batchSize ? count : batchSize);
+        CHECK(peeked > 0);
+        if (peeked == 0) {
+            return;
+        }
+
+        for (int s = 0; s < 2; s++) {
+            for (int i = 0; i < spans[s].count; i++) {
+                const sensorData* sample = &spans[s].samples[i];
+                const expectedSample& expected = written[readCount++];
+                CHECK(dataBuffer.getTimestampMillis(sample)
+                      == expected.bootMillis + epochOffsetMillis);
+                CHECK(memcmp(sample->pressureSensor, expected.values,
+                             sizeof(expected.values)) == 0);
+            }
+        }
+        dataBuffer.commitSamples(peeked);
+        count -= peeked;
+    }
+}
+
+static void testSyncAcrossBlocks() {
+    // Before the sync, the samples roll over the first blocks, and some are read
+    bootMillis = 1000;
+    CHECK(writeSamples(BUFFER_BLOCK_SIZE + 20) == BUFFER_BLOCK_SIZE + 20);
+    readSamples(30, 7);
+    CHECK(!isClockSynced());
+
+    // The sync happens in the middle of the second block, which stays on the timeline of the
+    // boot, and the next block starts on the time since 1970
+    bootMillis = TEST_SYNC_BOOT_MILLIS;
+    epochOffsetMillis = TEST_SYNC_EPOCH_MILLIS - TEST_SYNC_BOOT_MILLIS;
+    CHECK(writeSamples(BUFFER_BLOCK_SIZE) == BUFFER_BLOCK_SIZE);
+    CHECK(isClockSynced());
+
+    // A small adjustment of the clock backwards, within a block
+    bootMillis -= 3 * TEST_INTERVAL_MILLIS / 2;
+    CHECK(writeSamples(10) == 10);
+
+    readSamples(dataBuffer.getBufferSize(), 16);
+    CHECK(dataBuffer.isBufferEmpty());
+}
+
+static void testLaps() {
+    // Fill the ring up to the block that the producer can't start yet, then go around it a few
+    // times in batches of sizes that don't divide the blocks
+    int accepted = writeSamples(BUFFER_CAPACITY);
+    CHECK(accepted > BUFFER_CAPACITY - BUFFER_BLOCK_SIZE && accepted <= BUFFER_CAPACITY);
+    CHECK(dataBuffer.getNewSample(getCurrentMillisTimestamp()) == nullptr);
+
+    for (int lap = 0; lap < 4 * BUFFER_CAPACITY / 100; lap++) {
+        readSamples(100, 46);
+        CHECK(writeSamples(100) > 0);
+    }
+    readSamples(dataBuffer.getBufferSize(), 46);
+    CHECK(dataBuffer.isBufferEmpty());
+}
+
+static void testIndexWraparound() {
+    // Move both indexes to a few blocks before 2^32, as after a long uptime
+    const uint32_t startIndex = 0 - 3 * BUFFER_BLOCK_SIZE;
+    dataBuffer.readIndex.store(startIndex);
+    dataBuffer.writeIndex.store(startIndex);
+    CHECK(dataBuffer.getBufferSize() == 0);
+
+    CHECK(writeSamples(5 * BUFFER_BLOCK_SIZE) == 5 * BUFFER_BLOCK_SIZE);
+    CHECK(dataBuffer.getBufferSize() == 5 * BUFFER_BLOCK_SIZE);
+    CHECK(dataBuffer.writeIndex.load() < dataBuffer.readIndex.load());
+
+    readSamples(BUFFER_BLOCK_SIZE + 1, 33);
+    CHECK(writeSamples(BUFFER_CAPACITY) > 0);
+    readSamples(dataBuffer.getBufferSize(), 46);
+    CHECK(dataBuffer.isBufferEmpty());
+}
+
+int main() {
+    testSyncAcrossBlocks();
+    testLaps();
+    testIndexWraparound();
+
+    CHECK(readCount == written.size());
+    printf("round trip: samples=%zu bytes/sample=%zu capacity=%d samples (%.1f minutes at 2 Hz)\n",
+           written.size(), sizeof(sensorData), BUFFER_CAPACITY, BUFFER_CAPACITY / 2 / 60.0);
+
+    return checkResult("buffer_layout_test");
+}
@@ -0,0 +1,146 @@
+/*
+    BufferStressTest.cpp
+
+    * Stress test of the single-producer/single-consumer ring of SensorDataBuffer (see Buffer.h):
+    a producer thread writes millions of samples as fast as the ring lets it, while a consumer
+    thread reads them, alternating single samples (getSample()) and batches of varying sizes
+    (peekSamples()), as DataReader and Database do on the two cores of the device.
+    * Each sample carries its sequence number in all its channels and in its timestamp, so the
+    consumer checks that every sample arrives once, in order, and whole (no sample read before
+    the producer finished writing it).
+    * It reports the samples moved per second and how often each side found the ring full or
+    empty.
+    * Usage: buffer_stress_test [SAMPLES]
+*/
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#include "AsyncLog.h"
+#include "Buffer.h"
+#include "Check.h"
+#include "Errors.h"
+
+// Set the default amount of samples moved through the ring
+const uint32_t TEST_SAMPLE_COUNT = 20000000;
+
+// Define the timestamp of the first sample, after the clock sync (ms)
+const unsigned long long TEST_FIRST_TIMESTAMP_MILLIS = 1700000000000ULL;
+
+// Define the globals of the sketch
+Errors errorHandler;
+AsyncLog asyncLog;
+
+static SensorDataBuffer dataBuffer;
+
+// Get the value of a channel of the sample of a sequence number
+static uint16_t getChannelValue(uint32_t sequence, int channel) {
+    return channel < 2 ? static_cast<uint16_t>(sequence >> (16 * channel))
+                       : static_cast<uint16_t>(sequence * (2 * channel + 1));
+}
+
+/**
+ * Struct of the counters of a side of the ring
+ */
+struct sideStats {
+    uint64_t waits = 0;
+    uint64_t mismatches = 0;
+    uint32_t firstMismatch = 0;
+};
+
+static void produce(uint32_t sampleCount, sideStats* stats) {
+    for (uint32_t sequence = 0; sequence < sampleCount; sequence++) {
+        sensorData* sample;
+        while ((sample = dataBuffer.getNewSample(TEST_FIRST_TIMESTAMP_MILLIS + sequence))
+                   == nullptr) {
+            stats->waits++;
+            std::this_thread::yield();
+        }
+
+        for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+            sample->pressureSensor[i] = getChannelValue(sequence, i);
+        }
+        dataBuffer.commitNewSample();
+    }
+}
+
+// Check a sample read by the consumer against the one expected next
+static void checkSample(const sensorData* sample, uint32_t sequence, sideStats* stats) {
+    bool valid = dataBuffer.getTimestampMillis(sample) == TEST_FIRST_TIMESTAMP_MILLIS + sequence;
+    for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+        valid = valid && sample->pressureSensor[i] == getChannelValue(sequence, i);
+    }
+
+    if (!valid && stats->mismatches++ == 0) {
+        stats->firstMismatch = sequence;
+    }
+}
+
+static void consume(uint32_t sampleCount, sideStats* stats) {
+    uint32_t sequence = 0;
+    int batchSize = 1;
+    sensorDataSpan spans[2];
+
+    while (sequence < sampleCount) {
+        // Alternate the single reads of the samples and the batches, of 1 to 64 samples
+        if (sequence % 7 == 0) {
+            const sensorData* sample = dataBuffer.getSample();
+            if (sample == nullptr) {
+                stats->waits++;
+                std::this_thread::yield();
+                continue;
+            }
+            checkSample(sample, sequence++, stats);
+            dataBuffer.releaseSample();
+            continue;
+        }
+
+        batchSize = batchSize % 64 + 1;
+        int count = dataBuffer.peekSamples(spans, batchSize);
+        if (count == 0) {
+            stats->waits++;
+            std::this_thread::yield();
+            continue;
+        }
+
+        for (int s = 0; s < 2; s++) {
+            for (int i = 0; i < spans[s].count; i++) {
+                checkSample(&spans[s].samples[i], sequence++, stats);
+            }
+        }
+        dataBuffer.commitSamples(count);
+    }
+}
+
+int main(int argc, char** argv) {
+    uint32_t sampleCount = argc > 1 ? strtoul(argv[1], nullptr, 10) : TEST_SAMPLE_COUNT;
+
+    sideStats producerStats;
+    sideStats consumerStats;
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread consumer(consume, sampleCount, &consumerStats);
+    std::thread producer(produce, sampleCount, &producerStats);
+    producer.join();
+    consumer.join();
+    double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+
+    CHECK(consumerStats.mismatches == 0);
+    if (consumerStats.mismatches > 0) {
+        fprintf(stderr, "%llu samples lost, duplicated or torn, the first at %u\n",
+                static_cast<unsigned long long>(consumerStats.mismatches),
+                consumerStats.firstMismatch);
+    }
+    CHECK(dataBuffer.isBufferEmpty());
+
+    printf("samples=%u elapsed=%.3fs throughput=%.1fM samples/s full=%llu empty=%llu\n",
+           sampleCount, seconds, sampleCount / seconds / 1e6,
+           static_cast<unsigned long long>(producerStats.waits),
+           static_cast<unsigned long long>(consumerStats.waits));
+
+    return checkResult("buffer_stress_test");
+}
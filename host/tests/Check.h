@@ -0,0 +1,46 @@
+/*
+    Check.h
+
+    * Checks of the host tests: a failed check prints its expression and its line, and the
+    test ends with a non-zero status if any check failed (see checkResult()).
+    * The checks can be used from several threads.
+*/
+
+#ifndef Check_H_
+#define Check_H_
+
+#include <atomic>
+#include <cstdio>
+
+// Count the checks that failed since the start of the test
+inline std::atomic<int>& checkFailures() {
+    static std::atomic<int> failures{0};
+    return failures;
+}
+
+#define CHECK(condition)                                                                     \
+    do {                                                                                     \
+        if (!(condition)) {                                                                  \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition);   \
+            checkFailures()++;                                                               \
+        }                                                                                    \
+    } while (0)
+
+/**
+ * Report the result of the test
+ *
+ * @param testName the name of the test
+ * @return the exit status of the test, 0 if every check passed
+ */
+inline int checkResult(const char* testName) {
+    int failures = checkFailures().load();
+    if (failures > 0) {
+        printf("%s: %d checks failed\n", testName, failures);
+        return 1;
+    }
+
+    printf("%s: passed\n", testName);
+    return 0;
+}
+
+#endif  // Check_H_
@@ -0,0 +1,222 @@
+/*
+    ConnectivityTest.cpp
+
+    * Test of Connectivity (see Connectivity.h) against a scripted network: the access point of
+    the WiFi shim (see hostSetWiFiAvailable()), the sync of the clock and the database go up and
+    down at set times, while the test runs the loop of the database task: an update, then a push
+    whenever one can be attempted, which works while the database is up.
+    * It checks the sequence of the states, the intervals between the reconnection attempts and
+    between the failed pushes, which double up to their caps and start over once connected, and
+    that no push is attempted while the WiFi network is disconnected or the clock is not synced.
+    * The clock of the sketch is simulated: it moves forward by a period of the loop at each
+    step, so the outages of minutes take no real time, and it is synced by the script.
+    * Usage: connectivity_test
+*/
+
+#include <cstdio>
+#include <vector>
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+#include "AsyncLog.h"
+#include "Check.h"
+#include "Clock.h"
+#include "Connectivity.h"
+#include "Errors.h"
+#include "Network.h"
+#include "Telemetry.h"
+
+// Set the period of the loop of the database task, in milliseconds (ms)
+const unsigned long TEST_STEP_MILLIS = 50;
+
+/**
+ * Struct of a step of the script of the network, from a time since the start of the test
+ */
+struct networkStep {
+    unsigned long atMillis;
+    bool accessPointUp;
+    bool clockSynced;
+    bool databaseUp;
+};
+
+// Boot without WiFi, then connect before the clock is synced, lose the WiFi for 5 minutes, then
+// the database for 2 minutes
+static const networkStep TEST_SCRIPT[] = {
+    {0, false, false, true},
+    {20000, true, false, true},
+    {35000, true, true, true},
+    {40000, false, true, true},
+    {340000, true, true, true},
+    {380000, true, true, false},
+    {500000, true, true, true},
+    {560000, true, true, true},
+};
+const int TEST_SCRIPT_STEPS = sizeof(TEST_SCRIPT) / sizeof(TEST_SCRIPT[0]);
+
+// Define the globals of the sketch
+Errors errorHandler;
+AsyncLog asyncLog;
+Telemetry telemetry;
+Connectivity connectivity;
+
+// Store the simulated time of the clock of the sketch, and whether the script synced it
+static unsigned long simulatedMillis = 0;
+static bool clockSyncedNow = false;
+
+unsigned long clockMicros() {
+    return simulatedMillis * 1000;
+}
+
+unsigned long clockMillis() {
+    return simulatedMillis;
+}
+
+unsigned long long clockEpochMillis() {
+    return clockSyncedNow ? CLOCK_SYNCED_EPOCH_MILLIS + clockMillis() : clockMillis();
+}
+
+/**
+ * Struct of what happened during the loop, with the times since the start of the test
+ */
+struct testRecord {
+    std::vector<ConnectivityState> states;
+    std::vector<unsigned long> reconnectMillis;
+    std::vector<unsigned long> failedPushMillis;
+    // Count the pushes, and the ones attempted without a network or a synced clock
+    int pushes = 0;
+    int pushesOffline = 0;
+};
+
+// Record the state if it changed
+static void recordState(testRecord* record) {
+    if (connectivity.getState() != record->states.back()) {
+        record->states.push_back(connectivity.getState());
+    }
+}
+
+// Run the loop of the database task over the script
+static testRecord runScript() {
+    testRecord record;
+    uint32_t producedSamples = 0;
+    int step = 0;
+
+    record.states.push_back(connectivity.getState());
+    for (unsigned long elapsed = 0; elapsed <= TEST_SCRIPT[TEST_SCRIPT_STEPS - 1].atMillis;
+         elapsed += TEST_STEP_MILLIS) {
+        if (step < TEST_SCRIPT_STEPS && elapsed >= TEST_SCRIPT[step].atMillis) {
+            hostSetWiFiAvailable(TEST_SCRIPT[step].accessPointUp);
+            clockSyncedNow = TEST_SCRIPT[step].clockSynced;
+            step++;
+        }
+        const networkStep& network = TEST_SCRIPT[step - 1];
+
+        uint32_t attempts = connectivity.getReconnectAttempts();
+        connectivity.update(++producedSamples);
+        if (connectivity.getReconnectAttempts() != attempts) {
+            record.reconnectMillis.push_back(elapsed);
+        }
+        recordState(&record);
+
+        if (connectivity.canPush()) {
+            record.pushes++;
+            if (WiFi.status() != WL_CONNECTED || !network.clockSynced) {
+                record.pushesOffline++;
+            }
+            if (!network.databaseUp) {
+                record.failedPushMillis.push_back(elapsed);
+            }
+            connectivity.reportPush(network.databaseUp);
+            recordState(&record);
+        }
+
+        simulatedMillis += TEST_STEP_MILLIS;
+    }
+
+    return record;
+}
+
+// Check that the intervals between the events from a time to another double from a first one
+// up to a cap, and get the amount of events
+static int checkBackoff(const std::vector<unsigned long>& eventMillis, unsigned long fromMillis,
+                        unsigned long toMillis, unsigned long firstMillis,
+                        unsigned long maxMillis) {
+    std::vector<unsigned long> intervals;
+    int events = 0;
+    unsigned long lastMillis = 0;
+    for (unsigned long millis : eventMillis) {
+        if (millis < fromMillis || millis > toMillis) {
+            continue;
+        }
+        if (events++ > 0) {
+            intervals.push_back(millis - lastMillis);
+        }
+        lastMillis = millis;
+    }
+
+    unsigned long expectedMillis = firstMillis;
+    for (unsigned long interval : intervals) {
+        CHECK(interval == expectedMillis);
+        if (interval != expectedMillis) {
+            fprintf(stderr, "Interval of %lu ms instead of %lu ms\n", interval, expectedMillis);
+        }
+        expectedMillis = min(expectedMillis * 2, maxMillis);
+    }
+
+    return events;
+}
+
+int main() {
+    hostSetSerialOutput(fopen("/dev/null", "w"));
+    hostSetWiFiAvailable(false);
+
+    connectivity.setup();
+    testRecord record = runScript();
+
+    // Offline until the WiFi is back, Degraded until the clock is synced, then Connected. The
+    // loss of the WiFi goes through Offline and Degraded again, the failed pushes only through
+    // Degraded
+    const std::vector<ConnectivityState> expectedStates = {
+        ConnectivityState::Offline, ConnectivityState::Degraded, ConnectivityState::Connected,
+        ConnectivityState::Offline, ConnectivityState::Degraded, ConnectivityState::Connected,
+        ConnectivityState::Degraded, ConnectivityState::Connected,
+    };
+    CHECK(record.states == expectedStates);
+
+    // The first attempt is a backoff after the boot. The first one of an outage is right away,
+    // as the backoff started over once connected. The last attempt of each outage connects
+    int bootAttempts = checkBackoff(record.reconnectMillis, 0, 35000,
+                                    WIFI_RECONNECT_BACKOFF_MIN_MILLIS,
+                                    WIFI_RECONNECT_BACKOFF_MAX_MILLIS);
+    CHECK(!record.reconnectMillis.empty()
+          && record.reconnectMillis[0] == WIFI_RECONNECT_BACKOFF_MIN_MILLIS);
+    int outageAttempts = checkBackoff(record.reconnectMillis, 40000, 380000,
+                                      WIFI_RECONNECT_BACKOFF_MIN_MILLIS,
+                                      WIFI_RECONNECT_BACKOFF_MAX_MILLIS);
+    CHECK(outageAttempts > 0 && record.reconnectMillis[bootAttempts] == 40000);
+    CHECK(record.reconnectMillis.back() > 340000);
+    CHECK(connectivity.getReconnectAttempts() == record.reconnectMillis.size());
+
+    // The outage of the WiFi reached the cap of the backoff
+    CHECK(record.reconnectMillis.back() - record.reconnectMillis[record.reconnectMillis.size() - 2]
+          == WIFI_RECONNECT_BACKOFF_MAX_MILLIS);
+
+    // The failed pushes back off from the first one, up to the cap, and the first retry after the
+    // database is back works
+    int failedPushes = checkBackoff(record.failedPushMillis, 0, 560000, PUSH_BACKOFF_MIN_MILLIS,
+                                    PUSH_BACKOFF_MAX_MILLIS);
+    CHECK(failedPushes > 1 && record.failedPushMillis[0] == 380000);
+    CHECK(record.failedPushMillis.back() - record.failedPushMillis[failedPushes - 2]
+          == PUSH_BACKOFF_MAX_MILLIS);
+    CHECK(500000 - record.failedPushMillis.back() <= PUSH_BACKOFF_MAX_MILLIS);
+
+    CHECK(record.pushesOffline == 0);
+    CHECK(connectivity.getOutageCount() == 2);
+
+    printf("states=%zu reconnections=%u (boot %d, outage %d) pushes=%d (failed %d, offline %d) "
+           "outages=%u (%llu ms)\n", record.states.size(), connectivity.getReconnectAttempts(),
+           bootAttempts, outageAttempts, record.pushes, failedPushes, record.pushesOffline,
+           connectivity.getOutageCount(), connectivity.getOutageMillis());
+
+    return checkResult("connectivity_test");
+}
@@ -0,0 +1,212 @@
+/*
+    ExternalAdcTest.cpp
+
+    * Test of the order of ExternalPressureSensors (see PressureSensors.h) against the emulated
+    ADS1115 of the Wire shim, whose conversions take the time of their data rate: the result of
+    the channel k must be read before the conversion of the channel k+1 is started, as the ADCs
+    have a single conversion register, and the result read must be the one of the channel k.
+    * The shim reports the starts, the ends and the reads of the conversions of each ADC (see
+    hostSetExternalAdcObserver()), so the test checks their exact sequence, and that each value
+    of a reading lands in the slot of its ADC and its channel.
+    * The readings are taken with the nominal conversion time, then with conversions slower than
+    their data rate (see hostSetExternalAdcDelay()), so that the driver has to poll the ADCs
+    until they are done, then with the task preempted for longer than a conversion right after
+    each start, so that the conversions started are done before the driver goes on.
+    * The waits of the test are skipped (see hostSetFastForward()).
+    * Usage: external_adc_test
+*/
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <Wire.h>
+
+#include "AsyncLog.h"
+#include "Check.h"
+#include "Clock.h"
+#include "Errors.h"
+#include "PressureSensors.h"
+#include "Telemetry.h"
+
+// Set the amount of readings taken in each case
+const int TEST_READING_COUNT = 50;
+
+// Set the time between two calls of advance(), as the acquisition task polls (us)
+const unsigned int TEST_POLL_MICROS = 100;
+
+// Set the time that the slow conversions take beyond their data rate (us)
+const unsigned long TEST_SLOW_DELAY_MICROS = 350;
+
+// Set the time that the task is preempted for after each start of a conversion (us)
+const unsigned long TEST_PREEMPTION_MICROS = 3 * CONVERSION_TIME_MICROS;
+
+// Define the globals of the sketch
+Errors errorHandler;
+AsyncLog asyncLog;
+Telemetry telemetry;
+
+static ExternalPressureSensors sensors;
+
+// Define the inputs in the order in which the driver converts them (see ExternalADCs.cpp)
+static const uint8_t TEST_INPUTS[EXTERNAL_ADC_CHANNEL_COUNT] = {3, 2, 1, 0};
+
+static std::vector<hostAdcEvent> events;
+static uint32_t conversionCount = 0;
+static unsigned long preemptionMicros = 0;
+
+// Give every conversion a distinct result, by ADC, by input and over time
+static int16_t readExternalAdc(uint8_t address, uint8_t input, void*) {
+    return 4000 * input + 1000 * (address - I2C_ADDRESS_1) + conversionCount++ % 500;
+}
+
+// Record the event, and preempt the task after the starts of the conversions
+static void recordEvent(const hostAdcEvent& event, void*) {
+    events.push_back(event);
+    if (event.type == HostAdcEvent::ConversionStarted && preemptionMicros > 0) {
+        delayMicroseconds(preemptionMicros);
+    }
+}
+
+// Scale a raw result as ExternalADCs does, to the range of the reads
+static uint16_t scaleResult(int16_t raw) {
+    long scaled = (static_cast<long>(raw) + 32768) * (2 * EXTERNAL_ADC_RESULT_RANGE) / 65535
+                  - EXTERNAL_ADC_RESULT_RANGE;
+    return scaled > 0 ? scaled : 0;
+}
+
+// Get the sequence of the events of an ADC, as a type and an input per event
+static std::string getSequence(uint8_t address) {
+    std::string sequence;
+    for (const hostAdcEvent& event : events) {
+        if (event.address != address) {
+            continue;
+        }
+        sequence += event.type == HostAdcEvent::ConversionStarted ? 'S'
+                    : event.type == HostAdcEvent::ConversionDone  ? 'D'
+                                                                  : 'R';
+        sequence += static_cast<char>('0' + event.input);
+    }
+
+    return sequence;
+}
+
+// Get the sequence expected from the order of the driver: each conversion is started, done and
+// read before the next one is started
+static std::string getExpectedSequence() {
+    std::string sequence;
+    for (int k = 0; k < EXTERNAL_ADC_CHANNEL_COUNT; k++) {
+        for (char type : {'S', 'D', 'R'}) {
+            sequence += type;
+            sequence += static_cast<char>('0' + TEST_INPUTS[k]);
+        }
+    }
+
+    return sequence;
+}
+
+// Take a reading as the registry does, advancing it until it completes, and get its duration
+static unsigned long takeReading(uint16_t* values) {
+    events.clear();
+    unsigned long startMicros = clockMicros();
+
+    bool complete = sensors.start(values);
+    for (int i = 0; !complete && i < 10000; i++) {
+        delayMicroseconds(TEST_POLL_MICROS);
+        complete = sensors.advance(values);
+    }
+    CHECK(complete);
+
+    return clockMicros() - startMicros;
+}
+
+// Check the order of the events of a reading, and the values that it gave
+static void checkReading(const uint16_t* values) {
+    const std::string expected = getExpectedSequence();
+
+    for (int a = 0; a < EXTERNAL_ADC_COUNT; a++) {
+        uint8_t address = I2C_ADDRESS_1 + a;
+        std::string sequence = getSequence(address);
+        CHECK(sequence == expected);
+        if (sequence != expected) {
+            fprintf(stderr, "ADC 0x%02X: %s instead of %s\n", address, sequence.c_str(),
+                    expected.c_str());
+        }
+
+        // Each result read is the one of the conversion of its channel, not of a later one
+        int16_t results[EXTERNAL_ADC_CHANNEL_COUNT] = {};
+        bool done[EXTERNAL_ADC_CHANNEL_COUNT] = {};
+        for (const hostAdcEvent& event : events) {
+            if (event.address != address) {
+                continue;
+            }
+            if (event.type == HostAdcEvent::ConversionDone) {
+                results[event.input] = event.value;
+                done[event.input] = true;
+            } else if (event.type == HostAdcEvent::ConversionRead) {
+                CHECK(done[event.input] && event.value == results[event.input]);
+            }
+        }
+
+        // The values are stored as pairs, one for each ADC, in the order of the channels
+        for (int k = 0; k < EXTERNAL_ADC_CHANNEL_COUNT; k++) {
+            CHECK(values[EXTERNAL_ADC_COUNT * k + a] == scaleResult(results[TEST_INPUTS[k]]));
+        }
+    }
+}
+
+// Take readings with conversions that take their time plus a delay, and the task preempted
+// after their starts, and get the average time and I2C transactions of a reading
+static void runCase(unsigned long delayMicros, unsigned long preemptMicros,
+                    double* readingMicros, double* transactions) {
+    hostSetExternalAdcDelay(delayMicros);
+    preemptionMicros = preemptMicros;
+
+    hostI2cStats before = hostGetI2cStats();
+    unsigned long totalMicros = 0;
+    for (int i = 0; i < TEST_READING_COUNT; i++) {
+        uint16_t values[EXTERNAL_ADC_COUNT * EXTERNAL_ADC_CHANNEL_COUNT] = {};
+        unsigned long micros = takeReading(values);
+        checkReading(values);
+
+        // A reading can't be faster than its conversions, one after the other
+        CHECK(micros >= EXTERNAL_ADC_CHANNEL_COUNT * (CONVERSION_TIME_MICROS + delayMicros));
+        totalMicros += micros;
+    }
+    hostI2cStats after = hostGetI2cStats();
+
+    *readingMicros = static_cast<double>(totalMicros) / TEST_READING_COUNT;
+    *transactions = static_cast<double>(after.transactions - before.transactions)
+                    / TEST_READING_COUNT;
+}
+
+int main() {
+    hostSetSerialOutput(fopen("/dev/null", "w"));
+    hostSetFastForward(true);
+    hostSetExternalAdcReader(readExternalAdc, nullptr);
+    hostSetExternalAdcObserver(recordEvent, nullptr);
+
+    CHECK(sensors.setup());
+
+    double nominalMicros, nominalTransactions;
+    runCase(0, 0, &nominalMicros, &nominalTransactions);
+
+    // The slow conversions aren't done at their nominal time, so the ADCs are polled again
+    double slowMicros, slowTransactions;
+    runCase(TEST_SLOW_DELAY_MICROS, 0, &slowMicros, &slowTransactions);
+    CHECK(slowTransactions > nominalTransactions);
+
+    // The conversions are done while the task is preempted, so the ADCs are polled only once,
+    // and the values must still land in the slots of their channels
+    double preemptedMicros, preemptedTransactions;
+    runCase(0, TEST_PREEMPTION_MICROS, &preemptedMicros, &preemptedTransactions);
+    CHECK(preemptedMicros >= EXTERNAL_ADC_CHANNEL_COUNT * TEST_PREEMPTION_MICROS);
+
+    printf("nominal: %.0fus/reading %.1f I2C transactions/reading, slow (+%luus/conversion): "
+           "%.0fus/reading %.1f I2C transactions/reading\n", nominalMicros, nominalTransactions,
+           TEST_SLOW_DELAY_MICROS, slowMicros, slowTransactions);
+    printf("preempted (%luus after each start): %.0fus/reading %.1f I2C transactions/reading\n",
+           TEST_PREEMPTION_MICROS, preemptedMicros, preemptedTransactions);
+
+    return checkResult("external_adc_test");
+}
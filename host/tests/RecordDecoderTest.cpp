@@ -0,0 +1,171 @@
+/*
+    RecordDecoderTest.cpp
+
+    * Test of the decoder of the records of the change filter on the side of the readers (see
+    host/consumer/RecordDecoder.h), against the forms in which the database returns them.
+    * Forms: keyframes, sparse objects, and the arrays with null holes that the database stores
+    instead of the sparse objects holding most of their channels (see toDatabaseForm()), plus
+    the records that must be refused.
+    * Round trip: a random walk with noise and steps goes through the ChangeFilter and the
+    JsonBatch of the sketch, in batches, and each record is stored in the form of the database.
+    Once decoded in order, every timestamp, including the skipped ones, must be within the
+    deadband of its channels from the sample it stands for.
+    * Usage: record_decoder_test
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "AsyncLog.h"
+#include "Check.h"
+#include "JsonBatch.h"
+#include "RecordDecoder.h"
+#include "RtdbEmulator.h"
+#include "Sensors.h"
+
+// Define the timestamp of the first sample, and the interval between two samples (ms)
+const unsigned long long TEST_FIRST_TIMESTAMP_MILLIS = 1700000000000ULL;
+const unsigned long long TEST_INTERVAL_MILLIS = 20;
+
+// Set the amount of samples of the round trip and of the samples per batch
+const int TEST_SAMPLE_COUNT = 20000;
+const int TEST_BATCH_SIZE = 40;
+
+// Define the globals of the sketch
+AsyncLog asyncLog;
+
+static void testForms() {
+    uint16_t channelMask;
+    uint16_t values[SENSOR_CHANNEL_COUNT];
+
+    CHECK(RecordDecoder::parseRecord("[1,2,3,4,5,6,7,8,9,10,11,12]", &channelMask, values));
+    CHECK(channelMask == CHANNEL_MASK_ALL && values[0] == 1 && values[11] == 12);
+
+    CHECK(RecordDecoder::parseRecord("{\"3\":7,\"11\":4095}", &channelMask, values));
+    CHECK(channelMask == ((1 << 3) | (1 << 11)) && values[3] == 7 && values[11] == 4095);
+
+    // The holes and the channels after the last one aren't carried
+    CHECK(RecordDecoder::parseRecord("[1, null, 3]", &channelMask, values));
+    CHECK(channelMask == 0x5 && values[0] == 1 && values[2] == 3);
+
+    const char* invalidRecords[] = {
+        "[]", "{}", "[null]", "[1,2,3,4,5,6,7,8,9,10,11,12,13]", "{\"12\":1}", "{\"03\":1}",
+        "{\"a\":1}", "[70000]", "{\"3\":-1}", "{\"3\":1.5}", "\"3\"", "[1,2",
+    };
+    for (const char* record : invalidRecords) {
+        CHECK(!RecordDecoder::parseRecord(record, &channelMask, values));
+    }
+
+    // The database keeps the sparse objects holding up to half of their indexes
+    CHECK(toDatabaseForm("{\"0\":1,\"2\":3}") == "[1,null,3]");
+    CHECK(toDatabaseForm("{\"1\":1,\"0\":2}") == "[2,1]");
+    CHECK(toDatabaseForm("{\"0\":1,\"3\":3}") == "{\"0\":1,\"3\":3}");
+    CHECK(toDatabaseForm("{\"5\":1}") == "{\"5\":1}");
+    CHECK(toDatabaseForm("{\"0\":1,\"x\":3}") == "{\"0\":1,\"x\":3}");
+    CHECK(toDatabaseForm("[1,2]") == "[1,2]");
+
+    // A record is refused without changing the values
+    RecordDecoder decoder;
+    CHECK(decoder.apply("{\"3\":7}"));
+    CHECK(!decoder.hasKeyframe());
+    CHECK(!decoder.apply("{\"3\":\"x\"}"));
+    CHECK(decoder.getValues()[3] == 7);
+}
+
+static void testRoundTrip() {
+    std::mt19937 random(7);
+    std::normal_distribution<double> noise(0, 4);
+    std::uniform_int_distribution<int> level(0, 4095);
+    std::uniform_real_distribution<double> chance(0, 1);
+
+    // Each channel holds a level, with noise around it, and jumps to another one once in a while
+    std::vector<sensorData> samples(TEST_SAMPLE_COUNT);
+    int levels[SENSOR_CHANNEL_COUNT];
+    for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+        levels[i] = level(random);
+    }
+    for (sensorData& sample : samples) {
+        for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+            if (chance(random) < 0.002) {
+                levels[i] = level(random);
+            }
+            int value = levels[i] + static_cast<int>(noise(random));
+            sample.pressureSensor[i] = value < 0 ? 0 : (value > 4095 ? 4095 : value);
+        }
+    }
+
+    // Filter and serialize the samples in batches, as Database does, and store each record in
+    // the form of the database
+    ChangeFilter changeFilter;
+    JsonBatch jsonBatch;
+    std::map<std::string, std::string> records;
+    for (int first = 0; first < TEST_SAMPLE_COUNT; first += TEST_BATCH_SIZE) {
+        changeFilter.begin();
+        jsonBatch.clear();
+        for (int i = first; i < first + TEST_BATCH_SIZE && i < TEST_SAMPLE_COUNT; i++) {
+            unsigned long long timestampMillis = TEST_FIRST_TIMESTAMP_MILLIS
+                                                 + i * TEST_INTERVAL_MILLIS;
+            uint16_t channelMask = changeFilter.filter(timestampMillis, &samples[i]);
+            if (channelMask != 0) {
+                CHECK(jsonBatch.appendSample(timestampMillis, &samples[i], nullptr, channelMask));
+            }
+        }
+        changeFilter.commit();
+
+        std::map<std::string, std::string> members;
+        CHECK(jsonBatch.getSampleCount() == 0 || splitJsonObject(jsonBatch.getBody(), &members));
+        for (const auto& member : members) {
+            records[member.first] = toDatabaseForm(member.second);
+        }
+    }
+
+    int keyframes = 0;
+    int sparseObjects = 0;
+    int sparseArrays = 0;
+    for (const auto& record : records) {
+        uint16_t channelMask;
+        uint16_t values[SENSOR_CHANNEL_COUNT];
+        CHECK(RecordDecoder::parseRecord(record.second, &channelMask, values));
+        if (channelMask == CHANNEL_MASK_ALL) {
+            keyframes++;
+        } else if (record.second[0] == '[') {
+            sparseArrays++;
+        } else {
+            sparseObjects++;
+        }
+    }
+    CHECK(keyframes > 0 && sparseObjects > 0 && sparseArrays > 0);
+
+    // Decode the records in the order of the timestamps, holding the values between them
+    RecordDecoder decoder;
+    int maxError = 0;
+    for (int i = 0; i < TEST_SAMPLE_COUNT; i++) {
+        std::string key = std::to_string(TEST_FIRST_TIMESTAMP_MILLIS + i * TEST_INTERVAL_MILLIS);
+        auto record = records.find(key);
+        if (record != records.end()) {
+            CHECK(decoder.apply(record->second));
+        }
+
+        CHECK(decoder.hasKeyframe());
+        for (int c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+            int error = abs(decoder.getValues()[c] - samples[i].pressureSensor[c]);
+            CHECK(error <= Sensors::getDeadband(c));
+            maxError = error > maxError ? error : maxError;
+        }
+    }
+
+    printf("round trip: samples=%d records=%zu keyframes=%d sparse objects=%d sparse arrays=%d "
+           "largest error=%d counts\n", TEST_SAMPLE_COUNT, records.size(), keyframes,
+           sparseObjects, sparseArrays, maxError);
+}
+
+int main() {
+    testForms();
+    testRoundTrip();
+
+    return checkResult("record_decoder_test");
+}
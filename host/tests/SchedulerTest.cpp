@@ -0,0 +1,138 @@
+/*
+    SchedulerTest.cpp
+
+    * Test of the accounting of SampleScheduler (see Scheduler.h): the ticks handled, the ticks
+    missed while the task was busy and the lateness of the wakeups, against the work done
+    between the ticks.
+    * The timer and the waits run on the simulated time of the shims (see hostSetFastForward()),
+    so a tick is never late by itself, and the work of the task is a wait of a known duration.
+    The clock of the sketch is this time moved by an offset (see Clock.h), so that it wraps
+    around during a late wakeup, as the 32-bit microseconds of the ESP32 do every 71 minutes.
+    * First, the work always ends before the next tick: no tick is missed and the wakeups are on
+    time. Then, some of the work overruns: by more than an interval, so that the next wakeup is
+    late, and by more than three, so that two ticks are missed and the next wakeup is late too.
+    * Usage: scheduler_test
+*/
+
+#include <cstdio>
+
+#include <Arduino.h>
+
+#include "AsyncLog.h"
+#include "Check.h"
+#include "Clock.h"
+#include "DataReader.h"
+#include "Errors.h"
+#include "Scheduler.h"
+
+// Set the rate of the ticks, as the one of the data collection (Hz)
+const int TEST_RATE = SAMPLE_RATE * OVERSAMPLING_RATIO;
+const unsigned long TEST_INTERVAL_MICROS = 1e6 / TEST_RATE;
+
+// Set the amount of ticks handled in each phase of the test
+const int TEST_PHASE_TICKS = 100;
+
+// Set the work done after most ticks, and the overruns of the second phase, every 10 ticks, in
+// intervals. The work never ends right on a tick, so that the ticks pending when it ends don't
+// depend on the real time that the test takes
+const double TEST_WORK_INTERVALS = 0.3;
+const double TEST_LATE_WORK_INTERVALS = 1.25;
+const double TEST_MISSED_WORK_INTERVALS = 3.5;
+
+// Set the lateness tolerated on each wakeup, for the real time that the test itself takes (us)
+const unsigned long TEST_TOLERANCE_MICROS = 1000;
+
+// Define the globals of the sketch
+Errors errorHandler;
+AsyncLog asyncLog;
+
+static SampleScheduler scheduler;
+
+// Offset of the clock of the sketch from the simulated time of the shims
+static unsigned long clockOffsetMicros = 0;
+
+unsigned long clockMicros() {
+    return micros() + clockOffsetMicros;
+}
+
+unsigned long clockMillis() {
+    return clockMicros() / 1000;
+}
+
+unsigned long long clockEpochMillis() {
+    return clockMillis();
+}
+
+// Handle a tick, then work for a number of intervals
+static void handleTick(double workIntervals) {
+    CHECK(scheduler.waitForTick());
+    delayMicroseconds(workIntervals * TEST_INTERVAL_MICROS);
+}
+
+static void testOnTime() {
+    for (int i = 0; i < TEST_PHASE_TICKS; i++) {
+        handleTick(TEST_WORK_INTERVALS);
+    }
+
+    CHECK(scheduler.getTickCount() == TEST_PHASE_TICKS);
+    CHECK(scheduler.getMissedTicks() == 0);
+    CHECK(scheduler.getMaxJitterMicros() < TEST_TOLERANCE_MICROS);
+}
+
+static void testOverruns() {
+    // The clock of the sketch wraps around during the first late wakeup
+    CHECK(clockMicros() > 0UL - 5 * TEST_INTERVAL_MICROS);
+
+    int lateWakeups = 0;
+    int missedWakeups = 0;
+    for (int i = 0; i < TEST_PHASE_TICKS; i++) {
+        double workIntervals = TEST_WORK_INTERVALS;
+        if (i % 10 == 2) {
+            workIntervals = TEST_LATE_WORK_INTERVALS;
+            lateWakeups++;
+        } else if (i % 10 == 7) {
+            workIntervals = TEST_MISSED_WORK_INTERVALS;
+            missedWakeups++;
+        }
+        handleTick(workIntervals);
+    }
+    // The wakeup after the last overrun is counted too
+    CHECK(scheduler.waitForTick());
+
+    // An overrun of 1.25 intervals finds a single tick pending, a quarter of an interval late.
+    // One of 3.5 intervals finds 3, the 2 oldest are missed and the wakeup is half an interval
+    // late. The deadlines stay on the ticks, so the next wakeup is on time again
+    CHECK(scheduler.getTickCount() == 2 * TEST_PHASE_TICKS + 1);
+    CHECK(scheduler.getMissedTicks() == 2 * static_cast<uint32_t>(missedWakeups));
+
+    unsigned long maxJitterMicros = (TEST_MISSED_WORK_INTERVALS - 3) * TEST_INTERVAL_MICROS;
+    CHECK(scheduler.getMaxJitterMicros() >= maxJitterMicros);
+    CHECK(scheduler.getMaxJitterMicros() < maxJitterMicros + TEST_TOLERANCE_MICROS);
+
+    double totalJitterMicros = (lateWakeups * (TEST_LATE_WORK_INTERVALS - 1)
+                                + missedWakeups * (TEST_MISSED_WORK_INTERVALS - 3))
+                               * TEST_INTERVAL_MICROS;
+    unsigned long meanJitterMicros = totalJitterMicros / scheduler.getTickCount();
+    CHECK(scheduler.getMeanJitterMicros() + 1 >= meanJitterMicros);
+    CHECK(scheduler.getMeanJitterMicros() < meanJitterMicros + TEST_TOLERANCE_MICROS);
+}
+
+int main() {
+    hostSetSerialOutput(fopen("/dev/null", "w"));
+    hostSetFastForward(true);
+
+    // Wrap the clock of the sketch around between the tick of the first late wakeup, the 104th,
+    // and the wakeup itself, so that the lateness is measured across the wrap
+    clockOffsetMicros = 0UL - micros() - (TEST_PHASE_TICKS + 4) * TEST_INTERVAL_MICROS
+                        - TEST_INTERVAL_MICROS / 8;
+
+    CHECK(scheduler.setup(TEST_RATE));
+    testOnTime();
+    testOverruns();
+
+    printf("ticks=%u missed=%u jitter mean=%luus max=%luus (interval %luus)\n",
+           scheduler.getTickCount(), scheduler.getMissedTicks(), scheduler.getMeanJitterMicros(),
+           scheduler.getMaxJitterMicros(), TEST_INTERVAL_MICROS);
+
+    return checkResult("scheduler_test");
+}
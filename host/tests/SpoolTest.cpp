@@ -0,0 +1,261 @@
+/*
+    SpoolTest.cpp
+
+    * Test of the flash spool (see Spool.h) on the file-backed flash of the LittleFS shim (see
+    host/shims/LittleFS.h), in a temporary directory.
+    * Throughput: fills most of the spool in bursts flushed like the spills of Database, then
+    reads it back in batches, checking the order and the values of every record. It reports
+    the records/s of both directions and the flash traffic per record.
+    * Torn write: cuts the power in the middle of a record and corrupts a record of an older
+    segment, then reboots. Every record before them must be read back, in order, with the
+    newer segments, and the appends must go on in a new segment.
+    * Full spool: while a batch of the oldest segment is in flight, the spool must refuse the
+    appends instead of dropping that segment, so that no record is released without being sent.
+    * Usage: spool_test
+*/
+
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <LittleFS.h>
+
+#include "AsyncLog.h"
+#include "Check.h"
+#include "Database.h"
+#include "Spool.h"
+
+namespace fs = std::filesystem;
+
+// Define the timestamp of the first record, and the interval between two records (ms)
+const unsigned long long TEST_FIRST_TIMESTAMP_MILLIS = 1700000000000ULL;
+const unsigned long long TEST_INTERVAL_MILLIS = 500;
+
+// Define the globals of the sketch
+AsyncLog asyncLog;
+
+static fs::path testRoot;
+
+static spoolRecord batch[BATCH_SIZE_MAX];
+
+// Build the sample of the record of the given sequence number
+static sensorData makeSample(uint32_t sequence) {
+    sensorData sample;
+    for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+        sample.pressureSensor[i] = (sequence * 31 + i * 7) & 0x0FFF;
+    }
+    return sample;
+}
+
+static unsigned long long getTimestampMillis(uint32_t sequence) {
+    return TEST_FIRST_TIMESTAMP_MILLIS + sequence * TEST_INTERVAL_MILLIS;
+}
+
+// Check that a record read back is the one of the given sequence number
+static bool isRecord(const spoolRecord& record, uint32_t sequence) {
+    sensorData expected = makeSample(sequence);
+    return record.timestampMillis == getTimestampMillis(sequence)
+           && memcmp(record.sample.pressureSensor, expected.pressureSensor,
+                     sizeof(expected.pressureSensor)) == 0;
+}
+
+static bool appendRecord(Spool* spool, uint32_t sequence) {
+    sensorData sample = makeSample(sequence);
+    return spool->append(getTimestampMillis(sequence), &sample);
+}
+
+// Start each case on an empty flash
+static void eraseFlash() {
+    std::error_code error;
+    fs::remove_all(testRoot, error);
+    fs::create_directories(testRoot);
+}
+
+// Add the sequence numbers of a range of records to the ones expected
+static void expectRange(std::vector<uint32_t>* expected, uint32_t first, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        expected->push_back(first + i);
+    }
+}
+
+// Read and release the records until the spool is empty, checking that they are the expected
+// ones, in order
+static void drainSpool(Spool* spool, const std::vector<uint32_t>& expected) {
+    size_t total = 0;
+    while (true) {
+        int count = spool->read(batch, BATCH_SIZE_MAX);
+        if (count == 0) {
+            break;
+        }
+
+        for (int i = 0; i < count && total + i < expected.size(); i++) {
+            CHECK(isRecord(batch[i], expected[total + i]));
+        }
+        spool->commit(count);
+        total += count;
+    }
+
+    CHECK(total == expected.size());
+    CHECK(spool->isEmpty());
+}
+
+static void testThroughput() {
+    eraseFlash();
+    Spool spool;
+    CHECK(spool.setup());
+
+    const uint32_t recordCount = SPOOL_SEGMENT_RECORDS * (SPOOL_MAX_SEGMENTS - 2);
+    hostLittleFSStats statsBefore = hostGetLittleFSStats();
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t sequence = 0; sequence < recordCount; sequence++) {
+        CHECK(appendRecord(&spool, sequence));
+        if ((sequence + 1) % SPOOL_SPILL_BATCH_SIZE == 0) {
+            spool.flush();
+        }
+    }
+    spool.flush();
+    double appendSeconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    hostLittleFSStats statsAppended = hostGetLittleFSStats();
+
+    std::vector<uint32_t> expected;
+    expectRange(&expected, 0, recordCount);
+
+    start = std::chrono::steady_clock::now();
+    drainSpool(&spool, expected);
+    double readSeconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    hostLittleFSStats statsRead = hostGetLittleFSStats();
+
+    CHECK(spool.getDroppedRecords() == 0);
+
+    double megabytes = recordCount * sizeof(spoolRecord) / 1e6;
+    printf("throughput: records=%u append=%.0f records/s (%.1f MB/s) read=%.0f records/s "
+           "(%.1f MB/s)\n", recordCount, recordCount / appendSeconds, megabytes / appendSeconds,
+           recordCount / readSeconds, megabytes / readSeconds);
+    printf("flash: written=%.1f bytes/record read=%.1f bytes/record flushes=%llu "
+           "segments created=%llu removed=%llu\n",
+           static_cast<double>(statsAppended.bytesWritten - statsBefore.bytesWritten)
+               / recordCount,
+           static_cast<double>(statsRead.bytesRead - statsAppended.bytesRead) / recordCount,
+           static_cast<unsigned long long>(statsAppended.flushes - statsBefore.flushes),
+           static_cast<unsigned long long>(statsRead.filesCreated - statsBefore.filesCreated),
+           static_cast<unsigned long long>(statsRead.filesRemoved - statsBefore.filesRemoved));
+}
+
+static void testTornWrite() {
+    eraseFlash();
+
+    // The first segment is full and the second one takes the next records, until the power is
+    // cut in the middle of the record 1034
+    const uint32_t tornSequence = SPOOL_SEGMENT_RECORDS + 10;
+    const uint32_t corruptedSequence = 500;
+    {
+        Spool spool;
+        CHECK(spool.setup());
+        for (uint32_t sequence = 0; sequence < tornSequence; sequence++) {
+            CHECK(appendRecord(&spool, sequence));
+        }
+        spool.flush();
+
+        hostSetLittleFSPowerLoss(sizeof(spoolRecord) / 2);
+        CHECK(!appendRecord(&spool, tornSequence));
+        CHECK(!appendRecord(&spool, tornSequence + 1));
+    }
+    hostRestoreLittleFSPower();
+
+    // A record of the first segment is also corrupted, like a page of the flash going bad
+    std::string segmentPath = (testRoot / "spool" / "0000000000").string();
+    FILE* segment = fopen(segmentPath.c_str(), "r+b");
+    CHECK(segment != nullptr);
+    if (segment != nullptr) {
+        fseek(segment, corruptedSequence * sizeof(spoolRecord) + 10, SEEK_SET);
+        int byte = fgetc(segment);
+        fseek(segment, corruptedSequence * sizeof(spoolRecord) + 10, SEEK_SET);
+        fputc(byte ^ 0x01, segment);
+        fclose(segment);
+    }
+
+    // After the reboot, the first segment ends before the corrupted record and the second one
+    // before the torn record, and the new records follow them
+    Spool spool;
+    CHECK(spool.setup());
+    const uint32_t rebootSequence = 2 * SPOOL_SEGMENT_RECORDS;
+    for (uint32_t sequence = rebootSequence; sequence < rebootSequence + 100; sequence++) {
+        CHECK(appendRecord(&spool, sequence));
+    }
+    spool.flush();
+
+    std::vector<uint32_t> expected;
+    expectRange(&expected, 0, corruptedSequence);
+    expectRange(&expected, SPOOL_SEGMENT_RECORDS, tornSequence - SPOOL_SEGMENT_RECORDS);
+    expectRange(&expected, rebootSequence, 100);
+    drainSpool(&spool, expected);
+
+    printf("torn write: recovered %u records before the corrupted one, %u before the torn one "
+           "and 100 appended after the reboot\n", corruptedSequence,
+           tornSequence - SPOOL_SEGMENT_RECORDS);
+}
+
+static void testFullSpoolInFlight() {
+    eraseFlash();
+    Spool spool;
+    CHECK(spool.setup());
+
+    const uint32_t capacity = SPOOL_SEGMENT_RECORDS * SPOOL_MAX_SEGMENTS;
+    uint32_t sequence = 0;
+    for (; sequence < capacity; sequence++) {
+        CHECK(appendRecord(&spool, sequence));
+    }
+    spool.flush();
+
+    // A batch of the oldest segment is in flight, so the spool is full until it is released
+    const int batchSize = 20;
+    CHECK(spool.read(batch, batchSize) == batchSize);
+    CHECK(isRecord(batch[0], 0));
+    CHECK(!appendRecord(&spool, sequence));
+    CHECK(spool.getDroppedRecords() == 0);
+
+    // A dropped batch is read again, and the next batch can be in flight at the same time
+    spool.rewind(batchSize);
+    CHECK(spool.read(batch, batchSize) == batchSize);
+    CHECK(isRecord(batch[0], 0));
+    CHECK(spool.read(batch, batchSize) == batchSize);
+    CHECK(isRecord(batch[0], batchSize));
+    CHECK(!appendRecord(&spool, sequence));
+
+    // Once sent, the records are released and the next ones follow them, without any loss
+    spool.commit(2 * batchSize);
+    CHECK(spool.read(batch, batchSize) == batchSize);
+    CHECK(isRecord(batch[0], 2 * batchSize));
+    spool.commit(batchSize);
+
+    // Without any record in flight, the oldest segment is dropped to make room
+    CHECK(appendRecord(&spool, sequence));
+    CHECK(spool.getDroppedRecords() == SPOOL_SEGMENT_RECORDS - 3 * batchSize);
+    CHECK(spool.read(batch, batchSize) == batchSize);
+    CHECK(isRecord(batch[0], SPOOL_SEGMENT_RECORDS));
+
+    printf("full spool: appends refused while records were in flight, %u records dropped "
+           "once they were released\n", spool.getDroppedRecords());
+}
+
+int main() {
+    testRoot = fs::temp_directory_path() / ("spool_test_" + std::to_string(getpid()));
+    hostSetLittleFSRoot(testRoot.c_str());
+
+    testThroughput();
+    testTornWrite();
+    testFullSpoolInFlight();
+
+    std::error_code error;
+    fs::remove_all(testRoot, error);
+
+    return checkResult("spool_test");
+}
@@ -0,0 +1,359 @@
+/*
+    StreamTransportTest.cpp
+
+    * Test of the stream transport (see StreamTransport.h), through Database built with
+    DATABASE_TRANSPORT set to TRANSPORT_STREAM: a backlog of samples, then a few more, are sent
+    by the loop of the encode stage to a collector server run by the test, which keeps every
+    byte received.
+    * The bytes are decoded afterwards: a hello frame with the version, the amount of channels
+    and the MAC of the device, then batch frames whose lengths match their sample counts, with
+    every sample written, once and in order, with its timestamp and all its channels.
+    * The boot log and the telemetry still go through Firebase, to an RTDB emulator (see
+    host/emulator). The client of the transport is redirected to the collector (see
+    hostSetClientAddress()).
+    * It reports the frames per second and the bytes per sample of the stream, next to the
+    bytes per sample of the JSON bodies of the Firebase transport for the same batches.
+    * Usage: stream_transport_test
+*/
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <LittleFS.h>
+#include <WiFi.h>
+
+#include "AsyncLog.h"
+#include "Buffer.h"
+#include "Check.h"
+#include "Clock.h"
+#include "Connectivity.h"
+#include "Database.h"
+#include "Errors.h"
+#include "JsonBatch.h"
+#include "RtdbEmulator.h"
+#include "Stages.h"
+#include "StreamTransport.h"
+#include "Telemetry.h"
+
+static_assert(DATABASE_TRANSPORT == TRANSPORT_STREAM, "The test needs the stream transport");
+
+namespace fs = std::filesystem;
+
+// Set the backlog written at once, then the samples written afterwards, sent by the interval
+const int TEST_BACKLOG_SAMPLES = 20 * BATCH_SIZE_MAX;
+const int TEST_TAIL_SAMPLES = 7;
+
+// Define the MAC of the device, sent in the hello frame
+const uint64_t TEST_MAC = 0x0000a1b2c3d4e5f6ULL;
+
+// Set the longest time given to the samples to reach the collector, in real time (s)
+const int TEST_TIMEOUT_SECONDS = 20;
+
+// Define the globals of the sketch
+Errors errorHandler;
+AsyncLog asyncLog;
+Telemetry telemetry;
+Connectivity connectivity;
+StageMonitor stageMonitor;
+
+static SensorDataBuffer dataBuffer;
+static Database database;
+
+/**
+ * Struct of a sample written, as the collector must receive it
+ */
+struct expectedSample {
+    unsigned long long timestampMillis;
+    uint16_t values[SENSOR_CHANNEL_COUNT];
+};
+
+static std::vector<expectedSample> written;
+
+/**
+ * Struct of the collector server: a listening socket, and the bytes received from its
+ * connections
+ */
+struct collectorServer {
+    int listenSocket = -1;
+    uint16_t port = 0;
+    std::thread thread;
+
+    std::mutex mutex;
+    std::vector<uint8_t> received;
+    int connections = 0;
+};
+
+static collectorServer collector;
+
+// Accept the connections one after the other and keep their bytes, until the socket is closed
+static void runCollector() {
+    while (true) {
+        int connection = accept(collector.listenSocket, nullptr, nullptr);
+        if (connection < 0) {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(collector.mutex);
+            collector.connections++;
+        }
+
+        uint8_t data[4096];
+        ssize_t length;
+        while ((length = recv(connection, data, sizeof(data), 0)) > 0) {
+            std::lock_guard<std::mutex> lock(collector.mutex);
+            collector.received.insert(collector.received.end(), data, data + length);
+        }
+        close(connection);
+    }
+}
+
+static bool startCollector() {
+    collector.listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addressLength = sizeof(address);
+
+    if (bind(collector.listenSocket, reinterpret_cast<sockaddr*>(&address), addressLength) != 0
+            || listen(collector.listenSocket, 4) != 0
+            || getsockname(collector.listenSocket, reinterpret_cast<sockaddr*>(&address),
+                           &addressLength) != 0) {
+        return false;
+    }
+
+    collector.port = ntohs(address.sin_port);
+    collector.thread = std::thread(runCollector);
+    return true;
+}
+
+// Write samples to the buffer, with distinct timestamps in the past and values that all change
+static void writeSamples(int count) {
+    unsigned long long timestampMillis = clockEpochMillis() - 500ULL * count;
+    if (!written.empty() && timestampMillis <= written.back().timestampMillis) {
+        timestampMillis = written.back().timestampMillis + 1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        expectedSample expected;
+        expected.timestampMillis = timestampMillis + 500ULL * i;
+
+        sensorData* sample = dataBuffer.getNewSample(expected.timestampMillis);
+        CHECK(sample != nullptr);
+        if (sample == nullptr) {
+            return;
+        }
+        for (int c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+            expected.values[c] = 1 + (written.size() * 397 + c * 1000) % 4000;
+            sample->pressureSensor[c] = expected.values[c];
+        }
+        dataBuffer.commitNewSample();
+        written.push_back(expected);
+    }
+}
+
+// Run the loop of the encode stage until the buffer is empty
+static bool drainBuffer() {
+    auto deadline = std::chrono::steady_clock::now()
+                    + std::chrono::seconds(TEST_TIMEOUT_SECONDS);
+    while (!dataBuffer.isBufferEmpty()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        database.sendData(&dataBuffer);
+        vTaskDelay(ENCODE_STAGE_INTERVAL_MILLIS);
+    }
+
+    return true;
+}
+
+// Read a little-endian unsigned integer from the bytes received
+static uint64_t readLittleEndian(const uint8_t* position, int size) {
+    uint64_t value = 0;
+    for (int i = 0; i < size; i++) {
+        value |= static_cast<uint64_t>(position[i]) << (8 * i);
+    }
+
+    return value;
+}
+
+/**
+ * Struct of the result of the decoding of the stream
+ */
+struct streamSummary {
+    int batchFrames = 0;
+    // Frames with samples of the backlog
+    int backlogFrames = 0;
+    size_t decodedSamples = 0;
+    bool valid = false;
+};
+
+// Decode the frames received and check them against the samples written
+static streamSummary decodeStream(const std::vector<uint8_t>& stream) {
+    streamSummary summary;
+    size_t position = 0;
+    bool hello = false;
+
+    while (position + STREAM_FRAME_HEADER_SIZE <= stream.size()) {
+        const uint8_t* frame = &stream[position];
+        uint32_t length = readLittleEndian(frame, 4);
+        if (position + 4 + length > stream.size() || length < 1) {
+            return summary;
+        }
+        uint8_t type = frame[4];
+        const uint8_t* body = frame + STREAM_FRAME_HEADER_SIZE;
+        position += 4 + length;
+
+        // The hello frame comes first on the connection, then only batches
+        if (!hello) {
+            if (type != STREAM_FRAME_HELLO || length != 1 + 2 + 6
+                    || body[0] != STREAM_PROTOCOL_VERSION || body[1] != SENSOR_CHANNEL_COUNT
+                    || readLittleEndian(body + 2, 6) != TEST_MAC) {
+                return summary;
+            }
+            hello = true;
+            continue;
+        }
+
+        uint32_t count = readLittleEndian(body, 2);
+        if (type != STREAM_FRAME_BATCH || count < 1 || count > BATCH_SIZE_MAX
+                || length != 1 + STREAM_BATCH_HEADER_SIZE + count * STREAM_SAMPLE_SIZE) {
+            return summary;
+        }
+        if (summary.decodedSamples < TEST_BACKLOG_SAMPLES) {
+            summary.backlogFrames++;
+        }
+
+        const uint8_t* sample = body + STREAM_BATCH_HEADER_SIZE;
+        for (uint32_t i = 0; i < count; i++, sample += STREAM_SAMPLE_SIZE) {
+            if (summary.decodedSamples >= written.size()) {
+                return summary;
+            }
+            const expectedSample& expected = written[summary.decodedSamples++];
+            if (readLittleEndian(sample, 8) != expected.timestampMillis) {
+                return summary;
+            }
+            for (int c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+                if (readLittleEndian(sample + 8 + 2 * c, 2) != expected.values[c]) {
+                    return summary;
+                }
+            }
+        }
+        summary.batchFrames++;
+    }
+
+    summary.valid = hello && position == stream.size();
+    return summary;
+}
+
+// Get the bytes per sample of the JSON bodies of the Firebase transport, for the same batches
+static double getJsonBytesPerSample(int batchFrames) {
+    static JsonBatch jsonBatch;
+    size_t bytes = 0;
+    int batchSize = (written.size() + batchFrames - 1) / batchFrames;
+
+    for (size_t first = 0; first < written.size(); first += batchSize) {
+        jsonBatch.clear();
+        for (size_t i = first; i < written.size() && i < first + batchSize; i++) {
+            sensorData sample;
+            memcpy(sample.pressureSensor, written[i].values, sizeof(written[i].values));
+            jsonBatch.appendSample(written[i].timestampMillis, &sample, nullptr,
+                                   CHANNEL_MASK_ALL);
+        }
+        bytes += jsonBatch.getLength();
+    }
+
+    return static_cast<double>(bytes) / written.size();
+}
+
+int main() {
+    fs::path testRoot = fs::temp_directory_path()
+                        / ("stream_transport_test_" + std::to_string(getpid()));
+    fs::create_directories(testRoot);
+    hostSetLittleFSRoot((testRoot / "littlefs").c_str());
+    hostSetSerialOutput(fopen("/dev/null", "w"));
+    hostSetEfuseMac(TEST_MAC);
+
+    if (!startCollector()) {
+        perror("Could not start the collector");
+        return 1;
+    }
+    hostSetClientAddress("127.0.0.1", collector.port);
+
+    emulatorConfig config;
+    config.port = 0;
+    RtdbEmulator emulator(config);
+    if (!emulator.start()) {
+        perror("Could not start the emulator");
+        return 1;
+    }
+    char address[32];
+    snprintf(address, sizeof(address), "127.0.0.1:%u", emulator.getPort());
+    setenv("FIREBASE_DATABASE_EMULATOR_HOST", address, 1);
+    setenv("FIREBASE_DATABASE_NAMESPACE", "stream", 1);
+
+    asyncLog.setup();
+    connectivity.setup();
+    database.setup();
+
+    // A backlog goes in full batches, as fast as the connection takes them, then the last
+    // samples go by the send interval
+    auto start = std::chrono::steady_clock::now();
+    writeSamples(TEST_BACKLOG_SAMPLES);
+    CHECK(drainBuffer());
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+                         .count();
+    writeSamples(TEST_TAIL_SAMPLES);
+    CHECK(drainBuffer());
+
+    // The samples are released once written to the connection, so the collector may still be
+    // reading the last ones
+    std::vector<uint8_t> stream;
+    streamSummary summary;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    do {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        {
+            std::lock_guard<std::mutex> lock(collector.mutex);
+            stream = collector.received;
+        }
+        summary = decodeStream(stream);
+    } while (summary.decodedSamples < written.size()
+             && std::chrono::steady_clock::now() < deadline);
+
+    CHECK(summary.valid);
+    CHECK(summary.decodedSamples == written.size());
+    CHECK(collector.connections == 1);
+
+    double streamBytesPerSample = static_cast<double>(stream.size()) / written.size();
+    printf("samples=%zu frames=%d (%.0f samples/frame) connections=%d\n", written.size(),
+           summary.batchFrames, static_cast<double>(written.size()) / summary.batchFrames,
+           collector.connections);
+    printf("stream: %.0f frames/s %.0f samples/s over the backlog, %.1f bytes/sample; "
+           "Firebase: %.1f bytes/sample of JSON body, without the HTTP headers\n",
+           summary.backlogFrames / seconds, TEST_BACKLOG_SAMPLES / seconds, streamBytesPerSample,
+           getJsonBytesPerSample(summary.batchFrames));
+
+    shutdown(collector.listenSocket, SHUT_RDWR);
+    close(collector.listenSocket);
+    emulator.stop();
+    std::error_code error;
+    fs::remove_all(testRoot, error);
+
+    // The log task and the collector are still running, so the process ends without the
+    // destructors
+    int result = checkResult("stream_transport_test");
+    fflush(stdout);
+    _exit(result);
+}
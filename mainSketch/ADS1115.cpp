@@ -0,0 +1,78 @@
+#include "ADS1115.h"
+#include "Clock.h"
+
+bool ADS1115::writeRegister(uint8_t reg, uint16_t value) {
+    unsigned long startMicros = clockMicros();
+
+    wire->beginTransmission(address);
+    wire->write(reg);
+    wire->write(static_cast<uint8_t>(value >> 8));
+    wire->write(static_cast<uint8_t>(value & 0xFF));
+    bool written = wire->endTransmission() == 0;
+
+    // After a failed transaction, the register addressed by the ADC is unknown
+    pointer = written ? reg : -1;
+    busMicros += clockMicros() - startMicros;
+    return written;
+}
+
+bool ADS1115::readRegister(uint8_t reg, uint16_t* value) {
+    unsigned long startMicros = clockMicros();
+    bool read = true;
+
+    if (pointer != reg) {
+        wire->beginTransmission(address);
+        wire->write(reg);
+        read = wire->endTransmission() == 0;
+        pointer = read ? reg : -1;
+    }
+
+    if (read && wire->requestFrom(address, static_cast<uint8_t>(2)) == 2) {
+        uint8_t high = wire->read();
+        *value = (static_cast<uint16_t>(high) << 8) | static_cast<uint8_t>(wire->read());
+    } else {
+        read = false;
+    }
+
+    busMicros += clockMicros() - startMicros;
+    return read;
+}
+
+bool ADS1115::setup(TwoWire& i2c, uint8_t i2cAddress, uint16_t configuration) {
+    wire = &i2c;
+    address = i2cAddress;
+    config = configuration & ~(ADS1115_CONFIG_START | ADS1115_CONFIG_MUX_MASK);
+    pointer = -1;
+
+    // Writing the configuration, without starting a conversion, checks that the ADC answers
+    return writeRegister(ADS1115_REGISTER_CONFIG, config | ADS1115_CONFIG_MUX_GND);
+}
+
+bool ADS1115::startConversion(uint8_t input) {
+    uint16_t mux = ADS1115_CONFIG_MUX_GND | (static_cast<uint16_t>(input & 0x03) << 12);
+    return writeRegister(ADS1115_REGISTER_CONFIG, config | mux | ADS1115_CONFIG_START);
+}
+
+bool ADS1115::isBusy() {
+    uint16_t value;
+    if (!readRegister(ADS1115_REGISTER_CONFIG, &value)) {
+        return true;
+    }
+
+    return (value & ADS1115_CONFIG_READY) == 0;
+}
+
+int16_t ADS1115::readConversion() {
+    uint16_t value;
+    if (!readRegister(ADS1115_REGISTER_CONVERSION, &value)) {
+        return 0;
+    }
+
+    return static_cast<int16_t>(value);
+}
+
+unsigned long ADS1115::takeBusMicros() {
+    unsigned long micros = busMicros;
+    busMicros = 0;
+    return micros;
+}
@@ -0,0 +1,109 @@
+/*
+    ADS1115.h
+
+    * This module drives an ADS1115 ADC directly through its registers, in place of a general
+    purpose library, to keep the I2C traffic of each conversion to the minimum.
+    * The config register is cached, so a conversion is started by writing the input and the
+    start bit in a single transaction, without reading the register first.
+    * The pointer register is cached too: the ADC keeps the last register addressed, so the
+    config register can be polled and the conversion register read without addressing them
+    again when they were the last one used.
+    * The time spent on the bus is accumulated, to be reported per sample.
+*/
+
+#ifndef ADS1115_H_
+#define ADS1115_H_
+
+#include <Arduino.h>
+#include <Wire.h>
+
+// Define the registers of the ADS1115
+const uint8_t ADS1115_REGISTER_CONVERSION = 0x00;
+const uint8_t ADS1115_REGISTER_CONFIG = 0x01;
+
+// Define the fields of the config register
+const uint16_t ADS1115_CONFIG_START = 0x8000;         // OS: start a single conversion
+const uint16_t ADS1115_CONFIG_READY = 0x8000;         // OS: no conversion in progress
+const uint16_t ADS1115_CONFIG_MUX_MASK = 0x7000;
+const uint16_t ADS1115_CONFIG_MUX_GND = 0x4000;       // MUX: input 0 against GND
+const uint16_t ADS1115_CONFIG_RANGE_4096 = 0x0200;    // PGA: +-4.096 V
+const uint16_t ADS1115_CONFIG_SINGLE_SHOT = 0x0100;   // MODE: power down between conversions
+const uint16_t ADS1115_CONFIG_RATE_860_SPS = 0x00E0;  // DR: 860 samples per second
+const uint16_t ADS1115_CONFIG_COMPARATOR_OFF = 0x0003;
+
+/**
+ * Class that drives an ADS1115 in single-shot mode, one input against GND at a time
+ */
+class ADS1115 {
+    TwoWire* wire = nullptr;
+    uint8_t address = 0;
+
+    // Store the config register without the input and the start bit
+    uint16_t config = 0;
+    // Store the register addressed by the pointer register, unknown until the first access
+    int pointer = -1;
+
+    // Accumulate the time spent on the bus, in microseconds (us)
+    unsigned long busMicros = 0;
+
+    /**
+     * Write a register in a single transaction, which also addresses it
+     *
+     * @param reg the register to be written
+     * @param value the value to be written
+     * @return true if the ADC acknowledged the transaction, false otherwise
+     */
+    bool writeRegister(uint8_t reg, uint16_t value);
+
+    /**
+     * Read a register, addressing it first only if it isn't already
+     *
+     * @param reg the register to be read
+     * @param value where the value is stored
+     * @return true if the register was read, false otherwise
+     */
+    bool readRegister(uint8_t reg, uint16_t* value);
+
+public:
+
+    /**
+     * Check that the ADC answers and write its configuration
+     *
+     * @param i2c the I2C bus of the ADC, already started
+     * @param i2cAddress the address of the ADC
+     * @param configuration the config register, without the input and the start bit
+     * @return true if the ADC was configured, false otherwise
+     */
+    bool setup(TwoWire& i2c, uint8_t i2cAddress, uint16_t configuration);
+
+    /**
+     * Start a single conversion of an input against GND
+     *
+     * @param input the input to be converted, from 0 to 3
+     * @return true if the conversion was started, false otherwise
+     */
+    bool startConversion(uint8_t input);
+
+    /**
+     * Check if a conversion is still in progress
+     *
+     * @return true if the conversion isn't done yet, or if the ADC couldn't be read
+     */
+    bool isBusy();
+
+    /**
+     * Read the result of the last conversion done
+     *
+     * @return the raw result of the conversion, or 0 if the ADC couldn't be read
+     */
+    int16_t readConversion();
+
+    /**
+     * Get the time spent on the bus since the last call, and start accumulating it again
+     *
+     * @return the time spent on the bus, in microseconds (us)
+     */
+    unsigned long takeBusMicros();
+};
+
+#endif  // ADS1115_H_
@@ -0,0 +1,128 @@
+#include "AsyncLog.h"
+#include "Debug.h"
+
+AsyncLog::AsyncLog() {
+    // Slot i is free for the producer that reserves the position i
+    for (uint32_t i = 0; i < LOG_RING_CAPACITY; i++) {
+        ring[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+void AsyncLog::setup() {
+    // The task runs at the idle priority, so it only prints while the other tasks are waiting
+    xTaskCreatePinnedToCore(
+        writerTask,              // Task function
+        "asyncLogWriter",        // Name of task
+        4096,                    // Stack size of task
+        this,                    // Parameter of the task
+        tskIDLE_PRIORITY,        // Priority of the task
+        NULL,                    // Task handle
+        tskNO_AFFINITY);         // Let the task run on any core
+}
+
+logRecord* AsyncLog::reserve(uint8_t level, bool newline) {
+    uint32_t position = enqueuePosition.load(std::memory_order_relaxed);
+
+    // Bounded MPMC ring: claim the position with a CAS, retrying if another producer won it
+    while (true) {
+        logRecord* record = &ring[position & (LOG_RING_CAPACITY - 1)];
+        uint32_t sequence = record->sequence.load(std::memory_order_acquire);
+        int32_t difference = static_cast<int32_t>(sequence - position);
+
+        if (difference == 0) {
+            if (enqueuePosition.compare_exchange_weak(position, position + 1,
+                                                      std::memory_order_relaxed)) {
+                record->level = level;
+                record->newline = newline;
+                record->argCount = 0;
+                record->textLength = 0;
+                return record;
+            }
+        } else if (difference < 0) {
+            // The writer didn't release this slot yet, so the ring is full
+            droppedRecords.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        } else {
+            position = enqueuePosition.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void AsyncLog::publish(logRecord* record) {
+    uint32_t position = record->sequence.load(std::memory_order_relaxed);
+    record->sequence.store(position + 1, std::memory_order_release);
+}
+
+void AsyncLog::drain() {
+    uint32_t dropped = droppedRecords.load(std::memory_order_relaxed);
+    if (dropped != reportedDroppedRecords) {
+        Serial.print(debugLevelLabels[DEBUG_LEVEL_WARNING]);
+        Serial.print(": Dropped ");
+        Serial.print(dropped - reportedDroppedRecords);
+        Serial.println(" log records");
+        reportedDroppedRecords = dropped;
+    }
+
+    while (true) {
+        logRecord* record = &ring[dequeuePosition & (LOG_RING_CAPACITY - 1)];
+
+        // Stop at the first slot that is still free or being filled by a producer
+        if (record->sequence.load(std::memory_order_acquire) != dequeuePosition + 1) {
+            return;
+        }
+
+        writeRecord(record);
+
+        // Hand the slot back to the producers for the next lap of the ring
+        record->sequence.store(dequeuePosition + LOG_RING_CAPACITY, std::memory_order_release);
+        dequeuePosition++;
+    }
+}
+
+void AsyncLog::writeRecord(const logRecord* record) const {
+    Serial.print(debugLevelLabels[record->level]);
+    Serial.print(": ");
+
+    for (int i = 0; i < record->argCount; i++) {
+        const logArgValue* value = &record->values[i];
+
+        switch (record->types[i]) {
+            case LogArgType::Signed:
+                Serial.print(value->signedValue);
+                break;
+            case LogArgType::Unsigned:
+                Serial.print(value->unsignedValue);
+                break;
+            case LogArgType::Float:
+                Serial.print(value->floatValue);
+                break;
+            case LogArgType::Literal:
+                Serial.print(value->literal);
+                break;
+            case LogArgType::Text:
+                Serial.write(reinterpret_cast<const uint8_t*>(record->text + value->text.offset),
+                             value->text.length);
+                break;
+            case LogArgType::Address:
+                Serial.print(IPAddress(value->address));
+                break;
+        }
+    }
+
+    if (record->newline) {
+        Serial.println();
+    }
+}
+
+uint32_t AsyncLog::getDroppedRecords() const {
+    return droppedRecords.load(std::memory_order_relaxed);
+}
+
+void AsyncLog::writerTask(void* parameter) {
+    AsyncLog* log = static_cast<AsyncLog*>(parameter);
+
+    while (true) {
+        log->drain();
+        vTaskDelay(pdMS_TO_TICKS(LOG_WRITER_INTERVAL_MILLIS));
+    }
+}
@@ -0,0 +1,211 @@
+/*
+    AsyncLog.h
+
+    * This module takes the Serial printing off the hot paths of the sketch. The Log* macros of
+    Debug.h only encode their arguments into a compact binary record of a lock-free ring, and a
+    low-priority task formats and writes the records to the Serial port.
+    * String literals marked with the _log suffix ("Connected"_log) are stored as pointers (they
+    live in flash for the whole execution), so they work as the format ids of the records. The
+    other strings, char arrays included, are copied into the text area of the record, as they
+    may not outlive the call.
+    * When the ring is full the record is dropped and counted, so logging never blocks the caller.
+*/
+
+#ifndef AsyncLog_H_
+#define AsyncLog_H_
+
+#include <Arduino.h>
+#include <atomic>
+#include <type_traits>
+
+// Define the amount of records of the ring (must be a power of two to mask the indexes)
+const uint32_t LOG_RING_CAPACITY = 64;
+static_assert((LOG_RING_CAPACITY & (LOG_RING_CAPACITY - 1)) == 0,
+              "LOG_RING_CAPACITY must be a power of two");
+
+// Define the maximum amount of arguments of a record (the extra ones are ignored)
+const int LOG_MAX_ARGS = 10;
+
+// Define the capacity of the area where the non-literal strings of a record are copied, in bytes
+const int LOG_TEXT_CAPACITY = 48;
+
+// Set the interval between the checks of the writer task for new records, in milliseconds (ms)
+const int LOG_WRITER_INTERVAL_MILLIS = 10;
+
+/**
+ * Enumerate the types of the arguments stored in a record
+ *
+ * Signed/Unsigned/Float: numbers, widened to 64 bits
+ * Literal: pointer to a string literal
+ * Text: string copied into the text area of the record (offset and length)
+ * Address: IPv4 address
+ */
+enum class LogArgType : uint8_t {
+    Signed,
+    Unsigned,
+    Float,
+    Literal,
+    Text,
+    Address
+};
+
+/**
+ * Struct of a string literal passed to the log, built by the _log suffix only from literals
+ */
+struct logLiteral {
+    const char* value;
+};
+
+/**
+ * Mark a string literal to be stored as a pointer in the records, instead of being copied
+ */
+constexpr logLiteral operator"" _log(const char* value, size_t) {
+    return logLiteral{value};
+}
+
+union logArgValue {
+    long long signedValue;
+    unsigned long long unsignedValue;
+    double floatValue;
+    const char* literal;
+    struct {
+        uint8_t offset;
+        uint8_t length;
+    } text;
+    uint32_t address;
+};
+
+struct logRecord {
+    // Sequence of the slot in the ring, it tells whether the slot is free or published
+    std::atomic<uint32_t> sequence;
+    uint8_t level;
+    bool newline;
+    uint8_t argCount;
+    uint8_t textLength;
+    LogArgType types[LOG_MAX_ARGS];
+    logArgValue values[LOG_MAX_ARGS];
+    char text[LOG_TEXT_CAPACITY];
+};
+
+class AsyncLog {
+private:
+    logRecord ring[LOG_RING_CAPACITY];
+
+    // Free-running positions of the producers and of the writer task
+    std::atomic<uint32_t> enqueuePosition{0};
+    uint32_t dequeuePosition = 0;
+
+    std::atomic<uint32_t> droppedRecords{0};
+    uint32_t reportedDroppedRecords = 0;
+
+    void writeRecord(const logRecord* record) const;
+
+    static void writerTask(void* parameter);
+
+public:
+    AsyncLog();
+
+    // Start the task that formats and writes the records
+    void setup();
+
+    // Reserve a slot of the ring, or return nullptr (and count the drop) if the ring is full
+    logRecord* reserve(uint8_t level, bool newline);
+
+    // Publish a reserved slot to the writer task
+    void publish(logRecord* record);
+
+    // Write all the published records to the Serial port
+    void drain();
+
+    uint32_t getDroppedRecords() const;
+};
+
+extern AsyncLog asyncLog;
+
+// The encoders below pick the type of each argument at compile time, so the callers only copy
+// the raw values. Only the literals marked with _log are stored as pointers
+
+inline void logEncodeText(logRecord* record, const char* value, size_t maxLength) {
+    size_t available = LOG_TEXT_CAPACITY - record->textLength;
+    int length = strnlen(value, maxLength < available ? maxLength : available);
+    logArgValue* arg = &record->values[record->argCount];
+
+    arg->text.offset = record->textLength;
+    arg->text.length = length;
+    memcpy(record->text + record->textLength, value, length);
+
+    record->textLength += length;
+    record->types[record->argCount++] = LogArgType::Text;
+}
+
+inline void logEncode(logRecord* record, const logLiteral& value) {
+    record->values[record->argCount].literal = value.value;
+    record->types[record->argCount++] = LogArgType::Literal;
+}
+
+// A char array may be a local or a member of a temporary, so it is copied, up to its size
+template <size_t N>
+inline void logEncode(logRecord* record, const char (&value)[N]) {
+    logEncodeText(record, value, N);
+}
+
+template <typename T>
+inline typename std::enable_if<std::is_same<T, const char*>::value ||
+                               std::is_same<T, char*>::value>::type
+logEncode(logRecord* record, const T& value) {
+    logEncodeText(record, value, LOG_TEXT_CAPACITY);
+}
+
+inline void logEncode(logRecord* record, const String& value) {
+    logEncodeText(record, value.c_str(), LOG_TEXT_CAPACITY);
+}
+
+inline void logEncode(logRecord* record, const IPAddress& value) {
+    record->values[record->argCount].address = static_cast<uint32_t>(value);
+    record->types[record->argCount++] = LogArgType::Address;
+}
+
+template <typename T>
+inline typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type
+logEncode(logRecord* record, T value) {
+    record->values[record->argCount].signedValue = value;
+    record->types[record->argCount++] = LogArgType::Signed;
+}
+
+template <typename T>
+inline typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type
+logEncode(logRecord* record, T value) {
+    record->values[record->argCount].unsignedValue = value;
+    record->types[record->argCount++] = LogArgType::Unsigned;
+}
+
+template <typename T>
+inline typename std::enable_if<std::is_floating_point<T>::value>::type
+logEncode(logRecord* record, T value) {
+    record->values[record->argCount].floatValue = value;
+    record->types[record->argCount++] = LogArgType::Float;
+}
+
+inline void logEncodeArgs(logRecord*) {
+}
+
+template <typename T, typename... Args>
+inline void logEncodeArgs(logRecord* record, T&& value, Args&&... args) {
+    if (record->argCount < LOG_MAX_ARGS) {
+        logEncode(record, value);
+        logEncodeArgs(record, args...);
+    }
+}
+
+template <typename... Args>
+void logRecordArgs(uint8_t level, bool newline, Args&&... args) {
+    logRecord* record = asyncLog.reserve(level, newline);
+    if (record == nullptr) {
+        return;
+    }
+
+    logEncodeArgs(record, args...);
+    asyncLog.publish(record);
+}
+
+#endif // AsyncLog_H_
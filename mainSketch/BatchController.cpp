@@ -0,0 +1,28 @@
+#include "BatchController.h"
+
+int BatchController::getBatchSize() const {
+    return batchSize;
+}
+
+void BatchController::setFixedBatchSize(int size) {
+    batchSize = min(max(size, BATCH_SIZE_MIN), BATCH_SIZE_MAX);
+    adaptive = false;
+}
+
+void BatchController::update(bool sent, unsigned long pushMicros, int backlog) {
+    if (!adaptive) {
+        return;
+    }
+
+    // Back off quickly when the connection struggles, so the following pushes get through
+    if (!sent || pushMicros > BATCH_SLOW_PUSH_MICROS) {
+        batchSize = max(batchSize / 2, BATCH_SIZE_MIN);
+        return;
+    }
+
+    // Only grow while the samples back up. In steady state, the batches are sent by the send
+    // interval before they get full, so their size doesn't matter
+    if (backlog > batchSize) {
+        batchSize = min(batchSize + BATCH_SIZE_INCREMENT, BATCH_SIZE_MAX);
+    }
+}
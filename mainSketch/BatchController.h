@@ -0,0 +1,62 @@
+/*
+    BatchController.h
+
+    * This module adapts the size of the batches sent to the database to the backlog of the
+    buffer and to the measured push latency (AIMD: additive increase, multiplicative decrease).
+    * While the samples back up and the pushes are fast, the batches grow by a few samples at a
+    time, so a backlog drains faster than the steady-state rate. When a push fails or slows
+    down, the size is halved to relieve the connection.
+    * The size always stays within the memory reserved for the serialized body of a batch.
+*/
+
+#ifndef BatchController_H_
+#define BatchController_H_
+
+#include "JsonBatch.h"
+#include "StreamTransport.h"
+
+// Set the size of the batches in steady state, also the smallest one, in samples
+const int BATCH_SIZE_MIN = 10;
+// Define the largest batch, the one whose worst case serialization fills the JSON body
+const int BATCH_SIZE_MAX = JSON_BATCH_CAPACITY / JSON_MAX_SAMPLE_SIZE;
+static_assert(BATCH_SIZE_MAX >= BATCH_SIZE_MIN, "The JSON body can't hold the smallest batch");
+static_assert(BATCH_SIZE_MAX <= STREAM_MAX_BATCH_SAMPLES, "The stream frame can't hold a batch");
+
+// Set the amount of samples added to the batch size after a fast push with a backlog
+const int BATCH_SIZE_INCREMENT = 4;
+
+// Set the push latency above which the batch size is halved, in microseconds (us)
+const unsigned long BATCH_SLOW_PUSH_MICROS = 500000;
+
+/**
+ * Class that adapts the batch size to the backlog and to the push latency
+ */
+class BatchController {
+    // Current size of the batches, in samples
+    int batchSize = BATCH_SIZE_MIN;
+    // Store whether the size adapts to the pushes, or stays at the one set
+    bool adaptive = true;
+
+public:
+    /**
+     * Set a fixed size of the batches, that the pushes don't change anymore
+     * @param size The size of the batches, from BATCH_SIZE_MIN to BATCH_SIZE_MAX samples
+     */
+    void setFixedBatchSize(int size);
+
+    /**
+     * Get the current size of the batches
+     * @return The current size of the batches, in samples
+     */
+    int getBatchSize() const;
+
+    /**
+     * Adapt the batch size to the result of a push
+     * @param sent Whether the push succeeded
+     * @param pushMicros The duration of the push, in microseconds
+     * @param backlog The amount of samples still waiting to be sent
+     */
+    void update(bool sent, unsigned long pushMicros, int backlog);
+};
+
+#endif  // BatchController_H_
@@ -1,13 +1,13 @@
 #include "Buffer.h"
-#include "Errors.h"
+#include "Network.h"
 #include "Debug.h"
 
 bool SensorDataBuffer::isBufferEmpty() const {
-    return bufferSize == 0;
+    return getBufferSize() == 0;
 }
 
 bool SensorDataBuffer::isBufferFull() const {
-    return bufferSize >= BUFFER_CAPACITY;
+    return getBufferSize() >= BUFFER_CAPACITY;
 }
 
 int SensorDataBuffer::getBufferCapacity() const {
@@ -15,128 +15,122 @@ int SensorDataBuffer::getBufferCapacity() const {
 }
 
 int SensorDataBuffer::getBufferSize() const {
-    return bufferSize;
+    // The acquire loads pair with the release stores of the other side, so the slots counted
+    // here are guaranteed to be fully written (or fully read)
+    uint32_t read = readIndex.load(std::memory_order_acquire);
+    uint32_t write = writeIndex.load(std::memory_order_acquire);
+
+    // The unsigned subtraction stays correct when the free-running indexes wrap around
+    return static_cast<int>(write - read);
 }
 
 int SensorDataBuffer::getReadIndex() const {
-    return readIndex;
+    return readIndex.load(std::memory_order_relaxed) & BUFFER_INDEX_MASK;
 }
 
 int SensorDataBuffer::getWriteIndex() const {
-    return writeIndex;
-}
-
-void SensorDataBuffer::moveReadIndexForward() {
-    readIndex = (readIndex + 1) % BUFFER_CAPACITY;
-    bufferSize--;
+    return writeIndex.load(std::memory_order_relaxed) & BUFFER_INDEX_MASK;
 }
 
-void SensorDataBuffer::moveReadIndexBackward() {
-    readIndex = (readIndex - 1 + BUFFER_CAPACITY) % BUFFER_CAPACITY;
-    bufferSize++;
+void SensorDataBuffer::moveReadIndexForward(int count) {
+    uint32_t read = readIndex.load(std::memory_order_relaxed);
+    readIndex.store(read + count, std::memory_order_release);
 }
 
 void SensorDataBuffer::moveWriteIndexForward() {
-    writeIndex = (writeIndex + 1) % BUFFER_CAPACITY;
-    bufferSize++;
-}
-
-void SensorDataBuffer::moveWriteIndexBackward() {
-    writeIndex = (writeIndex - 1 + BUFFER_CAPACITY) % BUFFER_CAPACITY;
-    bufferSize--;
+    uint32_t write = writeIndex.load(std::memory_order_relaxed);
+    writeIndex.store(write + 1, std::memory_order_release);
 }
 
-time_t SensorDataBuffer::getCurrentSampleSeconds() const {
-    return buffer[readIndex].timestampMillis / 1000ULL;
-}
+unsigned long long SensorDataBuffer::getTimestampMillis(const sensorData* sample) const {
+    int block = (sample - buffer) / BUFFER_BLOCK_SIZE;
 
-void SensorDataBuffer::computeCurrentSampleDate(char* sampleDate) {
-    // Get the next sample from the buffer
-    time_t sampleTimestampSec = getCurrentSampleSeconds();
-    // Get the time information from the time_t object
-    localtime_r(&sampleTimestampSec, &timeInfo);
-    // Convert the struct tm to a formatted string like "YYYY-MM-DD\0"
-    strftime(sampleDate, 11, "%F", &timeInfo);
-}
-
-void SensorDataBuffer::computeNextDaySeconds() {
-    time_t sampleTimestampSec = getCurrentSampleSeconds();
-    // Get the time info of the next day
-    sampleTimestampSec += 24 * 60 * 60;
-    localtime_r(&sampleTimestampSec, &timeInfo);
-    // Set the time info to the start of the day
-    timeInfo.tm_hour = 0;
-    timeInfo.tm_min = 0;
-    timeInfo.tm_sec = 0;
-
-    // Convert back to time_t and save it
-    nextDay = mktime(&timeInfo);
-}
-
-bool SensorDataBuffer::hasDateChanged() {
-    // Compare the current timestamp with the timestamp of the next day
-    return getCurrentSampleSeconds() >= nextDay;
+    // The blocks started before the clock sync are on the timeline of the boot
+    return toEpochMillis(blockBaseMillis[block] + sample->timestampOffsetMillis);
 }
 
 bool SensorDataBuffer::isSampleNull(const sensorData* sample) const {
-    // Check if we have some non null data in the sample struct
-    for (int i = 0; i < PRESSURE_SENSOR_COUNT; i++) {
-        if (sample->pressureSensor[i] != 0) {
-            return false;
-        }
-    }
-
     // Return true if all the sample data is null
-    return true;
+    return Sensors::isNull(sample->pressureSensor);
 }
 
-const sensorData* SensorDataBuffer::getSample() {
+const sensorData* SensorDataBuffer::getSample() const {
     // If the buffer is empty
     if (isBufferEmpty()) {
         // Return nullptr if the sample was not retrieved from the buffer
         return nullptr;
     }
 
-    // Get the next sample from the buffer
-    const sensorData* ptrSample = &buffer[readIndex];
+    // Get the next sample from the buffer. The read index only moves forward when the
+    // sample is released, so the producer can't overwrite it while it is being used
+    return &buffer[getReadIndex()];
+}
 
-    // Move the read index to the next sample
+void SensorDataBuffer::releaseSample() {
     moveReadIndexForward();
+}
 
-    // Return the sample if it was retrieved from the buffer
-    return ptrSample;
+int SensorDataBuffer::peekSamples(sensorDataSpan spans[2], int maxCount, int skip) const {
+    int count = max(min(getBufferSize() - skip, maxCount), 0);
+    int start = (getReadIndex() + skip) & BUFFER_INDEX_MASK;
+
+    // The first span goes from the read index up to the end of the array, at most
+    int firstCount = min(count, BUFFER_CAPACITY - start);
+    spans[0].samples = &buffer[start];
+    spans[0].count = firstCount;
+
+    // The remaining samples, if any, wrapped around to the start of the array
+    spans[1].samples = &buffer[0];
+    spans[1].count = count - firstCount;
+
+    return count;
+}
+
+void SensorDataBuffer::commitSamples(int count) {
+    moveReadIndexForward(count);
 }
 
-sensorData* SensorDataBuffer::getNewSample() {
-    // If the buffer is full
-    if (isBufferFull()) {
+sensorData* SensorDataBuffer::getNewSample(unsigned long long timestampMillis) {
+    int writePosition = getWriteIndex();
+    int block = writePosition / BUFFER_BLOCK_SIZE;
+    bool startsBlock = writePosition % BUFFER_BLOCK_SIZE == 0;
+
+    // If the buffer is full. Starting a new block overwrites its base timestamp, so the
+    // samples of the previous round in that block must all have been released first
+    if (isBufferFull()
+            || (startsBlock && getBufferSize() > BUFFER_CAPACITY - BUFFER_BLOCK_SIZE)) {
         // Return nullptr if the sample was not added to the buffer
         return nullptr;
     }
 
-    // Get the pointer to the next sample to be written
-    sensorData* ptrSample = &buffer[writeIndex];
+    if (startsBlock) {
+        blockBaseMillis[block] = timestampMillis;
+    } else if (blockBaseMillis[block] < CLOCK_SYNCED_EPOCH_MILLIS) {
+        // A block started before the clock sync stays on the timeline of the boot, otherwise
+        // the jump of the sync wouldn't fit in the offsets of its samples (see Network.h)
+        timestampMillis = toBootMillis(timestampMillis);
+    }
 
-    // Move the write index to the next sample
-    moveWriteIndexForward();
+    // Get the pointer to the next sample to be written. The write index only moves forward
+    // when the sample is committed, so the consumer can't read a partially filled sample
+    sensorData* ptrSample = &buffer[writePosition];
+    ptrSample->timestampOffsetMillis =
+        static_cast<int32_t>(timestampMillis - blockBaseMillis[block]);
 
-    // Return the pointer to the next sample to be written
     return ptrSample;
 }
 
-void SensorDataBuffer::printBufferState() const {
-    // If the buffer gets full
-    if (isBufferFull()) {
-        // Print an error message and restart the device
-        errorHandler.showError(ErrorType::BufferFull, true);
-    }
+void SensorDataBuffer::commitNewSample() {
+    moveWriteIndexForward();
+}
 
+void SensorDataBuffer::printBufferState() const {
     // Prints the buffer state
-    LogVerboseln("Buffer state: ", bufferSize, "/", BUFFER_CAPACITY);
+    LogVerboseln("Buffer state: "_log, getBufferSize(), "/"_log, BUFFER_CAPACITY);
 }
 
 void SensorDataBuffer::printBufferIndexes() const {
-    LogVerboseln("Buffer index: R=", readIndex, " W=", writeIndex);
+    LogVerboseln("Buffer index: R="_log, getReadIndex(), " W="_log, getWriteIndex());
 }
 
 void SensorDataBuffer::dumpBufferContent(int start, int end) const {
@@ -146,14 +140,14 @@ void SensorDataBuffer::dumpBufferContent(int start, int end) const {
         const sensorData* sample = &buffer[i];
 
         // Print the sample timestamp
-        LogDebug(sample->timestampMillis, " ");
+        LogDebug(getTimestampMillis(sample), " "_log);
 
         // Print the sample pressure sensor values
-        for (int j = 0; j < PRESSURE_SENSOR_COUNT; j++) {
-            LogDebug(sample->pressureSensor[j], " ");
+        for (int j = 0; j < SENSOR_CHANNEL_COUNT; j++) {
+            LogDebug(sample->pressureSensor[j], " "_log);
         }
 
         // Print the end of the line
-        LogDebugln("\n");
+        LogDebugln("\n"_log);
     }
 }
@@ -2,9 +2,13 @@
     Buffer.h
 
     * This module handles the buffer that stores the data collected from the sensors.
-    * The buffer consists of an array of sensorData structs and some indexes to keep track of
-    the buffer state. It also provides functions to add and get samples from the buffer,
-    handle buffer capacity and indexes.
+    * The buffer is a lock-free single-producer/single-consumer ring: the data collection
+    (Core 1) is the only writer and the database task (Core 0) is the only reader. It
+    consists of an array of packed sensorData structs and two atomic indexes to keep track of
+    the buffer state. To keep the records small, the samples are grouped in blocks and
+    each sample only stores the offset of its timestamp from the base timestamp of its block.
+    It also provides functions to add and get samples from the buffer, handle buffer capacity
+    and indexes.
     * For debug purposes, it also provides functions to print the buffer state and dump
     its content.
 */
@@ -13,65 +17,89 @@
 #define Buffer_H_
 
 #include <time.h>
+#include <atomic>
 
 #include <Arduino.h>
 
-// Define the capacity of the buffer
-const int BUFFER_CAPACITY = 1024;
+#include "Sensors.h"
 
-// Define the amount of pressure sensors
-const int PRESSURE_SENSOR_COUNT = 12;
+// Define the capacity of the buffer. It must be a power of two, so that the indexes can be
+// wrapped with a mask instead of a modulo
+const int BUFFER_CAPACITY = 2048;
+const uint32_t BUFFER_INDEX_MASK = BUFFER_CAPACITY - 1;
+
+static_assert((BUFFER_CAPACITY & (BUFFER_CAPACITY - 1)) == 0,
+              "BUFFER_CAPACITY must be a power of two");
+
+// Define the amount of samples that share the same base timestamp. It must divide the capacity
+const int BUFFER_BLOCK_SIZE = 64;
+const int BUFFER_BLOCK_COUNT = BUFFER_CAPACITY / BUFFER_BLOCK_SIZE;
+
+static_assert(BUFFER_CAPACITY % BUFFER_BLOCK_SIZE == 0,
+              "BUFFER_BLOCK_SIZE must divide BUFFER_CAPACITY");
 
 /**
- * Struct to organize the collected data
+ * Struct to organize the collected data, packed to save memory
  * 
- * timestampMillis: timestamp of the sample in milliseconds
- * pressureSensor: array of pressure sensor values
+ * timestampOffsetMillis: offset of the sample timestamp from the base timestamp of its block,
+ * in milliseconds. Use SensorDataBuffer::getTimestampMillis() to get the full timestamp
+ * pressureSensor: array of the values of the channels of the sensors, in the order of their
+ * list (see Sensors.h). The readings fit in 12 to 16 bits
  */
 struct sensorData {
-    // 8 bytes
-    unsigned long long timestampMillis = 0;
+    // 4 bytes, signed so that small clock adjustments backwards are still representable
+    int32_t timestampOffsetMillis = 0;
 
     // 2 bytes each
-    int pressureSensor[PRESSURE_SENSOR_COUNT] = {0};
+    uint16_t pressureSensor[SENSOR_CHANNEL_COUNT] = {0};
+};
+
+static_assert(sizeof(sensorData) == 4 + 2 * SENSOR_CHANNEL_COUNT,
+              "sensorData must not have padding");
+
+/**
+ * Contiguous range of samples stored in the buffer
+ * 
+ * samples: pointer to the first sample of the range
+ * count: number of samples in the range
+ */
+struct sensorDataSpan {
+    const sensorData* samples = nullptr;
+    int count = 0;
 };
 
 // Define a class to store the collected data
 
 /**
  * Class that handles the buffer that stores the data collected from the sensors.
- * The buffer consists of an array of sensorData structs and some indexes to keep track of
- * the buffer state. It also provides functions to add and get samples from the buffer,
- * handle buffer capacity and indexes.
+ * The buffer is a lock-free single-producer/single-consumer ring. The producer reserves a
+ * slot with getNewSample(), fills it and publishes it with commitNewSample(). The consumer
+ * peeks the oldest sample with getSample() and frees its slot with releaseSample().
+ * Only the producer writes the write index and only the consumer writes the read index,
+ * so no shared counter is needed and both sides can run on different cores.
  * For debug purposes, it also provides functions to print the buffer state and dump
  * its content.
  * 
  * @param buffer the array of sensorData structs that stores the collected data
- * @param bufferSize the number of samples in the buffer
- * @param readIndex the index of the next sample to be read
- * @param writeIndex the index of the next sample to be written
+ * @param readIndex the free-running count of samples read from the buffer
+ * @param writeIndex the free-running count of samples written to the buffer
 */
 class SensorDataBuffer {
 
-    // Sotre information regarding the time of the read samples
-    struct tm timeInfo;
-
-    // Store the timestamp of the following day to check if the date has changed
-    // The initial value is 0 so that it gets updated during the first use
-    time_t nextDay = 0;
-
 public:
 
     // Create a buffer based on the sensorData struct
     sensorData buffer[BUFFER_CAPACITY];
 
-    // Hold the number of samples in the buffer
-    int bufferSize = 0;
+    // Store the base timestamp of each block of samples, in milliseconds. It is written by the
+    // producer when it starts the block, only after the whole block was released by the consumer
+    unsigned long long blockBaseMillis[BUFFER_BLOCK_COUNT] = {0};
 
-    // Index to read the next sample
-    int readIndex = 0;
-    // Index to write the next sample
-    int writeIndex = 0;
+    // Free-running index of the next sample to be read, only written by the consumer.
+    // The slot position is obtained by masking it with BUFFER_INDEX_MASK
+    std::atomic<uint32_t> readIndex{0};
+    // Free-running index of the next sample to be written, only written by the producer
+    std::atomic<uint32_t> writeIndex{0};
 
     /**
      * Check if the buffer is empty
@@ -103,86 +131,95 @@ public:
     int getBufferSize() const;
 
     /**
-     * Get the index of the next sample to be read
+     * Get the position in the buffer of the next sample to be read
      * 
-     * @return the index of the next sample to be read
+     * @return the position in the buffer of the next sample to be read
      */
     int getReadIndex() const;
 
     /**
-     * Get the index of the next sample to be written
+     * Get the position in the buffer of the next sample to be written
      * 
-     * @return the index of the next sample to be written
+     * @return the position in the buffer of the next sample to be written
      */
     int getWriteIndex() const;
 
     /** 
-     * Move the read index to the next sample 
-     */
-    void moveReadIndexForward();
-
-    /** 
-     * Move the read index to the previous sample 
+     * Move the read index forward, releasing the slots to the producer.
+     * Must only be called by the consumer
+     * 
+     * @param count the number of samples to move forward
      */
-    void moveReadIndexBackward();
+    void moveReadIndexForward(int count = 1);
 
     /** 
-     * Move the write index to the next sample 
+     * Move the write index to the next sample, publishing it to the consumer.
+     * Must only be called by the producer
      */
     void moveWriteIndexForward();
 
-    /** 
-     * Move the write index to the previous sample in the buffer 
+    /**
+     * Get the full timestamp of a sample stored in the buffer. The samples taken before the
+     * clock sync are only converted to the time since 01 January 1970 once it is synced
+     * 
+     * @param sample the sample, which must point to a slot of the buffer
+     * @return the timestamp of the sample in milliseconds
      */
-    void moveWriteIndexBackward();
+    unsigned long long getTimestampMillis(const sensorData* sample) const;
 
     /**
-     * Get the timestamp of the next sample to be read from the buffer
+     * Check if the content of the sample is null
      * 
-     * @return the timestamp of the next sample to be read from the buffer
+     * @param sample the sample to check
+     * @return true if the sample is null, false otherwise
      */
-    time_t getCurrentSampleSeconds() const;
+    bool isSampleNull(const sensorData* sample) const;
 
     /**
-     * Get the current sample date. Should receive an array of at least 11 chars
+     * Get the next sample from the buffer at the read index, without releasing it.
+     * The sample stays valid until releaseSample() is called
      * 
-     * @param sampleDate the array of chars to store the sample date
+     * @return a pointer to the next sample to be read, or nullptr if the buffer is empty
      */
-    void computeCurrentSampleDate(char* sampleDate);
+    const sensorData* getSample() const;
 
     /**
-     * Compute the timestamp of the start of the following day
+     * Release the sample returned by getSample(), so that its slot can be reused
      */
-    void computeNextDaySeconds();
+    void releaseSample();
 
     /**
-     * Check if the date has changed
+     * Get up to maxCount of the oldest samples in the buffer, without releasing them.
+     * Since the buffer wraps around, the samples are returned as one or two contiguous spans,
+     * in order. The samples stay valid until commitSamples() is called
      * 
-     * @return true if the date has changed, false otherwise
+     * @param spans the array of two spans to be filled (the second one may be empty)
+     * @param maxCount the maximum number of samples to get
+     * @param skip the amount of oldest samples to skip, like the ones of the batches in flight
+     * @return the total number of samples in the spans
      */
-    bool hasDateChanged();
+    int peekSamples(sensorDataSpan spans[2], int maxCount, int skip = 0) const;
 
     /**
-     * Check if the content of the sample is null
+     * Release the oldest samples of the buffer, usually after they were peeked and processed
      * 
-     * @param sample the sample to check
-     * @return true if the sample is null, false otherwise
+     * @param count the number of samples to release
      */
-    bool isSampleNull(const sensorData* sample) const;
+    void commitSamples(int count);
 
     /**
-     * Get the next sample from the buffer at the read index and increment it
+     * Get the slot at the write index and set its timestamp, without publishing it.
+     * The sample only becomes visible to the consumer after commitNewSample() is called
      * 
-     * @return a pointer to the next sample to be read
+     * @param timestampMillis the timestamp of the new sample, in milliseconds
+     * @return a pointer to the next sample to be written, or nullptr if the buffer is full
      */
-    const sensorData* getSample();
+    sensorData* getNewSample(unsigned long long timestampMillis);
 
     /**
-     * Get the next sample from the buffer at the write index and increment it
-     * 
-     * @return a pointer to the next sample to be written
+     * Publish the sample filled through getNewSample() to the consumer
      */
-    sensorData* getNewSample();
+    void commitNewSample();
 
     /**
      * Print the buffer state, the number of samples in the buffer and its capacity
@@ -0,0 +1,95 @@
+#include "ChangeFilter.h"
+
+ChangeFilter::ChangeFilter() {
+    memset(&committed, 0, sizeof(committed));
+    pending = committed;
+
+    for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+        deadbandThresholds[i] = Sensors::getDeadband(i);
+    }
+}
+
+void ChangeFilter::begin() {
+    pending = committed;
+}
+
+uint16_t ChangeFilter::filter(unsigned long long timestampMillis, const sensorData* sample) {
+    uint16_t channelMask = 0;
+
+    bool keyframeDue = timestampMillis - pending.keyframeMillis >= KEYFRAME_INTERVAL_MILLIS;
+
+    if (!pending.hasKeyframe || keyframeDue) {
+        channelMask = CHANNEL_MASK_ALL;
+    } else {
+        for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+            int difference = sample->pressureSensor[i] - pending.referenceValues[i];
+            if (abs(difference) > deadbandThresholds[i]) {
+                channelMask |= 1 << i;
+            }
+        }
+    }
+
+    // A channel of a sparse record takes about twice the bytes of a channel of a dense one, so a
+    // sample where most channels changed is sent dense
+    if (__builtin_popcount(channelMask) > SPARSE_CHANNELS_MAX) {
+        channelMask = CHANNEL_MASK_ALL;
+    }
+
+    // A sample whose channels all changed is sent dense, so it also restarts the keyframe
+    // interval
+    if (channelMask == CHANNEL_MASK_ALL) {
+        pending.keyframeMillis = timestampMillis;
+        pending.hasKeyframe = true;
+    }
+
+    // The references only follow the channels sent, so a slow drift is still sent once it
+    // accumulates beyond the deadband
+    for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+        if (channelMask & (1 << i)) {
+            pending.referenceValues[i] = sample->pressureSensor[i];
+        }
+    }
+
+    pending.filteredSamples++;
+    pending.keptValues += __builtin_popcount(channelMask);
+
+    return channelMask;
+}
+
+void ChangeFilter::commit() {
+    committed = pending;
+}
+
+void ChangeFilter::commit(const changeFilterState& state) {
+    committed = state;
+}
+
+const changeFilterState& ChangeFilter::getPendingState() const {
+    return pending;
+}
+
+float ChangeFilter::getKeptRatio() const {
+    if (committed.filteredSamples == 0) {
+        return 1.0f;
+    }
+
+    return static_cast<float>(committed.keptValues) /
+           (static_cast<float>(committed.filteredSamples) * SENSOR_CHANNEL_COUNT);
+}
+
+ChangeDecoder::ChangeDecoder() {
+    memset(values, 0, sizeof(values));
+}
+
+void ChangeDecoder::apply(uint16_t channelMask,
+                          const uint16_t recordValues[SENSOR_CHANNEL_COUNT]) {
+    for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+        if (channelMask & (1 << i)) {
+            values[i] = recordValues[i];
+        }
+    }
+}
+
+const uint16_t* ChangeDecoder::getValues() const {
+    return values;
+}
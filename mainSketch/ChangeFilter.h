@@ -0,0 +1,124 @@
+/*
+    ChangeFilter.h
+
+    * This module reduces the data sent to the database by only keeping the channels that
+    changed. A channel changed when it moved more than its deadband away from the last value
+    sent for it, so small fluctuations of an occupied chair aren't sent every tick.
+    * The samples without any changed channel are skipped, and the ones with only a few changed
+    channels (up to SPARSE_CHANNELS_MAX) are sent as sparse records, the others as dense ones.
+    Every KEYFRAME_INTERVAL_MILLIS a dense record (keyframe) is sent, so that a consumer can
+    always rebuild the values without the older records.
+    * The ChangeDecoder rebuilds the dense values, holding the last value of each channel between
+    the records. The readers of the database decode the records with host/consumer first.
+*/
+
+#ifndef ChangeFilter_H_
+#define ChangeFilter_H_
+
+#include "Buffer.h"
+
+// Set the maximum interval without a keyframe, in milliseconds (ms)
+const unsigned long long KEYFRAME_INTERVAL_MILLIS = 10000;
+
+// Set the maximum amount of channels of a sparse record. The samples with more changed channels
+// are sent dense, as they take less bytes that way
+const int SPARSE_CHANNELS_MAX = SENSOR_CHANNEL_COUNT / 2;
+
+// Define the channel mask of a dense record, with all the channels
+const uint16_t CHANNEL_MASK_ALL = (1 << SENSOR_CHANNEL_COUNT) - 1;
+static_assert(SENSOR_CHANNEL_COUNT <= 16, "The channel masks hold up to 16 channels");
+
+// Define the state of the filter: the last value sent for each channel, the time of the last
+// keyframe and the counters of the samples filtered and of the values kept since the boot
+struct changeFilterState {
+    uint16_t referenceValues[SENSOR_CHANNEL_COUNT];
+    unsigned long long keyframeMillis;
+    bool hasKeyframe;
+    uint32_t filteredSamples;
+    uint32_t keptValues;
+};
+
+/**
+ * Class that selects the changed channels of each sample
+ *
+ * A batch may fail to be sent and be built again, so the filter works on a pending copy of
+ * its state, started by begin() and only kept by commit() once the batch is sent.
+ * 
+ * While some batches are in flight, the next ones go on from the pending state, which is saved
+ * after each batch and kept by commit(state) once that batch is sent.
+ */
+class ChangeFilter {
+    changeFilterState committed;
+    changeFilterState pending;
+
+    // Store the deadband of each channel, from its sensor (see Sensors.h), in counts. A change up
+    // to the deadband is considered noise (0 sends every change)
+    uint16_t deadbandThresholds[SENSOR_CHANNEL_COUNT];
+
+public:
+    /** Initialize the filter, so that the first sample is a keyframe */
+    ChangeFilter();
+
+    /**
+     * Start the state of a new batch from the state of the last batch sent
+     */
+    void begin();
+
+    /**
+     * Select the channels of a sample that must be sent, and update the pending state
+     * @param timestampMillis The timestamp of the sample, in milliseconds
+     * @param sample The sample to be filtered
+     * @return The mask of the channels to be sent (bit i for the sensor i). 0 skips the sample
+     * and CHANNEL_MASK_ALL is a keyframe
+     */
+    uint16_t filter(unsigned long long timestampMillis, const sensorData* sample);
+
+    /**
+     * Keep the pending state, once the batch is sent
+     */
+    void commit();
+
+    /**
+     * Keep a state saved after a batch, once that batch is sent
+     * @param state The pending state saved after the batch (see getPendingState())
+     */
+    void commit(const changeFilterState& state);
+
+    /**
+     * Get the pending state, to be saved after a batch that is still in flight
+     * @return The pending state
+     */
+    const changeFilterState& getPendingState() const;
+
+    /**
+     * Get the ratio between the values kept and all the values filtered, over the batches sent
+     * @return The ratio of the values kept, from 0 to 1
+     */
+    float getKeptRatio() const;
+};
+
+/**
+ * Class that rebuilds the dense values from the records sent by the ChangeFilter
+ */
+class ChangeDecoder {
+    uint16_t values[SENSOR_CHANNEL_COUNT];
+
+public:
+    /** Initialize the decoder with all the values at 0, until the first keyframe */
+    ChangeDecoder();
+
+    /**
+     * Apply a record to the values
+     * @param channelMask The channels carried by the record (CHANNEL_MASK_ALL for a keyframe)
+     * @param recordValues The values of the record, indexed by channel
+     */
+    void apply(uint16_t channelMask, const uint16_t recordValues[SENSOR_CHANNEL_COUNT]);
+
+    /**
+     * Get the dense values. The timestamps without a record hold the values of the last one
+     * @return The value of each channel
+     */
+    const uint16_t* getValues() const;
+};
+
+#endif  // ChangeFilter_H_
@@ -0,0 +1,22 @@
+#include <sys/time.h>
+
+#include <Arduino.h>
+
+#include "Clock.h"
+
+unsigned long clockMicros() {
+    return micros();
+}
+
+unsigned long clockMillis() {
+    return millis();
+}
+
+unsigned long long clockEpochMillis() {
+    struct timeval tv;
+
+    // Fill the timeval struct with the current time (tv_sec and tv_usec)
+    gettimeofday(&tv, NULL);
+
+    return tv.tv_sec * 1000LL + tv.tv_usec / 1000LL;
+}
@@ -0,0 +1,34 @@
+/*
+    Clock.h
+
+    * This module gathers the clock sources used by the other modules of the sketch.
+    * Every time measurement goes through these functions instead of calling micros(),
+    millis() or gettimeofday() directly, so that a single translation unit (Clock.cpp)
+    can be swapped by a simulated clock when the modules are built off the board.
+*/
+
+#ifndef Clock_H_
+#define Clock_H_
+
+/**
+ * Get the time since the device's boot, in microseconds. It wraps around after ~71 minutes
+ * 
+ * @return the time since the boot, in microseconds (us)
+ */
+unsigned long clockMicros();
+
+/**
+ * Get the time since the device's boot, in milliseconds. It wraps around after ~49 days
+ * 
+ * @return the time since the boot, in milliseconds (ms)
+ */
+unsigned long clockMillis();
+
+/**
+ * Get the wall-clock time, in milliseconds since 01 January 1970
+ * 
+ * @return the current timestamp in milliseconds
+ */
+unsigned long long clockEpochMillis();
+
+#endif  // Clock_H_
@@ -0,0 +1,159 @@
+#include "Connectivity.h"
+#include "Clock.h"
+#include "Credentials.h"
+#include "Errors.h"
+#include "Network.h"
+#include "Telemetry.h"
+#include "Debug.h"
+
+void Connectivity::onWiFiGotIp(WiFiEvent_t, WiFiEventInfo_t) {
+    connectivity.linkUp.store(true);
+}
+
+void Connectivity::onWiFiDisconnected(WiFiEvent_t, WiFiEventInfo_t) {
+    connectivity.linkUp.store(false);
+}
+
+void Connectivity::setup() {
+    // The reconnections are attempted by update(), with a backoff, instead of by the library
+    WiFi.mode(WIFI_STA);
+    WiFi.setAutoReconnect(false);
+    WiFi.onEvent(onWiFiGotIp, ARDUINO_EVENT_WIFI_STA_GOT_IP);
+    WiFi.onEvent(onWiFiDisconnected, ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+
+    LogInfoln("Connecting to Wi-Fi"_log);
+    WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+
+    nextReconnectMillis = clockMillis() + reconnectBackoffMillis;
+    errorHandler.showError(ErrorType::NoInternet);
+}
+
+void Connectivity::setState(ConnectivityState newState) {
+    ConnectivityState oldState = state.load();
+    if (newState == oldState) {
+        return;
+    }
+    state.store(newState);
+
+    unsigned long currentMillis = clockMillis();
+
+    // An outage starts when a working connection is lost. Until the first push, the device is
+    // only starting up
+    if (oldState == ConnectivityState::Connected) {
+        outageOngoing = true;
+        outageStartMillis = currentMillis;
+        outageSamples = 0;
+        outages++;
+        LogWarningln("Connection lost, the samples are kept until it is back"_log);
+    }
+
+    if (newState == ConnectivityState::Connected && outageOngoing) {
+        unsigned long durationMillis = currentMillis - outageStartMillis;
+        outageOngoing = false;
+        outageTotalMillis += durationMillis;
+        telemetry.countOutage(durationMillis, outageSamples);
+        LogInfoln("Connection back after "_log, durationMillis, " ms, "_log, outageSamples,
+                  " samples taken in the meantime"_log);
+    }
+
+    if (newState == ConnectivityState::Offline) {
+        errorHandler.showError(ErrorType::NoInternet);
+    } else if (newState == ConnectivityState::Degraded && !clockSynced) {
+        errorHandler.showError(ErrorType::NoNTPdata);
+    }
+}
+
+void Connectivity::reconnectWiFi(unsigned long currentMillis) {
+    if (static_cast<long>(currentMillis - nextReconnectMillis) < 0) {
+        return;
+    }
+
+    // The attempt only starts the association, its result comes through the WiFi events
+    reconnectAttempts++;
+    LogInfoln("Reconnecting to Wi-Fi, attempt "_log, reconnectAttempts, ", next one in "_log,
+              reconnectBackoffMillis, " ms"_log);
+    WiFi.reconnect();
+
+    nextReconnectMillis = currentMillis + reconnectBackoffMillis;
+    reconnectBackoffMillis = min(reconnectBackoffMillis * 2, WIFI_RECONNECT_BACKOFF_MAX_MILLIS);
+}
+
+void Connectivity::update(uint32_t producedSamples) {
+    unsigned long currentMillis = clockMillis();
+
+    // The samples taken since the last update wait for the connection if it isn't working
+    uint32_t newSamples = producedSamples - lastProducedSamples;
+    lastProducedSamples = producedSamples;
+    if (state.load() != ConnectivityState::Connected) {
+        outageSamples += newSamples;
+        offlineSamples += newSamples;
+    }
+
+    if (!linkUp.load()) {
+        setState(ConnectivityState::Offline);
+        reconnectWiFi(currentMillis);
+        return;
+    }
+
+    if (state.load() == ConnectivityState::Offline) {
+        LogInfoln("Connected to Wi-Fi with IP: "_log, WiFi.localIP());
+        reconnectBackoffMillis = WIFI_RECONNECT_BACKOFF_MIN_MILLIS;
+        nextReconnectMillis = currentMillis;
+
+        // Try to push right away, the database may have been fine all along
+        pushBackoffMillis = PUSH_BACKOFF_MIN_MILLIS;
+        nextPushMillis = currentMillis;
+        setState(ConnectivityState::Degraded);
+    }
+
+    if (!ntpStarted) {
+        syncWithNTPTime();
+        ntpStarted = true;
+    }
+
+    if (!clockSynced && isClockSynced()) {
+        clockSynced = true;
+        printLocalTime();
+    }
+}
+
+bool Connectivity::canPush() const {
+    return state.load() != ConnectivityState::Offline && clockSynced
+           && static_cast<long>(clockMillis() - nextPushMillis) >= 0;
+}
+
+void Connectivity::reportPush(bool success) {
+    if (success) {
+        pushBackoffMillis = PUSH_BACKOFF_MIN_MILLIS;
+        setState(ConnectivityState::Connected);
+        return;
+    }
+
+    // A failed push is retried after the backoff, so that a struggling database isn't flooded
+    nextPushMillis = clockMillis() + pushBackoffMillis;
+    pushBackoffMillis = min(pushBackoffMillis * 2, PUSH_BACKOFF_MAX_MILLIS);
+
+    if (state.load() == ConnectivityState::Connected) {
+        setState(ConnectivityState::Degraded);
+    }
+}
+
+ConnectivityState Connectivity::getState() const {
+    return state.load();
+}
+
+uint32_t Connectivity::getOutageCount() const {
+    return outages;
+}
+
+unsigned long long Connectivity::getOutageMillis() const {
+    return outageTotalMillis + (outageOngoing ? clockMillis() - outageStartMillis : 0);
+}
+
+uint32_t Connectivity::getOfflineSampleCount() const {
+    return offlineSamples;
+}
+
+uint32_t Connectivity::getReconnectAttempts() const {
+    return reconnectAttempts;
+}
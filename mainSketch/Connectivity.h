@@ -0,0 +1,162 @@
+/*
+    Connectivity.h
+
+    * This module manages the connection of the device to the WiFi network and to the database,
+    so that the data collection keeps running while they are unavailable.
+    * The WiFi events only update an atomic flag, and the reconnections are attempted by the
+    database task (Core 0) with an exponential backoff, without ever blocking.
+    * It tracks the state of the connection: Offline without WiFi, Degraded while the clock is
+    not synced or the pushes fail, and Connected once a push works. The Database checks it in
+    O(1) before building a batch, and waits for the backoff after a failed push.
+    * It also counts the duration of the outages and the samples taken while offline, kept in
+    the buffer and in the spool until the connection is back.
+*/
+
+#ifndef Connectivity_H_
+#define Connectivity_H_
+
+#include <atomic>
+
+#include <WiFi.h>
+
+// Set the first and the largest interval between the reconnection attempts, in milliseconds (ms)
+const unsigned long WIFI_RECONNECT_BACKOFF_MIN_MILLIS = 500;
+const unsigned long WIFI_RECONNECT_BACKOFF_MAX_MILLIS = 60000;
+
+// Set the first and the largest interval before a push is retried, in milliseconds (ms)
+const unsigned long PUSH_BACKOFF_MIN_MILLIS = 250;
+const unsigned long PUSH_BACKOFF_MAX_MILLIS = 30000;
+
+/**
+ * Enumerate the states of the connection
+ * 
+ * Offline: the WiFi network is not connected
+ * Degraded: the WiFi network is connected, but the clock is not synced yet or the last push
+ * failed
+ * Connected: the last push to the database worked
+ */
+enum class ConnectivityState : uint8_t {
+    Offline,
+    Degraded,
+    Connected
+};
+
+/**
+ * Class that keeps the WiFi connection up and gates the pushes to the database
+ * 
+ * The state is written by the database task only, and read by any task.
+ */
+class Connectivity {
+    // Store the current state of the connection
+    std::atomic<ConnectivityState> state{ConnectivityState::Offline};
+
+    // Store whether the WiFi network has an IP, set by the WiFi events
+    std::atomic<bool> linkUp{false};
+
+    // Store whether the NTP sync was started, which needs the WiFi network
+    bool ntpStarted = false;
+    // Store whether the clock was seen synced
+    bool clockSynced = false;
+
+    // Save the time of the next reconnection attempt and the current backoff, in milliseconds
+    unsigned long nextReconnectMillis = 0;
+    unsigned long reconnectBackoffMillis = WIFI_RECONNECT_BACKOFF_MIN_MILLIS;
+    // Count the reconnection attempts since the boot
+    uint32_t reconnectAttempts = 0;
+
+    // Save the time from which the pushes can be retried and the current backoff, in milliseconds
+    unsigned long nextPushMillis = 0;
+    unsigned long pushBackoffMillis = PUSH_BACKOFF_MIN_MILLIS;
+
+    // Store whether an outage is ongoing, and the time it started, in milliseconds (ms)
+    bool outageOngoing = false;
+    unsigned long outageStartMillis = 0;
+    // Count the outages and their total duration since the boot, in milliseconds (ms)
+    uint32_t outages = 0;
+    unsigned long long outageTotalMillis = 0;
+
+    // Count the samples taken while not connected, in the current outage and since the boot
+    uint32_t outageSamples = 0;
+    uint32_t offlineSamples = 0;
+    // Store the amount of samples produced at the last update, to count the new ones
+    uint32_t lastProducedSamples = 0;
+
+    // Handle the WiFi events, on the event task of the WiFi library
+    static void onWiFiGotIp(WiFiEvent_t event, WiFiEventInfo_t info);
+    static void onWiFiDisconnected(WiFiEvent_t event, WiFiEventInfo_t info);
+
+    // Change the state, starting or ending the outage and updating the LED indicator
+    void setState(ConnectivityState newState);
+
+    // Attempt to reconnect to the WiFi network, once the backoff has elapsed
+    void reconnectWiFi(unsigned long currentMillis);
+
+public:
+    /**
+     * Start the connection to the WiFi network, without waiting for it
+     */
+    void setup();
+
+    /**
+     * Follow the WiFi events, reconnect and check the clock sync. Must be called periodically
+     * by the database task
+     * 
+     * @param producedSamples the free-running count of samples written to the buffer
+     */
+    void update(uint32_t producedSamples);
+
+    /**
+     * Check if a push can be attempted: the WiFi network is connected, the clock is synced and
+     * the backoff of the last failed push has elapsed
+     * 
+     * @return true if a push can be attempted, false otherwise
+     */
+    bool canPush() const;
+
+    /**
+     * Update the state with the result of a push, backing off after a failure
+     * 
+     * @param success whether the push worked
+     */
+    void reportPush(bool success);
+
+    /**
+     * Get the current state of the connection
+     * 
+     * @return the current state
+     */
+    ConnectivityState getState() const;
+
+    /**
+     * Get the amount of outages since the boot, including the ongoing one
+     * 
+     * @return the amount of outages
+     */
+    uint32_t getOutageCount() const;
+
+    /**
+     * Get the total duration of the outages since the boot, including the ongoing one
+     * 
+     * @return the duration of the outages, in milliseconds (ms)
+     */
+    unsigned long long getOutageMillis() const;
+
+    /**
+     * Get the amount of samples taken while not connected since the boot
+     * 
+     * @return the amount of samples
+     */
+    uint32_t getOfflineSampleCount() const;
+
+    /**
+     * Get the amount of attempts to reconnect to the WiFi network since the boot
+     * 
+     * @return the amount of attempts
+     */
+    uint32_t getReconnectAttempts() const;
+};
+
+// Declare the extern instance of the Connectivity class
+extern Connectivity connectivity;
+
+#endif  // Connectivity_H_
@@ -13,15 +13,19 @@
 #define CREDENTIALS_H
 
 // Define the WiFi credentials (https://youtu.be/pDDdA9qEFwY)
-static const char* WIFI_SSID = "YOUR_WIFI_SSID";
-static const char* WIFI_PASSWORD = "YOUR_WIFI_PASSWORD";
+static const char* const WIFI_SSID = "YOUR_WIFI_SSID";
+static const char* const WIFI_PASSWORD = "YOUR_WIFI_PASSWORD";
 
 // Define the RTDB (Realtime Database) URL and the API Key
-static const char* DATABASE_URL = "YOUR_DATABASE_URL";
-static const char* DATABASE_API_KEY = "YOUR_DATABASE_API_KEY";
+static const char* const DATABASE_URL = "YOUR_DATABASE_URL";
+static const char* const DATABASE_API_KEY = "YOUR_DATABASE_API_KEY";
 
 // Define the database user e-mail and password that were already registered or added to the database project
-static const char* DATABASE_USER_EMAIL = "YOUR_DATABASE_USER_EMAIL";
-static const char* DATABASE_USER_PASSWORD = "YOUR_DATABASE_USER_PASSWORD";
+static const char* const DATABASE_USER_EMAIL = "YOUR_DATABASE_USER_EMAIL";
+static const char* const DATABASE_USER_PASSWORD = "YOUR_DATABASE_USER_PASSWORD";
+
+// Define the address and port of the collector server, used by the stream transport
+static const char* const STREAM_SERVER_HOST = "YOUR_COLLECTOR_SERVER_HOST";
+static const int STREAM_SERVER_PORT = 5555;
 
 #endif
\ No newline at end of file
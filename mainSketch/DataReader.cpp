@@ -1,20 +1,17 @@
 #include "DataReader.h"
+#include "Clock.h"
 #include "Network.h"
 #include "Buffer.h"
-
-void DataReader::updateCurrentTime() {
-    // Set the variable 'currentMicros' with the current time in microseconds (us)
-    currentMicros = micros();
-}
+#include "Telemetry.h"
+#include "Debug.h"
 
 bool DataReader::setup() {
-    // Set each pressure sensor pin as an input
-    for (int i = 0; i < internalAdcPinsCount; ++i) {
-        pinMode(internalAdcPins[i], INPUT);
+    // Setup the sensors
+    if (!sensors.setup()) {
+        return false;
     }
 
-    // Setup the external ADCs
-    if (!externalAdcs.setup()) {
+    if (!scheduler.setup(SAMPLE_RATE * OVERSAMPLING_RATIO)) {
         return false;
     }
 
@@ -23,44 +20,107 @@ bool DataReader::setup() {
 }
 
 void DataReader::addDataToSample(sensorData* newSample) {
-    // Fill the buffer with current timestamp (in milliseconds)
-    newSample->timestampMillis = getCurrentMillisTimestamp();
+    pendingSampleStartMicros = clockMicros();
+
+    // Start the sensors, the ones that complete right away fill their channels now and the
+    // others are advanced by updateSample()
+    pendingSample = newSample;
+    pendingSampleComplete = sensors.start(newSample->pressureSensor);
+}
 
-    // Fill the buffer with sensor data connected to the internal ADC
-    int i = 0;
-    for (i; i < internalAdcPinsCount; ++i) {
-        newSample->pressureSensor[i] = analogRead(internalAdcPins[i]);
+bool DataReader::updateSample() {
+    if (!pendingSampleComplete) {
+        pendingSampleComplete = sensors.advance(pendingSample->pressureSensor);
     }
 
-    // Fill the buffer with sensor data connected to the external ADC
-    int externalAdcsChannelIndex = 0;
-    for (i; i < internalAdcPinsCount + externalAdcPinsCount; i += 2) {
-        externalAdcs.read(externalAdcsChannelIndex);
+    return pendingSampleComplete;
+}
+
+bool DataReader::waitForTick(TickType_t timeout) {
+    // Ticks that arrived during the last sample are counted as missed by the scheduler and
+    // the next sample starts right away
+    return scheduler.waitForTick(timeout);
+}
 
-        // Fill the buffer with the collected values
-        newSample->pressureSensor[i] = externalAdcs.get(0);
-        newSample->pressureSensor[i + 1] = externalAdcs.get(1);
+void DataReader::startReading() {
+    // Start a new reading, with the current timestamp (in milliseconds)
+    readingTimestampMillis = getCurrentMillisTimestamp();
+    addDataToSample(&reading);
 
-        // Go to next channel of the external ADCs
-        externalAdcsChannelIndex++;
+    if (scheduler.getTickCount() % schedulerStatsIntervalTicks == 0) {
+        scheduler.printStats();
     }
 }
 
-void DataReader::fillBuffer(SensorDataBuffer* dataBuffer) {
-    // Save the time when the device start to collect the data from the sensors,
-    // to keep control of the intervals between data collection
-    updateCurrentTime();
+bool DataReader::isReadingPending() const {
+    return pendingSample != nullptr;
+}
+
+bool DataReader::advanceReading(sensorReading* completed) {
+    if (!updateSample()) {
+        return false;
+    }
 
-    // If the time elapsed since the last data collection is greater than the
-    // set interval for data collections, collect more data
-    if (currentMicros - dataPrevColletionMicros > dataCollectIntervalMicros) {
+    pendingSample = nullptr;
+    telemetry.record(TelemetryStage::Acquisition, clockMicros() - pendingSampleStartMicros);
 
-        // Pointer to the next sample to be written
-        sensorData* newSample = dataBuffer->getNewSample();
+    #if CAPTURE_STATUS == ENABLE
+        printCaptureLine();
+    #endif
 
-        addDataToSample(newSample);
+    completed->timestampMillis = readingTimestampMillis;
+    memcpy(completed->values, reading.pressureSensor, sizeof(completed->values));
+    return true;
+}
 
-        // Update the time variable that controls the collect interval
-        dataPrevColletionMicros = currentMicros;
+bool DataReader::filterReading(const sensorReading& completed, SensorDataBuffer* dataBuffer) {
+    uint16_t decimated[SENSOR_CHANNEL_COUNT];
+    if (!decimator.update(completed.values, decimated)) {
+        return false;
     }
+
+    sensorData* newSample =
+        dataBuffer->getNewSample(completed.timestampMillis - decimatorDelayMillis);
+
+    // If the buffer is full, the sample is dropped and counted, and the consumer reports it
+    if (newSample == nullptr) {
+        telemetry.countDroppedSample();
+        return false;
+    }
+
+    memcpy(newSample->pressureSensor, decimated, sizeof(decimated));
+    dataBuffer->commitNewSample();
+    return true;
+}
+
+void DataReader::fillBuffer(SensorDataBuffer* dataBuffer) {
+    // If a reading is being collected, advance it and decimate it once it is complete
+    if (isReadingPending()) {
+        sensorReading completed;
+        if (advanceReading(&completed)) {
+            filterReading(completed, dataBuffer);
+        } else {
+            // Let the task sleep until the conversion has a chance to be done
+            vTaskDelay(1);
+        }
+        return;
+    }
+
+    // Sleep until the next deadline, then start a new reading
+    if (waitForTick()) {
+        startReading();
+    }
+}
+
+void DataReader::printCaptureLine() const {
+    char line[16 + 20 + 6 * SENSOR_CHANNEL_COUNT];
+    int length = snprintf(line, sizeof(line), "CAPTURE,%llu", readingTimestampMillis);
+
+    for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+        length += snprintf(&line[length], sizeof(line) - length, ",%u",
+                           reading.pressureSensor[i]);
+    }
+    line[length++] = '\n';
+
+    Serial.write(reinterpret_cast<const uint8_t*>(line), length);
 }
@@ -4,18 +4,39 @@
     * This module handle the sensors and the data collection from them.
     * It setup the sensors and the constants related to them
     * It also handle the routine to collect data from the sensors and store it on the buffer.
+    * The samples are started on the ticks of a drift-free scheduler (see Scheduler.h), and
+    the task sleeps between them.
+    * The sensors are the ones of the list in Sensors.h, read in its order by the sensor
+    registry (see SensorRegistry.h).
+    * The collection of a sample is a non-blocking state machine: each call of fillBuffer()
+    advances it, collecting the conversions of the external ADCs that are already done and
+    starting the following ones, instead of waiting for them.
+    * The pins of the internal ADC are converted in the background by its DMA, and each reading
+    takes the average of their conversions since the previous one (see InternalADCs.h).
+    * The channels are read OVERSAMPLING_RATIO times per sample and decimated back to
+    SAMPLE_RATE before being stored on the buffer (see Decimator.h).
+    * The acquisition of the readings and their decimation can run on separate tasks, joined
+    by a queue of readings (see Stages.h), or in turns by fillBuffer().
 */
 
 #ifndef DataReader_H_
 #define DataReader_H_
 
 // #include <FirebaseESP32.h>
-#include "ExternalADCs.h"
 #include "Buffer.h"
+#include "Decimator.h"
+#include "Scheduler.h"
+#include "Sensors.h"
 
 // Sample Rate of the data collection, in hertz (Hz)
 const int SAMPLE_RATE = 2;
 
+// Define a reading of the sensors, before the decimation, and its timestamp in milliseconds
+struct sensorReading {
+    unsigned long long timestampMillis;
+    uint16_t values[SENSOR_CHANNEL_COUNT];
+};
+
 
 /**
  * This class handle the sensors and the data collection from them.
@@ -23,44 +44,109 @@ const int SAMPLE_RATE = 2;
  * It also handle the routine to collect data from the sensors and store it on the buffer.
 */
 class DataReader {
-    // External ADCs that will be used to read the pressure sensors
-    ExternalADCs externalAdcs;
-    // Define the amount of pressure sensors hooked up to the external ADCs
-    const int externalAdcPinsCount = 8;
-
-    // Define the pins that will be used to read the pressure sensors through the internal ADC(ADC1)
-    const uint8_t internalAdcPins[4] = {A2, A3, A4, A5};
-    // Define the amount of pressure sensors hooked up to the internal ADC (ADC1)
-    const int internalAdcPinsCount = sizeof(internalAdcPins) / sizeof(internalAdcPins[0]);
-
-    // Set the interval between data collect, in microseconds (us)
-    const int dataCollectIntervalMicros = 1e6 / SAMPLE_RATE;
-    // Save the time of the last data collect, in microseconds (us)
-    unsigned long dataPrevColletionMicros = 0;
-    // Save the current time, in microseconds (us)
-    unsigned long currentMicros = 0;
-
-    /** Update the current time variable */
-    void updateCurrentTime();  
+    // Sensors that will be read, in the order of their channels in the samples
+    Sensors sensors;
+
+    // Wake up the data collection at the oversampled rate
+    SampleScheduler scheduler;
+    // Set the amount of ticks between the reports of the scheduler statistics
+    const uint32_t schedulerStatsIntervalTicks = 60 * SAMPLE_RATE * OVERSAMPLING_RATIO;
+
+    // Average the readings back to SAMPLE_RATE
+    Decimator decimator;
+    // Set the delay of the decimated samples relative to the last reading, half of the length of
+    // the filter, so that their timestamps point to the middle of the readings they average
+    const unsigned long long decimatorDelayMillis =
+        DECIMATOR_ORDER * (OVERSAMPLING_RATIO - 1) * 1000ULL
+        / (2 * SAMPLE_RATE * OVERSAMPLING_RATIO);
+
+    // Store the reading being collected, before it goes through the decimator
+    sensorData reading;
+    // Save the timestamp of the reading being collected, in milliseconds (ms)
+    unsigned long long readingTimestampMillis = 0;
+
+    // Point to the reading being collected, or nullptr if there is no collection in progress
+    sensorData* pendingSample = nullptr;
+    // Store whether all the sensors completed the pending sample
+    bool pendingSampleComplete = false;
+    // Save the time when the pending sample was started, in microseconds (us)
+    unsigned long pendingSampleStartMicros = 0;
+
+    /**
+     * Print the reading as a "CAPTURE,<timestamp>,<values...>" line, with a single write so
+     * that the log messages don't split it
+     */
+    void printCaptureLine() const;
 
 public:
 
     /**
-     * Setup the sensors and the devices' pins
+     * Setup the sensors, the devices' pins and the scheduler. Must be called from the task
+     * that will call fillBuffer()
      * 
      * @return true if everything went well, false otherwise
      */
     bool setup();
 
     /**
-     * Collect data from the sensors and store it in the buffer location represented by the pointer
+     * Start collecting data from the sensors into the location represented by the pointer.
+     * The sensors are started in the order of their list, up to the first one that doesn't
+     * complete right away
      * 
-     * @param dataBuffer: Pointer to the buffer where the data will be stored
+     * @param newSample: Pointer to the location where the data will be stored
      */
     void addDataToSample(sensorData* newSample);
 
     /**
-     * Fill buffer if the moment of the function call is greater than the data collection interval
+     * Advance the collection of the pending sample, without waiting for the sensors. Once the
+     * sensor in progress completes, the next one is started
+     * 
+     * @return true if the pending sample is complete, false otherwise
+     */
+    bool updateSample();
+
+    /**
+     * Sleep until the next tick of the scheduler
+     * 
+     * @param timeout: The maximum time to wait, in FreeRTOS ticks
+     * @return true if a tick happened, false if the timeout expired
+     */
+    bool waitForTick(TickType_t timeout = portMAX_DELAY);
+
+    /**
+     * Start a new reading, with the current timestamp
+     */
+    void startReading();
+
+    /**
+     * Check if a reading is being collected
+     * 
+     * @return true if a reading is pending, false otherwise
+     */
+    bool isReadingPending() const;
+
+    /**
+     * Advance the pending reading, without waiting for the external ADCs
+     * 
+     * @param completed: Where the reading is copied to, once it is complete
+     * @return true if the reading is complete, false otherwise
+     */
+    bool advanceReading(sensorReading* completed);
+
+    /**
+     * Feed a reading to the decimator and publish the decimated sample on the buffer, when the
+     * decimator outputs one
+     * 
+     * @param completed: The reading to be decimated
+     * @param dataBuffer: Pointer to the buffer where the data will be stored
+     * @return true if a sample was published, false otherwise
+     */
+    bool filterReading(const sensorReading& completed, SensorDataBuffer* dataBuffer);
+
+    /**
+     * Advance the pending reading and feed it to the decimator once complete, publishing the
+     * decimated samples on the buffer. If there is no pending reading, sleep until the next
+     * tick of the scheduler and start a new one
      * 
      * @param dataBuffer: Pointer to the buffer where the data will be stored
      */
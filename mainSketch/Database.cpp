@@ -5,19 +5,57 @@
 #include <addons/TokenHelper.h>
 
 #include "Database.h"
+#include "Clock.h"
+#include "Connectivity.h"
 #include "Errors.h"
 #include "Network.h"
 #include "Buffer.h"
+#include "Telemetry.h"
 #include "Debug.h"
 
-Database::Database() : last_was_valid(true) {}
+Database::Database() : bootLogged(false), last_was_valid(true), batch_last_was_valid(true) {
+    fullDataPath[0] = '\0';
+}
 
 void Database::updateCurrentTime() {
     // Set the variable `currentMicros` with the current time in microseconds (us)
-    currentMicros = micros();
+    currentMicros = clockMicros();
+}
+
+void Database::updateUploadStats(int samples, int bytes) {
+    sentMessages++;
+    sentSamples += samples;
+    sentBytes += bytes;
+
+    unsigned long currentMillis = clockMillis();
+    unsigned long elapsedMillis = currentMillis - statsPrevReportMillis;
+    if (elapsedMillis < UPLOAD_STATS_INTERVAL_MILLIS) {
+        return;
+    }
+
+    LogInfoln("Upload stats: "_log, sentMessages * 1000.0f / elapsedMillis, " messages/s, "_log,
+              static_cast<float>(sentBytes) / max(sentSamples, 1U), " bytes/sample, "_log,
+              changeFilter.getKeptRatio() * 100.0f, "% of the values kept"_log);
+
+    sentMessages = 0;
+    sentSamples = 0;
+    sentBytes = 0;
+    statsPrevReportMillis = currentMillis;
+}
+
+void Database::setPipelineDepth(int depth) {
+    pipelineDepth = depth;
+}
+
+void Database::setFixedBatchSize(int size) {
+    batchController.setFixedBatchSize(size);
 }
 
-void Database::setup(time_t timestampUnix) {
+void Database::setEncodeTask(TaskHandle_t task) {
+    uploadPipeline.setCompletionTask(task);
+}
+
+void Database::setup() {
     // Assign the api key (required) of the database
     config.api_key = DATABASE_API_KEY;
 
@@ -33,87 +71,449 @@ void Database::setup(time_t timestampUnix) {
 
     // Authenticate and initialize the communication with the Firebase database
     Firebase.begin(&config, &auth);
-    Firebase.reconnectWiFi(true);
+    // The reconnections are handled by the Connectivity module, without blocking the calls
+    Firebase.reconnectWiFi(false);
+
+    // Recover the samples spooled before the reboot. Without the spool, the device still
+    // works, but the samples are lost if the buffer gets full
+    if (!spool.setup()) {
+        LogErrorln("The flash spool is not available"_log);
+    }
+
+    // Start the upload tasks. If only some of them started, the pipeline is shallower
+    if (!uploadPipeline.setup(pipelineDepth, transmitBatch, this)) {
+        LogErrorln("The upload pipeline could not be fully started"_log);
+    }
 }
 
-void Database::bootLog() {
+bool Database::bootLog() {
+    // The boot is recorded before the first batch, so the first slot is free
+    uploadSlot* slot = uploadPipeline.getFreeSlot();
+
     // If the database is ready to receive the data, we record the timestamp of the device's boot
-    if (Firebase.ready()) {
-        // Record the current timestamp string to the database
-        if (Firebase.pushInt(fbdo, "/bootLog/", getCurrentMillisTimestamp())) {
-            LogInfoln("Inicialização registrada com sucesso!");
-        // If an error occurs during this process, we show it as a fatal
-        // database error and restart the device
+    if (Firebase.ready() && slot != nullptr) {
+        uint32_t freeHeapBefore = ESP.getFreeHeap();
+        // Record the timestamp of the boot itself, as it is only sent once the clock is synced
+        if (Firebase.pushInt(slot->fbdo, "/bootLog/", getBootEpochMillis())) {
+            measureConnection(slot, freeHeapBefore);
+            LogInfoln("Inicialização registrada com sucesso!"_log);
+            return true;
+        // If an error occurs during this process, we show it as a database error and try again
+        // later, the samples are kept in the meantime
         } else {
-            LogFatalln("Ocorreu um erro ao registrar a inicialização:\n", fbdo.errorReason());
-            errorHandler.showError(ErrorType::NoDatabaseConnection, true);
+            LogErrorln("Ocorreu um erro ao registrar a inicialização:\n"_log,
+                       slot->fbdo.errorReason());
+            errorHandler.showError(ErrorType::NoDatabaseConnection);
         }
-    // If the Firebase Database is not ready, we test the connection to
-    // the network and to the database and display it on the LED indicator
+    // If the Firebase Database is not ready, we show it on the LED indicator
     } else {
-        if (WiFi.status() != WL_CONNECTED) {
-            LogFatalln("Não foi possível conectar à rede para registrar a inicialização");
-            errorHandler.showError(ErrorType::NoInternet, true);
-        } else {
-            LogFatalln("Não foi possível conectar ao banco de dados para registrar a inicialização");
-            errorHandler.showError(ErrorType::NoDatabaseConnection, true);
-        }
+        LogErrorln("Não foi possível conectar ao banco de dados para registrar a "_log,
+                   "inicialização"_log);
+        errorHandler.showError(ErrorType::NoDatabaseConnection);
     }
+
+    return false;
 }
 
-void Database::appendDataToJSON(const sensorData* data) {
-    // Clears the previous data stored in the payload array
-    payload.clear();
-    // Add the pressure sensors' data to the payload
-    for (int i = 0; i < PRESSURE_SENSOR_COUNT; i++) {
-        payload.add(data->pressureSensor[i]);
+bool Database::appendDataToJSON(unsigned long long timestampMillis, const sensorData* data,
+                                uint16_t channelMask) {
+    bool appended;
+    if (batchSpansShards) {
+        // The samples are sorted, so the shard only changes once in a while
+        partitioner.update(timestampMillis);
+        appended = batchSlot->jsonBatch.appendSample(timestampMillis, data,
+                                                     partitioner.getShardPath(), channelMask);
+    } else {
+        appended = batchSlot->jsonBatch.appendSample(timestampMillis, data, nullptr, channelMask);
     }
 
-    // Set the node where the data will be stored as a the date, with a milliseconds subkey.
-    jsonBuffer.add(data->timestampMillis, payload);
+    // A sample that doesn't fit in the JSON body is not counted, it waits for the next batch
+    if (!appended) {
+        return false;
+    }
 
     // Increment the jsonSize to keep control of how many data samples are been stored in the JSON
     // buffer
     jsonSize++;
+    return true;
 }
 
-bool Database::pushData() {
+bool Database::appendDataToBatch(unsigned long long timestampMillis, const sensorData* data,
+                                 [[maybe_unused]] uint16_t channelMask) {
+    #if DATABASE_TRANSPORT == TRANSPORT_STREAM
+
+        // A batch never exceeds BATCH_SIZE_MAX samples, which always fit in a frame (see the
+        // static_assert in BatchController.h), so the frame is only full if that stops holding.
+        // The sample is then left for the next batch, as with the JSON body
+        if (!streamTransport.appendSample(timestampMillis, data)) {
+            return false;
+        }
+        jsonSize++;
+        return true;
+
+    #else
+
+        return appendDataToJSON(timestampMillis, data, channelMask);
+
+    #endif
+}
+
+bool Database::batchHasRoom() const {
+    #if DATABASE_TRANSPORT == TRANSPORT_STREAM
+        return streamTransport.getSampleCount() < STREAM_MAX_BATCH_SAMPLES;
+    #else
+        return batchSlot->jsonBatch.hasRoom();
+    #endif
+}
+
+void Database::beginBatch() {
+    batchSlot->jsonBatch.clear();
+    jsonSize = 0;
+
+    #if DATABASE_TRANSPORT == TRANSPORT_STREAM
+        streamTransport.beginBatch();
+    #endif
+
+    // The batches in flight follow each other, so a new batch goes on from the last one built.
+    // Without them, it starts from the last batch sent
+    if (uploadPipeline.getInFlightCount() == 0) {
+        batch_last_was_valid = last_was_valid;
+        changeFilter.begin();
+    }
+}
+
+bool Database::addSampleToBatch(const SensorDataBuffer* dataBuffer,
+                                unsigned long long timestampMillis, const sensorData* sample) {
+    // A full batch is closed before the sample goes through the filter, so that the sample is
+    // left, with the state of the filter, for the next batch
+    if (!batchHasRoom()) {
+        return false;
+    }
+
+    // Check if the current sample is valid
+    bool current_is_valid = !dataBuffer->isSampleNull(sample);
+
+    /**
+     * If the current or the last sample is valid, we send the data to the database.
+     * If the sample being processed is non-zero, it is always sent to the database.
+     * Else, it is only sent if the last sample was valid, so that we don't send
+     * too many null values to the database in succession.
+     */
+    bool appended = true;
+    if (current_is_valid || batch_last_was_valid) {
+        #if CHANGE_FILTER_STATUS == ENABLE
+            // Only the samples that are sent go through the filter, so that its references
+            // always match what the consumer received
+            uint16_t channelMask = changeFilter.filter(timestampMillis, sample);
+        #else
+            uint16_t channelMask = CHANNEL_MASK_ALL;
+        #endif
+
+        if (channelMask != 0) {
+            appended = appendDataToBatch(timestampMillis, sample, channelMask);
+        }
+    }
+
+    batch_last_was_valid = current_is_valid;
+    return appended;
+}
+
+int Database::buildBatch(SensorDataBuffer* dataBuffer, const sensorDataSpan spans[2]) {
+    beginBatch();
+
+    int batchCount = 0;
+    for (int s = 0; s < 2; s++) {
+        for (int i = 0; i < spans[s].count; i++) {
+            const sensorData* sample = &spans[s].samples[i];
+
+            // Once the batch is full, the rest of the samples stay in the buffer
+            if (!addSampleToBatch(dataBuffer, dataBuffer->getTimestampMillis(sample), sample)) {
+                LogWarningln("The batch is full after "_log, batchCount, " samples"_log);
+                return batchCount;
+            }
+            batchCount++;
+        }
+    }
+
+    return batchCount;
+}
+
+bool Database::transmitBatch(uploadSlot* slot, [[maybe_unused]] void* context) {
+    // If every sample of the batch was filtered out, there is nothing to send
+    if (slot->sampleCount == 0) {
+        return true;
+    }
+
     #ifdef DEBUG
 
         // In debug mode, we only print the values instead of sending them to the database
-        json.toString(Serial, true, 255);
+        Serial.println(slot->jsonBatch.getBody());
         return true;
 
+    #elif DATABASE_TRANSPORT == TRANSPORT_STREAM
+
+        return static_cast<Database*>(context)->streamTransport.sendBatch();
+
     #else
 
-        // If the Firebase Database is ready to receive the data, we send it asynchronously
-        // to be faster and to be able the send a larger amount of the data points per second
-        if (Firebase.ready()) {
-            // Send the data to database
-            if (Firebase.updateNodeSilentAsync(fbdo, fullDataPath, jsonBuffer)) {
+        // Hand the serialized batch to the library, which takes the body as a JSON object
+        slot->jsonBuffer.setJsonData(slot->jsonBatch.getBody());
+
+        // Send the data to database, waiting for the response on the upload task while the
+        // next batches are built
+        uint32_t freeHeapBefore = ESP.getFreeHeap();
+        bool sent = Firebase.updateNodeSilent(slot->fbdo, slot->path, slot->jsonBuffer);
+        if (sent) {
+            measureConnection(slot, freeHeapBefore);
+        }
+        return sent;
+
+    #endif
+}
+
+void Database::measureConnection(uploadSlot* slot, uint32_t freeHeapBefore) {
+    // Only the first request of a slot opens its connection, the next ones reuse it. The other
+    // tasks allocate in the meantime, so it is an estimate
+    uint32_t freeHeapAfter = ESP.getFreeHeap();
+    if (slot->connectionHeapBytes != 0 || freeHeapAfter >= freeHeapBefore) {
+        return;
+    }
+
+    slot->connectionHeapBytes = freeHeapBefore - freeHeapAfter;
+    LogInfoln("The connection of an upload slot keeps "_log, slot->connectionHeapBytes,
+              " bytes of heap"_log);
+}
+
+void Database::updateDataPath(unsigned long long firstTimestampMillis,
+                              unsigned long long lastTimestampMillis) {
+    bool shardChanged = partitioner.update(firstTimestampMillis);
+    bool spansShards = !partitioner.contains(lastTimestampMillis);
+
+    // The path is only written again when the shard or the kind of update changes
+    if (!shardChanged && spansShards == batchSpansShards && fullDataPath[0] != '\0') {
+        return;
+    }
+
+    batchSpansShards = spansShards;
+    if (batchSpansShards) {
+        snprintf(fullDataPath, sizeof(fullDataPath), "%s", DATABASE_BASE_PATH);
+    } else {
+        snprintf(fullDataPath, sizeof(fullDataPath), "%s%s", DATABASE_BASE_PATH,
+                 partitioner.getShardPath());
+    }
+}
+
+void Database::submitBatch(int bufferCount, int spoolCount) {
+    batchSlot->sampleCount = jsonSize;
+    batchSlot->bufferCount = bufferCount;
+    batchSlot->spoolCount = spoolCount;
+
+    #if DATABASE_TRANSPORT == TRANSPORT_STREAM
+        batchSlot->length = streamTransport.getFrameLength();
+    #else
+        batchSlot->length = batchSlot->jsonBatch.getLength();
+    #endif
+
+    memcpy(batchSlot->path, fullDataPath, sizeof(fullDataPath));
+
+    // Save the state after the batch, which is kept once the batch is sent
+    batchSlot->filterState = changeFilter.getPendingState();
+    batchSlot->lastWasValid = batch_last_was_valid;
+
+    bufferSamplesInFlight += bufferCount;
+
+    uploadPipeline.submitSlot();
+    batchSlot = nullptr;
+}
+
+void Database::completeBatches(SensorDataBuffer* dataBuffer) {
+    uploadSlot* slot;
+    while ((slot = uploadPipeline.getCompletedSlot()) != nullptr) {
+        if (slot->sampleCount > 0) {
+            telemetry.record(TelemetryStage::Upload, slot->uploadMicros);
+            telemetry.countPush(slot->sent);
+
+            // The whole spool and the buffer are still waiting behind a batch of the spool
+            int backlog = slot->spoolCount > 0
+                              ? dataBuffer->getBufferSize() + BATCH_SIZE_MAX
+                              : dataBuffer->getBufferSize() - bufferSamplesInFlight;
+            batchController.update(slot->sent, slot->uploadMicros, backlog);
+            connectivity.reportPush(slot->sent);
+        }
+
+        if (!slot->sent) {
+            // The reason of the error is a String copied on each call, so only the code of
+            // the response is logged, to keep the upload path free of heap allocations
+            LogErrorln("Database error on "_log, slot->path, ": HTTP code "_log,
+                       slot->fbdo.httpCode());
+            LogErrorln("Payload buffer length: "_log, slot->length);
+            errorHandler.showError(ErrorType::NoDatabaseConnection);
+
+            // The batches after this one were built from it, so they are built again
+            rewinding = true;
+        }
+
+        if (rewinding) {
+            // The records of the spool of the batches dropped are read again
+            spool.rewind(slot->spoolCount);
+        } else {
+            // The samples are only released once their batch is sent. The batches dropped
+            // after a failure are sent again, which only writes the same values again
+            dataBuffer->commitSamples(slot->bufferCount);
+            if (slot->spoolCount > 0) {
+                spool.commit(slot->spoolCount);
+            }
+            last_was_valid = slot->lastWasValid;
+            changeFilter.commit(slot->filterState);
+
+            if (slot->sampleCount > 0) {
                 // Update the LED indicator, showing that everything works fine
                 errorHandler.showError(ErrorType::None);
 
-                // Clear the JSON buffer and reset the counter
-                jsonBuffer.clear();
-                jsonSize = 0;
+                // Only the body is accounted, the HTTP headers are not visible from here
+                updateUploadStats(slot->sampleCount, slot->length);
+            }
+        }
+
+        bufferSamplesInFlight -= slot->bufferCount;
+        uploadPipeline.releaseCompletedSlot();
+    }
+
+    if (uploadPipeline.getInFlightCount() == 0) {
+        rewinding = false;
+    }
+}
+
+bool Database::sendTelemetry() {
+    // The snapshot goes through the connection of the next slot, before its batch is built
+    uploadSlot* slot = uploadPipeline.getFreeSlot();
+    if (slot == nullptr) {
+        return false;
+    }
+
+    if (!Firebase.ready()) {
+        return true;
+    }
 
-                // If the data was sent successfully, we return true
-                return true;
-            // If some error occurs during this process, we show as a fatal database error and
-            // restart the device
-            } else {
-                LogErrorln("Database error on ", fullDataPath, ": ", fbdo.errorReason());
-                LogErrorln("Payload buffer length: ", jsonBuffer.serializedBufferLength());
-                errorHandler.showError(ErrorType::NoDatabaseConnection);
+    if (telemetry.serialize(telemetrySnapshot, sizeof(telemetrySnapshot)) == 0) {
+        LogErrorln("The telemetry snapshot doesn't fit in its buffer"_log);
+        return true;
+    }
 
-                return false;
+    // Keep each snapshot under its timestamp, in the node of the device
+    char telemetryPath[48];
+    snprintf(telemetryPath, sizeof(telemetryPath), "/telemetry/%012llx/%llu",
+             static_cast<unsigned long long>(ESP.getEfuseMac()), getCurrentMillisTimestamp());
+
+    slot->jsonBuffer.setJsonData(telemetrySnapshot);
+    uint32_t freeHeapBefore = ESP.getFreeHeap();
+    if (Firebase.updateNodeSilentAsync(slot->fbdo, telemetryPath, slot->jsonBuffer)) {
+        measureConnection(slot, freeHeapBefore);
+    } else {
+        LogErrorln("Could not send the telemetry: HTTP code "_log, slot->fbdo.httpCode());
+    }
+
+    return true;
+}
+
+int Database::spillToSpool(SensorDataBuffer* dataBuffer) {
+    sensorDataSpan spans[2];
+    dataBuffer->peekSamples(spans, SPOOL_SPILL_BATCH_SIZE);
+
+    int spilledCount = 0;
+    for (int s = 0; s < 2; s++) {
+        for (int i = 0; i < spans[s].count; i++) {
+            const sensorData* sample = &spans[s].samples[i];
+
+            if (!spool.append(dataBuffer->getTimestampMillis(sample), sample)) {
+                break;
             }
-        } else {
-            return false;
+
+            spilledCount++;
         }
+    }
 
-    #endif
+    // The samples are only released from the buffer once they are on the flash
+    spool.flush();
+    dataBuffer->commitSamples(spilledCount);
+
+    // The spool refuses the samples while it is full and its oldest records are in flight
+    if (spilledCount > 0) {
+        LogWarningln("Moved "_log, spilledCount, " samples to the spool"_log);
+    }
+    return spilledCount;
+}
+
+void Database::restartWhenSafe(SensorDataBuffer* dataBuffer) {
+    // The samples of the batches in flight can't be moved, and the ones taken before the clock
+    // sync can't be spooled, so the restart waits for them
+    if (uploadPipeline.getInFlightCount() > 0 || !isClockSynced()) {
+        return;
+    }
+
+    // The spool survives the restart and is sent first after it. If the spool can't take the
+    // samples, they are sent from the buffer one batch at a time instead
+    while (!dataBuffer->isBufferEmpty()) {
+        if (spillToSpool(dataBuffer) == 0) {
+            return;
+        }
+    }
+
+    LogFatalln("The heap is too fragmented for the uploads, restarting"_log);
+    delay(RESTART_LOG_DELAY_MILLIS);
+
+    // Move the samples taken while the log was written
+    while (!dataBuffer->isBufferEmpty() && spillToSpool(dataBuffer) > 0) {
+    }
+
+    ESP.restart();
+}
+
+void Database::reportDroppedSamples() {
+    uint32_t droppedSamples = telemetry.getDroppedSampleCount();
+    if (droppedSamples == reportedDroppedSamples
+            || clockMillis() - droppedPrevReportMillis < DROPPED_SAMPLES_REPORT_INTERVAL_MILLIS) {
+        return;
+    }
+
+    errorHandler.showError(ErrorType::BufferFull);
+    LogWarningln("The buffer is full, "_log, droppedSamples - reportedDroppedSamples,
+                 " samples dropped ("_log, droppedSamples, " since the boot)"_log);
+
+    reportedDroppedSamples = droppedSamples;
+    droppedPrevReportMillis = clockMillis();
+}
+
+void Database::sendSpooledData(SensorDataBuffer* dataBuffer) {
+    // The records of the batches in flight are skipped, they are still on the spool
+    int count = spool.read(spoolBatch, batchController.getBatchSize());
+    if (count == 0) {
+        return;
+    }
+
+    updateDataPath(spoolBatch[0].timestampMillis, spoolBatch[count - 1].timestampMillis);
+
+    unsigned long serializationStartMicros = clockMicros();
+    beginBatch();
+
+    int batchCount = 0;
+    while (batchCount < count) {
+        const spoolRecord* record = &spoolBatch[batchCount];
+        if (!addSampleToBatch(dataBuffer, record->timestampMillis, &record->sample)) {
+            break;
+        }
+        batchCount++;
+    }
+    telemetry.record(TelemetryStage::Serialization, clockMicros() - serializationStartMicros);
+
+    // Once the batch is full, the rest of the records are read again for the next batch
+    if (batchCount < count) {
+        LogWarningln("The batch is full after "_log, batchCount, " spooled samples"_log);
+        spool.rewind(count - batchCount);
+    }
+
+    // The records are kept on the spool until the batch is sent
+    submitBatch(0, batchCount);
 }
 
 void Database::sendData(SensorDataBuffer* dataBuffer) {
@@ -121,64 +521,108 @@ void Database::sendData(SensorDataBuffer* dataBuffer) {
     // to keep control of the intervals between data uploads
     updateCurrentTime();
 
-    // If the time elapsed since the last data sending is greater than the interval between
-    // the data uploads, if the JSON buffer is full or if the next package is from another day, we
-    // send the data to the database
-    if ((jsonSize > 0 && currentMicros - dataPrevSendingMicros > dataSendIntervalMicros)
-            || jsonSize >= jsonBatchSize
-            || jsonSize > 0 && dataBuffer->hasDateChanged()) {
-        pushData();
+    telemetry.updateBufferDepth(dataBuffer->getBufferSize());
 
-        // Update the time variable that controls the send interval
-        dataPrevSendingMicros = currentMicros;
-    }
+    // Follow the state of the connection, with the samples produced since the last call
+    connectivity.update(dataBuffer->writeIndex.load(std::memory_order_relaxed));
 
-    // Otherwise, we keep filling the JSON buffer with the data from the main buffer
-    else {
+    // Release the samples of the batches sent since the last call, in order
+    completeBatches(dataBuffer);
 
-        // Get one sample from the sensor data buffer
-        const sensorData* sample = dataBuffer->getSample();
+    // Hold fewer connections at once while the heap is degraded, and restart the device before
+    // the uploads fail when it is critical
+    HeapState heapState = heapWatchdog.update();
+    uploadPipeline.setSlotLimit(heapState == HeapState::Healthy ? pipelineDepth : 1);
+    if (heapState == HeapState::Critical) {
+        restartWhenSafe(dataBuffer);
+    }
 
-        // Check if the current sample is valid
-        bool current_is_valid = !dataBuffer->isSampleNull(sample);
-        // bool current_is_valid = true; // DEBUG
+    // If the database can't keep up, move the oldest samples to the flash before the buffer
+    // gets full. The samples taken before the clock sync stay in the buffer, as their
+    // timestamps are only known once it is synced (see Network.h). The samples of the batches
+    // in flight can't be moved, so no batch of the buffer is built until they complete
+    bool spillDue = isClockSynced() && dataBuffer->getBufferSize() >= SPOOL_SPILL_THRESHOLD;
+    if (spillDue && bufferSamplesInFlight == 0) {
+        spillToSpool(dataBuffer);
+        spillDue = false;
+    }
 
-        /**
-         * If the current or the last sample is valid, we send the data to the database.
-         * If the sample being processed is non-zero, it is always sent to the database.
-         * Else, it is only sent if the last sample was valid, so that we don't send
-         * too many null values to the database in succession.
-         */
-        if (current_is_valid || last_was_valid) {
-            // Concatenate the sample in a JSON buffer
-            appendDataToJSON(sample);
+    // Without a working connection, the samples wait in the buffer and in the spool, and
+    // no batch is built until the connection is back or the backoff of the last push elapsed
+    if (!connectivity.canPush()) {
+        return;
+    }
+
+    // Record the boot before the first batch, once the database is reachable
+    if (!bootLogged) {
+        bootLogged = bootLog();
+        connectivity.reportPush(bootLogged);
+        if (!bootLogged) {
+            return;
         }
+    }
 
-        last_was_valid = current_is_valid;
+    // The telemetry is sent before the next batch is built in the same slot, so that it isn't
+    // held back while all the slots are busy with a backlog
+    if (clockMillis() - telemetryPrevSendingMillis >= TELEMETRY_INTERVAL_MILLIS
+            && sendTelemetry()) {
+        telemetryPrevSendingMillis = clockMillis();
     }
 
-    // If necessary, we update the path of the database node that will receive the data
-    if (dataBuffer->hasDateChanged()) {
-        // Get the date string of the current sample
-        dataBuffer->computeCurrentSampleDate(sampleDate);
-        // Add a slash to the end of the date string to make the path valid
-        sampleDate[10] = '/';
-        sampleDate[11] = '\0';
-        // Get the seconds that represent the following day, used to check if the date changed
-        dataBuffer->computeNextDaySeconds();
-        // Update the path of the database node that will receive the data
-        fullDataPath = DATABASE_BASE_PATH + sampleDate;
+    // Build the next batch while the previous ones are in flight, in a free slot. After a
+    // failure, the next batch waits for the ones in flight, as it is built from the failed one
+    batchSlot = rewinding ? nullptr : uploadPipeline.getFreeSlot();
+
+    #if DATABASE_TRANSPORT == TRANSPORT_FIREBASE
+        // The batches are only built once the database is ready to receive them
+        if (batchSlot != nullptr && !Firebase.ready()) {
+            connectivity.reportPush(false);
+            batchSlot = nullptr;
+        }
+    #endif
+
+    // Get up to a whole batch of samples from the sensor data buffer, after the ones in flight
+    // and without releasing them
+    sensorDataSpan spans[2];
+    int batchSize = batchController.getBatchSize();
+    int pendingCount = dataBuffer->peekSamples(spans, batchSize, bufferSamplesInFlight);
+
+    // If there are enough samples to fill a batch or if the time elapsed since the last data
+    // sending is greater than the interval between the data uploads, we send the data
+    bool sendIntervalElapsed = currentMicros - dataPrevSendingMicros > dataSendIntervalMicros;
+
+    // The spooled samples are older than the ones in the buffer, so they are sent first
+    if (batchSlot != nullptr && !spool.isEmpty()) {
+        sendSpooledData(dataBuffer);
+    } else if (batchSlot != nullptr && !spillDue
+                   && (pendingCount >= batchSize || (pendingCount > 0 && sendIntervalElapsed))) {
+        // If necessary, we update the path of the database node that will receive the data
+        const sensorDataSpan* lastSpan = spans[1].count > 0 ? &spans[1] : &spans[0];
+        updateDataPath(dataBuffer->getTimestampMillis(spans[0].samples),
+                       dataBuffer->getTimestampMillis(&lastSpan->samples[lastSpan->count - 1]));
+
+        unsigned long serializationStartMicros = clockMicros();
+        int batchCount = buildBatch(dataBuffer, spans);
+        telemetry.record(TelemetryStage::Serialization, clockMicros() - serializationStartMicros);
+
+        // The samples are only released once the batch is sent, even if every one of them was
+        // filtered out and there is nothing to send
+        submitBatch(batchCount, 0);
+
+        // Update the time variable that controls the send interval
+        dataPrevSendingMicros = currentMicros;
     }
+    batchSlot = nullptr;
 
+    // The buffer only fills up while the spool can't take its oldest samples: before the clock
+    // sync, or while the spool is full. The new samples are then dropped and counted instead of
+    // restarting the device, which would lose the whole buffer
+    reportDroppedSamples();
     dataBuffer->printBufferState();
 
-    // Print the size of the JSON buffer
-    LogVerboseln("JSON buffer: ", jsonSize, "/", jsonBatchSize);
+    // Print the size of the JSON buffer and the amount of batches in flight
+    LogVerboseln("JSON buffer: "_log, jsonSize, "/"_log, batchController.getBatchSize(), ", "_log,
+                 uploadPipeline.getInFlightCount(), " batches in flight"_log);
 
     dataBuffer->printBufferIndexes();
-
-    // If we just send an amount of data to the database,
-    // give an interval to Core 0 to work on maintence activities, avoiding crash problems
-    vTaskDelay(10);
-    yield();
 }
@@ -5,8 +5,15 @@
     to the database.
     * It uses the FirebaseESP32 library to connect and send data directly to the
     Firebase Realtime Database. It also provides a function to structure the collected
-    data into JSON formatted batches to be sent to the database.
+    data into JSON formatted batches to be sent to the database (see JsonBatch.h).
+    * Alternatively, it can stream the batches to a collector server over a persistent
+    connection (see StreamTransport.h), selected by DATABASE_TRANSPORT.
     * It also logs the device's boot, useful to analyze crashes, stability, reboots...
+    * The batches are only built while the connection works (see Connectivity.h), the samples
+    wait in the buffer and in the spool otherwise.
+    * The next batches are built while the previous ones are in flight (see UploadPipeline.h).
+    * It follows the heap (see HeapWatchdog.h): the uploads are sent one at a time while it is
+    degraded, and the device is restarted once its samples are on the spool when it is critical.
 */
 
 #ifndef Database_H_
@@ -14,12 +21,54 @@
 
 #include <FirebaseESP32.h>
 
+#include "BatchController.h"
 #include "Buffer.h"
+#include "ChangeFilter.h"
 #include "Credentials.h"
+#include "HeapWatchdog.h"
+#include "JsonBatch.h"
+#include "Partitioner.h"
+#include "Spool.h"
+#include "StreamTransport.h"
+#include "Telemetry.h"
+#include "UploadPipeline.h"
 
-// Send Rate of the data sending, in hertz (Hz)
+// Define the transports that can be used to send the sensor data
+#define TRANSPORT_FIREBASE              0 // One Firebase REST call (HTTPS PATCH) per batch
+#define TRANSPORT_STREAM                1 // Length-prefixed batches over a persistent connection
+
+// Set the transport used to send the sensor data, unless the build selects it
+#ifndef DATABASE_TRANSPORT
+    #define DATABASE_TRANSPORT          TRANSPORT_FIREBASE
+#endif
+
+// Set the amount of batches in flight at most (see UploadPipeline.h). The stream transport
+// sends the batches over a single connection, so they are sent one at a time
+#if DATABASE_TRANSPORT == TRANSPORT_STREAM
+    #define UPLOAD_PIPELINE_DEPTH       1
+#else
+    #define UPLOAD_PIPELINE_DEPTH       2
+#endif
+
+// Send Rate of the data sending in steady state, in hertz (Hz). With a backlog, the full batches
+// are sent as soon as they are ready
 const int SEND_RATE = 2;
 
+// Set the buffer usage from which the oldest samples are moved to the flash spool
+const int SPOOL_SPILL_THRESHOLD = BUFFER_CAPACITY * 3 / 4;
+// Set the maximum amount of samples moved to the flash spool at once
+const int SPOOL_SPILL_BATCH_SIZE = 64;
+
+// Set the time given to the log task to write the last messages before a restart, in
+// milliseconds (ms)
+const unsigned long RESTART_LOG_DELAY_MILLIS = 100;
+
+// Set the interval between the reports of the upload statistics, in milliseconds (ms)
+const unsigned long UPLOAD_STATS_INTERVAL_MILLIS = 60000;
+
+// Set the minimum interval between the reports of the samples dropped, in milliseconds (ms)
+const unsigned long DROPPED_SAMPLES_REPORT_INTERVAL_MILLIS = 10000;
+
 /**
  * Database class to handle the database connection and data sending 
  * to the Firebase Realtime Database
@@ -28,44 +77,160 @@ const int SEND_RATE = 2;
  * Firebase Realtime Database. It also provides a function to structure the collected
  * data into JSON formatted batches to be sent to the database.
  * 
+ * The samples are stored in one node per shard of time (see Partitioner.h). A batch that crosses
+ * the boundary of a shard is sent as a single multi-path update to the base path.
+ * 
+ * The batches can also be streamed to a collector server instead, through the StreamTransport.
+ * 
+ * Unless CHANGE_FILTER_STATUS is disabled, only the channels that changed beyond their deadband
+ * are sent, with periodic keyframes (see ChangeFilter.h).
+ * 
+ * The size of the batches adapts to the backlog and to the push latency (see BatchController.h).
+ * 
+ * When the database can't keep up, the oldest samples are moved from the buffer to a spool on
+ * the flash memory, which survives reboots and is sent first once the database is reachable.
+ * 
+ * While the connection doesn't work, no batch is built and the samples wait in the buffer and in
+ * the spool (see Connectivity.h).
+ * 
+ * Up to UPLOAD_PIPELINE_DEPTH batches are in flight, each one in its own slot and connection, and
+ * they are completed in order. When a batch fails, the ones after it are dropped as they complete
+ * and built again from the failed one (go-back-N), as their samples and the state of the change
+ * filter follow from it. The boot log and the telemetry borrow the connection of a free slot, so
+ * the device holds one connection per slot and no more.
+ * 
  * It also logs the device's boot, useful to analyze crashes, stability, reboots...
  */
 class Database {
-    static const int jsonBatchSize = 10;
-
-    // Define the Firebase Data, Authentication and Configuration objects
-    FirebaseData fbdo;
+    // Define the Firebase Authentication and Configuration objects. The requests go through the
+    // connections of the slots of the upload pipeline
     FirebaseAuth auth;
     FirebaseConfig config;
-    // Create a JSON object to hold and organize the data before sending it to the database
-    FirebaseJson jsonBuffer;
-    FirebaseJsonArray payload;
+
+    // Send the batches from their slots, while the next ones are built
+    UploadPipeline uploadPipeline;
+    // Store the slot of the batch being built, with its preallocated JSON body
+    uploadSlot* batchSlot = nullptr;
+    // Set the amount of batches in flight at most
+    int pipelineDepth = UPLOAD_PIPELINE_DEPTH;
+
+    // Count the samples of the buffer covered by the batches in flight, which are skipped by
+    // the next batches. The spool counts its own records in flight
+    int bufferSamplesInFlight = 0;
+    // Store whether a batch failed, so that the batches after it are dropped as they complete
+    bool rewinding = false;
+
+    #if DATABASE_TRANSPORT == TRANSPORT_STREAM
+        // Keep a persistent connection to stream the batches to the collector server
+        StreamTransport streamTransport;
+    #endif
 
     // Create a counter to help to fill the JSON object until a certain size
     int jsonSize = 0;
 
-    // Store the current date
-    char sampleDate[12];
+    // Adapt the size of the batches to the backlog and to the push latency
+    BatchController batchController;
+
+    // Select the channels that changed since the last values sent
+    ChangeFilter changeFilter;
+
+    // Hold the samples that overflowed the buffer, on the flash memory
+    Spool spool;
+    // Store the records read from the spool for the batch being sent
+    spoolRecord spoolBatch[BATCH_SIZE_MAX];
+
+    // Track the shard of time of the samples being sent
+    Partitioner partitioner;
+
+    // Follow the heap, to relieve it before it gets too fragmented for the uploads
+    HeapWatchdog heapWatchdog;
 
     // Set the database where the json will be pushed to
-    String DATABASE_BASE_PATH = "/yet_another_test/";
+    const char* const DATABASE_BASE_PATH = "/yet_another_test/";
 
     // Set the data path on the database where the sensor data will be stored
-    String fullDataPath;
+    char fullDataPath[DATABASE_PATH_CAPACITY];
+
+    // Store whether the batch crosses the boundary of a shard, so that it is sent to the base
+    // path with the path of the shard in the key of each sample
+    bool batchSpansShards = false;
+
+    // Store whether the device's boot was recorded on the database
+    bool bootLogged;
 
     // Store whether or not the last sample from the sensors was valid (non-zero)
     bool last_was_valid;
+    // Store the value of last_was_valid after the batch in the JSON buffer, applied only
+    // once the batch is sent and its samples are released from the buffer
+    bool batch_last_was_valid;
 
     // Set the interval between data send, in microseconds (us)
-    const int dataSendIntervalMicros = 1e6 / SEND_RATE;
+    const unsigned long dataSendIntervalMicros = 1e6 / SEND_RATE;
     // Save the time of the last data send, in microseconds (us)
     unsigned long dataPrevSendingMicros = 0;
     // Save the current time, in microseconds (us)
     unsigned long currentMicros = 0;
 
+    // Count the messages, samples and bytes sent since the last report of the upload statistics
+    uint32_t sentMessages = 0;
+    uint32_t sentSamples = 0;
+    uint32_t sentBytes = 0;
+    // Save the time of the last report of the upload statistics, in milliseconds (ms)
+    unsigned long statsPrevReportMillis = 0;
+
+    // Store the amount of samples dropped at the last report, and the time of that report, in
+    // milliseconds (ms)
+    uint32_t reportedDroppedSamples = 0;
+    unsigned long droppedPrevReportMillis = 0;
+
+    // Store the serialized telemetry snapshot
+    char telemetrySnapshot[TELEMETRY_SNAPSHOT_CAPACITY];
+    // Save the time of the last telemetry snapshot sent, in milliseconds (ms)
+    unsigned long telemetryPrevSendingMillis = 0;
+
     // Update the current time variable
     void updateCurrentTime();
 
+    // Account a sent batch and periodically report the messages/s and bytes/sample
+    void updateUploadStats(int samples, int bytes);
+
+    // Update the path of the database node that will receive the batch, from the timestamps
+    // of its first and last samples
+    void updateDataPath(unsigned long long firstTimestampMillis,
+                        unsigned long long lastTimestampMillis);
+
+    // Move the oldest samples of the buffer to the spool, before the buffer fills up, and
+    // return the amount of samples moved
+    int spillToSpool(SensorDataBuffer* dataBuffer);
+
+    // Restart the device once no batch is in flight and the whole buffer is on the spool
+    void restartWhenSafe(SensorDataBuffer* dataBuffer);
+
+    // Report the samples dropped by the data collection since the last report, as the buffer
+    // was full and the spool couldn't take its oldest samples
+    void reportDroppedSamples();
+
+    // Send a batch of the samples held by the spool
+    void sendSpooledData(SensorDataBuffer* dataBuffer);
+
+    // Send the batch of a slot through the selected transport, on the upload task of the slot
+    static bool transmitBatch(uploadSlot* slot, void* context);
+
+    // Measure the heap kept by the connection of a slot after its first request, from the free
+    // heap before the request, and log it once
+    static void measureConnection(uploadSlot* slot, uint32_t freeHeapBefore);
+
+    // Hand the batch being built to the pipeline, with the samples and the records it covers
+    void submitBatch(int bufferCount, int spoolCount);
+
+    // Complete the batches done, in order: release their samples if they were sent and adapt the
+    // batch size to the result and to the remaining backlog
+    void completeBatches(SensorDataBuffer* dataBuffer);
+
+    // Send a snapshot of the telemetry to the node of the device ("/telemetry/<device>"),
+    // through the connection of a free slot. Return false if every slot is in flight
+    bool sendTelemetry();
+
 public:
     /**
      * Constructor for the Database class
@@ -74,30 +239,93 @@ public:
 
     /**
      * Log the device's boot. Useful to analyze crashes, stability, reboots...
-     * Prints all the relevant information to the Serial Monitor
+     * Prints all the relevant information to the Serial Monitor. It is sent by sendData()
+     * once the connection works, through the connection of the first slot
+     * @return Whether or not the boot was recorded on the database
+     */
+    bool bootLog();
+
+    /**
+     * Set the amount of batches in flight at most, up to UPLOAD_PIPELINE_MAX_DEPTH. Must be
+     * called before setup()
+     * @param depth The depth of the upload pipeline
+     */
+    void setPipelineDepth(int depth);
+
+    /**
+     * Set a fixed size of the batches instead of adapting it (see BatchController.h), to
+     * compare both. Must be called before setup()
+     * @param size The size of the batches, from BATCH_SIZE_MIN to BATCH_SIZE_MAX samples
+     */
+    void setFixedBatchSize(int size);
+
+    /**
+     * Set the task that calls sendData(), woken up when a batch in flight completes
+     * @param task The task of the encode stage (see Stages.h)
      */
-    void bootLog();
+    void setEncodeTask(TaskHandle_t task);
 
     /** 
      * Setup the database connection 
-     * @param timestampUnix The timestamp of the device's boot, in Unix time
      */
-    void setup(time_t timestampUnix);
+    void setup();
 
     /**
      * Append sensor data into the JSON object
+     * @param timestampMillis The timestamp of the sensor data, in milliseconds
+     * @param data The sensor data to be appended
+     * @param channelMask The channels to be appended (see ChangeFilter.h)
+     * @return True if the sample was appended, false if the JSON body is full
+    */
+    bool appendDataToJSON(unsigned long long timestampMillis, const sensorData* data,
+                          uint16_t channelMask = CHANNEL_MASK_ALL);
+
+    /**
+     * Append sensor data into the batch of the selected transport. The stream transport
+     * always sends all the channels of the samples
+     * @param timestampMillis The timestamp of the sensor data, in milliseconds
      * @param data The sensor data to be appended
+     * @param channelMask The channels to be appended (see ChangeFilter.h)
+     * @return True if the sample was appended, false if the batch is full
     */
-    void appendDataToJSON(const sensorData* data);
+    bool appendDataToBatch(unsigned long long timestampMillis, const sensorData* data,
+                           uint16_t channelMask = CHANNEL_MASK_ALL);
+
+    /**
+     * Check if a sample still fits in the batch of the selected transport
+     * @return True if there is room for a sample of the worst case size
+     */
+    bool batchHasRoom() const;
 
     /**
-     * Send the JSON object to the database, update the node asynchronously
-     * @return Whether or not the data was successfully sent to the database
+     * Start an empty batch in the current slot. It goes on from the batches in flight, or from
+     * the last batch sent, as a batch that failed to be sent is built again
+     */
+    void beginBatch();
+
+    /**
+     * Add the changed channels of a sample to the batch, unless it is a repeated null sample
+     * @param dataBuffer The buffer containing the sensor data
+     * @param timestampMillis The timestamp of the sample, in milliseconds
+     * @param sample The sample to be added
+     * @return True if the sample is covered by the batch, false if the batch is full and the
+     * sample is left for the next one
+     */
+    bool addSampleToBatch(const SensorDataBuffer* dataBuffer,
+                          unsigned long long timestampMillis, const sensorData* sample);
+
+    /**
+     * Fill the batch with samples, in a single pass over the spans
+     * @param dataBuffer The buffer containing the sensor data
+     * @param spans The spans of samples peeked from the buffer
+     * @return The number of samples from the buffer covered by the batch
      */
-    bool pushData();
+    int buildBatch(SensorDataBuffer* dataBuffer, const sensorDataSpan spans[2]);
 
     /**
-     * Track the incoming data and fill the json buffer to be sent to the database
+     * Track the incoming data and send it to the database in batches. The samples are only
+     * released from the buffer after their batch is sent, and the next batch is built while
+     * the previous ones are in flight. It doesn't sleep, the caller waits between the calls
      * @param dataBuffer The buffer containing the sensor data
      */
     void sendData(SensorDataBuffer* dataBuffer);
@@ -13,6 +13,8 @@
 
 #include <Arduino.h>
 
+#include "AsyncLog.h"
+
 #define DEBUG_LEVEL_NONE                0 // No messages
 #define DEBUG_LEVEL_FATAL               1 // Fatal errors
 #define DEBUG_LEVEL_ERROR               2 // All errors
@@ -38,8 +40,13 @@
 #define WIFI_STATUS                     ENABLE
 #define NTP_STATUS                      ENABLE
 #define DATABASE_STATUS                 ENABLE
+// Send only the channels that changed (see ChangeFilter.h). It changes the shape of the samples
+// in the database, so it is only enabled once their readers rebuild them (see host/consumer)
+#define CHANGE_FILTER_STATUS            DISABLE
+// Print each reading of the sensors to the Serial Port, to be recorded (see host/replay)
+#define CAPTURE_STATUS                  DISABLE
 
-static const char *debugLevelLabels[] = {
+static const char *const debugLevelLabels[] = {
     "",
     "FATAL",
     "ERROR",
@@ -54,51 +61,58 @@ static const char *debugLevelLabels[] = {
 
 #define DEBUG_ENABLED 1
 
-template <typename T>
-void logArgs(const T& t) {
-    Serial.print(t);
-}
-
-template <typename T, typename... Args>
-void logArgs(const T& t, const Args&... args) {
-    Serial.print(t);
-    logArgs(args...);
-}
-
-#define LOG_LEVEL(level, ...)                   \
-    if (level <= DEBUG_LEVEL)                   \
-    {                                           \
-        Serial.print(debugLevelLabels[level]);  \
-        Serial.print(": ");                     \
-        logArgs(__VA_ARGS__);                   \
-    }
-
-#define LOG_LEVEL_LN(level, ...)                \
-    if (level <= DEBUG_LEVEL)                   \
-    {                                           \
-        Serial.print(debugLevelLabels[level]);  \
-        Serial.print(": ");                     \
-        logArgs(__VA_ARGS__);                   \
-        Serial.println();                       \
-    }
+// The macros of the levels above DEBUG_LEVEL expand to nothing, so their arguments aren't even
+// evaluated. The others only push a record to the asynchronous log (see AsyncLog.h)
+#define LOG_LEVEL(level, ...) logRecordArgs(level, false, __VA_ARGS__)
+#define LOG_LEVEL_LN(level, ...) logRecordArgs(level, true, __VA_ARGS__)
 
+#if DEBUG_LEVEL >= DEBUG_LEVEL_FATAL
 #define LogFatal(...) LOG_LEVEL(DEBUG_LEVEL_FATAL, __VA_ARGS__)
 #define LogFatalln(...) LOG_LEVEL_LN(DEBUG_LEVEL_FATAL, __VA_ARGS__)
+#else
+#define LogFatal(...)
+#define LogFatalln(...)
+#endif
 
+#if DEBUG_LEVEL >= DEBUG_LEVEL_ERROR
 #define LogError(...) LOG_LEVEL(DEBUG_LEVEL_ERROR, __VA_ARGS__)
 #define LogErrorln(...) LOG_LEVEL_LN(DEBUG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define LogError(...)
+#define LogErrorln(...)
+#endif
 
+#if DEBUG_LEVEL >= DEBUG_LEVEL_WARNING
 #define LogWarning(...) LOG_LEVEL(DEBUG_LEVEL_WARNING, __VA_ARGS__)
 #define LogWarningln(...) LOG_LEVEL_LN(DEBUG_LEVEL_WARNING, __VA_ARGS__)
+#else
+#define LogWarning(...)
+#define LogWarningln(...)
+#endif
 
+#if DEBUG_LEVEL >= DEBUG_LEVEL_INFO
 #define LogInfo(...) LOG_LEVEL(DEBUG_LEVEL_INFO, __VA_ARGS__)
 #define LogInfoln(...) LOG_LEVEL_LN(DEBUG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define LogInfo(...)
+#define LogInfoln(...)
+#endif
 
+#if DEBUG_LEVEL >= DEBUG_LEVEL_DEBUG
 #define LogDebug(...) LOG_LEVEL(DEBUG_LEVEL_DEBUG, __VA_ARGS__)
 #define LogDebugln(...) LOG_LEVEL_LN(DEBUG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define LogDebug(...)
+#define LogDebugln(...)
+#endif
 
+#if DEBUG_LEVEL >= DEBUG_LEVEL_VERBOSE
 #define LogVerbose(...) LOG_LEVEL(DEBUG_LEVEL_VERBOSE, __VA_ARGS__)
 #define LogVerboseln(...) LOG_LEVEL_LN(DEBUG_LEVEL_VERBOSE, __VA_ARGS__)
+#else
+#define LogVerbose(...)
+#define LogVerboseln(...)
+#endif
 
 #else
 
@@ -0,0 +1,47 @@
+#include "Decimator.h"
+
+Decimator::Decimator() {
+    memset(integrators, 0, sizeof(integrators));
+    memset(combDelays, 0, sizeof(combDelays));
+}
+
+bool Decimator::update(const uint16_t reading[SENSOR_CHANNEL_COUNT],
+                       uint16_t output[SENSOR_CHANNEL_COUNT]) {
+    // The integrators run at the oversampled rate
+    for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+        integrators[0][i] += reading[i];
+    }
+    for (int stage = 1; stage < DECIMATOR_ORDER; stage++) {
+        for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+            integrators[stage][i] += integrators[stage - 1][i];
+        }
+    }
+
+    if (++phase < OVERSAMPLING_RATIO) {
+        return false;
+    }
+    phase = 0;
+
+    // The combs run at the decimated rate, each one subtracting its previous input
+    uint32_t values[SENSOR_CHANNEL_COUNT];
+    memcpy(values, integrators[DECIMATOR_ORDER - 1], sizeof(values));
+
+    for (int stage = 0; stage < DECIMATOR_ORDER; stage++) {
+        for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+            uint32_t delayed = combDelays[stage][i];
+            combDelays[stage][i] = values[i];
+            values[i] -= delayed;
+        }
+    }
+
+    if (warmupOutputs > 0) {
+        warmupOutputs--;
+        return false;
+    }
+
+    for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+        output[i] = values[i] >> DECIMATOR_GAIN_LOG2;
+    }
+
+    return true;
+}
@@ -0,0 +1,59 @@
+/*
+    Decimator.h
+
+    * This module implements the oversampling front end of the data collection: the channels
+    are sampled OVERSAMPLING_RATIO times faster than SAMPLE_RATE and a CIC (cascaded
+    integrator-comb) decimator averages them back to SAMPLE_RATE, reducing the noise of the
+    readings (mainly the ones of the internal ADC).
+    * The filter is integer-only: the integrators wrap around on overflow, which the combs
+    cancel exactly, and the gain (a power of two) is removed by a shift.
+    * The channels are kept in packed arrays, so each stage is a branch-free loop over them.
+*/
+
+#ifndef Decimator_H_
+#define Decimator_H_
+
+#include "Buffer.h"
+
+// Set the decimation ratio as a power of two (2^3 = 8 readings per sample, 0 disables it)
+const int OVERSAMPLING_RATIO_LOG2 = 3;
+const int OVERSAMPLING_RATIO = 1 << OVERSAMPLING_RATIO_LOG2;
+
+// Set the order of the filter (the amount of integrator and comb stages). Order 1 is a boxcar
+// average, the higher ones attenuate more the noise above SAMPLE_RATE / 2
+const int DECIMATOR_ORDER = 2;
+
+// Define the shift that removes the gain of the filter, OVERSAMPLING_RATIO ^ DECIMATOR_ORDER
+const int DECIMATOR_GAIN_LOG2 = DECIMATOR_ORDER * OVERSAMPLING_RATIO_LOG2;
+static_assert(DECIMATOR_ORDER >= 1, "The decimator needs at least one stage");
+static_assert(16 + DECIMATOR_GAIN_LOG2 <= 32, "The filter output doesn't fit in 32 bits");
+
+/**
+ * Class that decimates the readings of the pressure sensors with a CIC filter
+ */
+class Decimator {
+    // Store the state of each stage, for all the channels
+    uint32_t integrators[DECIMATOR_ORDER][SENSOR_CHANNEL_COUNT];
+    uint32_t combDelays[DECIMATOR_ORDER][SENSOR_CHANNEL_COUNT];
+
+    // Count the readings of the current output
+    int phase = 0;
+    // Count the first outputs, computed before the filter is filled, that are discarded
+    int warmupOutputs = DECIMATOR_ORDER - 1;
+
+public:
+    /** Initialize the filter with all the stages at 0 */
+    Decimator();
+
+    /**
+     * Add a reading of all the channels to the filter
+     * 
+     * @param reading the values of the channels
+     * @param output the decimated values, written once every OVERSAMPLING_RATIO readings
+     * @return true if the output was written, false otherwise
+     */
+    bool update(const uint16_t reading[SENSOR_CHANNEL_COUNT],
+                uint16_t output[SENSOR_CHANNEL_COUNT]);
+};
+
+#endif  // Decimator_H_
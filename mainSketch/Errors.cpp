@@ -30,7 +30,7 @@ void Errors::showError(ErrorType error, bool fatal) {
 
     // If the error is fatal, restart the device after 3 seconds
     if (fatal) {
-        LogFatalln("Reiniciando o dispositivo em 3 segundos...");
+        LogFatalln("Reiniciando o dispositivo em 3 segundos..."_log);
         delay(3000);
         ESP.restart();
     }
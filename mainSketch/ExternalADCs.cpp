@@ -1,66 +1,79 @@
 #include "ExternalADCs.h"
+#include "Clock.h"
+#include "Telemetry.h"
 #include "Debug.h"
 
 // #define DEBUG_EXTERNAL_ADCS
 
-// Set the list of channels that will be iterated during the data collection
-const ADS1115_MUX channels[4] = {ADS1115_COMP_3_GND, ADS1115_COMP_2_GND,
-                                ADS1115_COMP_1_GND, ADS1115_COMP_0_GND};
+// Set the list of inputs that will be iterated during the data collection
+const uint8_t channels[EXTERNAL_ADC_CHANNEL_COUNT] = {3, 2, 1, 0};
+
+// Scale a raw result to the range of the reads, as map(raw, -32768, 32767, -range, range)
+static int scaleResult(int16_t raw) {
+    return (static_cast<long>(raw) + 32768) * (2 * EXTERNAL_ADC_RESULT_RANGE) / 65535
+           - EXTERNAL_ADC_RESULT_RANGE;
+}
 
 // Setup the external ADCs
 bool ExternalADCs::setup() {
-    // Instantiate the external ADCs, according to each address
-    adcs[0] = ADS1115_WE(I2C_ADDRESS_1);
-    adcs[1] = ADS1115_WE(I2C_ADDRESS_2);
+    // Run the bus in fast mode, the ADCs are the only devices on it
+    Wire.setClock(I2C_CLOCK_HZ);
 
-    #ifdef DEBUG_EXTERNAL_ADCS
+    // Initialize both the external ADCs, according to each address
+    const uint8_t addresses[EXTERNAL_ADC_COUNT] = {I2C_ADDRESS_1, I2C_ADDRESS_2};
+    for (int i = 0; i < EXTERNAL_ADC_COUNT; i++) {
+        bool connected = adcs[i].setup(Wire, addresses[i], EXTERNAL_ADC_CONFIG);
 
-        return true;
+        #ifndef DEBUG_EXTERNAL_ADCS
 
-    #else
-
-        // Initialize both the external ADCs
-        for (int i = 0; i < 2; i++) {
             // If the ADCs are not connected, show an error and restart the device
-            if (!adcs[i].init()) {
-                LogFatalln("ADS1115 No ", i, " not connected!")
+            if (!connected) {
+                LogFatalln("ADS1115 No "_log, i, " not connected!"_log);
 
                 errorHandler.showError(ErrorType::ExternalADCInitFailure, true);
                 return false;
             }
-            // Set the voltage range of the ADCs
-            adcs[i].setVoltageRange_mV(VOLTAGE_RANGE);
-            // Set the conversion rate (SPS: Samples per second) of the ADCs
-            adcs[i].setConvRate(CONVERSION_RATE);
-            // Set the measure mode (SINGLE or CONTINUOUS) of the ADCs
-            adcs[i].setMeasureMode(MEASURE_MODE);
-        }
+
+        #endif
+    }
 
     return true;
+}
+
+int ExternalADCs::getChannelCount() const {
+    return EXTERNAL_ADC_CHANNEL_COUNT;
+}
 
-    #endif
+// Start a conversion on the external ADCs in parallel, according to the channel index
+void ExternalADCs::startConversion(int channelIndex) {
+    // Set the channel and start the measurement, in a single transaction for each ADC
+    adcs[0].startConversion(channels[channelIndex]);
+    adcs[1].startConversion(channels[channelIndex]);
+
+    conversionStartMicros = clockMicros();
 }
 
-// Read the external ADCs in parallel, according to the channel index
-void ExternalADCs::read(int channelIndex) {
-    // Choose the channel to be read
-    ADS1115_MUX channel = channels[channelIndex];
-
-    // Set the channel in the ADCs
-    adcs[0].setCompareChannels(channel);
-    adcs[1].setCompareChannels(channel);
-
-    // Start the measurement, if the mode is SINGLE
-    if (MEASURE_MODE == ADS1115_SINGLE) {
-        adcs[0].startSingleMeasurement();
-        adcs[1].startSingleMeasurement();
-        // Wait until the measurement is done
-        while (adcs[0].isBusy() || adcs[1].isBusy()) {}
+// Check if the conversion is done, without waiting for it
+bool ExternalADCs::isConversionDone() {
+    // The conversion can't be done before its nominal duration, so the bus is left alone
+    unsigned long waitMicros = clockMicros() - conversionStartMicros;
+    if (waitMicros < CONVERSION_TIME_MICROS) {
+        return false;
+    }
+
+    if (adcs[0].isBusy() || adcs[1].isBusy()) {
+        return false;
     }
 
+    telemetry.record(TelemetryStage::AdcWait, waitMicros);
+    return true;
+}
+
+// Collect the results of the last finished conversion
+void ExternalADCs::collectConversion() {
     // Read the results of the ADCs
-    externalAdcsValues[0] = adcs[0].getResultWithRange(-5082, 5082);
-    externalAdcsValues[1] = adcs[1].getResultWithRange(-5082, 5082);
+    externalAdcsValues[0] = scaleResult(adcs[0].readConversion());
+    externalAdcsValues[1] = scaleResult(adcs[1].readConversion());
 }
 
 // Get the read from the external ADCs, according to the index
@@ -68,3 +81,7 @@ int ExternalADCs::get(int index) const {
     // Fit the values into a positive range before giving the read
     return max(0, externalAdcsValues[index]);
 }
+
+unsigned long ExternalADCs::takeBusMicros() {
+    return adcs[0].takeBusMicros() + adcs[1].takeBusMicros();
+}
@@ -5,24 +5,44 @@
     * It setups the external ADCs and checks the status of the initialization process.
     * It also reads the data from the external ADCs in parallel, according to the channel
     index, and stores it in the externalAdcsValues array (as an internal buffer).
+    * The conversions are non-blocking: a conversion is started on both ADCs, its completion
+    is polled without waiting and its results are collected afterwards.
+    * The ADCs are driven through their registers (see ADS1115.h), on a fast mode I2C bus, and
+    the time spent on the bus is reported for each sample.
 */
 
 #ifndef ExternalADCs_H_
 #define ExternalADCs_H_
 
-#include <ADS1115_WE.h>
 #include <Wire.h>
 
+#include "ADS1115.h"
 #include "Errors.h"
 
 // Define the addresses of the external ADCs connected to the I2C bus
 #define I2C_ADDRESS_1 0x48
 #define I2C_ADDRESS_2 0x49
 
-// Define constants to setup the external ADCs (Analog to Digital Converter)
-#define VOLTAGE_RANGE ADS1115_RANGE_4096
-#define MEASURE_MODE ADS1115_SINGLE
-#define CONVERSION_RATE ADS1115_860_SPS
+// Define the amount of external ADCs, converted in parallel, and of channels read on each one
+const int EXTERNAL_ADC_COUNT = 2;
+const int EXTERNAL_ADC_CHANNEL_COUNT = 4;
+
+// Set the clock of the I2C bus, in Hertz (Hz). 400 kHz is the fast mode of the ADS1115, the
+// faster ones need its high-speed mode, which the I2C driver of the ESP32 doesn't support
+#define I2C_CLOCK_HZ 400000
+
+// Define the configuration of the external ADCs (Analog to Digital Converter): +-4.096 V range,
+// single-shot conversions at 860 SPS, without the comparator
+const uint16_t EXTERNAL_ADC_CONFIG = ADS1115_CONFIG_RANGE_4096 | ADS1115_CONFIG_SINGLE_SHOT
+                                     | ADS1115_CONFIG_RATE_860_SPS
+                                     | ADS1115_CONFIG_COMPARATOR_OFF;
+
+// Define the range to which the raw results of the ADCs are scaled
+const int EXTERNAL_ADC_RESULT_RANGE = 5082;
+
+// Set the time that a single conversion takes at 860 SPS, in microseconds (us).
+// Before that, the ADCs are not even polled, to avoid useless traffic on the I2C bus
+const unsigned long CONVERSION_TIME_MICROS = 1e6 / 860;
 
 
 /**
@@ -32,11 +52,14 @@
  */
 class ExternalADCs {
 
-    // Instantiate 2 ADS1115_WE objects, one for each external ADC
-    ADS1115_WE adcs[2];
+    // Instantiate 2 ADS1115 objects, one for each external ADC
+    ADS1115 adcs[EXTERNAL_ADC_COUNT];
 
     // Save the reads from the ADCs
-    int externalAdcsValues[2];
+    int externalAdcsValues[EXTERNAL_ADC_COUNT];
+
+    // Save the time when the last conversion was started, in microseconds (us)
+    unsigned long conversionStartMicros = 0;
 
  public:
 
@@ -48,11 +71,33 @@ class ExternalADCs {
     bool setup();
 
     /**
-     * Read the external ADCs in parallel, according to the channel index
+     * Get the amount of channels of each external ADC
+     * 
+     * @return the amount of channels of each external ADC
+     */
+    int getChannelCount() const;
+
+    /**
+     * Start a conversion on both external ADCs in parallel, according to the channel index.
+     * It returns right away, without waiting for the conversion
      * 
      * @param channelIndex the index of the channel to read from
      */
-    void read(int channelIndex);
+    void startConversion(int channelIndex);
+
+    /**
+     * Check, without waiting, if the conversion started on both external ADCs is done
+     * 
+     * @return true if the conversion is done, false otherwise
+     */
+    bool isConversionDone();
+
+    /**
+     * Collect the results of the last finished conversion of both external ADCs.
+     * The results stay available until the following conversion is done, so they can still
+     * be collected right after the next conversion is started
+     */
+    void collectConversion();
 
     /**
      * Get the read from the external ADCs, according to the index
@@ -61,6 +106,13 @@ class ExternalADCs {
      * @return the read from the external ADCs
      */
     int get(int index) const;
+
+    /**
+     * Get the time spent on the I2C bus by both external ADCs since the last call
+     * 
+     * @return the time spent on the bus, in microseconds (us)
+     */
+    unsigned long takeBusMicros();
 };
 
 #endif  // ExternalADCs_H_
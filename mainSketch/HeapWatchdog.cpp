@@ -0,0 +1,74 @@
+#include <esp_heap_caps.h>
+
+#include "HeapWatchdog.h"
+#include "Clock.h"
+#include "Debug.h"
+
+void HeapWatchdog::updateTrend() {
+    if (windowSamples == 0) {
+        windowStartLargestFreeBlock = largestFreeBlock;
+    }
+    if (++windowSamples <= HEAP_TREND_WINDOW_SAMPLES) {
+        return;
+    }
+
+    // The blocks come and go with each request, so the slope of each window is smoothed
+    float windowHours = HEAP_TREND_WINDOW_SAMPLES * HEAP_WATCHDOG_INTERVAL_MILLIS / 3600000.0f;
+    float windowTrend = (static_cast<float>(largestFreeBlock) - windowStartLargestFreeBlock)
+                        / windowHours;
+    largestFreeBlockTrend = largestFreeBlockTrend == 0
+                                ? windowTrend
+                                : (largestFreeBlockTrend + windowTrend) / 2;
+    windowSamples = 0;
+
+    LogInfoln("Heap: "_log, freeHeap, " B free, largest block "_log, largestFreeBlock,
+              " B (min "_log, minLargestFreeBlock, ", trend "_log, largestFreeBlockTrend,
+              " B/h)"_log);
+}
+
+HeapState HeapWatchdog::update() {
+    unsigned long currentMillis = clockMillis();
+    if (sampled && currentMillis - samplePrevMillis < HEAP_WATCHDOG_INTERVAL_MILLIS) {
+        return state;
+    }
+    samplePrevMillis = currentMillis;
+    sampled = true;
+
+    freeHeap = ESP.getFreeHeap();
+    largestFreeBlock = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    minLargestFreeBlock = min(minLargestFreeBlock, largestFreeBlock);
+    updateTrend();
+
+    // Project the largest block over the horizon, when it shrinks
+    float projectedLargestFreeBlock = largestFreeBlock;
+    if (largestFreeBlockTrend < 0) {
+        projectedLargestFreeBlock += largestFreeBlockTrend * HEAP_TREND_HORIZON_MILLIS / 3600000.0f;
+    }
+
+    HeapState newState = HeapState::Healthy;
+    if (largestFreeBlock < HEAP_LARGEST_BLOCK_CRITICAL) {
+        newState = HeapState::Critical;
+    } else if (largestFreeBlock < HEAP_LARGEST_BLOCK_DEGRADED
+                   || projectedLargestFreeBlock < HEAP_LARGEST_BLOCK_CRITICAL) {
+        newState = HeapState::Degraded;
+    }
+
+    if (newState != state) {
+        state = newState;
+        LogWarningln("Heap "_log, state == HeapState::Healthy    ? "healthy"_log
+                              : state == HeapState::Degraded ? "degraded"_log
+                                                             : "critical"_log,
+                     ": "_log, freeHeap, " B free, largest block "_log, largestFreeBlock,
+                     " B (trend "_log, largestFreeBlockTrend, " B/h)"_log);
+    }
+
+    return state;
+}
+
+HeapState HeapWatchdog::getState() const {
+    return state;
+}
+
+float HeapWatchdog::getLargestFreeBlockTrend() const {
+    return largestFreeBlockTrend;
+}
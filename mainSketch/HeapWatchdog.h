@@ -0,0 +1,96 @@
+/*
+    HeapWatchdog.h
+
+    * This module follows the heap of the device over the weeks it runs: the free heap, the
+    largest free block and the trend of the largest block, from samples taken periodically.
+    * The data path doesn't allocate once it runs (see JsonBatch.h and UploadPipeline.h), but
+    the network libraries do on each request. When the heap fragments, the largest free block
+    shrinks until the TLS handshakes, which need a large contiguous block, start to fail.
+    * The watchdog acts before that happens: when the largest block gets low, or is projected
+    to get there soon at its current trend, the heap is degraded and the uploads are sent one at
+    a time. When it gets critically low, a restart is due, which the database makes at a safe
+    point, once the samples are held by the spool (see Database.h).
+*/
+
+#ifndef HeapWatchdog_H_
+#define HeapWatchdog_H_
+
+#include <Arduino.h>
+
+// Set the interval between the samples of the heap, in milliseconds (ms)
+const unsigned long HEAP_WATCHDOG_INTERVAL_MILLIS = 10000;
+
+// Set the amount of samples over which the trend of the largest free block is measured
+const int HEAP_TREND_WINDOW_SAMPLES = 30;
+
+// Set the largest free block below which the heap is degraded, in bytes. A TLS handshake
+// needs about this much in a single block
+const uint32_t HEAP_LARGEST_BLOCK_DEGRADED = 40 * 1024;
+// Set the largest free block below which the device is restarted, in bytes
+const uint32_t HEAP_LARGEST_BLOCK_CRITICAL = 24 * 1024;
+
+// Set how far ahead the trend is projected to degrade the heap early, in milliseconds (ms)
+const unsigned long HEAP_TREND_HORIZON_MILLIS = 6UL * 60 * 60 * 1000;
+
+/**
+ * Enumerate the states of the heap
+ *
+ * Healthy: the largest free block is large enough for the uploads
+ * Degraded: the largest free block is low, or shrinks fast enough to get critical soon
+ * Critical: the largest free block is too small, the device is due for a restart
+ */
+enum class HeapState : uint8_t {
+    Healthy,
+    Degraded,
+    Critical
+};
+
+/**
+ * Class that samples the heap, keeps its trend and tells when it must be relieved
+ */
+class HeapWatchdog {
+    HeapState state = HeapState::Healthy;
+
+    // Store the last samples of the heap, in bytes
+    uint32_t freeHeap = 0;
+    uint32_t largestFreeBlock = 0;
+    // Store the smallest largest free block since the boot, in bytes (the smallest free heap
+    // is kept by the ESP32 itself)
+    uint32_t minLargestFreeBlock = UINT32_MAX;
+
+    // Store the largest free block at the start of the trend window, and the amount of samples
+    // taken in the window
+    uint32_t windowStartLargestFreeBlock = 0;
+    int windowSamples = 0;
+    // Store the trend of the largest free block, smoothed over the windows, in bytes per hour
+    float largestFreeBlockTrend = 0;
+
+    // Save the time of the last sample of the heap, in milliseconds (ms)
+    unsigned long samplePrevMillis = 0;
+    bool sampled = false;
+
+    // Update the trend of the largest free block with the last sample
+    void updateTrend();
+
+public:
+    /**
+     * Sample the heap if the interval elapsed, and update its state. Logs the samples at each
+     * change of state and at the end of each trend window
+     * @return The state of the heap
+     */
+    HeapState update();
+
+    /**
+     * Get the state of the heap from the last sample
+     * @return The state of the heap
+     */
+    HeapState getState() const;
+
+    /**
+     * Get the trend of the largest free block
+     * @return The change of the largest free block, in bytes per hour (negative if it shrinks)
+     */
+    float getLargestFreeBlockTrend() const;
+};
+
+#endif  // HeapWatchdog_H_
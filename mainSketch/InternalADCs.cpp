@@ -0,0 +1,112 @@
+#include "InternalADCs.h"
+#include "Debug.h"
+
+bool IRAM_ATTR InternalADCs::onPoolOverflow(adc_continuous_handle_t,
+                                            const adc_continuous_evt_data_t*,
+                                            void* internalAdcs) {
+    static_cast<InternalADCs*>(internalAdcs)->overflowCount++;
+
+    // No task needs to be woken up
+    return false;
+}
+
+bool InternalADCs::setup(const uint8_t* pins, int count, bool averageConversions) {
+    pinCount = min(count, INTERNAL_ADC_MAX_PINS);
+    averaging = averageConversions;
+    memset(channelPins, -1, sizeof(channelPins));
+
+    // Convert the pins in turns, with the attenuation of analogRead() (0 to ~3.1 V)
+    adc_digi_pattern_config_t patterns[INTERNAL_ADC_MAX_PINS];
+    for (int i = 0; i < pinCount; i++) {
+        adc_unit_t unit;
+        adc_channel_t channel;
+        if (adc_continuous_io_to_channel(pins[i], &unit, &channel) != ESP_OK
+                || unit != ADC_UNIT_1 || channel >= INTERNAL_ADC_CHANNEL_COUNT) {
+            LogErrorln("The pin "_log, pins[i], " isn't on the internal ADC (ADC1)"_log);
+            return false;
+        }
+
+        channelPins[channel] = i;
+        patterns[i].atten = ADC_ATTEN_DB_11;
+        patterns[i].channel = channel;
+        patterns[i].unit = ADC_UNIT_1;
+        patterns[i].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+    }
+
+    adc_continuous_handle_cfg_t handleConfig = {};
+    handleConfig.max_store_buf_size = INTERNAL_ADC_POOL_SIZE;
+    handleConfig.conv_frame_size = INTERNAL_ADC_FRAME_SIZE;
+    if (adc_continuous_new_handle(&handleConfig, &handle) != ESP_OK) {
+        LogErrorln("Could not create the driver of the internal ADC"_log);
+        return false;
+    }
+
+    adc_continuous_config_t config = {};
+    config.pattern_num = pinCount;
+    config.adc_pattern = patterns;
+    config.sample_freq_hz = INTERNAL_ADC_CONVERSION_RATE;
+    config.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+    config.format = ADC_DIGI_OUTPUT_FORMAT_TYPE1;
+
+    adc_continuous_evt_cbs_t callbacks = {};
+    callbacks.on_pool_ovf = onPoolOverflow;
+
+    if (adc_continuous_config(handle, &config) != ESP_OK
+            || adc_continuous_register_event_callbacks(handle, &callbacks, this) != ESP_OK
+            || adc_continuous_start(handle) != ESP_OK) {
+        LogErrorln("Could not start the conversions of the internal ADC"_log);
+        return false;
+    }
+
+    return true;
+}
+
+void InternalADCs::unpackFrame(const uint8_t* data, uint32_t length) {
+    const adc_digi_output_data_t* results = reinterpret_cast<const adc_digi_output_data_t*>(data);
+    uint32_t resultCount = length / SOC_ADC_DIGI_RESULT_BYTES;
+
+    for (uint32_t i = 0; i < resultCount; i++) {
+        uint32_t channel = results[i].type1.channel;
+        int pin = channel < INTERNAL_ADC_CHANNEL_COUNT ? channelPins[channel] : -1;
+        if (pin < 0) {
+            continue;
+        }
+
+        uint16_t value = results[i].type1.data;
+        sums[pin] += value;
+        counts[pin]++;
+        values[pin] = value;
+    }
+
+    conversionCount += resultCount;
+}
+
+void InternalADCs::collect(uint16_t* readings) {
+    // Drain the frames converted since the last reading, without waiting for the next one
+    uint32_t length = 0;
+    while (adc_continuous_read(handle, frame, sizeof(frame), &length, 0) == ESP_OK) {
+        unpackFrame(frame, length);
+    }
+
+    for (int i = 0; i < pinCount; i++) {
+        if (averaging && counts[i] > 0) {
+            values[i] = (sums[i] + counts[i] / 2) / counts[i];
+        }
+        sums[i] = 0;
+        counts[i] = 0;
+
+        readings[i] = values[i];
+    }
+
+    // The frames dropped while the pool was full leave a gap in the averages
+    uint32_t overflows = overflowCount;
+    if (overflows != reportedOverflowCount) {
+        LogWarningln("The pool of the internal ADC was full "_log,
+                     overflows - reportedOverflowCount, " times, conversions were dropped"_log);
+        reportedOverflowCount = overflows;
+    }
+}
+
+uint32_t InternalADCs::getConversionCount() const {
+    return conversionCount;
+}
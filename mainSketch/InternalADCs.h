@@ -0,0 +1,106 @@
+/*
+    InternalADCs.h
+
+    * This module handles the pressure sensors hooked up to the internal ADC (ADC1).
+    * Instead of a blocking analogRead() of each pin at each reading, the digital controller of
+    ADC1 converts all the pins in the background, at a fixed rate, and its DMA fills frames of
+    results in a pool kept by the driver.
+    * At each reading, the frames converted since the previous one are drained without waiting
+    and unpacked: the value of each pin is the average of its conversions over the interval,
+    which also filters the noise of the ADC, or its last conversion if the averaging is disabled.
+*/
+
+#ifndef InternalADCs_H_
+#define InternalADCs_H_
+
+#include <Arduino.h>
+#include <esp_adc/adc_continuous.h>
+
+// Define the largest amount of pins converted by the internal ADC
+const int INTERNAL_ADC_MAX_PINS = 4;
+// Define the amount of channels of ADC1
+const int INTERNAL_ADC_CHANNEL_COUNT = 10;
+
+// Set the rate of the conversions of the internal ADC, over all its pins, in conversions per
+// second. 20 kHz is the lowest rate of the digital controller of the ESP32
+const uint32_t INTERNAL_ADC_CONVERSION_RATE = 20000;
+
+// Set the size of the DMA frames and of the pool of frames kept by the driver, in bytes. The
+// pool holds about 100 ms of conversions, longer than the interval between two readings
+const uint32_t INTERNAL_ADC_FRAME_SIZE = 256;
+const uint32_t INTERNAL_ADC_POOL_SIZE = 4096;
+
+// Average the conversions of each pin between two readings, or take the last one of each pin
+const bool INTERNAL_ADC_AVERAGING = true;
+
+/**
+ * Class that converts the pins of the internal ADC in the background and collects their values
+ * at each reading
+ */
+class InternalADCs {
+    adc_continuous_handle_t handle = nullptr;
+
+    // Store the amount of pins and the index of the pin of each channel of ADC1 (-1 if none)
+    int pinCount = 0;
+    int8_t channelPins[INTERNAL_ADC_CHANNEL_COUNT];
+    bool averaging = INTERNAL_ADC_AVERAGING;
+
+    // Accumulate the conversions of each pin since the last reading, and keep its last value
+    uint32_t sums[INTERNAL_ADC_MAX_PINS] = {0};
+    uint32_t counts[INTERNAL_ADC_MAX_PINS] = {0};
+    uint16_t values[INTERNAL_ADC_MAX_PINS] = {0};
+
+    // Receive the frames drained from the pool
+    uint8_t frame[INTERNAL_ADC_FRAME_SIZE];
+
+    // Count the conversions unpacked, and the times the pool was full and frames were dropped
+    uint32_t conversionCount = 0;
+    volatile uint32_t overflowCount = 0;
+    uint32_t reportedOverflowCount = 0;
+
+    /**
+     * Count a full pool, called by the driver from its interrupt
+     *
+     * @param internalAdcs the InternalADCs whose pool is full
+     */
+    static bool IRAM_ATTR onPoolOverflow(adc_continuous_handle_t handle,
+                                         const adc_continuous_evt_data_t* event,
+                                         void* internalAdcs);
+
+    /**
+     * Add the conversions of a frame to the pins
+     *
+     * @param data the frame, as given by the driver
+     * @param length the size of the frame, in bytes
+     */
+    void unpackFrame(const uint8_t* data, uint32_t length);
+
+public:
+
+    /**
+     * Start converting the pins in the background
+     *
+     * @param pins the pins to be converted, all on ADC1
+     * @param count the amount of pins, up to INTERNAL_ADC_MAX_PINS
+     * @param averageConversions whether the conversions between two readings are averaged
+     * @return true if the conversions were started, false otherwise
+     */
+    bool setup(const uint8_t* pins, int count, bool averageConversions = INTERNAL_ADC_AVERAGING);
+
+    /**
+     * Drain the frames converted since the last call, without waiting, and give the value of
+     * each pin. A pin without any new conversion keeps its last value
+     *
+     * @param readings where the values are stored, in the order of the pins
+     */
+    void collect(uint16_t* readings);
+
+    /**
+     * Get the amount of conversions unpacked since the setup
+     *
+     * @return the amount of conversions
+     */
+    uint32_t getConversionCount() const;
+};
+
+#endif  // InternalADCs_H_
@@ -0,0 +1,127 @@
+#include "JsonBatch.h"
+
+// Write a 32-bit unsigned integer in decimal and return the next position. The digits are
+// written backwards into a small array, as divisions by constants become multiplications
+static char* writeDecimal(char* position, uint32_t value) {
+    char digits[10];
+    int count = 0;
+
+    do {
+        digits[count++] = '0' + value % 10;
+        value /= 10;
+    } while (value != 0);
+
+    while (count > 0) {
+        *position++ = digits[--count];
+    }
+
+    return position;
+}
+
+// Write a 64-bit unsigned integer in decimal and return the next position. There is no 64-bit
+// division in hardware, so it is only used once to split the value in 32-bit halves
+static char* writeDecimal64(char* position, unsigned long long value) {
+    const uint32_t lowDigitsDivisor = 100000000;
+
+    if (value < lowDigitsDivisor) {
+        return writeDecimal(position, static_cast<uint32_t>(value));
+    }
+
+    unsigned long long high = value / lowDigitsDivisor;
+    uint32_t low = static_cast<uint32_t>(value - high * lowDigitsDivisor);
+
+    position = writeDecimal64(position, high);
+
+    // The lower half is padded with zeros to always take 8 digits
+    for (int i = 7; i >= 0; i--) {
+        position[i] = '0' + low % 10;
+        low /= 10;
+    }
+
+    return position + 8;
+}
+
+JsonBatch::JsonBatch() {
+    clear();
+}
+
+void JsonBatch::clear() {
+    body[0] = '{';
+    length = 1;
+    sampleCount = 0;
+}
+
+bool JsonBatch::hasRoom() const {
+    return length + JSON_MAX_SAMPLE_SIZE <= JSON_BATCH_CAPACITY;
+}
+
+bool JsonBatch::appendSample(unsigned long long timestampMillis, const sensorData* data,
+                             const char* keyPrefix, uint16_t channelMask) {
+    if (!hasRoom()) {
+        return false;
+    }
+
+    char* position = &body[length];
+
+    if (sampleCount > 0) {
+        *position++ = ',';
+    }
+
+    // Set the node where the data will be stored as the milliseconds timestamp
+    *position++ = '"';
+    if (keyPrefix != nullptr) {
+        for (int i = 0; i < SHARD_PATH_CAPACITY && keyPrefix[i] != '\0'; i++) {
+            *position++ = keyPrefix[i];
+        }
+    }
+    position = writeDecimal64(position, timestampMillis);
+    *position++ = '"';
+    *position++ = ':';
+
+    if (channelMask == CHANNEL_MASK_ALL) {
+        // Add the pressure sensors' data as an array
+        *position++ = '[';
+        for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+            position = writeDecimal(position, data->pressureSensor[i]);
+            *position++ = ',';
+        }
+        // Replace the last comma with the closing bracket
+        position[-1] = ']';
+    } else {
+        // Add only the changed channels, indexed by channel
+        *position++ = '{';
+        for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+            if (channelMask & (1 << i)) {
+                *position++ = '"';
+                position = writeDecimal(position, i);
+                *position++ = '"';
+                *position++ = ':';
+                position = writeDecimal(position, data->pressureSensor[i]);
+                *position++ = ',';
+            }
+        }
+        // Replace the last comma with the closing brace
+        position[-1] = '}';
+    }
+
+    length = position - body;
+    sampleCount++;
+
+    return true;
+}
+
+int JsonBatch::getSampleCount() const {
+    return sampleCount;
+}
+
+int JsonBatch::getLength() const {
+    return length + 1;
+}
+
+const char* JsonBatch::getBody() {
+    // Close the object without counting the brace, so that more samples can still be appended
+    body[length] = '}';
+    body[length + 1] = '\0';
+
+    return body;
+}
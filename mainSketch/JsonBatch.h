@@ -0,0 +1,94 @@
+/*
+    JsonBatch.h
+
+    * This module serializes batches of samples into JSON, in the same shape that the
+    database expects: {"TIMESTAMP_MILLIS":[SENSOR_1_VALUE,...,SENSOR_12_VALUE],...}
+    * The sparse records of the ChangeFilter only carry some channels, as an object indexed by
+    channel: {"TIMESTAMP_MILLIS":{"CHANNEL":VALUE,...},...}
+    * The JSON is written straight into a fixed, preallocated array, using integer to ASCII
+    conversions that avoid the String class and any heap allocation.
+*/
+
+#ifndef JsonBatch_H_
+#define JsonBatch_H_
+
+#include "Buffer.h"
+#include "ChangeFilter.h"
+#include "Partitioner.h"
+
+// Define the capacity of the serialized JSON, in bytes
+const int JSON_BATCH_CAPACITY = 8192;
+
+// Define the worst case size of a serialized sample, in bytes: the separator, the quoted key
+// (path of a shard and timestamp with 20 digits), the colon, the braces and each value
+// (5 digits) with its quoted channel (2 digits), colon and comma
+const int JSON_MAX_SAMPLE_SIZE =
+    1 + (SHARD_PATH_CAPACITY + 20 + 2) + 1 + 2 + SENSOR_CHANNEL_COUNT * (4 + 1 + 5 + 1);
+
+/**
+ * Class that serializes a batch of samples into JSON, in a preallocated array.
+ * The samples are appended one by one and the finished body is obtained with getBody().
+ */
+class JsonBatch {
+    // Store the serialized JSON, with room for the closing brace and the null terminator
+    char body[JSON_BATCH_CAPACITY + 2];
+    // Number of bytes used in the body, without the closing brace
+    int length = 0;
+    // Number of samples in the batch
+    int sampleCount = 0;
+
+public:
+
+    /** Initialize an empty batch */
+    JsonBatch();
+
+    /**
+     * Discard the samples of the batch
+     */
+    void clear();
+
+    /**
+     * Check if a sample still fits in the batch, whatever its channels and key
+     * 
+     * @return true if there is room for a sample of the worst case size
+     */
+    bool hasRoom() const;
+
+    /**
+     * Append a sample to the batch
+     * 
+     * @param timestampMillis the timestamp of the sample, in milliseconds
+     * @param data the sample to be appended
+     * @param keyPrefix the path written before the timestamp in the key, like "YYYY-MM-DD/",
+     * so that a single update reaches several nodes. Null to write only the timestamp
+     * @param channelMask the channels to be written (bit i for the sensor i). With all of them
+     * the sample is written as an array, otherwise as a sparse object
+     * @return true if the sample was appended, false if there is not enough room for it
+     */
+    bool appendSample(unsigned long long timestampMillis, const sensorData* data,
+                      const char* keyPrefix = nullptr, uint16_t channelMask = CHANNEL_MASK_ALL);
+
+    /**
+     * Get the number of samples in the batch
+     * 
+     * @return the number of samples in the batch
+     */
+    int getSampleCount() const;
+
+    /**
+     * Get the size of the serialized JSON, in bytes
+     * 
+     * @return the size of the serialized JSON, in bytes
+     */
+    int getLength() const;
+
+    /**
+     * Get the serialized JSON, as a null terminated string. It stays valid until the batch
+     * is changed
+     * 
+     * @return the serialized JSON
+     */
+    const char* getBody();
+};
+
+#endif  // JsonBatch_H_
@@ -1,53 +1,43 @@
-#include <WiFi.h>
+#include <atomic>
 
 #include "Network.h"
+#include "Clock.h"
 #include "Errors.h"
 #include "Debug.h"
 
-void setupWiFi() {
-    // Connect to the WiFi network
-    WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
-    LogInfo("Connecting to Wi-Fi");
-
-    // If the connection fails, start a loop, retrying every 0.5 seconds
-    while (WiFi.status() != WL_CONNECTED) {
-        errorHandler.showError(ErrorType::NoInternet);
-        LogInfo(".");
-        delay(500);
-    }
-
-    // If the connection works, print the IP of the ESP32 on the local network
-    LogInfoln("\n\nConnected with IP: ", WiFi.localIP());
-}
+// Store the time of the boot, set by the first task that sees the clock synced. Both the
+// producer and the consumer of the samples convert their timestamps with it
+static std::atomic<unsigned long long> bootEpochMillis{0};
 
 void syncWithNTPTime() {
-    // Set the time obtained from the NTP Server
+    // Set the NTP Server, the time is set by the SNTP client once it answers
     configTime(gmtOffset_sec, daylightOffset_sec, ntpServer);
-    // Print the time obtained from the NTP Server
-    printLocalTime();
 }
 
 void printLocalTime() {
     struct tm timeInfo;
 
-    // If the local time is not available, we have a fatal error
-    if (!getLocalTime(&timeInfo)) {
-        errorHandler.showError(ErrorType::NoNTPdata, true);
-        LogFatalln("Failed to obtain time");
+    // Don't wait for the NTP Server, the sync is checked by the Connectivity module
+    if (!getLocalTime(&timeInfo, 0)) {
+        errorHandler.showError(ErrorType::NoNTPdata);
+        LogErrorln("Failed to obtain time"_log);
         return;
     }
 
-    LogInfoln(&timeInfo, "%A, %d/%m/%Y %H:%M:%S");
+    // Format the time here, the log only keeps the raw arguments of the message
+    char formattedTime[48];
+    strftime(formattedTime, sizeof(formattedTime), "%A, %d/%m/%Y %H:%M:%S", &timeInfo);
+    LogInfoln(formattedTime);
 }
 
 time_t getCurrentTime() {
     time_t now;
     struct tm timeInfo;
 
-    // If the local time is not available, we have a fatal error
-    if (!getLocalTime(&timeInfo)) {
-        errorHandler.showError(ErrorType::NoNTPdata, true);
-        LogFatalln("Failed to obtain Unix time");
+    // If the local time is not available, the clock isn't synced yet
+    if (!getLocalTime(&timeInfo, 0)) {
+        errorHandler.showError(ErrorType::NoNTPdata);
+        LogErrorln("Failed to obtain Unix time"_log);
         return (0);
     }
 
@@ -58,11 +48,37 @@ time_t getCurrentTime() {
 
 // Function that returns the current timestamp in milliseconds since 01 January 1970
 unsigned long long getCurrentMillisTimestamp() {
-    struct timeval tv;
+    return clockEpochMillis();
+}
+
+bool isClockSynced() {
+    return getBootEpochMillis() != 0;
+}
 
-    // Fill the timeval struct with the current time (tv_sec and tv_usec)
-    gettimeofday(&tv, NULL);
+unsigned long long getBootEpochMillis() {
+    unsigned long long bootMillis = bootEpochMillis.load();
+    if (bootMillis != 0) {
+        return bootMillis;
+    }
+
+    unsigned long long nowMillis = clockEpochMillis();
+    if (nowMillis < CLOCK_SYNCED_EPOCH_MILLIS) {
+        return 0;
+    }
+
+    // The first task to see the sync sets the time of the boot for all of them
+    unsigned long long expected = 0;
+    bootEpochMillis.compare_exchange_strong(expected, nowMillis - clockMillis());
+
+    return bootEpochMillis.load();
+}
+
+unsigned long long toEpochMillis(unsigned long long timestampMillis) {
+    return timestampMillis < CLOCK_SYNCED_EPOCH_MILLIS
+               ? timestampMillis + getBootEpochMillis() : timestampMillis;
+}
 
-    // Return the current timestamp in milliseconds
-    return tv.tv_sec * 1000LL + tv.tv_usec / 1000LL;
+unsigned long long toBootMillis(unsigned long long timestampMillis) {
+    return timestampMillis >= CLOCK_SYNCED_EPOCH_MILLIS
+               ? timestampMillis - getBootEpochMillis() : timestampMillis;
 }
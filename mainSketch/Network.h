@@ -1,10 +1,13 @@
 /*
     Network.h
 
-    * This module handles the network connection of the device.
-    * It connects to the WiFi network and syncs the device's time with an NTP Server time.
+    * This module syncs the device's time with an NTP Server time. The WiFi connection itself
+    is handled by the Connectivity module (see Connectivity.h).
     * It also formats the unix timestamp to a human readable format
     or to a timestamp in milliseconds.
+    * Until the first sync, the clock of the ESP32 counts from the boot. The samples taken in
+    the meantime keep that timeline and are converted to the time since 01 January 1970 once
+    the clock is synced (see toEpochMillis()), so that the sampling doesn't wait for the network.
 */
 
 #ifndef Network_H_
@@ -14,18 +17,17 @@
 #include "Credentials.h"
 
 // Define constants for the connection with the NTP Server, in order to get the current time
-static const char* ntpServer = "pool.ntp.org";  // NTP Server address
+static const char* const ntpServer = "pool.ntp.org";  // NTP Server address
 static const long gmtOffset_sec = -10800;  // GMT Offset in seconds (-3 hours)
 static const int daylightOffset_sec = 0;  // Daylight Offset in seconds (0)
 
-/**
- * Try to connect to the WiFi network defined in the Credentials.h file.
- * If the connection fails, it will try again until it succeeds.
- */
-void setupWiFi();
+// Set the timestamp from which the clock is considered synced (01 January 2020), in
+// milliseconds. Before the sync, the clock counts from the boot and stays far below it
+const unsigned long long CLOCK_SYNCED_EPOCH_MILLIS = 1577836800000ULL;
 
 /** 
- * Sync the device's time with an NTP Server time 
+ * Start to sync the device's time with an NTP Server time. The sync runs in the background,
+ * see isClockSynced()
  */
 void syncWithNTPTime();
 
@@ -37,10 +39,43 @@ void printLocalTime();
 /**
  * Get current epoch time
  * 
- * @return the current time in epoch format (unix timestamp)
+ * @return the current time in epoch format (unix timestamp), or 0 if the clock isn't synced
 */
 time_t getCurrentTime();
 
+/**
+ * Check if the clock was synced with the NTP Server since the boot
+ * 
+ * @return true if the clock is synced, false otherwise
+ */
+bool isClockSynced();
+
+/**
+ * Get the time of the boot, once the clock is synced
+ * 
+ * @return the timestamp of the boot in milliseconds, or 0 if the clock isn't synced
+ */
+unsigned long long getBootEpochMillis();
+
+/**
+ * Convert a timestamp taken before the clock was synced, counted from the boot, into the
+ * time since 01 January 1970. The timestamps taken after the sync are returned as they are
+ * 
+ * @param timestampMillis the timestamp, in milliseconds
+ * @return the timestamp in milliseconds since 01 January 1970, or the timestamp itself if the
+ * clock isn't synced yet
+ */
+unsigned long long toEpochMillis(unsigned long long timestampMillis);
+
+/**
+ * Convert a timestamp taken after the clock was synced back to the timeline of the boot, the
+ * inverse of toEpochMillis(). The timestamps taken before the sync are returned as they are
+ * 
+ * @param timestampMillis the timestamp, in milliseconds
+ * @return the timestamp in milliseconds since the boot
+ */
+unsigned long long toBootMillis(unsigned long long timestampMillis);
+
 /**
  * Obtain the time in milliseconds since 01 January 1970
  * 
@@ -0,0 +1,64 @@
+#include "Partitioner.h"
+
+Partitioner::Partitioner(ShardGranularity granularity) : granularity(granularity) {
+    shardPath[0] = '\0';
+}
+
+bool Partitioner::update(unsigned long long timestampMillis) {
+    if (contains(timestampMillis)) {
+        return false;
+    }
+
+    time_t sampleSeconds = timestampMillis / 1000ULL;
+    time_t startSeconds;
+    time_t endSeconds;
+
+    struct tm timeInfo;
+    // Get the time information of the sample, in the configured time zone
+    localtime_r(&sampleSeconds, &timeInfo);
+
+    switch (granularity) {
+        case ShardGranularity::Day:
+            strftime(shardPath, sizeof(shardPath), "%F/", &timeInfo);
+
+            // Set the time info to the start of the day. The days around the daylight saving
+            // time changes don't last 24 hours, so the following day is also computed by mktime
+            timeInfo.tm_hour = 0;
+            timeInfo.tm_min = 0;
+            timeInfo.tm_sec = 0;
+            timeInfo.tm_isdst = -1;
+            startSeconds = mktime(&timeInfo);
+
+            timeInfo.tm_mday += 1;
+            timeInfo.tm_isdst = -1;
+            endSeconds = mktime(&timeInfo);
+            break;
+
+        case ShardGranularity::Hour:
+            strftime(shardPath, sizeof(shardPath), "%F/%H/", &timeInfo);
+
+            // Keep the daylight saving flag of the sample, as an hour may repeat when it ends
+            timeInfo.tm_min = 0;
+            timeInfo.tm_sec = 0;
+            startSeconds = mktime(&timeInfo);
+            endSeconds = startSeconds + 3600;
+            break;
+
+        default:
+            strftime(shardPath, sizeof(shardPath), "%F/%H/%M/", &timeInfo);
+
+            timeInfo.tm_sec = 0;
+            startSeconds = mktime(&timeInfo);
+            endSeconds = startSeconds + 60;
+            break;
+    }
+
+    shardStartMillis = static_cast<unsigned long long>(startSeconds) * 1000ULL;
+    shardEndMillis = static_cast<unsigned long long>(endSeconds) * 1000ULL;
+
+    return true;
+}
+
+const char* Partitioner::getShardPath() const {
+    return shardPath;
+}
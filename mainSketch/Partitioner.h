@@ -0,0 +1,82 @@
+/*
+    Partitioner.h
+
+    * This module splits the timeline of the samples into shards (days, hours or minutes in the
+    local time zone), each one stored in its own node of the database.
+    * The boundaries of the current shard are cached as epochs, so checking whether a sample
+    belongs to it only takes a comparison. The calendar conversions only run when a sample
+    falls outside of the cached shard.
+    * The relative path of the shard is written into a fixed array, without the String class.
+*/
+
+#ifndef Partitioner_H_
+#define Partitioner_H_
+
+#include <Arduino.h>
+#include <time.h>
+
+/**
+ * Enumerate the sizes of the shards
+ *
+ * Day: "YYYY-MM-DD/"
+ * Hour: "YYYY-MM-DD/HH/"
+ * Minute: "YYYY-MM-DD/HH/MM/"
+ */
+enum class ShardGranularity {
+    Day,
+    Hour,
+    Minute
+};
+
+// Set the size of the shards. Smaller shards keep each node of the database small, which makes
+// the downstream reads faster
+const ShardGranularity SHARD_GRANULARITY = ShardGranularity::Day;
+
+// Define the capacity of the relative path of a shard, with the null terminator
+const int SHARD_PATH_CAPACITY = 20;
+
+/**
+ * Class that tracks the shard of the samples being sent
+ */
+class Partitioner {
+    ShardGranularity granularity;
+
+    // Store the epochs of the start of the current shard and of the following one, in
+    // milliseconds. The initial values are 0 so that they are set on the first use
+    unsigned long long shardStartMillis = 0;
+    unsigned long long shardEndMillis = 0;
+
+    // Store the relative path of the current shard, like "YYYY-MM-DD/"
+    char shardPath[SHARD_PATH_CAPACITY];
+
+public:
+    /**
+     * Constructor for the Partitioner class
+     * @param granularity The size of the shards
+     */
+    Partitioner(ShardGranularity granularity = SHARD_GRANULARITY);
+
+    /**
+     * Check whether a timestamp belongs to the current shard
+     * @param timestampMillis The timestamp, in milliseconds
+     * @return Whether the timestamp belongs to the current shard
+     */
+    bool contains(unsigned long long timestampMillis) const {
+        return timestampMillis >= shardStartMillis && timestampMillis < shardEndMillis;
+    }
+
+    /**
+     * Move to the shard of a timestamp, if it is not the current one
+     * @param timestampMillis The timestamp, in milliseconds
+     * @return Whether the shard changed
+     */
+    bool update(unsigned long long timestampMillis);
+
+    /**
+     * Get the relative path of the current shard, like "YYYY-MM-DD/"
+     * @return The relative path of the current shard
+     */
+    const char* getShardPath() const;
+};
+
+#endif  // Partitioner_H_
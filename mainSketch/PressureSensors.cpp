@@ -0,0 +1,38 @@
+#include "PressureSensors.h"
+#include "Telemetry.h"
+
+bool ExternalPressureSensors::setup() {
+    return adcs.setup();
+}
+
+bool ExternalPressureSensors::start(uint16_t*) {
+    channelIndex = 0;
+    adcs.startConversion(channelIndex);
+    return false;
+}
+
+bool ExternalPressureSensors::advance(uint16_t* values) {
+    if (!adcs.isConversionDone()) {
+        return false;
+    }
+
+    // Collect the results of the current channel before converting the next one: the ADCs keep
+    // a single conversion register, so if the task were preempted for longer than a conversion
+    // after starting the next one, the results read would already be the ones of the next channel
+    int index = channelIndex++;
+    bool isLastChannel = channelIndex >= EXTERNAL_ADC_CHANNEL_COUNT;
+    adcs.collectConversion();
+    if (!isLastChannel) {
+        adcs.startConversion(channelIndex);
+    }
+
+    // Store the collected values as a pair, one for each ADC
+    for (int i = 0; i < EXTERNAL_ADC_COUNT; i++) {
+        values[EXTERNAL_ADC_COUNT * index + i] = adcs.get(i);
+    }
+
+    if (isLastChannel) {
+        telemetry.record(TelemetryStage::I2cBus, adcs.takeBusMicros());
+    }
+    return isLastChannel;
+}
@@ -0,0 +1,75 @@
+/*
+    PressureSensors.h
+
+    * This module defines the drivers of the pressure sensors for the sensor registry (see
+    SensorRegistry.h): the ones hooked up to the internal ADC and the ones hooked up to the
+    external ADCs.
+    * The sensors of the internal ADC are converted in the background, so their reading
+    completes as soon as it starts. The ones of the external ADCs are converted a channel at a
+    time on both ADCs, so their reading completes over several calls.
+*/
+
+#ifndef PressureSensors_H_
+#define PressureSensors_H_
+
+#include "ExternalADCs.h"
+#include "InternalADCs.h"
+#include "SensorRegistry.h"
+
+// Set the deadband of the pressure sensors, in ADC counts. A change up to the deadband is
+// considered noise (0 sends every change)
+const uint16_t PRESSURE_SENSOR_DEADBAND = 8;
+
+/**
+ * Driver of the pressure sensors hooked up to the internal ADC (ADC1)
+ *
+ * @tparam Pins the pins of the sensors, in the order of their channels
+ */
+template <uint8_t... Pins>
+class InternalPressureSensors
+    : public SensorDriver<sizeof...(Pins), PRESSURE_SENSOR_DEADBAND, true> {
+    static_assert(sizeof...(Pins) <= INTERNAL_ADC_MAX_PINS, "Too many pins on the internal ADC");
+
+    InternalADCs adcs;
+
+public:
+    bool setup() {
+        const uint8_t pins[] = {Pins...};
+
+        // Set each pressure sensor pin as an input, and start converting them in the background
+        for (uint8_t pin : pins) {
+            pinMode(pin, INPUT);
+        }
+        return adcs.setup(pins, sizeof...(Pins));
+    }
+
+    bool start(uint16_t* values) {
+        // Collect the values converted since the last reading
+        adcs.collect(values);
+        return true;
+    }
+
+    bool advance(uint16_t*) {
+        return true;
+    }
+};
+
+/**
+ * Driver of the pressure sensors hooked up to the external ADCs, converted in parallel: each
+ * channel of the ADCs gives a pair of values, one for each ADC
+ */
+class ExternalPressureSensors
+    : public SensorDriver<EXTERNAL_ADC_COUNT * EXTERNAL_ADC_CHANNEL_COUNT,
+                          PRESSURE_SENSOR_DEADBAND> {
+    ExternalADCs adcs;
+
+    // Index of the channel of the external ADCs being converted
+    int channelIndex = 0;
+
+public:
+    bool setup();
+    bool start(uint16_t* values);
+    bool advance(uint16_t* values);
+};
+
+#endif  // PressureSensors_H_
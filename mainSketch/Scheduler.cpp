@@ -0,0 +1,92 @@
+#include "Scheduler.h"
+#include "Clock.h"
+#include "Debug.h"
+
+void SampleScheduler::onTimer(void* scheduler) {
+    xTaskNotifyGive(static_cast<SampleScheduler*>(scheduler)->task);
+}
+
+bool SampleScheduler::setup(int rate) {
+    task = xTaskGetCurrentTaskHandle();
+    intervalMicros = 1e6 / rate;
+
+    esp_timer_create_args_t timerArgs = {};
+    timerArgs.callback = &SampleScheduler::onTimer;
+    timerArgs.arg = this;
+    timerArgs.dispatch_method = ESP_TIMER_TASK;
+    timerArgs.name = "sampleScheduler";
+
+    if (esp_timer_create(&timerArgs, &timer) != ESP_OK) {
+        LogFatalln("Could not create the sample scheduler timer"_log);
+        return false;
+    }
+
+    return true;
+}
+
+bool SampleScheduler::start() {
+    // The first deadline is one interval after the start, like the first tick of the timer
+    deadlineMicros = clockMicros();
+    if (esp_timer_start_periodic(timer, intervalMicros) != ESP_OK) {
+        LogFatalln("Could not start the sample scheduler timer"_log);
+        return false;
+    }
+
+    started = true;
+    return true;
+}
+
+bool SampleScheduler::waitForTick(TickType_t timeout) {
+    // Start the timer only on the first wait, so that the rest of the device's setup
+    // doesn't count as missed ticks
+    if (!started && !start()) {
+        return false;
+    }
+
+    // Take all the pending notifications at once, each one of them is a tick
+    uint32_t pendingTicks = ulTaskNotifyTake(pdTRUE, timeout);
+    if (pendingTicks == 0) {
+        return false;
+    }
+
+    recordTick(clockMicros(), pendingTicks);
+    return true;
+}
+
+void SampleScheduler::recordTick(unsigned long nowMicros, uint32_t pendingTicks) {
+    // The deadlines only depend on the interval, never on the time of the wakeups
+    deadlineMicros += intervalMicros * pendingTicks;
+
+    // Only one sample is collected per wakeup, so the older pending ticks were missed
+    tickCount++;
+    missedTicks += pendingTicks - 1;
+
+    // The subtraction keeps working when the microseconds counter wraps around. A wakeup
+    // slightly before the deadline (the timer and the clock may be read apart) counts as on time
+    long latenessMicros = static_cast<long>(nowMicros - deadlineMicros);
+    unsigned long jitterMicros = latenessMicros > 0 ? latenessMicros : 0;
+    totalJitterMicros += jitterMicros;
+    maxJitterMicros = max(maxJitterMicros, jitterMicros);
+}
+
+uint32_t SampleScheduler::getTickCount() const {
+    return tickCount;
+}
+
+uint32_t SampleScheduler::getMissedTicks() const {
+    return missedTicks;
+}
+
+unsigned long SampleScheduler::getMeanJitterMicros() const {
+    return tickCount > 0 ? totalJitterMicros / tickCount : 0;
+}
+
+unsigned long SampleScheduler::getMaxJitterMicros() const {
+    return maxJitterMicros;
+}
+
+void SampleScheduler::printStats() const {
+    LogInfoln("Scheduler: "_log, tickCount, " ticks, "_log, missedTicks,
+              " missed, jitter mean="_log, getMeanJitterMicros(), "us max="_log, maxJitterMicros,
+              "us"_log);
+}
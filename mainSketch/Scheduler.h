@@ -0,0 +1,117 @@
+/*
+    Scheduler.h
+
+    * This module handles the timing of the data collection.
+    * A periodic hardware-backed timer (esp_timer) notifies the data collection task at a
+    fixed rate, so the deadlines are kept at `previous deadline + interval` and late wakeups
+    don't accumulate into the period. Between the ticks, the task sleeps on the notification.
+    * Ticks that arrive while the task is still busy are counted as missed instead of being
+    silently absorbed, and the lateness of each wakeup is tracked as jitter statistics.
+*/
+
+#ifndef Scheduler_H_
+#define Scheduler_H_
+
+#include <Arduino.h>
+#include <esp_timer.h>
+
+/**
+ * Class that wakes up the calling task at a fixed rate and keeps statistics of the jitter
+ * and of the missed ticks. The statistics only depend on the time given to recordTick(),
+ * so they can be checked with a simulated clock.
+ */
+class SampleScheduler {
+    // Timer that notifies the task on every tick
+    esp_timer_handle_t timer = nullptr;
+    // Task to be notified on every tick
+    TaskHandle_t task = nullptr;
+    // Store whether the timer was already started
+    bool started = false;
+
+    // Set the interval between ticks, in microseconds (us)
+    unsigned long intervalMicros = 0;
+    // Save the deadline of the last tick handled, in microseconds (us)
+    unsigned long deadlineMicros = 0;
+
+    // Count the ticks handled and the ticks missed while the task was busy
+    uint32_t tickCount = 0;
+    uint32_t missedTicks = 0;
+    // Accumulate the lateness of the wakeups, in microseconds (us)
+    unsigned long long totalJitterMicros = 0;
+    unsigned long maxJitterMicros = 0;
+
+    /**
+     * Notify the task, called by the timer on every tick
+     * 
+     * @param scheduler the SampleScheduler to be notified
+     */
+    static void onTimer(void* scheduler);
+
+    /**
+     * Start the periodic timer
+     * 
+     * @return true if the timer was started, false otherwise
+     */
+    bool start();
+
+public:
+
+    /**
+     * Create the timer. The calling task is the one that will be woken up on every tick
+     * 
+     * @param rate the rate of the ticks, in hertz (Hz)
+     * @return true if the timer was started, false otherwise
+     */
+    bool setup(int rate);
+
+    /**
+     * Sleep until the next tick. If ticks were already pending, it returns right away
+     * 
+     * @param timeout the maximum time to wait, in FreeRTOS ticks
+     * @return true if a tick happened, false if the timeout expired
+     */
+    bool waitForTick(TickType_t timeout = portMAX_DELAY);
+
+    /**
+     * Update the deadline and the statistics for a wakeup
+     * 
+     * @param nowMicros the time of the wakeup, in microseconds (us)
+     * @param pendingTicks the amount of ticks that happened since the last wakeup
+     */
+    void recordTick(unsigned long nowMicros, uint32_t pendingTicks);
+
+    /**
+     * Get the amount of ticks handled
+     * 
+     * @return the amount of ticks handled
+     */
+    uint32_t getTickCount() const;
+
+    /**
+     * Get the amount of ticks missed because the task was still busy
+     * 
+     * @return the amount of ticks missed
+     */
+    uint32_t getMissedTicks() const;
+
+    /**
+     * Get the mean lateness of the wakeups, in microseconds
+     * 
+     * @return the mean jitter, in microseconds (us)
+     */
+    unsigned long getMeanJitterMicros() const;
+
+    /**
+     * Get the maximum lateness of the wakeups, in microseconds
+     * 
+     * @return the maximum jitter, in microseconds (us)
+     */
+    unsigned long getMaxJitterMicros() const;
+
+    /**
+     * Print the jitter and overrun statistics
+     */
+    void printStats() const;
+};
+
+#endif  // Scheduler_H_
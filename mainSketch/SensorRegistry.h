@@ -0,0 +1,159 @@
+/*
+    SensorRegistry.h
+
+    * This module builds the data collection from a compile-time list of sensor drivers (see
+    Sensors.h), so that the record layout, the acquisition sequence, the null check and the
+    deadbands follow the list instead of being kept in sync by hand.
+    * Each driver gives its amount of channels, and the registry places them one after the
+    other in the values of a sample, in the order of the list, which is also the order in
+    which they are serialized. The offsets are template arguments, so each driver writes its
+    channels at a constant position.
+    * A reading goes through the drivers in the order of the list: the next driver is started
+    once the previous one completes, and each call advances the one in progress, without
+    waiting for it. A reading is advanced only until it completes.
+    * The list is unrolled by the compiler: there is no virtual call, and the disabled sensors
+    are removed from the list, so no code runs for them.
+*/
+
+#ifndef SensorRegistry_H_
+#define SensorRegistry_H_
+
+#include <Arduino.h>
+#include <type_traits>
+
+#include "Debug.h"
+
+/**
+ * Base of the sensor drivers, with the constants that the registry reads from them
+ *
+ * A driver derives from it and provides:
+ * bool setup(): setup the sensors, from the acquisition task
+ * bool start(uint16_t* values): start a reading, true if it is already complete
+ * bool advance(uint16_t* values): advance the reading without waiting, true once complete
+ * The values point to the first channel of the driver in the sample.
+ *
+ * @tparam ChannelCount the amount of channels of the driver, each one a 16-bit value
+ * @tparam Deadband the deadband of its channels, in counts (see ChangeFilter.h)
+ * @tparam CompletesAtStart whether its readings always complete when they start, so the
+ * registry never advances them
+ */
+template <int ChannelCount, uint16_t Deadband, bool CompletesAtStart = false>
+struct SensorDriver {
+    static_assert(ChannelCount > 0, "A sensor driver needs at least one channel");
+
+    static const int CHANNEL_COUNT = ChannelCount;
+    static const uint16_t DEADBAND = Deadband;
+    static const bool COMPLETES_AT_START = CompletesAtStart;
+};
+
+/**
+ * Placeholder of a disabled sensor, removed from the list by the registry
+ */
+struct NoSensor {};
+
+// Select the driver of a sensor if its status (see Debug.h) is ENABLE, or NoSensor otherwise
+template <int Status, typename Driver>
+using EnabledSensor = typename std::conditional<Status == ENABLE, Driver, NoSensor>::type;
+
+/**
+ * Chain of the drivers of the list, from the one whose channels start at Offset
+ */
+template <int Offset, typename... Drivers>
+class SensorChain;
+
+// The end of the list
+template <int Offset>
+class SensorChain<Offset> {
+public:
+    static const int CHANNEL_COUNT = 0;
+
+    bool setup() { return true; }
+    bool start(uint16_t*) { return true; }
+    bool advance(uint16_t*) { return true; }
+
+    static uint16_t getDeadband(int) { return 0; }
+};
+
+// A disabled sensor, skipped
+template <int Offset, typename... Rest>
+class SensorChain<Offset, NoSensor, Rest...> : public SensorChain<Offset, Rest...> {};
+
+template <int Offset, typename Driver, typename... Rest>
+class SensorChain<Offset, Driver, Rest...> {
+    typedef SensorChain<Offset + Driver::CHANNEL_COUNT, Rest...> RestChain;
+
+    // The reading of the last driver of the list is never complete when the list is advanced,
+    // so only the drivers followed by others and completing over several calls keep a flag
+    static const bool IS_LAST = RestChain::CHANNEL_COUNT == 0;
+    static const bool TRACKS_COMPLETION = !IS_LAST && !Driver::COMPLETES_AT_START;
+
+    Driver driver;
+    RestChain rest;
+
+    // Store whether the driver completed the reading in progress, so the rest of the list is
+    // being advanced
+    bool driverDone = true;
+
+public:
+    static const int CHANNEL_COUNT = Driver::CHANNEL_COUNT + RestChain::CHANNEL_COUNT;
+
+    bool setup() {
+        return driver.setup() && rest.setup();
+    }
+
+    bool start(uint16_t* values) {
+        bool started = driver.start(&values[Offset]);
+        if (TRACKS_COMPLETION) {
+            driverDone = started;
+        }
+        return (Driver::COMPLETES_AT_START || started) && rest.start(values);
+    }
+
+    bool advance(uint16_t* values) {
+        if (IS_LAST) {
+            return driver.advance(&values[Offset]);
+        }
+        if (!TRACKS_COMPLETION || driverDone) {
+            return rest.advance(values);
+        }
+
+        driverDone = driver.advance(&values[Offset]);
+        return driverDone && rest.start(values);
+    }
+
+    static uint16_t getDeadband(int channel) {
+        return channel < Offset + Driver::CHANNEL_COUNT ? Driver::DEADBAND
+                                                        : RestChain::getDeadband(channel);
+    }
+};
+
+/**
+ * Class of the sensors of the chair, from the list of their drivers
+ *
+ * @tparam Drivers the drivers, in the order of their channels in the samples
+ */
+template <typename... Drivers>
+class SensorRegistry : public SensorChain<0, Drivers...> {
+    typedef SensorChain<0, Drivers...> Chain;
+
+public:
+    static_assert(Chain::CHANNEL_COUNT > 0, "At least one sensor must be enabled");
+
+    /**
+     * Check if all the channels of a sample are null
+     *
+     * @param values the channels of the sample
+     * @return true if all of them are null, false otherwise
+     */
+    static bool isNull(const uint16_t* values) {
+        // The channels of all the drivers follow each other, so they are combined at once,
+        // without branching on each one of them
+        uint16_t combined = 0;
+        for (int i = 0; i < Chain::CHANNEL_COUNT; i++) {
+            combined |= values[i];
+        }
+        return combined == 0;
+    }
+};
+
+#endif  // SensorRegistry_H_
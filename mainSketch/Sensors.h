@@ -0,0 +1,24 @@
+/*
+    Sensors.h
+
+    * This module lists the sensors of the chair, from which the sensor registry builds the
+    data collection (see SensorRegistry.h): the channels of each sample, in the order of the
+    list, how they are read, checked for null and filtered.
+    * A sensor is added with a line in the list: its driver, enabled by its status in Debug.h.
+*/
+
+#ifndef Sensors_H_
+#define Sensors_H_
+
+#include "PressureSensors.h"
+#include "SensorRegistry.h"
+
+typedef SensorRegistry<
+    EnabledSensor<PRESSURE_SENSOR_STATUS, InternalPressureSensors<A2, A3, A4, A5>>,
+    EnabledSensor<PRESSURE_SENSOR_STATUS, ExternalPressureSensors>
+> Sensors;
+
+// Define the amount of channels of a sample, over all the sensors
+const int SENSOR_CHANNEL_COUNT = Sensors::CHANNEL_COUNT;
+
+#endif  // Sensors_H_
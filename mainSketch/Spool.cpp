@@ -0,0 +1,236 @@
+#include "Spool.h"
+#include "Debug.h"
+
+static_assert(sizeof(spoolRecord) == 8 + sizeof(sensorData) + 4,
+              "spoolRecord must not have padding");
+
+// Compute the CRC-32 (IEEE 802.3) of the record fields, except the CRC itself
+static uint32_t computeRecordCrc(const spoolRecord* record) {
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(record);
+    const size_t length = offsetof(spoolRecord, crc);
+
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+
+    return ~crc;
+}
+
+void Spool::getSegmentPath(uint32_t segment, char* path) const {
+    snprintf(path, 24, SPOOL_DIRECTORY "/%010lu", static_cast<unsigned long>(segment));
+}
+
+bool Spool::setup() {
+    if (!LittleFS.begin(true)) {
+        LogErrorln("Could not mount the file system of the spool"_log);
+        return false;
+    }
+
+    LittleFS.mkdir(SPOOL_DIRECTORY);
+
+    // Find the oldest and the newest segments left from before the reboot
+    bool foundSegments = false;
+    uint32_t oldestSegment = UINT32_MAX;
+    uint32_t newestSegment = 0;
+
+    File directory = LittleFS.open(SPOOL_DIRECTORY);
+    for (File entry = directory.openNextFile(); entry; entry = directory.openNextFile()) {
+        // Depending on the core version, the name may include the directory
+        const char* name = strrchr(entry.name(), '/');
+        uint32_t segment = strtoul(name != nullptr ? name + 1 : entry.name(), nullptr, 10);
+
+        oldestSegment = min(oldestSegment, segment);
+        newestSegment = max(newestSegment, segment);
+        foundSegments = true;
+    }
+    directory.close();
+
+    // The newest segment may end with a torn record, so the appends always go to a new one
+    headSegment = foundSegments ? oldestSegment : 0;
+    tailSegment = foundSegments ? newestSegment + 1 : 0;
+    headRecord = 0;
+    headRecordCount = -1;
+    tailRecordCount = 0;
+
+    char path[24];
+    getSegmentPath(tailSegment, path);
+    tailFile = LittleFS.open(path, "w");
+    if (!tailFile) {
+        LogErrorln("Could not create the spool segment "_log, path);
+        return false;
+    }
+
+    if (foundSegments) {
+        LogInfoln("Spool recovered "_log, newestSegment - oldestSegment + 1, " segments"_log);
+    }
+
+    mounted = true;
+    return true;
+}
+
+bool Spool::isEmpty() const {
+    return !mounted || (headSegment == tailSegment && headRecord >= tailRecordCount);
+}
+
+bool Spool::rotateTail() {
+    // If the spool is full, the oldest segment is dropped to make room for the new one. The
+    // records in flight would then be released from the next segment by commit(), so the
+    // rotation waits for them
+    if (tailSegment - headSegment + 2 > SPOOL_MAX_SEGMENTS) {
+        if (recordsInFlight > 0) {
+            return false;
+        }
+
+        int remainingRecords = headRecordCount >= 0 ? headRecordCount : SPOOL_SEGMENT_RECORDS;
+        droppedRecords += remainingRecords - headRecord;
+        LogErrorln("Spool full, dropping segment "_log, headSegment);
+        dropHead();
+    }
+
+    tailFile.close();
+    tailSegment++;
+    tailRecordCount = 0;
+
+    char path[24];
+    getSegmentPath(tailSegment, path);
+    tailFile = LittleFS.open(path, "w");
+    if (!tailFile) {
+        LogErrorln("Could not create the spool segment "_log, path);
+        return false;
+    }
+
+    return true;
+}
+
+void Spool::dropHead() {
+    if (headFile) {
+        headFile.close();
+    }
+
+    char path[24];
+    getSegmentPath(headSegment, path);
+    LittleFS.remove(path);
+
+    headSegment++;
+    headRecord = 0;
+    headRecordCount = -1;
+}
+
+bool Spool::openHead() {
+    while (true) {
+        if (headSegment == tailSegment) {
+            if (headRecord >= tailRecordCount) {
+                return false;
+            }
+
+            // The newest segment is still open for appending, so it is closed before being read
+            if (!rotateTail()) {
+                return false;
+            }
+        }
+
+        if (headRecordCount < 0) {
+            char path[24];
+            getSegmentPath(headSegment, path);
+            headFile = LittleFS.open(path, "r");
+
+            // A partially written record at the end of the file is not counted
+            headRecordCount = headFile ? headFile.size() / sizeof(spoolRecord) : 0;
+        }
+
+        if (headRecord < headRecordCount) {
+            return true;
+        }
+
+        // The segment was fully read (or is empty), so it is no longer needed
+        dropHead();
+    }
+}
+
+bool Spool::append(unsigned long long timestampMillis, const sensorData* sample) {
+    if (!mounted || !tailFile) {
+        return false;
+    }
+
+    // The newest segment is only rotated when a record doesn't fit, so a full spool takes the
+    // records again once the ones in flight are released
+    if (tailRecordCount >= SPOOL_SEGMENT_RECORDS && !rotateTail()) {
+        return false;
+    }
+
+    spoolRecord record;
+    record.timestampMillis = timestampMillis;
+    record.sample = *sample;
+    record.crc = computeRecordCrc(&record);
+
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(&record);
+    if (tailFile.write(data, sizeof(record)) != sizeof(record)) {
+        LogErrorln("Could not write to the spool segment "_log, tailSegment);
+        return false;
+    }
+
+    tailRecordCount++;
+    return true;
+}
+
+void Spool::flush() {
+    if (tailFile) {
+        tailFile.flush();
+    }
+}
+
+int Spool::read(spoolRecord* records, int maxCount) {
+    if (!mounted) {
+        return 0;
+    }
+
+    while (openHead()) {
+        int start = headRecord + recordsInFlight;
+        int count = max(min(maxCount, headRecordCount - start), 0);
+
+        headFile.seek(start * sizeof(spoolRecord));
+        uint8_t* data = reinterpret_cast<uint8_t*>(records);
+        count = headFile.read(data, count * sizeof(spoolRecord)) / sizeof(spoolRecord);
+
+        for (int i = 0; i < count; i++) {
+            // A torn or corrupted record ends the segment, as the ones after it can't be trusted
+            if (records[i].crc != computeRecordCrc(&records[i])) {
+                LogWarningln("Spool segment "_log, headSegment, " ends at a corrupted record"_log);
+                count = i;
+                break;
+            }
+        }
+
+        // The segment can only be left once the records in flight are released
+        if (count > 0 || recordsInFlight > 0) {
+            recordsInFlight += count;
+            return count;
+        }
+
+        // Nothing else can be read from this segment, so the next one is tried
+        headRecordCount = headRecord;
+    }
+
+    return 0;
+}
+
+void Spool::commit(int count) {
+    headRecord += count;
+    recordsInFlight -= count;
+
+    if (headRecordCount >= 0 && headRecord >= headRecordCount) {
+        dropHead();
+    }
+}
+
+void Spool::rewind(int count) {
+    recordsInFlight -= count;
+}
+
+uint32_t Spool::getDroppedRecords() const {
+    return droppedRecords;
+}
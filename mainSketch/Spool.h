@@ -0,0 +1,176 @@
+/*
+    Spool.h
+
+    * This module handles a crash-safe spool on the flash memory (LittleFS), that holds the
+    samples that don't fit in the RAM buffer while the database can't be reached.
+    * The spool is append-only and split in segment files, named after an increasing sequence
+    number. The samples are read back in order and each segment is deleted once it is fully
+    read, so the files are never rewritten in place, spreading the wear over the flash.
+    * Each record carries a CRC, so a record torn by a reset during a write is detected and
+    the segment is considered to end there. After a reboot, the appends always go to a new
+    segment and the older ones are read again from their start.
+    * The records read are in flight until they are released or given back. While some are,
+    the oldest segment is never dropped to make room, so the appends fail instead and the
+    samples stay in the RAM buffer.
+*/
+
+#ifndef Spool_H_
+#define Spool_H_
+
+#include <LittleFS.h>
+
+#include "Buffer.h"
+
+// Define the directory that holds the segment files
+#define SPOOL_DIRECTORY "/spool"
+
+// Define the amount of records in each segment file
+const int SPOOL_SEGMENT_RECORDS = 1024;
+// Define the maximum amount of segment files. When it is exceeded, the oldest one is dropped
+const uint32_t SPOOL_MAX_SEGMENTS = 24;
+
+/**
+ * Struct of a sample stored in the spool
+ * 
+ * timestampMillis: full timestamp of the sample in milliseconds
+ * sample: the sample values (its timestamp offset is not used)
+ * crc: CRC-32 of the fields above
+ */
+struct spoolRecord {
+    // 8 bytes
+    unsigned long long timestampMillis = 0;
+
+    // 28 bytes
+    sensorData sample;
+
+    // 4 bytes
+    uint32_t crc = 0;
+};
+
+/**
+ * Class that handles the segmented, append-only spool of samples on the flash memory.
+ * The records are appended to the newest segment and read back, in order, from the oldest one.
+ * A read doesn't remove the records: they are in flight until they are released by commit(),
+ * once they were sent, or given back by rewind().
+ */
+class Spool {
+    // Store whether the file system was mounted
+    bool mounted = false;
+
+    // Sequence number of the oldest segment, where the records are read from
+    uint32_t headSegment = 0;
+    // Index of the next record to be read from the oldest segment
+    int headRecord = 0;
+    // Amount of valid records in the oldest segment, or -1 if it wasn't checked yet
+    int headRecordCount = -1;
+    // File of the oldest segment, kept open while it is being read
+    File headFile;
+
+    // Sequence number of the newest segment, where the records are appended
+    uint32_t tailSegment = 0;
+    // Amount of records in the newest segment
+    int tailRecordCount = 0;
+    // File of the newest segment, kept open for appending
+    File tailFile;
+
+    // Count the records read and neither released nor given back yet, all in the oldest segment
+    int recordsInFlight = 0;
+
+    // Count the records dropped because the spool was full
+    uint32_t droppedRecords = 0;
+
+    /**
+     * Build the path of a segment file. Should receive an array of at least 24 chars
+     * 
+     * @param segment the sequence number of the segment
+     * @param path the array of chars to store the path
+     */
+    void getSegmentPath(uint32_t segment, char* path) const;
+
+    /**
+     * Close the newest segment and start a new one. If the spool is full, the oldest segment is
+     * dropped, unless some of its records are in flight
+     * 
+     * @return true if the new segment was created, false otherwise
+     */
+    bool rotateTail();
+
+    /**
+     * Delete the oldest segment and move the read position to the start of the next one
+     */
+    void dropHead();
+
+    /**
+     * Open the oldest segment, if needed, and count its valid records
+     * 
+     * @return true if the oldest segment has records left to be read, false otherwise
+     */
+    bool openHead();
+
+public:
+
+    /**
+     * Mount the file system and find the segments left from before the reboot
+     * 
+     * @return true if the spool is ready to be used, false otherwise
+     */
+    bool setup();
+
+    /**
+     * Check if there are no records to be read
+     * 
+     * @return true if the spool is empty, false otherwise
+     */
+    bool isEmpty() const;
+
+    /**
+     * Append a sample to the spool. It is only guaranteed to be on the flash after flush()
+     * 
+     * @param timestampMillis the timestamp of the sample, in milliseconds
+     * @param sample the sample to be appended
+     * @return true if the sample was appended, false otherwise (also while the spool is full
+     * and the oldest records are in flight)
+     */
+    bool append(unsigned long long timestampMillis, const sensorData* sample);
+
+    /**
+     * Write the appended records to the flash
+     */
+    void flush();
+
+    /**
+     * Read the oldest records of the spool after the ones in flight, which are then in flight
+     * too. The records are read from a single segment, so fewer than maxCount may be returned
+     * even if there are more left, and the records after the ones in flight are only read from
+     * the same segment, until they are released
+     * 
+     * @param records the array where the records will be stored
+     * @param maxCount the maximum amount of records to be read
+     * @return the amount of records read
+     */
+    int read(spoolRecord* records, int maxCount);
+
+    /**
+     * Release the oldest records in flight, after they were sent
+     * 
+     * @param count the amount of records to be released
+     */
+    void commit(int count);
+
+    /**
+     * Give back the newest records in flight, after their batch was dropped, so that they are
+     * read again
+     * 
+     * @param count the amount of records to be given back
+     */
+    void rewind(int count);
+
+    /**
+     * Get the amount of records dropped because the spool was full
+     * 
+     * @return the amount of records dropped
+     */
+    uint32_t getDroppedRecords() const;
+};
+
+#endif  // Spool_H_
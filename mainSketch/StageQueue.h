@@ -0,0 +1,125 @@
+/*
+    StageQueue.h
+
+    * This module joins two stages of the data path (see Stages.h) with a bounded, lock-free
+    queue: a single producer task pushes the items and a single consumer task pops them.
+    * The consumer sleeps on its task notification while the queue is empty, and the producer
+    notifies it on each push, so no stage polls its input.
+    * When the queue is full the item is dropped and counted, so the producer never blocks.
+*/
+
+#ifndef StageQueue_H_
+#define StageQueue_H_
+
+#include <Arduino.h>
+#include <atomic>
+
+/**
+ * Class of a bounded single-producer, single-consumer queue between two tasks
+ *
+ * The positions are free-running and masked to index the items, so the capacity must be a
+ * power of two.
+ */
+template <typename T, uint32_t Capacity>
+class StageQueue {
+    static_assert((Capacity & (Capacity - 1)) == 0, "The capacity must be a power of two");
+
+    T items[Capacity];
+
+    // Free-running positions of the producer and of the consumer
+    std::atomic<uint32_t> writePosition{0};
+    std::atomic<uint32_t> readPosition{0};
+
+    // Task to be notified on each push, the consumer
+    TaskHandle_t consumer = nullptr;
+
+    // Count the items dropped because the queue was full
+    std::atomic<uint32_t> droppedItems{0};
+
+public:
+    /**
+     * Set the task that pops the items. Must be called before the first push
+     *
+     * @param task the consumer task
+     */
+    void setConsumer(TaskHandle_t task) {
+        consumer = task;
+    }
+
+    /**
+     * Push an item and wake up the consumer. Must only be called by the producer task
+     *
+     * @param item the item to be copied into the queue
+     * @return true if the item was pushed, false if the queue was full
+     */
+    bool push(const T& item) {
+        uint32_t position = writePosition.load(std::memory_order_relaxed);
+        if (position - readPosition.load(std::memory_order_acquire) >= Capacity) {
+            droppedItems.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        items[position & (Capacity - 1)] = item;
+        writePosition.store(position + 1, std::memory_order_release);
+
+        if (consumer != nullptr) {
+            xTaskNotifyGive(consumer);
+        }
+        return true;
+    }
+
+    /**
+     * Pop the oldest item, sleeping until one is pushed if the queue is empty. Must only be
+     * called by the consumer task
+     *
+     * @param item where the item is copied to
+     * @param timeout the maximum time to wait, in FreeRTOS ticks
+     * @return true if an item was popped, false if the timeout expired
+     */
+    bool pop(T* item, TickType_t timeout) {
+        uint32_t position = readPosition.load(std::memory_order_relaxed);
+
+        // A push between the check and the wait leaves its notification pending, so the wait
+        // returns right away and the item isn't missed
+        if (writePosition.load(std::memory_order_acquire) == position) {
+            ulTaskNotifyTake(pdTRUE, timeout);
+            if (writePosition.load(std::memory_order_acquire) == position) {
+                return false;
+            }
+        }
+
+        *item = items[position & (Capacity - 1)];
+        readPosition.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Get the amount of items in the queue
+     *
+     * @return the amount of items
+     */
+    int size() const {
+        return writePosition.load(std::memory_order_acquire)
+               - readPosition.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Get the capacity of the queue
+     *
+     * @return the capacity, in items
+     */
+    int capacity() const {
+        return Capacity;
+    }
+
+    /**
+     * Get the amount of items dropped because the queue was full, since the boot
+     *
+     * @return the amount of items dropped
+     */
+    uint32_t getDroppedItems() const {
+        return droppedItems.load(std::memory_order_relaxed);
+    }
+};
+
+#endif  // StageQueue_H_
@@ -0,0 +1,189 @@
+#include "Stages.h"
+#include "Clock.h"
+#include "Errors.h"
+#include "Debug.h"
+
+StageMonitor::StageMonitor() {
+    for (int i = 0; i < static_cast<int>(PipelineStage::Count); i++) {
+        busyMicros[i].store(0);
+        queueDepth[i].store(0);
+        queueCapacity[i].store(0);
+        queueHighWaterMark[i].store(0);
+        intervalQueueMax[i].store(0);
+        reportedBusyMicros[i] = 0;
+    }
+}
+
+void StageMonitor::addBusyTime(PipelineStage stage, unsigned long durationMicros) {
+    busyMicros[static_cast<int>(stage)].fetch_add(durationMicros, std::memory_order_relaxed);
+}
+
+void StageMonitor::updateQueueDepth(PipelineStage stage, int depth, int capacity) {
+    int i = static_cast<int>(stage);
+    queueDepth[i].store(depth, std::memory_order_relaxed);
+    queueCapacity[i].store(capacity, std::memory_order_relaxed);
+
+    if (depth > queueHighWaterMark[i].load(std::memory_order_relaxed)) {
+        queueHighWaterMark[i].store(depth, std::memory_order_relaxed);
+    }
+    if (depth > intervalQueueMax[i].load(std::memory_order_relaxed)) {
+        intervalQueueMax[i].store(depth, std::memory_order_relaxed);
+    }
+}
+
+uint32_t StageMonitor::getBusyMicros(PipelineStage stage) const {
+    return busyMicros[static_cast<int>(stage)].load(std::memory_order_relaxed);
+}
+
+int StageMonitor::getQueueHighWaterMark(PipelineStage stage) const {
+    return queueHighWaterMark[static_cast<int>(stage)].load(std::memory_order_relaxed);
+}
+
+int StageMonitor::getQueueCapacity(PipelineStage stage) const {
+    return queueCapacity[static_cast<int>(stage)].load(std::memory_order_relaxed);
+}
+
+void StageMonitor::printReport() {
+    unsigned long currentMicros = clockMicros();
+    unsigned long elapsedMicros = currentMicros - reportedMicros;
+    reportedMicros = currentMicros;
+
+    for (int i = 0; i < static_cast<int>(PipelineStage::Count); i++) {
+        // The subtraction keeps working when the counter wraps around
+        uint32_t busy = busyMicros[i].load(std::memory_order_relaxed);
+        uint32_t intervalBusyMicros = busy - reportedBusyMicros[i];
+        reportedBusyMicros[i] = busy;
+
+        // The transmit stage has a task per slot, so its share can go above 100%
+        LogInfoln("Stage "_log, STAGE_CONFIGS[i].name, ": "_log,
+                  intervalBusyMicros * 100.0f / max(elapsedMicros, 1UL), "% busy, queue "_log,
+                  queueDepth[i].load(std::memory_order_relaxed), "/"_log,
+                  queueCapacity[i].load(std::memory_order_relaxed), " (max "_log,
+                  intervalQueueMax[i].exchange(0, std::memory_order_relaxed), ")"_log);
+    }
+}
+
+bool StagePipeline::startTask(PipelineStage stage, void (*function)(void*)) {
+    const stageConfig& config = STAGE_CONFIGS[static_cast<int>(stage)];
+
+    if (xTaskCreatePinnedToCore(function, config.name, config.stackSize, this, config.priority,
+                                &tasks[static_cast<int>(stage)], config.core) != pdPASS) {
+        LogErrorln("Could not start the task of the stage "_log, config.name);
+        return false;
+    }
+
+    return true;
+}
+
+bool StagePipeline::setup(DataReader* reader, SensorDataBuffer* buffer, Database* db) {
+    dataReader = reader;
+    dataBuffer = buffer;
+    database = db;
+    reportPrevMillis = clockMillis();
+
+    // The consumers are started first, so that their handles are known by the producers
+    if (!startTask(PipelineStage::Encode, encodeTask)) {
+        return false;
+    }
+    database->setEncodeTask(tasks[static_cast<int>(PipelineStage::Encode)]);
+
+    if (!startTask(PipelineStage::Filter, filterTask)) {
+        return false;
+    }
+    readingQueue.setConsumer(tasks[static_cast<int>(PipelineStage::Filter)]);
+
+    return startTask(PipelineStage::Acquisition, acquisitionTask);
+}
+
+void StagePipeline::stopAcquisition() {
+    acquiring.store(false);
+}
+
+int StagePipeline::getReadingQueueSize() const {
+    return readingQueue.size();
+}
+
+void StagePipeline::acquisitionTask(void* pipeline) {
+    StagePipeline* stages = static_cast<StagePipeline*>(pipeline);
+
+    // The scheduler wakes up the task that sets it up
+    if (!stages->dataReader->setup()) {
+        errorHandler.showError(ErrorType::ExternalADCInitFailure, true);
+    }
+
+    sensorReading completed;
+    while (true) {
+        if (!stages->acquiring.load()) {
+            vTaskDelay(pdMS_TO_TICKS(STAGE_IDLE_TIMEOUT_MILLIS));
+            continue;
+        }
+
+        if (!stages->dataReader->isReadingPending()) {
+            if (!stages->dataReader->waitForTick(pdMS_TO_TICKS(STAGE_IDLE_TIMEOUT_MILLIS))) {
+                continue;
+            }
+
+            unsigned long workStartMicros = clockMicros();
+            stages->dataReader->startReading();
+            stageMonitor.addBusyTime(PipelineStage::Acquisition, clockMicros() - workStartMicros);
+        }
+
+        unsigned long workStartMicros = clockMicros();
+        bool isComplete = stages->dataReader->advanceReading(&completed);
+        if (isComplete && !stages->readingQueue.push(completed)) {
+            LogErrorln("The queue of readings is full, the reading is dropped"_log);
+        }
+        stageMonitor.addBusyTime(PipelineStage::Acquisition, clockMicros() - workStartMicros);
+
+        // Let the task sleep until the conversion has a chance to be done
+        if (!isComplete) {
+            vTaskDelay(1);
+        }
+    }
+}
+
+void StagePipeline::filterTask(void* pipeline) {
+    StagePipeline* stages = static_cast<StagePipeline*>(pipeline);
+    TaskHandle_t encodeTask = stages->tasks[static_cast<int>(PipelineStage::Encode)];
+
+    sensorReading completed;
+    while (true) {
+        // Sleep until the acquisition pushes a reading
+        if (!stages->readingQueue.pop(&completed, pdMS_TO_TICKS(STAGE_IDLE_TIMEOUT_MILLIS))) {
+            continue;
+        }
+        stageMonitor.updateQueueDepth(PipelineStage::Filter, stages->readingQueue.size() + 1,
+                                      stages->readingQueue.capacity());
+
+        unsigned long workStartMicros = clockMicros();
+        if (stages->dataReader->filterReading(completed, stages->dataBuffer)) {
+            // Wake up the encode stage for the new sample
+            xTaskNotifyGive(encodeTask);
+        }
+        stageMonitor.addBusyTime(PipelineStage::Filter, clockMicros() - workStartMicros);
+    }
+}
+
+void StagePipeline::encodeTask(void* pipeline) {
+    StagePipeline* stages = static_cast<StagePipeline*>(pipeline);
+
+    while (true) {
+        stageMonitor.updateQueueDepth(PipelineStage::Encode, stages->dataBuffer->getBufferSize(),
+                                      BUFFER_CAPACITY);
+
+        // The database also works without new samples: it completes the uploads, sends the
+        // spool and follows the connection
+        unsigned long workStartMicros = clockMicros();
+        stages->database->sendData(stages->dataBuffer);
+        stageMonitor.addBusyTime(PipelineStage::Encode, clockMicros() - workStartMicros);
+
+        if (clockMillis() - stages->reportPrevMillis >= STAGE_REPORT_INTERVAL_MILLIS) {
+            stageMonitor.printReport();
+            stages->reportPrevMillis = clockMillis();
+        }
+
+        // Sleep until a new sample or the end of an upload, which also gives Core 0 the time
+        // for its maintenance activities
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ENCODE_STAGE_INTERVAL_MILLIS));
+    }
+}
@@ -0,0 +1,210 @@
+/*
+    Stages.h
+
+    * This module splits the data path into explicit stages, each one run by its own FreeRTOS
+    task: the acquisition of the readings, their filter (decimation) into samples, the encode
+    of the samples into batches and the transmit of the batches to the database.
+    * The stages are joined by bounded, lock-free queues: a StageQueue of readings, the
+    SensorDataBuffer of samples and the slots of the UploadPipeline. Each task sleeps on its
+    input instead of polling it, and the core, the priority and the stack of each task are set
+    in STAGE_CONFIGS.
+    * The StageMonitor accounts the time each stage spends working, outside of the waits for its
+    input, and the occupancy of its input queue. A report is periodically logged, so the stage
+    that limits the throughput shows up as the one that is always busy or whose queue fills up.
+*/
+
+#ifndef Stages_H_
+#define Stages_H_
+
+#include <Arduino.h>
+#include <atomic>
+
+#include "Buffer.h"
+#include "DataReader.h"
+#include "Database.h"
+#include "StageQueue.h"
+
+/**
+ * Enumerate the stages of the data path
+ *
+ * Acquisition: reading of the sensors on the ticks of the scheduler (no input queue)
+ * Filter: decimation of the readings into samples, published on the buffer
+ * Encode: build of the batches from the buffer and from the spool (see Database.h)
+ * Transmit: transmission of the batches, one task per slot (see UploadPipeline.h)
+ */
+enum class PipelineStage : uint8_t {
+    Acquisition,
+    Filter,
+    Encode,
+    Transmit,
+    Count
+};
+
+/**
+ * Struct of the configuration of the task of a stage
+ */
+struct stageConfig {
+    const char* name;
+    BaseType_t core;
+    UBaseType_t priority;
+    uint32_t stackSize;
+};
+
+// Set the task of each stage. The acquisition keeps Core 1 with the highest priority, so that
+// the ticks are kept, and the network stays on Core 0 (the transmit tasks are set per slot)
+static const stageConfig STAGE_CONFIGS[static_cast<int>(PipelineStage::Count)] = {
+    {"acquisition", 1, 3, 4096},
+    {"filter",      1, 2, 4096},
+    {"encode",      0, 1, 10000},
+    {"transmit",    0, 1, 8192}
+};
+
+// Define the capacity of the queue of readings between the acquisition and the filter (must be
+// a power of two)
+const uint32_t READING_QUEUE_CAPACITY = 16;
+
+// Set the longest sleep of the encode stage, in milliseconds (ms). It is also woken up by each
+// new sample and by each upload completed
+const unsigned long ENCODE_STAGE_INTERVAL_MILLIS = 10;
+
+// Set the longest sleep of the stages waiting on their input, so that they can be stopped,
+// in milliseconds (ms)
+const unsigned long STAGE_IDLE_TIMEOUT_MILLIS = 1000;
+
+// Set the interval between the reports of the stages, in milliseconds (ms)
+const unsigned long STAGE_REPORT_INTERVAL_MILLIS = 60000;
+
+/**
+ * Class that accounts the work of each stage and the occupancy of its input queue
+ *
+ * The busy times are free-running counters, in microseconds, so the shares are computed on
+ * intervals shorter than their wrap-around (about 71 minutes).
+ */
+class StageMonitor {
+    // Accumulate the time each stage spent working, in microseconds (us)
+    std::atomic<uint32_t> busyMicros[static_cast<int>(PipelineStage::Count)];
+
+    // Store the occupancy of the input queue of each stage, its capacity and its largest
+    // occupancy since the boot and since the last report
+    std::atomic<int> queueDepth[static_cast<int>(PipelineStage::Count)];
+    std::atomic<int> queueCapacity[static_cast<int>(PipelineStage::Count)];
+    std::atomic<int> queueHighWaterMark[static_cast<int>(PipelineStage::Count)];
+    std::atomic<int> intervalQueueMax[static_cast<int>(PipelineStage::Count)];
+
+    // Save the busy times and the time of the last report
+    uint32_t reportedBusyMicros[static_cast<int>(PipelineStage::Count)];
+    unsigned long reportedMicros = 0;
+
+public:
+    /** Initialize the counters */
+    StageMonitor();
+
+    /**
+     * Account the work of a stage
+     *
+     * @param stage the stage that worked
+     * @param durationMicros the duration of the work, in microseconds (us)
+     */
+    void addBusyTime(PipelineStage stage, unsigned long durationMicros);
+
+    /**
+     * Update the occupancy of the input queue of a stage. Must only be called by one task per
+     * stage
+     *
+     * @param stage the stage that consumes the queue
+     * @param depth the amount of items in the queue
+     * @param capacity the capacity of the queue
+     */
+    void updateQueueDepth(PipelineStage stage, int depth, int capacity);
+
+    /**
+     * Get the time a stage spent working since the boot, wrapping around
+     *
+     * @param stage the stage
+     * @return the busy time, in microseconds (us)
+     */
+    uint32_t getBusyMicros(PipelineStage stage) const;
+
+    /**
+     * Get the largest occupancy of the input queue of a stage since the boot
+     *
+     * @param stage the stage
+     * @return the largest amount of items seen in the queue
+     */
+    int getQueueHighWaterMark(PipelineStage stage) const;
+
+    /**
+     * Get the capacity of the input queue of a stage
+     *
+     * @param stage the stage
+     * @return the capacity of the queue, or 0 if the stage has no input queue
+     */
+    int getQueueCapacity(PipelineStage stage) const;
+
+    /**
+     * Log the share of the time each stage spent working and the occupancy of its queue since
+     * the last report. Must only be called by one task
+     */
+    void printReport();
+};
+
+// Declare the extern instance of the StageMonitor class
+extern StageMonitor stageMonitor;
+
+/**
+ * Class that runs the acquisition, the filter and the encode stages on their own tasks
+ *
+ * The transmit stage is run by the UploadPipeline of the Database, on one task per slot.
+ */
+class StagePipeline {
+    DataReader* dataReader = nullptr;
+    SensorDataBuffer* dataBuffer = nullptr;
+    Database* database = nullptr;
+
+    // Hold the readings between the acquisition and the filter
+    StageQueue<sensorReading, READING_QUEUE_CAPACITY> readingQueue;
+
+    // Store the task of each stage
+    TaskHandle_t tasks[static_cast<int>(PipelineStage::Count)] = {nullptr};
+
+    // Store whether new readings are started
+    std::atomic<bool> acquiring{true};
+
+    // Save the time of the last report of the stages, in milliseconds (ms)
+    unsigned long reportPrevMillis = 0;
+
+    // Run the loop of each stage, on its task
+    static void acquisitionTask(void* pipeline);
+    static void filterTask(void* pipeline);
+    static void encodeTask(void* pipeline);
+
+    // Start the task of a stage, with its configuration
+    bool startTask(PipelineStage stage, void (*function)(void*));
+
+public:
+    /**
+     * Start the tasks of the stages. The acquisition task sets the DataReader up, as its
+     * scheduler wakes up the task that sets it up
+     *
+     * @param reader the DataReader that reads and filters the samples
+     * @param buffer the buffer between the filter and the encode stages
+     * @param db the Database that encodes and transmits the samples
+     * @return true if every task was started, false otherwise
+     */
+    bool setup(DataReader* reader, SensorDataBuffer* buffer, Database* db);
+
+    /**
+     * Stop starting new readings. The readings and the samples already taken still go through
+     * the other stages
+     */
+    void stopAcquisition();
+
+    /**
+     * Get the amount of readings in the queue between the acquisition and the filter
+     *
+     * @return the amount of readings
+     */
+    int getReadingQueueSize() const;
+};
+
+#endif  // Stages_H_
@@ -0,0 +1,107 @@
+#include "StreamTransport.h"
+#include "Clock.h"
+#include "Credentials.h"
+#include "Debug.h"
+
+// Write an unsigned integer to the array in little-endian order and return the next position
+static uint8_t* writeLittleEndian(uint8_t* position, uint64_t value, int size) {
+    for (int i = 0; i < size; i++) {
+        position[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+
+    return position + size;
+}
+
+bool StreamTransport::ensureConnected() {
+    if (client.connected()) {
+        return true;
+    }
+
+    // Avoid blocking the task on a connection attempt every time a batch is sent
+    unsigned long currentMillis = clockMillis();
+    if (attemptedConnection
+            && currentMillis - lastConnectionAttemptMillis < STREAM_RECONNECT_INTERVAL_MILLIS) {
+        return false;
+    }
+    lastConnectionAttemptMillis = currentMillis;
+    attemptedConnection = true;
+
+    client.stop();
+    if (!client.connect(STREAM_SERVER_HOST, STREAM_SERVER_PORT)) {
+        LogErrorln("Could not connect to the collector server"_log);
+        return false;
+    }
+
+    // Send the small frames right away instead of waiting to coalesce them
+    client.setNoDelay(true);
+
+    LogInfoln("Connected to the collector server"_log);
+
+    return sendHello();
+}
+
+bool StreamTransport::sendHello() {
+    uint8_t hello[STREAM_FRAME_HEADER_SIZE + 2 + 6];
+    uint64_t mac = ESP.getEfuseMac();
+
+    uint8_t* position = writeLittleEndian(hello, sizeof(hello) - 4, 4);
+    *position++ = STREAM_FRAME_HELLO;
+    *position++ = STREAM_PROTOCOL_VERSION;
+    *position++ = SENSOR_CHANNEL_COUNT;
+    writeLittleEndian(position, mac, 6);
+
+    return writeFrame(hello, sizeof(hello));
+}
+
+bool StreamTransport::writeFrame(const uint8_t* data, int length) {
+    if (client.write(data, length) != static_cast<size_t>(length)) {
+        // A partially written frame corrupts the stream, so the connection is restarted
+        LogErrorln("Could not write the frame to the collector server"_log);
+        client.stop();
+        return false;
+    }
+
+    return true;
+}
+
+void StreamTransport::beginBatch() {
+    frameLength = STREAM_FRAME_HEADER_SIZE + STREAM_BATCH_HEADER_SIZE;
+    sampleCount = 0;
+}
+
+bool StreamTransport::appendSample(unsigned long long timestampMillis, const sensorData* data) {
+    if (sampleCount >= STREAM_MAX_BATCH_SAMPLES) {
+        return false;
+    }
+
+    uint8_t* position = writeLittleEndian(&frame[frameLength], timestampMillis, 8);
+    for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+        position = writeLittleEndian(position, data->pressureSensor[i], 2);
+    }
+
+    frameLength += STREAM_SAMPLE_SIZE;
+    sampleCount++;
+
+    return true;
+}
+
+int StreamTransport::getSampleCount() const {
+    return sampleCount;
+}
+
+int StreamTransport::getFrameLength() const {
+    return frameLength;
+}
+
+bool StreamTransport::sendBatch() {
+    if (!ensureConnected()) {
+        return false;
+    }
+
+    // Fill the headers now that the amount of samples is known
+    uint8_t* position = writeLittleEndian(frame, frameLength - 4, 4);
+    *position++ = STREAM_FRAME_BATCH;
+    writeLittleEndian(position, sampleCount, 2);
+
+    return writeFrame(frame, frameLength);
+}
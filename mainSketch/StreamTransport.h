@@ -0,0 +1,126 @@
+/*
+    StreamTransport.h
+
+    * This module handles an alternative transport to send the collected data, streaming
+    it over a single long-lived TCP connection instead of one Firebase REST call per batch.
+    * The samples are sent in binary, length-prefixed frames, to a collector server that is
+    responsible for forwarding them to the database.
+    * It also keeps statistics of the data sent, to compare it with the Firebase transport.
+
+    Frame format (little-endian):
+    * [uint32 frame length, excluding this field][uint8 frame type][frame body]
+    * Hello frame (sent on every new connection): [uint8 version][uint8 sensor count][6 bytes MAC]
+    * Batch frame: [uint16 sample count] followed, for each sample, by
+    [uint64 timestamp in milliseconds][uint16 value of each pressure sensor]
+*/
+
+#ifndef StreamTransport_H_
+#define StreamTransport_H_
+
+#include <WiFi.h>
+
+#include "Buffer.h"
+
+// Define the version of the frame format
+const uint8_t STREAM_PROTOCOL_VERSION = 1;
+
+// Define the types of the frames
+const uint8_t STREAM_FRAME_HELLO = 1;
+const uint8_t STREAM_FRAME_BATCH = 2;
+
+// Define the maximum amount of samples in a single batch frame
+const int STREAM_MAX_BATCH_SAMPLES = 128;
+
+// Define the size of each part of the frames, in bytes
+const int STREAM_FRAME_HEADER_SIZE = 4 + 1;
+const int STREAM_BATCH_HEADER_SIZE = 2;
+const int STREAM_SAMPLE_SIZE = 8 + 2 * SENSOR_CHANNEL_COUNT;
+
+// Set the interval between connection attempts to the collector server, in milliseconds (ms)
+const unsigned long STREAM_RECONNECT_INTERVAL_MILLIS = 1000;
+
+/**
+ * Class that streams the collected data to a collector server over a single long-lived
+ * TCP connection, using binary length-prefixed frames.
+ * The frame is built in a preallocated array, so no heap allocation is needed per batch.
+ */
+class StreamTransport {
+    // Client of the persistent connection to the collector server
+    WiFiClient client;
+
+    // Store the frame being built
+    uint8_t frame[STREAM_FRAME_HEADER_SIZE + STREAM_BATCH_HEADER_SIZE
+                  + STREAM_MAX_BATCH_SAMPLES * STREAM_SAMPLE_SIZE];
+    // Number of bytes used in the frame
+    int frameLength = 0;
+    // Number of samples in the batch frame
+    int sampleCount = 0;
+
+    // Save the time of the last connection attempt, in milliseconds (ms)
+    unsigned long lastConnectionAttemptMillis = 0;
+    // Store whether a connection attempt was already made
+    bool attemptedConnection = false;
+
+    /**
+     * Make sure the connection to the collector server is open, reconnecting if needed
+     * 
+     * @return true if the connection is open, false otherwise
+     */
+    bool ensureConnected();
+
+    /**
+     * Send the hello frame that identifies the device to the collector server
+     * 
+     * @return true if the frame was sent, false otherwise
+     */
+    bool sendHello();
+
+    /**
+     * Write a whole frame to the connection
+     * 
+     * @param data the frame to be written
+     * @param length the length of the frame, in bytes
+     * @return true if the frame was completely written, false otherwise
+     */
+    bool writeFrame(const uint8_t* data, int length);
+
+public:
+
+    /**
+     * Start a new batch frame, discarding the previous one
+     */
+    void beginBatch();
+
+    /**
+     * Append a sample to the batch frame
+     * 
+     * @param timestampMillis the timestamp of the sample, in milliseconds
+     * @param data the sample to be appended
+     * @return true if the sample was appended, false if the batch frame is full
+     */
+    bool appendSample(unsigned long long timestampMillis, const sensorData* data);
+
+    /**
+     * Get the number of samples in the batch frame
+     * 
+     * @return the number of samples in the batch frame
+     */
+    int getSampleCount() const;
+
+    /**
+     * Get the size of the batch frame, in bytes
+     * 
+     * @return the size of the batch frame, in bytes
+     */
+    int getFrameLength() const;
+
+    /**
+     * Send the batch frame to the collector server. The frame is kept if it fails,
+     * so that it can be sent again
+     * 
+     * @return true if the frame was sent, false otherwise
+     */
+    bool sendBatch();
+};
+
+#endif  // StreamTransport_H_
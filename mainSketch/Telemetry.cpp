@@ -0,0 +1,99 @@
+#include <esp_heap_caps.h>
+
+#include "Telemetry.h"
+
+void Telemetry::record(TelemetryStage stage, unsigned long durationMicros) {
+    latencyHistogram* histogram = &histograms[static_cast<int>(stage)];
+
+    // The bucket is the amount of significant bits of the duration
+    int bucket = durationMicros == 0 ? 0 : 32 - __builtin_clz(durationMicros);
+    bucket = min(bucket, TELEMETRY_HISTOGRAM_BUCKETS - 1);
+
+    histogram->buckets[bucket]++;
+    if (durationMicros > histogram->maxMicros) {
+        histogram->maxMicros = durationMicros;
+    }
+}
+
+void Telemetry::countPush(bool success) {
+    pushes++;
+    if (!success) {
+        pushFailures++;
+    }
+}
+
+void Telemetry::countOutage(unsigned long durationMillis, uint32_t samples) {
+    outages++;
+    outageMillis += durationMillis;
+    outageSamples += samples;
+}
+
+void Telemetry::countDroppedSample() {
+    droppedSamples++;
+}
+
+void Telemetry::updateBufferDepth(int depth) {
+    if (depth > bufferHighWaterMark) {
+        bufferHighWaterMark = depth;
+    }
+}
+
+uint32_t Telemetry::getPushCount() const {
+    return pushes;
+}
+
+uint32_t Telemetry::getPushFailureCount() const {
+    return pushFailures;
+}
+
+uint32_t Telemetry::getDroppedSampleCount() const {
+    return droppedSamples;
+}
+
+const latencyHistogram& Telemetry::getHistogram(TelemetryStage stage) const {
+    return histograms[static_cast<int>(stage)];
+}
+
+int Telemetry::serialize(char* snapshot, int capacity) const {
+    int length = snprintf(snapshot, capacity,
+                          "{\"pushes\":%lu,\"pushFailures\":%lu,\"bufferHighWaterMark\":%d,"
+                          "\"outages\":%lu,\"outageMillis\":%lu,\"outageSamples\":%lu,"
+                          "\"droppedSamples\":%lu,"
+                          "\"freeHeap\":%lu,\"minFreeHeap\":%lu,\"largestFreeBlock\":%lu",
+                          static_cast<unsigned long>(pushes),
+                          static_cast<unsigned long>(pushFailures), bufferHighWaterMark,
+                          static_cast<unsigned long>(outages),
+                          static_cast<unsigned long>(outageMillis),
+                          static_cast<unsigned long>(outageSamples),
+                          static_cast<unsigned long>(droppedSamples),
+                          static_cast<unsigned long>(ESP.getFreeHeap()),
+                          static_cast<unsigned long>(ESP.getMinFreeHeap()),
+                          static_cast<unsigned long>(
+                              heap_caps_get_largest_free_block(MALLOC_CAP_8BIT)));
+
+    for (int stage = 0; stage < static_cast<int>(TelemetryStage::Count); stage++) {
+        const latencyHistogram* histogram = &histograms[stage];
+
+        // Only the buckets up to the last non-empty one are sent, to keep the snapshot compact
+        int usedBuckets = TELEMETRY_HISTOGRAM_BUCKETS;
+        while (usedBuckets > 0 && histogram->buckets[usedBuckets - 1] == 0) {
+            usedBuckets--;
+        }
+
+        length += snprintf(snapshot + length, max(capacity - length, 0),
+                           ",\"%s\":{\"maxMicros\":%lu,\"buckets\":[", stageLabels[stage],
+                           static_cast<unsigned long>(histogram->maxMicros));
+
+        for (int i = 0; i < usedBuckets; i++) {
+            length += snprintf(snapshot + length, max(capacity - length, 0), i > 0 ? ",%lu" : "%lu",
+                               static_cast<unsigned long>(histogram->buckets[i]));
+        }
+
+        length += snprintf(snapshot + length, max(capacity - length, 0), "]}");
+    }
+
+    length += snprintf(snapshot + length, max(capacity - length, 0), "}");
+
+    // If the snapshot was truncated, it is not valid JSON
+    return length < capacity ? length : 0;
+}
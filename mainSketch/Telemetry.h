@@ -0,0 +1,159 @@
+/*
+    Telemetry.h
+
+    * This module keeps production telemetry of the sketch: latency histograms of each stage
+    of the data path, counters of the uploads, of the outages and of the samples dropped, the
+    high-water mark of the buffer and the heap usage.
+    * Recording only takes a few integer operations, so it stays enabled in production builds.
+    * The values are cumulative since the boot, so each stage is only written by the task that
+    runs it, and a compact JSON snapshot is periodically sent to the database.
+*/
+
+#ifndef Telemetry_H_
+#define Telemetry_H_
+
+#include <Arduino.h>
+
+// Define the amount of buckets of each histogram. The bucket 0 counts the durations below 1 us
+// and the bucket i counts the durations in [2^(i-1), 2^i) us. The last one also holds the longer
+const int TELEMETRY_HISTOGRAM_BUCKETS = 24;
+
+// Set the interval between the telemetry snapshots sent to the database, in milliseconds (ms)
+const unsigned long TELEMETRY_INTERVAL_MILLIS = 5 * 60 * 1000;
+
+// Define the capacity of the serialized telemetry snapshot, in bytes
+const int TELEMETRY_SNAPSHOT_CAPACITY = 1280;
+
+/**
+ * Enumerate the stages of the data path whose durations are tracked
+ * 
+ * Acquisition: collection of a whole sample, from its start until it is published
+ * AdcWait: wait for a conversion of the external ADCs
+ * Serialization: build of a batch of samples
+ * Upload: call that sends a batch to the database
+ * I2cBus: time spent on the I2C bus by the external ADCs for a whole sample
+ */
+enum class TelemetryStage {
+    Acquisition,
+    AdcWait,
+    Serialization,
+    Upload,
+    I2cBus,
+    Count
+};
+
+/**
+ * Histogram of durations, with power of two buckets
+ */
+struct latencyHistogram {
+    uint32_t buckets[TELEMETRY_HISTOGRAM_BUCKETS] = {0};
+    uint32_t maxMicros = 0;
+};
+
+/**
+ * Class that records the telemetry of the sketch and serializes it into compact snapshots
+ */
+class Telemetry {
+    // Labels of the stages, used as keys of the snapshot
+    const char* stageLabels[static_cast<int>(TelemetryStage::Count)] = {
+        "acquisition", "adcWait", "serialization", "upload", "i2cBus"
+    };
+
+    // Store the histogram of each stage
+    latencyHistogram histograms[static_cast<int>(TelemetryStage::Count)];
+
+    // Count the batches sent and the ones that failed
+    uint32_t pushes = 0;
+    uint32_t pushFailures = 0;
+
+    // Store the largest amount of samples seen in the buffer
+    int bufferHighWaterMark = 0;
+
+    // Count the connection outages, their total duration and the samples taken during them
+    uint32_t outages = 0;
+    uint32_t outageMillis = 0;
+    uint32_t outageSamples = 0;
+
+    // Count the samples dropped as the buffer was full, only written by the data collection
+    uint32_t droppedSamples = 0;
+
+public:
+
+    /**
+     * Record the duration of a stage. Must only be called by the task that runs the stage
+     * 
+     * @param stage the stage that was run
+     * @param durationMicros the duration of the stage, in microseconds (us)
+     */
+    void record(TelemetryStage stage, unsigned long durationMicros);
+
+    /**
+     * Count a batch sent to the database
+     * 
+     * @param success whether the batch was successfully sent
+     */
+    void countPush(bool success);
+
+    /**
+     * Count an outage of the connection, once it is over (see Connectivity.h)
+     * 
+     * @param durationMillis the duration of the outage, in milliseconds (ms)
+     * @param samples the amount of samples taken during the outage
+     */
+    void countOutage(unsigned long durationMillis, uint32_t samples);
+
+    /**
+     * Count a sample dropped by the data collection, as the buffer had no room for it
+     */
+    void countDroppedSample();
+
+    /**
+     * Update the high-water mark of the buffer
+     * 
+     * @param depth the current amount of samples in the buffer
+     */
+    void updateBufferDepth(int depth);
+
+    /**
+     * Get the amount of batches sent to the database, including the ones that failed
+     * 
+     * @return the amount of batches sent
+     */
+    uint32_t getPushCount() const;
+
+    /**
+     * Get the amount of batches that failed to be sent
+     * 
+     * @return the amount of batches that failed
+     */
+    uint32_t getPushFailureCount() const;
+
+    /**
+     * Get the amount of samples dropped as the buffer was full
+     * 
+     * @return the amount of samples dropped
+     */
+    uint32_t getDroppedSampleCount() const;
+
+    /**
+     * Get the histogram of the durations of a stage
+     * 
+     * @param stage the stage
+     * @return the histogram of the stage
+     */
+    const latencyHistogram& getHistogram(TelemetryStage stage) const;
+
+    /**
+     * Serialize a snapshot of the telemetry as a JSON object, including the current heap usage
+     * 
+     * @param snapshot the array of chars to store the snapshot
+     * @param capacity the size of the array
+     * @return the length of the snapshot, or 0 if it didn't fit
+     */
+    int serialize(char* snapshot, int capacity) const;
+};
+
+// Declare the extern instance of the Telemetry class
+extern Telemetry telemetry;
+
+#endif  // Telemetry_H_
@@ -0,0 +1,99 @@
+#include "UploadPipeline.h"
+#include "Clock.h"
+#include "Stages.h"
+#include "Debug.h"
+
+void UploadPipeline::uploadTask(void* pipelineSlot) {
+    uploadSlot* slot = static_cast<uploadSlot*>(pipelineSlot);
+    UploadPipeline* pipeline = slot->pipeline;
+
+    while (true) {
+        // Sleep until a batch is submitted to the slot
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        unsigned long uploadStartMicros = clockMicros();
+        slot->sent = pipeline->transmit(slot, pipeline->transmitContext);
+        slot->uploadMicros = clockMicros() - uploadStartMicros;
+        stageMonitor.addBusyTime(PipelineStage::Transmit, slot->uploadMicros);
+
+        // The release store publishes the result to the encode stage
+        slot->state.store(UploadSlotState::Done, std::memory_order_release);
+
+        TaskHandle_t completionTask = pipeline->completionTask;
+        if (completionTask != nullptr) {
+            xTaskNotifyGive(completionTask);
+        }
+    }
+}
+
+bool UploadPipeline::setup(int pipelineDepth, uploadTransmitFunction transmitFunction,
+                           void* context) {
+    depth = min(max(pipelineDepth, 1), UPLOAD_PIPELINE_MAX_DEPTH);
+    transmit = transmitFunction;
+    transmitContext = context;
+
+    const stageConfig& config = STAGE_CONFIGS[static_cast<int>(PipelineStage::Transmit)];
+    for (int i = 0; i < depth; i++) {
+        slots[i].pipeline = this;
+
+        // The transmissions mostly wait for the network, so they run beside the encode stage
+        if (xTaskCreatePinnedToCore(uploadTask, config.name, config.stackSize, &slots[i],
+                                    config.priority, &slots[i].task, config.core) != pdPASS) {
+            LogErrorln("Could not start the upload task "_log, i);
+            depth = i;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void UploadPipeline::setCompletionTask(TaskHandle_t task) {
+    completionTask = task;
+}
+
+void UploadPipeline::setSlotLimit(int limit) {
+    slotLimit = max(limit, 1);
+}
+
+uploadSlot* UploadPipeline::getFreeSlot() {
+    if (inFlightCount >= min(depth, slotLimit)) {
+        return nullptr;
+    }
+
+    return &slots[(oldestSlot + inFlightCount) % depth];
+}
+
+void UploadPipeline::submitSlot() {
+    uploadSlot* slot = &slots[(oldestSlot + inFlightCount) % depth];
+    inFlightCount++;
+    stageMonitor.updateQueueDepth(PipelineStage::Transmit, inFlightCount, depth);
+
+    slot->state.store(UploadSlotState::InFlight, std::memory_order_release);
+    xTaskNotifyGive(slot->task);
+}
+
+uploadSlot* UploadPipeline::getCompletedSlot() {
+    if (inFlightCount == 0) {
+        return nullptr;
+    }
+
+    // The acquire load pairs with the release store of the upload task
+    uploadSlot* slot = &slots[oldestSlot];
+    if (slot->state.load(std::memory_order_acquire) != UploadSlotState::Done) {
+        return nullptr;
+    }
+
+    return slot;
+}
+
+void UploadPipeline::releaseCompletedSlot() {
+    slots[oldestSlot].state.store(UploadSlotState::Free, std::memory_order_relaxed);
+    oldestSlot = (oldestSlot + 1) % depth;
+    inFlightCount--;
+    stageMonitor.updateQueueDepth(PipelineStage::Transmit, inFlightCount, depth);
+}
+
+int UploadPipeline::getInFlightCount() const {
+    return inFlightCount;
+}
@@ -0,0 +1,184 @@
+/*
+    UploadPipeline.h
+
+    * This module overlaps the serialization of the batches with their transmission: while a
+    batch is in flight, the next ones are built in other slots, up to the depth of the pipeline.
+    * Each slot holds its own serialized body and its own connection to the database, and is
+    sent by its own upload task (Core 0), so the requests don't wait for each other. The
+    connection of a free slot can be lent to the other requests of the database task.
+    * Each slot costs the RAM of its body (JSON_BATCH_CAPACITY, reserved with the slot), the
+    stack of its upload task (see STAGE_CONFIGS) and the heap kept by its connection, mostly its
+    TLS session, which the device measures and logs when the connection is first opened.
+    * The batches complete in order: a batch is only handed back once all the older ones were,
+    so that the samples are still released from the buffer and from the spool in order.
+*/
+
+#ifndef UploadPipeline_H_
+#define UploadPipeline_H_
+
+#include <atomic>
+
+#include <FirebaseESP32.h>
+
+#include "ChangeFilter.h"
+#include "JsonBatch.h"
+
+// Define the largest depth of the pipeline. Each slot reserves the memory of a JSON body and
+// holds a connection to the database once it was used
+const int UPLOAD_PIPELINE_MAX_DEPTH = 4;
+
+// Define the capacity of the path of the database node that receives a batch, in bytes
+const int DATABASE_PATH_CAPACITY = 64;
+
+/**
+ * Enumerate the states of a slot
+ *
+ * Free: the slot can receive a new batch
+ * InFlight: the batch was handed to the upload task of the slot
+ * Done: the batch was sent or failed, waiting to be completed in order
+ */
+enum class UploadSlotState : uint8_t {
+    Free,
+    InFlight,
+    Done
+};
+
+class UploadPipeline;
+
+/**
+ * Struct of a batch slot: the batch, its connection and what it covers
+ *
+ * The fields are written by the database task while the slot is Free, and by the upload task
+ * while it is InFlight, so they never need a lock.
+ */
+struct uploadSlot {
+    // Store the serialized batch, and hand it to the database library as a JSON object
+    JsonBatch jsonBatch;
+    FirebaseJson jsonBuffer;
+    // Keep the connection of the slot to the database
+    FirebaseData fbdo;
+    // Store the path of the database node that receives the batch
+    char path[DATABASE_PATH_CAPACITY];
+
+    // Count the samples of the batch, and the samples of the buffer and the records of the
+    // spool that it covers (the filtered samples are covered but not sent)
+    int sampleCount = 0;
+    int bufferCount = 0;
+    int spoolCount = 0;
+    // Store the size of the body, in bytes
+    int length = 0;
+
+    // Store the state of the change filter and the validity of the last sample after the
+    // batch, kept once the batch is sent
+    changeFilterState filterState;
+    bool lastWasValid = true;
+
+    // Store the result of the transmission and its duration, in microseconds (us)
+    bool sent = false;
+    unsigned long uploadMicros = 0;
+    // Store the heap kept by the connection once it was opened, in bytes, 0 until measured
+    uint32_t connectionHeapBytes = 0;
+
+    std::atomic<UploadSlotState> state{UploadSlotState::Free};
+    // Store the upload task of the slot and the pipeline that runs it
+    TaskHandle_t task = nullptr;
+    UploadPipeline* pipeline = nullptr;
+};
+
+/**
+ * Send a batch through the selected transport. It runs on the upload task of the slot
+ *
+ * @param slot the slot to be sent
+ * @param context the context given to UploadPipeline::setup()
+ * @return true if the batch was sent, false otherwise
+ */
+typedef bool (*uploadTransmitFunction)(uploadSlot* slot, void* context);
+
+/**
+ * Class that runs the transmissions of the batch slots on their upload tasks and hands them
+ * back in order
+ *
+ * The slots are used as a ring: a batch is built in getFreeSlot(), sent by submitSlot(), and
+ * completed with getCompletedSlot() and releaseCompletedSlot(), always from the oldest one.
+ */
+class UploadPipeline {
+    uploadSlot slots[UPLOAD_PIPELINE_MAX_DEPTH];
+
+    // Store the amount of slots used, and the amount of them that can be in flight
+    int depth = 1;
+    int slotLimit = UPLOAD_PIPELINE_MAX_DEPTH;
+    // Store the position of the oldest slot in flight, and the amount of slots in flight
+    int oldestSlot = 0;
+    int inFlightCount = 0;
+
+    uploadTransmitFunction transmit = nullptr;
+    void* transmitContext = nullptr;
+
+    // Store the task notified when a batch is done, if any
+    TaskHandle_t completionTask = nullptr;
+
+    // Wait for the batches of a slot and send them, on the upload task of the slot
+    static void uploadTask(void* pipelineSlot);
+
+public:
+    /**
+     * Start the upload tasks of the slots
+     *
+     * @param pipelineDepth the amount of batches in flight at most, up to
+     * UPLOAD_PIPELINE_MAX_DEPTH
+     * @param transmitFunction the function that sends the batch of a slot
+     * @param context the context passed to the function
+     * @return true if the upload tasks were started, false otherwise
+     */
+    bool setup(int pipelineDepth, uploadTransmitFunction transmitFunction, void* context);
+
+    /**
+     * Set the task to be notified when a batch is done, so that it can sleep while the
+     * batches are in flight
+     *
+     * @param task the task that completes the slots
+     */
+    void setCompletionTask(TaskHandle_t task);
+
+    /**
+     * Limit the amount of batches in flight below the depth of the pipeline, for example to
+     * hold fewer connections at once. The batches already in flight complete normally
+     *
+     * @param limit the amount of batches in flight at most
+     */
+    void setSlotLimit(int limit);
+
+    /**
+     * Get the slot where the next batch can be built. Until the batch is submitted, the
+     * connection of the slot is idle, so it can also carry other requests of the caller
+     *
+     * @return the next slot, or nullptr if the pipeline is full or at its limit
+     */
+    uploadSlot* getFreeSlot();
+
+    /**
+     * Send the batch built in the slot returned by getFreeSlot()
+     */
+    void submitSlot();
+
+    /**
+     * Get the oldest slot in flight, once its transmission is done
+     *
+     * @return the oldest slot, or nullptr if it is still being sent or nothing is in flight
+     */
+    uploadSlot* getCompletedSlot();
+
+    /**
+     * Free the slot returned by getCompletedSlot()
+     */
+    void releaseCompletedSlot();
+
+    /**
+     * Get the amount of batches in flight, including the ones done but not completed yet
+     *
+     * @return the amount of batches in flight
+     */
+    int getInFlightCount() const;
+};
+
+#endif  // UploadPipeline_H_
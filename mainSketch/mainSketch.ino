@@ -8,19 +8,29 @@
 
 #include "Errors.h"
 #include "Credentials.h"
+#include "Connectivity.h"
 #include "Network.h"
 #include "Buffer.h"
 #include "DataReader.h"
 #include "Database.h"
+#include "Telemetry.h"
+#include "AsyncLog.h"
+#include "Stages.h"
 
 // Create a errors object to handle them and show them on the RGB LED
 Errors errorHandler;
 
-// Create a task to assign the data push to the database to Core 0
-TaskHandle_t sendToDatabaseTask;
+// Create the asynchronous log that takes the Serial printing off the other tasks
+AsyncLog asyncLog;
 
-// Create an ExternalADCs object to read the data from the external ADCs
-ExternalADCs externalAdcs;
+// Create a telemetry object to keep the latency histograms and counters of the data path
+Telemetry telemetry;
+
+// Create a connectivity object to keep the WiFi connection up and gate the pushes to the database
+Connectivity connectivity;
+
+// Create a stage monitor to account the work of the stages of the data path
+StageMonitor stageMonitor;
 
 // Create a buffer to store the data to be sent to the database
 SensorDataBuffer dataBuffer;
@@ -31,63 +41,44 @@ DataReader dataReader;
 // Create a Database object to send the data to the database
 Database database;
 
+// Create the stages of the data path, each one on its own task
+StagePipeline stagePipeline;
+
 // Initialization void
 void setup() {
     Serial.begin(115200);  // Open the Serial Port for communication with baudrate 115200
+    asyncLog.setup();  // Start the task that writes the log messages to the Serial Port
     Wire.begin();  // Start the I2C communication
 
-    // Setup the sensors
-    if(!dataReader.setup()){
-        errorHandler.showError(ErrorType::ExternalADCInitFailure, true);
-    }
-
-    // Setup WiFi connection
-    setupWiFi();
-
-    // Sync the device's time with an NTP Server time
-    syncWithNTPTime();
+    // Start the WiFi connection. It is completed in the background, the NTP sync and the
+    // reconnections are handled by the encode stage, so the data collection starts right away
+    connectivity.setup();
 
     // Setup the Firebase Database connection
-    database.setup(getCurrentTime());
-
-    // Assign the task of sending data to the database to Core 0
-    xTaskCreatePinnedToCore(
-        sendToDatabase,          // Task function
-        "sendToDatabaseLoop",    // Name of task
-        10000,                   // Stack size of task
-        NULL,                    // Parameter of the task
-        1,                       // Priority of the task
-        &sendToDatabaseTask,     // Task handle to keep track of created task
-        0);                      // Pin task to core 0
+    database.setup();
+
+    // Start the tasks of the stages: acquisition and filter on Core 1, encode on Core 0 (see
+    // Stages.h). The sensors are set up by the acquisition task
+    if (!stagePipeline.setup(&dataReader, &dataBuffer, &database)) {
+        // Without all the stages the data can't flow, so the device tries again from a reboot
+        Serial.println("Could not start the stages of the data path, restarting");
+        delay(3000);
+        ESP.restart();
+    }
 
     // Sanity delay
     delay(100);
 
-    // Register the boot on the database ("/bootLog")
-    database.bootLog();
-
-    errorHandler.showError(ErrorType::None);
+    // The boot is registered on the database ("/bootLog") by the encode stage, once the
+    // connection works
 }
 
-// Main loop, that keep running on Core 1
+// Main loop, the stages run on their own tasks
 void loop() {
     // Disable the watchdog of Core 0, avoiding reboots caused by
-    // the working time of the sendToDatabase task
+    // the working time of the encode stage
     disableCore0WDT();
 
-    dataReader.fillBuffer(&dataBuffer);
-}
-
-// Task attached to core 0
-void sendToDatabase(void* pvParameters) {
-    // A loop that runs forever to keep sending data to the database
-    while (true) {
-        // If the buffer is empty, wait for the data collection task to fill it
-        if (!dataBuffer.isBufferEmpty()) {
-            database.sendData(&dataBuffer);
-        } else {
-            vTaskDelay(10);
-            yield();
-        }
-    }
+    // The loop task isn't needed anymore
+    vTaskDelete(NULL);
 }